@@ -3,10 +3,16 @@
 #include "App.hpp"
 
 #include "utility.hpp"
+#include "AsyncMeshLoader.hpp"
+#include "Benchmark.hpp"
+#include "MeshCache.hpp"
+#include "ModelLoader.hpp"
+#include "3d/QuadricSimplifier.hpp"
 #include "base/Main.hpp"
 #include "gpu/GLContext.hpp"
 #include "gpu/Buffer.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cstddef>
@@ -30,6 +36,21 @@ enum VertexShaderAttributeLocations {
 	ATTRIB_COLOR = 2
 };
 
+// Size of the simplified mesh (key 5) relative to the loaded one.
+const float simplified_fraction = 0.25f;
+
+// Time per frame for applying vertex splits to a progressive mesh, and
+// the splits applied between looks at the clock.
+const float progressive_seconds_per_frame = 0.004f;
+const int progressive_splits_per_check = 256;
+
+// Vertex splits per batch read on the loader's pool.
+const int progressive_splits_per_read = 1024;
+
+// Moved corners of a progressive mesh at most this far apart in the index
+// buffer are uploaded as one range.
+const size_t progressive_patch_gap = 1024;
+
 const Vertex reference_plane_data[] = {
 	{ Vec3f(-1, -1, -1), Vec3f(0, 1, 0) },
 	{ Vec3f( 1, -1, -1), Vec3f(0, 1, 0) },
@@ -39,7 +60,7 @@ const Vertex reference_plane_data[] = {
 	{ Vec3f(-1, -1,  1), Vec3f(0, 1, 0) }
 };
 
-vector<Vertex> loadExampleModel() {
+IndexedMesh loadExampleModel() {
 	static const Vertex example_data[] = {
 		{ Vec3f( 0.0f,  0.5f, 0), Vec3f(0.0f, 0.0f, -1.0f) },
 		{ Vec3f(-0.5f, -0.5f, 0), Vec3f(0.0f, 0.0f, -1.0f) },
@@ -48,43 +69,15 @@ vector<Vertex> loadExampleModel() {
 	vector<Vertex> vertices;
 	for (auto v : example_data)
 		vertices.push_back(v);
-	return vertices;
+	IndexedMesh mesh;
+	indexTriangleSoup(vertices, mesh);
+	return mesh;
 }
 
-vector<Vertex> unpackIndexedData(
-	const vector<Vec3f>& positions,
-	const vector<Vec3f>& normals,
-	const vector<array<unsigned, 6>>& faces)
-{
-	vector<Vertex> vertices;
-	Vertex v0, v1, v2;
-
-	// This is a 'range-for' loop which goes through all objects in the container 'faces'.
-	// '&' gives us a reference to the object inside the container; if we omitted '&',
-	// 'f' would be a copy of the object instead.
-	// The compiler already knows the type of objects inside the container, so we can
-	// just write 'auto' instead of having to spell out 'array<unsigned, 6>'.
-	for (auto& f : faces) {
-
-		// YOUR CODE HERE (R3)
-		// Unpack the indexed data into a vertex array. For every face, you have to
-		// create three vertices and add them to the vector 'vertices'.
-
-		// f[0] is the index of the position of the first vertex
-		// f[1] is the index of the normal of the first vertex
-		// f[2] is the index of the position of the second vertex
-		// ...
-		v0.position = positions[f[0]]; v1.position = positions[f[2]]; v2.position = positions[f[4]];
-		v0.normal = normals[f[1]]; v1.normal = normals[f[3]]; v2.normal = normals[f[5]];
-		vertices.push_back(v0); vertices.push_back(v1); vertices.push_back(v2);
-	}
-
-	return vertices;
-};
-
-// This is for testing your unpackIndexedData implementation.
+// Indexed data is kept indexed: every distinct (position, normal) pair of
+// the faces becomes one vertex, see buildIndexedMesh().
 // You should get a tetrahedron like in example.exe.
-vector<Vertex> loadIndexedDataModel() {
+IndexedMesh loadIndexedDataModel() {
 	static const Vec3f point_data[] = {
 		Vec3f(0.0f, 0.407f, 0.0f),
 		Vec3f(0.0f, -0.3f, -0.5f),
@@ -111,12 +104,14 @@ vector<Vertex> loadIndexedDataModel() {
 		copy(arr, arr+6, f.begin());
 		faces.push_back(f);
 	}
-	return unpackIndexedData(points, normals, faces);
+	IndexedMesh mesh;
+	buildIndexedMesh(points, normals, faces, mesh);
+	return mesh;
 }
 
 // Generate an upright cone with tip at (0, 0, 0), a radius of 0.25 and a height of 1.0.
 // You can leave the base of the cone open, like it is in example.exe.
-vector<Vertex> loadUserGeneratedModel() {
+IndexedMesh loadUserGeneratedModel() {
 	static const float radius = 0.25f;
 	static const float height = 1.0f;
 	static const unsigned faces = 40;
@@ -156,7 +151,47 @@ vector<Vertex> loadUserGeneratedModel() {
 		v0.normal = v1.normal = v2.normal = (cross((v2.position - v0.position), (v1.position - v0.position)).normalized());
 		vertices.push_back(v0); vertices.push_back(v1); vertices.push_back(v2);
 	}
-	return vertices;
+	IndexedMesh mesh;
+	indexTriangleSoup(vertices, mesh);
+	return mesh;
+}
+
+// Wavefront OBJ or Stanford PLY, chosen by the file extension.
+bool loadModelFile(const string& filename, IndexedModel& model) {
+	bool is_obj = filename.size() >= 3 && filename.compare(filename.size() - 3, 3, "obj") == 0;
+	return is_obj ? loadObjMapped(filename, model) : loadPly(filename, model);
+}
+
+// Runs on a thread pool thread, see App::startFileLoad(). The processed mesh
+// comes from the cache when possible; otherwise the file is parsed, indexed
+// and, for the simplified model, decimated, checking for cancellation in
+// between.
+bool loadMeshFile(MeshCache& cache, const string& filename, bool simplified, IndexedMesh& mesh, AsyncMeshLoader::Job& job) {
+	// Quadric error simplification down to a fraction of the input, keeping
+	// open boundaries and normal seams in place. Points closer than half the
+	// mean edge length may merge even without an edge.
+	SimplifyParams params;
+	params.pairDistance = 0.5f;
+
+	string variant = simplified ? sprintf("quadric-%g-%g", simplified_fraction, params.pairDistance).getPtr() : "indexed";
+	job.setProgress("reading cache", 0.0f);
+	return cache.load(filename, variant, mesh, [&](IndexedMesh& out) {
+		IndexedModel model;
+		job.setProgress("parsing", 0.05f);
+		if (!loadModelFile(filename, model) || job.isCancelled())
+			return false;
+
+		job.setProgress("indexing", 0.4f);
+		buildIndexedMesh(model, out);
+		if (simplified) {
+			job.setProgress("simplifying", 0.5f);
+			params.targetTriangles = (int)(out.indices.size() / 3 * simplified_fraction);
+			simplifyIndexedMesh(out, params);
+			if (job.isCancelled())
+				return false;
+		}
+		return true;
+	});
 }
 
 }
@@ -167,6 +202,9 @@ App::App(void)
 	model_changed_(true),
 	shading_toggle_(false),
 	shading_mode_changed_(false),
+	vertex_capacity_(0),
+	index_capacity_(0),
+	progressive_job_(0),
 	camera_rotation_angle_(0.0f),
 	camera_z_angle_(0.0f),
 	translation_(Vec3f(0.0f, 0.0f, 0.0f)),
@@ -185,7 +223,7 @@ App::App(void)
 	common_ctrl_.addToggle((S32*)&current_model_, MODEL_USER_GENERATED,		FW_KEY_2, "Generated cone (2)",			&model_changed_);
 	common_ctrl_.addToggle((S32*)&current_model_, MODEL_FROM_INDEXED_DATA,	FW_KEY_3, "Unpacked tetrahedron (3)",	&model_changed_);
 	common_ctrl_.addToggle((S32*)&current_model_, MODEL_FROM_FILE,			FW_KEY_4, "Model loaded from file (4)",	&model_changed_);
-	common_ctrl_.addToggle((S32*)& current_model_, MODEL_FROM_FILE2,		FW_KEY_5, "Model loaded from file mesh simplified (4)", &model_changed_);
+	common_ctrl_.addToggle((S32*)& current_model_, MODEL_FROM_FILE2,		FW_KEY_5, "Model loaded from file, simplified (5)",		&model_changed_);
 	common_ctrl_.addSeparator();
 	common_ctrl_.addToggle(&shading_toggle_,								FW_KEY_T, "Toggle shading mode (T)",	&shading_mode_changed_);
 
@@ -203,49 +241,70 @@ bool App::handleEvent(const Window::Event& ev) {
 	}
 	if (model_changed_)	{
 		model_changed_ = false;
+
+		// Switching models abandons any load in progress.
+		loader_.cancelAll();
+		stopProgressiveLoad();
 		switch (current_model_)
 		{
 		case MODEL_EXAMPLE:
-			vertices_ = loadExampleModel();
+			mesh_ = loadExampleModel();
 			break;
 		case MODEL_FROM_INDEXED_DATA:
-			vertices_ = loadIndexedDataModel();
+			mesh_ = loadIndexedDataModel();
 			break;
 		case MODEL_USER_GENERATED:
-			vertices_ = loadUserGeneratedModel();
+			mesh_ = loadUserGeneratedModel();
 			break;
 		case MODEL_FROM_FILE:
+		case MODEL_FROM_FILE2:
 			{
 				auto filename = window_.showFileLoadDialog("Load new mesh");
-				if (filename.getLength()) {
-					vertices_ = loadObjFileModel(filename.getPtr());
+				if (filename.toLower().endsWith(".pmesh")) {
+					startProgressiveLoad(filename.getPtr());
+				} else if (filename.getLength()) {
+					startFileLoad(filename.getPtr(), current_model_ == MODEL_FROM_FILE2);
 				} else {
 					current_model_ = MODEL_EXAMPLE;
 					model_changed_ = true;
 				}
 			}
 			break;
-		case MODEL_FROM_FILE2:
-		{
-			auto filename = window_.showFileLoadDialog("Load new mesh");
-			if (filename.getLength()) {
-				vertices_ = loadObjFileModel2(filename.getPtr());
-			}
-			else {
-				current_model_ = MODEL_EXAMPLE;
-				model_changed_ = true;
-			}
-		}
-		break;
 		default:
 			assert(false && "invalid model type");
 		}
-		// Load the vertex buffer to GPU.
-		glBindBuffer(GL_ARRAY_BUFFER, gl_.dynamic_vertex_buffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices_.size(), vertices_.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		uploadMesh();
 	}
-	
+
+	// File models load in the background; the previous model stays on
+	// screen until the new one is ready.
+	AsyncMeshLoader::Result loaded;
+	while (loader_.poll(loaded)) {
+		if (progressive_ && loaded.id == progressive_job_) {
+			// Everything is read; refineProgressive() applies the rest.
+			if (!loaded.ok) {
+				common_ctrl_.message(sprintf("Failed to load '%s': %s", loaded.name.c_str(), loaded.error.c_str()));
+				stopProgressiveLoad();
+			}
+			continue;
+		}
+		if (!loaded.ok) {
+			common_ctrl_.message(sprintf("Failed to load '%s': %s", loaded.name.c_str(), loaded.error.c_str()));
+			continue;
+		}
+		mesh_ = move(loaded.mesh);
+		uploadMesh();
+		common_ctrl_.message(sprintf("Loaded mesh from %s: %d vertices, %d triangles in %.2f s (%s)",
+			loaded.name.c_str(), (int)mesh_.vertices.size(), (int)mesh_.indices.size() / 3, loaded.seconds,
+			cacheStatsString().c_str()));
+	}
+	AsyncMeshLoader::Progress progress;
+	if (loader_.getProgress(progress))
+		common_ctrl_.message(sprintf("Loading %s: %s (%d%%)", progress.name.c_str(), progress.stage.c_str(),
+			(int)(progress.fraction * 100.0f)), "loading");
+	else
+		common_ctrl_.message("", "loading");
+
 	if (shading_mode_changed_) {
 		common_ctrl_.message(shading_toggle_ ?
 			"Directional light shading using vertex normals; direction to light (0.5, 0.5, -0.6)" :
@@ -334,8 +393,10 @@ bool App::handleEvent(const Window::Event& ev) {
 
 
 	window_.setVisible(true);
-	if (ev.type == Window::EventType_Paint)
+	if (ev.type == Window::EventType_Paint) {
+		refineProgressive();
 		render();
+	}
 
 	window_.repaint();
 
@@ -373,6 +434,7 @@ void App::initRendering() {
 	glGenVertexArrays(1, &gl_.dynamic_vao);
 	glGenBuffers(1, &gl_.static_vertex_buffer);
 	glGenBuffers(1, &gl_.dynamic_vertex_buffer);
+	glGenBuffers(1, &gl_.dynamic_index_buffer);
 	
 	// Set up vertex attribute object for static data.
 	glBindVertexArray(gl_.static_vao);
@@ -386,7 +448,9 @@ void App::initRendering() {
 	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * SIZEOF_ARRAY(reference_plane_data), reference_plane_data, GL_STATIC_DRAW);
 	
 	// Set up vertex attribute object for dynamic data. We'll load the actual data later, whenever the model changes.
+	// The index buffer binding is part of the VAO state.
 	glBindVertexArray(gl_.dynamic_vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl_.dynamic_index_buffer);
 	glBindBuffer(GL_ARRAY_BUFFER, gl_.dynamic_vertex_buffer);
 	glEnableVertexAttribArray(ATTRIB_POSITION);
 	glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*) 0);
@@ -524,7 +588,7 @@ void App::render() {
 	glUniformMatrix4fv(gl_.model_to_world_uniform, 1, GL_FALSE, modelToWorld.getPtr());
 	glUniformMatrix4fv(gl_.model_to_world_transposed_uniform, 1, GL_FALSE, modelToWorld_T.getPtr());
 	glBindVertexArray(gl_.dynamic_vao);
-	glDrawArrays(GL_TRIANGLES, 0, vertices_.size());
+	glDrawElements(GL_TRIANGLES, (GLsizei)mesh_.indices.size(), GL_UNSIGNED_INT, (GLvoid*)0);
 
 	// Undo our bindings.
 	glBindVertexArray(0);
@@ -540,613 +604,167 @@ void App::render() {
 		-FW::cos(camera_rotation_angle_) * camera_distance), "camerainfo");
 }
 
-vector<Vertex> App::loadObjFileModel(string filename) {
-	window_.showModalMessage(sprintf("Loading mesh from '%s'...", filename.c_str()));
-
-	vector<Vec3f> positions, normals;
-	vector<array<unsigned, 6>> faces;
-
-	// Open input file stream for reading.
-	ifstream input(filename, ios::in);
-	string line;
-	int face_number = 0, vertex_number = 0, normal_number = 0;
-	string word;
-
-	// FORMAT: 0 AASCI - 1 BIG ENDIAN - 2 LITTLE ENDIAN
-	int format = 0;
-
-	if (filename.compare(filename.size() - 3, 3, "obj") == 0) {
-		// Read the file line by line.
-
-		while (getline(input, line)) {
-			// Replace any '/' characters with spaces ' ' so that all of the
-			// values we wish to read are separated with whitespace.
-			for (auto& c : line)
-				if (c == '/')
-					c = ' ';
-
-			// Temporary objects to read data into.
-			array<unsigned, 6>  f; // Face index array
-			Vec3f               v;
-			string              s;
-
-			// Create a stream from the string to pick out one value at a time.
-			istringstream        iss(line);
-
-			// Read the first token from the line into string 's'.
-			// It identifies the type of object (vertex or normal or ...)
-			iss >> s;
-
-			if (s == "v") { // vertex position
-				// YOUR CODE HERE (R4)
-				float a, b, c;
-				iss >> a;
-				iss >> b;
-				iss >> c;
-				// Read the three vertex coordinates (x, y, z) into 'v'.
-				v = Vec3f(a, b, c);
-				positions.push_back(v);
-				// Store a copy of 'v' in 'positions'.
-				// See std::vector documentation for push_back.
-			}
-			else if (s == "vn") { // normal
-			 // YOUR CODE HERE (R4)
-			 // Similar to above.
-				float a, b, c;
-				iss >> a;
-				iss >> b;
-				iss >> c;
-				v = Vec3f(a, b, c);
-				normals.push_back(v);
-			}
-			else if (s == "f") { // face
-			 // YOUR CODE HERE (R4)
-			 // Read the indices representing a face and store it in 'faces'.
-			 // The data in the file is in the format
-			 // f v1/vt1/vn1 v2/vt2/vn2 ...
-			 // where vi = vertex index, vti = texture index, vni = normal index.
-			 //
-			 // Remember we already replaced the '/' characters with whitespaces.
-			 //
-			 // Since we are not using textures in this exercise, you can ignore
-			 // the texture indices by reading them into a temporary variable.
-				unsigned sink; // Temporary variable for reading the unused texture indices.
-				unsigned temp;
-				int discarded = 0;
-				for (int i = 0; i < 9; i++) {
-					if (i % 3 == 1) {
-						iss >> sink;
-						discarded++;
-					}
-					else {
-						iss >> temp;
-						f[i - discarded] = temp - 1;
-					}
-				}
-				faces.push_back(f);
-
-				// Note that in C++ we index things starting from 0, but face indices in OBJ format start from 1.
-				// If you don't adjust for that, you'll index past the range of your vectors and get a crash.
+void App::startFileLoad(string filename, bool simplified) {
+	MeshCache* cache = &mesh_cache_;
+	loader_.start(filename, [=](IndexedMesh& mesh, AsyncMeshLoader::Job& job) {
+		return loadMeshFile(*cache, filename, simplified, mesh, job);
+	});
+}
 
-				// It might be a good idea to print the indices to see that they were read correctly.
-				// cout << f[0] << " " << f[1] << " " << f[2] << " " << f[3] << " " << f[4] << " " << f[5] << endl;
-			}
-		}
-	}
-	// PLY files
-	else {
-		// Temporary objects to read data into.
-		array<unsigned, 6>  f; // Face index array
-		Vec3f               v;
-		string              s;
-
-		while (getline(input, line)) {
-			istringstream iss(line);
-			iss >> word;
-			if (word.compare("end_header") == 0)
-				break;
-			if (word.compare("element") == 0) {
-				iss >> word;
-				if (word.compare("vertex") == 0) {
-					iss >> vertex_number;
-				}
-				else if (word.compare("face") == 0) {
-					iss >> face_number;
-				}
-			}
-			else if (word.compare("format") == 0) {
-				iss >> word;
-				if (word.compare("ascii") == 0) {
-					format = 0;
-				}
-				else if (word.compare("binary_big_endian") == 0) {
-					format = 1;
-				}
-				else if (word.compare("binary_little_endian") == 0) {
-					format = 2;
-				}
-			}
+// Reads the file on the loader's pool; refineProgressive() shows the base
+// mesh as soon as it is in and adds the detail as it arrives.
+void App::startProgressiveLoad(const string& filename) {
+	shared_ptr<ProgressiveLoad> load(new ProgressiveLoad);
+	load->name = filename;
+	load->has_base = false;
+	load->shown = false;
+	load->applied = 0;
+	progressive_ = load;
+	progressive_job_ = loader_.start(filename, [load](IndexedMesh&, AsyncMeshLoader::Job& job) {
+		job.setProgress("base mesh", 0.0f);
+		load->file.reset(new File(load->name.c_str(), File::Read));
+		load->stream.reset(new BufferedInputStream(*load->file));
+		load->reader.reset(new ProgressiveMeshReader(*load->stream));
+		ProgressiveMeshReader& reader = *load->reader;
+		if (!reader.getMesh())
+			return false;
+		load->lock.enter();
+		load->has_base = true;
+		load->lock.leave();
+
+		while (reader.getNumRead() < reader.getNumSplits()) {
+			if (job.isCancelled())
+				return false;
+			unique_ptr<Array<U8>> batch(new Array<U8>);
+			reader.readSplits(*batch, progressive_splits_per_read);
+			if (hasError())
+				return false;
+			load->lock.enter();
+			load->read.push_back(move(batch));
+			load->lock.leave();
+			job.setProgress("vertex splits", (F32)reader.getNumRead() / (F32)reader.getNumSplits());
 		}
+		return true;
+	});
+}
 
-		// TODO: ADD BINARY SUPPORT AND POLYGONS
+// Called once per frame. Applies the vertex splits read so far until the
+// frame's time is up, then uploads only what they changed.
+void App::refineProgressive() {
+	if (!progressive_)
+		return;
+	ProgressiveLoad& load = *progressive_;
+
+	load.lock.enter();
+	bool has_base = load.has_base;
+	for (auto& batch : load.read)
+		load.ready.push_back(move(batch));
+	load.read.clear();
+	load.lock.leave();
+	if (!has_base)
+		return;
+
+	ProgressiveMeshReader& reader = *load.reader;
+	if (!load.shown) {
+		buildIndexedMesh(*reader.getMesh(), mesh_);
+		uploadMesh(reader.getFinalNumVertices(), (size_t)reader.getFinalNumTriangles() * 3);
+		load.shown = true;
+	}
 
-		// VERTEX READING
-		float a, b, c, sink;
-		for (int i = 0; i < vertex_number; i++) {
-			getline(input, line);
-			istringstream iss(line);
-			iss >> a >> b >> c;
-			v = Vec3f(a, b, c);
-			positions.push_back(v);
+	size_t old_vertices = mesh_.vertices.size();
+	size_t old_indices = mesh_.indices.size();
+	progressive_moved_.clear();
+	Timer timer(true);
+	while (load.ready.size() && timer.getElapsed() < progressive_seconds_per_frame) {
+		const Array<U8>& batch = *load.ready.front();
+		const U8* end = batch.getPtr() + batch.getSize();
+		const U8* next = reader.applySplits(batch.getPtr(load.applied), end, progressive_splits_per_check, &progressive_moved_);
+		load.applied = (int)(next - batch.getPtr());
+		if (next == end) {
+			load.ready.pop_front();
+			load.applied = 0;
 		}
-		// FACES READING
-		for (int i = 0; i < face_number; i++) {
-			getline(input, line);
-			istringstream iss(line);
-
-			iss >> sink;
-			vector<int> temp;
-			Vec3f e1, e2;
-			//std::cout << "Face n. " << i << endl;
-			//std::cout << sink << " vertices" << endl;
-			for (int j = 0; j < sink; j++) {
-				iss >> a;
-				//std::cout << a << " ";
-				temp.push_back(a);
-			}
-			//std::cout << endl << endl;
-
-			// EAR CLIPPING ALGORITHM
-			while (temp.size() > 3) {
-
-				int index = 0;
-				bool not_found = true;
-				while (not_found) {
-
-					// SEE IF VERTEX IS CONVEX
-					
-					int pos_a, pos_b, pos_c, ind_a, ind_b, ind_c;
-					pos_b = temp[index];
-					ind_b = index;
-					if (index == 0) {
-						pos_a = temp[temp.size() - 1];
-						ind_a = temp.size() - 1;
-					}
-					else {
-						pos_a = temp[index - 1];
-						ind_a = index - 1;
-					}
-					if (index == temp.size() - 1) {
-						pos_c = temp[0];
-						ind_c = 0;
-					}
-					else {
-						pos_c = temp[index + 1];
-						ind_c = index + 1;
-					}
-
-					//std::cout << "Index: " << pos_a << "-" << pos_b << "-" << pos_c << endl;
-
-					e1 = Vec3f(positions[pos_a][0] - positions[pos_b][0],
-						positions[pos_a][1] - positions[pos_b][1],
-						positions[pos_a][2] - positions[pos_b][2]);
-
-					e2 = Vec3f(positions[pos_c][0] - positions[pos_b][0],
-						positions[pos_c][1] - positions[pos_b][1],
-						positions[pos_c][2] - positions[pos_b][2]);
-
-					float e1mag = sqrt(e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2]);
-					float e2mag = sqrt(e2[0] * e2[0] + e2[1] * e2[1] + e2[2] * e2[2]);
-
-					Vec3f e1norm = Vec3f(e1[0] / e1mag, e1[1] / e1mag, e1[2] / e1mag);
-					Vec3f e2norm = Vec3f(e2[0] / e2mag, e2[1] / e2mag, e2[2] / e2mag);
-
-					float angle = acos(e1norm[0] * e2norm[0] + e1norm[1] * e2norm[1] + e1norm[2] * e2norm[2]);
-					// STOP IF ANGLE IS CONCAVE
-					//std::cout << "Angle: " << angle << endl;
-					if (angle >= FW_PI) {
-						//std::cout << "Concave: next!" << endl;
-						index += 1;
-						continue;
-					}
-
-
-					// NOW WE NEED TO CHECK IF NO OTHER VERTEX IS CONTAINED INSIDE THIS TRIANGLE
-
-					e1 = Vec3f(positions[pos_b][0] - positions[pos_a][0],
-						positions[pos_b][1] - positions[pos_a][1],
-						positions[pos_b][2] - positions[pos_a][2]);
-
-					e2 = Vec3f(positions[pos_c][0] - positions[pos_a][0],
-						positions[pos_c][1] - positions[pos_a][1],
-						positions[pos_c][2] - positions[pos_a][2]);
-
-					Mat3f T;
-					T.setCol(0, positions[pos_a]);
-					T.setCol(1, positions[pos_b]);
-					T.setCol(2, positions[pos_c]);
-					T.invert(); T.transpose();
-					//std::cout << "T matrix" << endl;
-					//std::cout << T(0, 0) << "\t" << T(0, 1) << "\t" << T(0, 2) << endl;
-					//std::cout << T(1, 0) << "\t" << T(1, 1) << "\t" << T(1, 2) << endl;
-					//std::cout << T(2, 0) << "\t" << T(2, 1) << "\t" << T(2, 2) << endl;
-					//std::cout << "Inside triangle?" << endl;
-
-					bool no_points_inside = true;
-					for (int k = 0; k < temp.size(); k++) {
-						if (k == ind_a || k == ind_b || k == ind_c) {
-							std::cout << k << " is a triangle vertex." << endl;
-							continue;
-						}
-						Vec3f P = positions[temp[k]];
-						//std::cout << k << " position: " << P[0] << "-" << P[1] << "-" << P[2] << endl;
-						Vec3f res = T * P;
-						//std::cout << k << " triangulation: " << res[0] << " - " << res[1] << " - " << res[2] << endl;
-						float crossval = dot(P - positions[pos_a], cross(e1, e2));
-						//std::cout << "Crossval: " << crossval << endl;
-						if (res[0] >= 0 && res[1] >= 0 && res[2] >= 0 && res[1] < 1 && res[2] < 1 && res[0] + res[1] + res[2] == 1) {
-							//std::cout << k << " is inside triangle." << endl;
-							no_points_inside = false;
-							break;
-						}
-						//std::cout << k << " is not inside triangle." << endl;
-					}
-
-					// IF NO POINT WAS FOUND INSIDE THE TRIANGLE, ADD IT TO TRIANGULATION AND REPEAT
-					if (no_points_inside) {
-						f[0] = pos_a; f[2] = pos_b; f[4] = pos_c;
-
-						// NORMAL DEFINITION
-
-						Vec3f normal = cross(e1, e2);
-						normal.normalize();
-
-						normals.push_back(normal);
-
-						f[1] = normal_number; f[3] = normal_number; f[5] = normal_number;
-						normal_number += 1;
-						faces.push_back(f);
-
-						// EXTRACT EAR POINT FROM TEMP VECTOR AND BREAK
-						temp.erase(temp.begin() + index);
-						not_found = false;
-					}
-				}
-			}
-
-			f[0] = temp[0]; f[2] = temp[1]; f[4] = temp[2];
-			e1 = positions[temp[1]] - positions[temp[0]];
-			e2 = positions[temp[2]] - positions[temp[0]];
-			Vec3f normal = cross(e1, e2);
-
-			normal.normalize();
+	}
+	updateIndexedMesh(reader, progressive_moved_, mesh_);
+	uploadProgressiveChanges(old_vertices, old_indices);
 
-			normals.push_back(normal);
-			f[1] = normal_number; f[3] = normal_number; f[5] = normal_number;
-			normal_number += 1;
-			faces.push_back(f);
-		}
+	if (!reader.isComplete()) {
+		common_ctrl_.message(sprintf("Refining %s: %d of %d vertex splits, %d triangles", load.name.c_str(),
+			reader.getNumApplied(), reader.getNumSplits(), (int)mesh_.indices.size() / 3), "progressive");
+		return;
 	}
-	common_ctrl_.message(("Loaded mesh from " + filename).c_str());
-	return unpackIndexedData(positions, normals, faces);
+	common_ctrl_.message(sprintf("Loaded progressive mesh from %s: %d vertices, %d triangles",
+		load.name.c_str(), (int)mesh_.vertices.size(), (int)mesh_.indices.size() / 3));
+	stopProgressiveLoad();
 }
 
-vector<Vertex> App::loadObjFileModel2(string filename) {
-	window_.showModalMessage(sprintf("Loading mesh from '%s'...", filename.c_str()));
-
-	vector<Vec3f> positions, normals;
-	vector<array<unsigned, 6>> faces;
-	vector<Mat4f> Q;
-	float threshold = 0.5f;
-
-	// Open input file stream for reading.
-	ifstream input(filename, ios::in);
-	string line;
-	int face_number = 0, vertex_number = 0, normal_number = 0;
-	string word;
-
-	// FORMAT: 0 AASCI - 1 BIG ENDIAN - 2 LITTLE ENDIAN
-	int format = 0;
-
-	if (filename.compare(filename.size() - 3, 3, "obj") == 0) {
-		// Read the file line by line.
-
-		while (getline(input, line)) {
-			// Replace any '/' characters with spaces ' ' so that all of the
-			// values we wish to read are separated with whitespace.
-			for (auto& c : line)
-				if (c == '/')
-					c = ' ';
-
-			// Temporary objects to read data into.
-			array<unsigned, 6>  f; // Face index array
-			Vec3f               v;
-			string              s;
-
-			// Create a stream from the string to pick out one value at a time.
-			istringstream        iss(line);
-
-			// Read the first token from the line into string 's'.
-			// It identifies the type of object (vertex or normal or ...)
-			iss >> s;
-
-			if (s == "v") { // vertex position
-				// YOUR CODE HERE (R4)
-				float a, b, c;
-				iss >> a;
-				iss >> b;
-				iss >> c;
-				// Read the three vertex coordinates (x, y, z) into 'v'.
-				v = Vec3f(a, b, c);
-				positions.push_back(v);
-				// Store a copy of 'v' in 'positions'.
-				// See std::vector documentation for push_back.
-			}
-			else if (s == "vn") { // normal
-			 // YOUR CODE HERE (R4)
-			 // Similar to above.
-				float a, b, c;
-				iss >> a;
-				iss >> b;
-				iss >> c;
-				v = Vec3f(a, b, c);
-				normals.push_back(v);
-			}
-			else if (s == "f") { // face
-			 // YOUR CODE HERE (R4)
-			 // Read the indices representing a face and store it in 'faces'.
-			 // The data in the file is in the format
-			 // f v1/vt1/vn1 v2/vt2/vn2 ...
-			 // where vi = vertex index, vti = texture index, vni = normal index.
-			 //
-			 // Remember we already replaced the '/' characters with whitespaces.
-			 //
-			 // Since we are not using textures in this exercise, you can ignore
-			 // the texture indices by reading them into a temporary variable.
-				unsigned sink; // Temporary variable for reading the unused texture indices.
-				unsigned temp;
-				int discarded = 0;
-				for (int i = 0; i < 9; i++) {
-					if (i % 3 == 1) {
-						iss >> sink;
-						discarded++;
-					}
-					else {
-						iss >> temp;
-						f[i - discarded] = temp - 1;
-					}
-				}
-				faces.push_back(f);
+// The reading task holds on to the load until it notices the cancel.
+void App::stopProgressiveLoad() {
+	if (progressive_)
+		loader_.cancel(progressive_job_);
+	progressive_.reset();
+	progressive_moved_.reset();
+	common_ctrl_.message("", "progressive");
+}
 
-				// Note that in C++ we index things starting from 0, but face indices in OBJ format start from 1.
-				// If you don't adjust for that, you'll index past the range of your vectors and get a crash.
+void App::uploadMesh(size_t vertex_capacity, size_t index_capacity) {
+	// Load the vertex and index buffers to GPU, with room for the given
+	// numbers of vertices and indices.
+	vertex_capacity_ = max(vertex_capacity, mesh_.vertices.size());
+	index_capacity_ = max(index_capacity, mesh_.indices.size());
+	GLenum usage = (vertex_capacity_ > mesh_.vertices.size()) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+	glBindBuffer(GL_ARRAY_BUFFER, gl_.dynamic_vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertex_capacity_ * sizeof(Vertex), nullptr, usage);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, mesh_.vertexBytes(), mesh_.vertices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl_.dynamic_index_buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_capacity_ * sizeof(unsigned), nullptr, usage);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, mesh_.indexBytes(), mesh_.indices.data());
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
 
-				// It might be a good idea to print the indices to see that they were read correctly.
-				// cout << f[0] << " " << f[1] << " " << f[2] << " " << f[3] << " " << f[4] << " " << f[5] << endl;
-			}
-		}
+// Uploads the vertices and triangles past the old counts and the moved
+// corners of the older triangles. The first refinement makes room for the
+// final counts from the header; a header that undercounts costs a full
+// upload every time the mesh outgrows the buffers.
+void App::uploadProgressiveChanges(size_t old_vertices, size_t old_indices) {
+	size_t final_vertices = progressive_->reader->getFinalNumVertices();
+	size_t final_indices = (size_t)progressive_->reader->getFinalNumTriangles() * 3;
+	if (vertex_capacity_ < max(final_vertices, mesh_.vertices.size()) || index_capacity_ < max(final_indices, mesh_.indices.size())) {
+		uploadMesh(max(final_vertices, mesh_.vertices.size() * 2), max(final_indices, mesh_.indices.size() * 2));
+		return;
 	}
-	// PLY files
-	else {
-		// Temporary objects to read data into.
-		array<unsigned, 6>  f; // Face index array
-		Vec3f               v;
-		string              s;
-
-
-		while (getline(input, line)) {
-			istringstream iss(line);
-			iss >> word;
-			if (word.compare("end_header") == 0)
-				break;
-			if (word.compare("element") == 0) {
-				iss >> word;
-				if (word.compare("vertex") == 0) {
-					iss >> vertex_number;
-				}
-				else if (word.compare("face") == 0) {
-					iss >> face_number;
-				}
-			}
-			else if (word.compare("format") == 0) {
-				iss >> word;
-				if (word.compare("ascii") == 0) {
-					format = 0;
-				}
-				else if (word.compare("binary_big_endian") == 0) {
-					format = 1;
-				}
-				else if (word.compare("binary_little_endian") == 0) {
-					format = 2;
-				}
-			}
-		}
-
-		// TODO: ADD BINARY SUPPORT
 
-		// VERTEX READING
-		float a, b, c, sink;
-		for (int i = 0; i < vertex_number; i++) {
-			getline(input, line);
-			istringstream iss(line);
-			iss >> a >> b >> c;
-			v = Vec3f(a, b, c);
-			positions.push_back(v);
-		}
-		// FACES READING
-		for (int i = 0; i < face_number; i++) {
-			getline(input, line);
-			istringstream iss(line);
-
-			iss >> sink;
-			vector<int> temp;
-			Vec3f e1, e2;
-			//std::cout << "Face n. " << i << endl;
-			//std::cout << sink << " vertices" << endl;
-			for (int j = 0; j < sink; j++) {
-				iss >> a;
-				//std::cout << a << " ";
-				temp.push_back(a);
-			}
-			//std::cout << endl << endl;
-
-			// EAR CLIPPING ALGORITHM
-			while (temp.size() > 3) {
-
-				int index = 0;
-				bool not_found = true;
-				while (not_found) {
-
-					// SEE IF VERTEX IS CONVEX
-
-					int pos_a, pos_b, pos_c, ind_a, ind_b, ind_c;
-					pos_b = temp[index];
-					ind_b = index;
-					if (index == 0) {
-						pos_a = temp[temp.size() - 1];
-						ind_a = temp.size() - 1;
-					}
-					else {
-						pos_a = temp[index - 1];
-						ind_a = index - 1;
-					}
-					if (index == temp.size() - 1) {
-						pos_c = temp[0];
-						ind_c = 0;
-					}
-					else {
-						pos_c = temp[index + 1];
-						ind_c = index + 1;
-					}
-
-					//std::cout << "Index: " << pos_a << "-" << pos_b << "-" << pos_c << endl;
-
-					e1 = Vec3f(positions[pos_a][0] - positions[pos_b][0],
-						positions[pos_a][1] - positions[pos_b][1],
-						positions[pos_a][2] - positions[pos_b][2]);
-
-					e2 = Vec3f(positions[pos_c][0] - positions[pos_b][0],
-						positions[pos_c][1] - positions[pos_b][1],
-						positions[pos_c][2] - positions[pos_b][2]);
-
-					float e1mag = sqrt(e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2]);
-					float e2mag = sqrt(e2[0] * e2[0] + e2[1] * e2[1] + e2[2] * e2[2]);
-
-					Vec3f e1norm = Vec3f(e1[0] / e1mag, e1[1] / e1mag, e1[2] / e1mag);
-					Vec3f e2norm = Vec3f(e2[0] / e2mag, e2[1] / e2mag, e2[2] / e2mag);
-
-					float angle = acos(e1norm[0] * e2norm[0] + e1norm[1] * e2norm[1] + e1norm[2] * e2norm[2]);
-					// STOP IF ANGLE IS CONCAVE
-					//std::cout << "Angle: " << angle << endl;
-					if (angle >= FW_PI) {
-						//std::cout << "Concave: next!" << endl;
-						index += 1;
-						continue;
-					}
-
-
-					// NOW WE NEED TO CHECK IF NO OTHER VERTEX IS CONTAINED INSIDE THIS TRIANGLE
-
-					e1 = Vec3f(positions[pos_b][0] - positions[pos_a][0],
-						positions[pos_b][1] - positions[pos_a][1],
-						positions[pos_b][2] - positions[pos_a][2]);
-
-					e2 = Vec3f(positions[pos_c][0] - positions[pos_a][0],
-						positions[pos_c][1] - positions[pos_a][1],
-						positions[pos_c][2] - positions[pos_a][2]);
-
-					Mat3f T;
-					T.setCol(0, positions[pos_a]);
-					T.setCol(1, positions[pos_b]);
-					T.setCol(2, positions[pos_c]);
-					T.invert(); T.transpose();
-					//std::cout << "T matrix" << endl;
-					//std::cout << T(0, 0) << "\t" << T(0, 1) << "\t" << T(0, 2) << endl;
-					//std::cout << T(1, 0) << "\t" << T(1, 1) << "\t" << T(1, 2) << endl;
-					//std::cout << T(2, 0) << "\t" << T(2, 1) << "\t" << T(2, 2) << endl;
-					//std::cout << "Inside triangle?" << endl;
-
-					bool no_points_inside = true;
-					for (int k = 0; k < temp.size(); k++) {
-						if (k == ind_a || k == ind_b || k == ind_c) {
-							std::cout << k << " is a triangle vertex." << endl;
-							continue;
-						}
-						Vec3f P = positions[temp[k]];
-						//std::cout << k << " position: " << P[0] << "-" << P[1] << "-" << P[2] << endl;
-						Vec3f res = T * P;
-						//std::cout << k << " triangulation: " << res[0] << " - " << res[1] << " - " << res[2] << endl;
-						float crossval = dot(P - positions[pos_a], cross(e1, e2));
-						//std::cout << "Crossval: " << crossval << endl;
-						if (res[0] >= 0 && res[1] >= 0 && res[2] >= 0 && res[1] < 1 && res[2] < 1 && res[0] + res[1] + res[2] == 1) {
-							//std::cout << k << " is inside triangle." << endl;
-							no_points_inside = false;
-							break;
-						}
-						//std::cout << k << " is not inside triangle." << endl;
-					}
-
-					// IF NO POINT WAS FOUND INSIDE THE TRIANGLE, ADD IT TO TRIANGULATION AND REPEAT
-					if (no_points_inside) {
-						f[0] = pos_a; f[2] = pos_b; f[4] = pos_c;
-
-						// ADD VALID PAIR OF VERTICES FOR SEMPLIFICATION
-
-
-						// NORMAL DEFINITION
-
-						Vec3f normal = cross(e1, e2);
-						normal.normalize();
-
-						normals.push_back(normal);
-						float a, b, c, d;
-						a = normal[0]; b = normal[1]; c = normal[2]; d = a * positions[temp[0]][0] + b * positions[temp[0]][1] + c * positions[temp[0]][2];
-						Mat4f Q_int;
-						Q_int.setRow(0, Vec4f(a* a, a* b, a* c, a* d));
-						Q_int.setRow(1, Vec4f(b* a, b* b, b* c, b* d));
-						Q_int.setRow(2, Vec4f(c* a, c* b, c* c, c* d));
-						Q_int.setRow(3, Vec4f(d* a, d* b, d* c, d* d));
-						Q[pos_a] += Q_int; Q[pos_b] += Q_int; Q[pos_c] += Q_int;
-
-						f[1] = normal_number; f[3] = normal_number; f[5] = normal_number;
-						normal_number += 1;
-						faces.push_back(f);
-
-						// EXTRACT EAR POINT FROM TEMP VECTOR AND BREAK
-						temp.erase(temp.begin() + index);
-						not_found = false;
-					}
-				}
-			}
+	glBindBuffer(GL_ARRAY_BUFFER, gl_.dynamic_vertex_buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, old_vertices * sizeof(Vertex), (mesh_.vertices.size() - old_vertices) * sizeof(Vertex),
+		mesh_.vertices.data() + old_vertices);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-			f[0] = temp[0]; f[2] = temp[1]; f[4] = temp[2];
-			e1 = positions[temp[1]] - positions[temp[0]];
-			e2 = positions[temp[2]] - positions[temp[0]];
-			Vec3f normal = cross(e1, e2);
-
-			normal.normalize();
-
-			normals.push_back(normal);
-			float a, b, c, d;
-			a = normal[0]; b = normal[1]; c = normal[2]; d = a * positions[temp[0]][0] + b * positions[temp[0]][1] + c * positions[temp[0]][2];
-			Mat4f Q_int;
-			Q_int.setRow(0, Vec4f(a*a, a*b, a*c, a*d));
-			Q_int.setRow(1, Vec4f(b* a, b* b, b* c, b* d));
-			Q_int.setRow(2, Vec4f(c* a, c* b, c* c, c* d));
-			Q_int.setRow(3, Vec4f(d* a, d* b, d* c, d* d));
-			Q[temp[0]] += Q_int; Q[temp[1]] += Q_int; Q[temp[2]] += Q_int;
-			f[1] = normal_number; f[3] = normal_number; f[5] = normal_number;
-			normal_number += 1;
-			faces.push_back(f);
-		}
+	// Moved corners in ranges of nearby ones; those of the new triangles go
+	// with the rest of them.
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl_.dynamic_index_buffer);
+	S32* moved = progressive_moved_.getPtr();
+	S32* end = moved + progressive_moved_.getSize();
+	sort(moved, end);
+	while (moved != end && (size_t)*moved < old_indices) {
+		size_t first = *moved, last = first;
+		while (++moved != end && (size_t)*moved < old_indices && *moved - last <= progressive_patch_gap)
+			last = *moved;
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(unsigned), (last + 1 - first) * sizeof(unsigned), &mesh_.indices[first]);
 	}
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, old_indices * sizeof(unsigned), (mesh_.indices.size() - old_indices) * sizeof(unsigned),
+		mesh_.indices.data() + old_indices);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
 
-	// MESH SEMPLiFiCATION: VALID PAIR VERTICES
-
-	common_ctrl_.message(("Loaded mesh from " + filename).c_str());
-	return unpackIndexedData(positions, normals, faces);
+string App::cacheStatsString() const {
+	const MeshCacheStats& stats = mesh_cache_.stats();
+	return sprintf("mesh cache: %d hits in %.1f ms, %d misses in %.1f ms",
+		stats.hits, stats.hit_seconds * 1.0e3f, stats.misses, stats.miss_seconds * 1.0e3f).getPtr();
 }
 
 void FW::init(void) {
+	if (runBenchmarks(FW::argc, FW::argv))
+		return;
 	new App;
 }
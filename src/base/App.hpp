@@ -3,26 +3,51 @@
 #include "gui/Window.hpp"
 #include "gui/CommonControls.hpp"
 
+#include "AsyncMeshLoader.hpp"
+#include "IndexedMesh.hpp"
+#include "MeshCache.hpp"
+
+#include "io/File.hpp"
+#include "io/MeshProgressiveIO.hpp"
+#include "io/Stream.hpp"
+
+#include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 
 
 namespace FW {
 
-struct Vertex
-{
-	Vec3f position;
-	Vec3f normal;
-};
-
 struct glGeneratedIndices
 {
 	GLuint static_vao, dynamic_vao;
 	GLuint shader_program;
-	GLuint static_vertex_buffer, dynamic_vertex_buffer;
+	GLuint static_vertex_buffer, dynamic_vertex_buffer, dynamic_index_buffer;
 	GLuint model_to_world_uniform, world_to_clip_uniform, shading_toggle_uniform, model_to_world_transposed_uniform;
 };
 
+// A .pmesh file being loaded by a task on the loader's pool: it reads the
+// header and the base mesh, then the vertex splits in batches, and the
+// viewer applies the batches that have arrived. The reader reads from the
+// stream, which reads from the file.
+struct ProgressiveLoad
+{
+	std::string								name;
+	std::unique_ptr<File>					file;
+	std::unique_ptr<BufferedInputStream>	stream;
+	std::unique_ptr<ProgressiveMeshReader>	reader;
+
+	Spinlock								lock;		// Guards the two below.
+	bool									has_base;	// The reader is set up; it reads splits from here on.
+	std::deque<std::unique_ptr<Array<U8>>>	read;		// Batches from ProgressiveMeshReader::readSplits().
+
+	// Used by the viewer only.
+	bool									shown;		// The base mesh is in mesh_.
+	std::deque<std::unique_ptr<Array<U8>>>	ready;		// Taken from 'read', not yet applied...
+	int										applied;	// ...except for these bytes of the first one.
+};
+
 class App : public Window::Listener
 {
 private:
@@ -47,8 +72,13 @@ private:
 
 	void				initRendering();
 	void				render();
-	std::vector<Vertex>	loadObjFileModel(std::string filename);
-	std::vector<Vertex>	loadObjFileModel2(std::string filename);
+	void				startFileLoad(std::string filename, bool simplified);
+	void				startProgressiveLoad(const std::string& filename);
+	void				refineProgressive();
+	void				stopProgressiveLoad();
+	void				uploadMesh(size_t vertex_capacity = 0, size_t index_capacity = 0);
+	void				uploadProgressiveChanges(size_t old_vertices, size_t old_indices);
+	std::string			cacheStatsString() const;
 
 	Window				window_;
 	CommonControls		common_ctrl_;
@@ -60,7 +90,18 @@ private:
 
 	glGeneratedIndices	gl_;
 
-	std::vector<Vertex>	vertices_;
+	IndexedMesh			mesh_;
+	size_t				vertex_capacity_;	// Of the buffers mesh_ was uploaded to.
+	size_t				index_capacity_;
+	MeshCache			mesh_cache_;		// Processed meshes, stored next to their source files.
+	AsyncMeshLoader		loader_;			// Background file loads; declared after mesh_cache_, which they use.
+
+	// A .pmesh file being refined for a slice of every frame. mesh_ keeps
+	// the triangles in file order, so that refining only appends to it and
+	// rewrites the moved corners, listed in progressive_moved_.
+	std::shared_ptr<ProgressiveLoad>		progressive_;		// Shared with the reading task.
+	int										progressive_job_;	// Its id in loader_.
+	Array<S32>								progressive_moved_;
 
 	float				camera_rotation_angle_;
 	float				camera_z_angle_;
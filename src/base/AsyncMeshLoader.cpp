@@ -0,0 +1,132 @@
+#include "AsyncMeshLoader.hpp"
+
+#include "base/Timer.hpp"
+
+using namespace FW;
+using namespace std;
+
+void AsyncMeshLoader::Job::setProgress(const char* stage, F32 fraction) {
+	lock_.enter();
+	stage_ = stage;
+	fraction_ = fraction;
+	lock_.leave();
+}
+
+AsyncMeshLoader::AsyncMeshLoader()
+:	next_id_(1),
+	num_active_(0)
+{
+}
+
+AsyncMeshLoader::~AsyncMeshLoader() {
+	cancelAll();
+	wait();
+}
+
+int AsyncMeshLoader::start(const string& name, const LoadFunc& func) {
+	unique_ptr<Job> job(new Job);
+	job->id_ = next_id_++;
+	job->name_ = name;
+	job->func_ = func;
+	job->cancelled_ = false;
+	job->done_ = false;
+	job->stage_ = "queued";
+	job->fraction_ = 0.0f;
+	job->ok_ = false;
+	job->seconds_ = 0.0f;
+
+	launcher_.push(runJob, job.get());
+	jobs_.push_back(move(job));
+	num_active_++;
+	stats_.started++;
+	return jobs_.back()->id_;
+}
+
+void AsyncMeshLoader::cancel(int id) {
+	for (auto& job : jobs_)
+		if (job->id_ == id && !job->cancelled_) {
+			job->cancelled_ = true;
+			num_active_--;
+			stats_.cancelled++;
+		}
+	collectFinished();
+}
+
+void AsyncMeshLoader::cancelAll() {
+	for (auto& job : jobs_)
+		if (!job->cancelled_) {
+			job->cancelled_ = true;
+			num_active_--;
+			stats_.cancelled++;
+		}
+	collectFinished();
+}
+
+bool AsyncMeshLoader::poll(Result& result) {
+	collectFinished();
+	for (size_t i = 0; i < jobs_.size(); i++) {
+		Job& job = *jobs_[i];
+		if (!job.done_ || job.cancelled_)
+			continue;
+
+		result.id = job.id_;
+		result.name = job.name_;
+		result.ok = job.ok_;
+		result.seconds = job.seconds_;
+		result.error = job.error_;
+		result.mesh = move(job.mesh_);
+		jobs_.erase(jobs_.begin() + i);
+		num_active_--;
+		stats_.delivered++;
+		return true;
+	}
+	return false;
+}
+
+void AsyncMeshLoader::wait() {
+	while (launcher_.getNumTasks())
+		((Job*)launcher_.pop().data)->done_ = true;
+	collectFinished();
+}
+
+bool AsyncMeshLoader::getProgress(Progress& progress) const {
+	for (auto& job : jobs_) {
+		if (job->cancelled_)
+			continue;
+		progress.id = job->id_;
+		progress.name = job->name_;
+		job->lock_.enter();
+		progress.stage = job->stage_;
+		progress.fraction = job->fraction_;
+		job->lock_.leave();
+		return true;
+	}
+	return false;
+}
+
+void AsyncMeshLoader::runJob(MulticoreLauncher::Task& task) {
+	Job& job = *(Job*)task.data;
+	if (job.cancelled_)
+		return;
+
+	// The pool fails on errors left behind by a task; keep them with the job.
+
+	Timer timer(true);
+	job.ok_ = job.func_(job.mesh_, job);
+	job.seconds_ = timer.end();
+	String error = clearError();
+	if (!job.ok_)
+		job.error_ = error.getLength() ? error.getPtr() : (job.cancelled_ ? "cancelled" : "load failed");
+	job.setProgress("done", 1.0f);
+}
+
+void AsyncMeshLoader::collectFinished() {
+	while (launcher_.getNumFinished())
+		((Job*)launcher_.pop().data)->done_ = true;
+
+	for (size_t i = 0; i < jobs_.size();)
+		if (jobs_[i]->done_ && jobs_[i]->cancelled_)
+			jobs_.erase(jobs_.begin() + i);
+		else
+			i++;
+}
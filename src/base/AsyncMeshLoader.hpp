@@ -0,0 +1,112 @@
+#pragma once
+
+#include "IndexedMesh.hpp"
+
+#include "base/MulticoreLauncher.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace FW {
+
+// Runs mesh loads as tasks on the framework's thread pool (MulticoreLauncher)
+// and hands the results back to the owning thread, which only has to poll.
+//
+// A load is a function that fills an IndexedMesh. It runs on a pool thread;
+// it may use the pool itself, should check isCancelled() between stages and
+// can report its progress. Cancelled loads are never delivered; those still
+// running finish in the background and are discarded. Errors set by a load
+// are captured into its result instead of being left on the pool thread.
+//
+// All member functions must be called from the owning thread.
+class AsyncMeshLoader
+{
+public:
+	class Job
+	{
+	public:
+		bool				isCancelled	() const	{ return cancelled_; }
+		void				setProgress	(const char* stage, F32 fraction);
+
+	private:
+		friend class AsyncMeshLoader;
+
+		int					id_;
+		std::string			name_;
+		std::function<bool(IndexedMesh&, Job&)> func_;
+		std::atomic<bool>	cancelled_;
+		bool				done_;
+
+		Spinlock			lock_;		// Guards stage_ and fraction_.
+		std::string			stage_;
+		F32					fraction_;
+
+		bool				ok_;
+		F32					seconds_;
+		std::string			error_;
+		IndexedMesh			mesh_;
+	};
+
+	typedef std::function<bool(IndexedMesh& mesh, Job& job)> LoadFunc;
+
+	struct Result
+	{
+		int					id;
+		std::string			name;
+		bool				ok;
+		F32					seconds;	// Time spent in the load function.
+		std::string			error;		// Set if !ok.
+		IndexedMesh			mesh;		// May hold partial data even if !ok.
+	};
+
+	struct Progress
+	{
+		int					id;
+		std::string			name;
+		std::string			stage;
+		F32					fraction;	// [0, 1]
+	};
+
+	struct Stats
+	{
+		int					started;
+		int					delivered;
+		int					cancelled;
+
+		Stats() : started(0), delivered(0), cancelled(0) {}
+	};
+
+						AsyncMeshLoader		();
+						~AsyncMeshLoader	();		// Cancels everything and waits for running loads.
+
+	int					start				(const std::string& name, const LoadFunc& func);	// Returns the load's id.
+	void				cancel				(int id);
+	void				cancelAll			();
+
+	// Returns the oldest finished, uncancelled load without blocking.
+	bool				poll				(Result& result);
+	// Blocks until every load has finished; results stay available to poll().
+	void				wait				();
+
+	bool				isBusy				() const	{ return num_active_ > 0; }		// Uncancelled loads not yet delivered.
+	bool				getProgress			(Progress& progress) const;				// Of the oldest uncancelled load.
+	const Stats&		stats				() const	{ return stats_; }
+
+private:
+						AsyncMeshLoader		(const AsyncMeshLoader&);	// forbid copy
+	AsyncMeshLoader&	operator=			(const AsyncMeshLoader&);	// forbid assignment
+
+	static void			runJob				(MulticoreLauncher::Task& task);
+	void				collectFinished		();	// Marks finished jobs done and drops cancelled ones.
+
+	MulticoreLauncher					launcher_;
+	std::vector<std::unique_ptr<Job>>	jobs_;		// In start order.
+	int									next_id_;
+	int									num_active_;
+	Stats								stats_;
+};
+
+}
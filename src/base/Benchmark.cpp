@@ -0,0 +1,2360 @@
+#include "AsyncMeshLoader.hpp"
+#include "Benchmark.hpp"
+#include "IndexedMesh.hpp"
+#include "MeshCache.hpp"
+#include "ModelLoader.hpp"
+
+#include "3d/AOBaker.hpp"
+#include "3d/BVH.hpp"
+#include "3d/DistanceField.hpp"
+#include "3d/LodBuilder.hpp"
+#include "3d/MeshOptimizer.hpp"
+#include "3d/QuadricSimplifier.hpp"
+#include "3d/Triangulator.hpp"
+#include "base/MulticoreLauncher.hpp"
+#include "base/Random.hpp"
+#include "base/Timer.hpp"
+#include "base/UnionFind.hpp"
+#include "io/File.hpp"
+#include "io/MappedFile.hpp"
+#include "io/MeshBinaryIO.hpp"
+#include "io/MeshCodec.hpp"
+#include "io/MeshProgressiveIO.hpp"
+#include "io/MeshWavefrontIO.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace FW;
+
+namespace {
+
+typedef void (*BenchmarkFunc)(int argc, char** argv);
+
+struct BenchmarkEntry
+{
+	const char*		name;
+	const char*		usage;
+	BenchmarkFunc	func;
+};
+
+// Runs 'func' 'repeats' times and returns the fastest run in seconds.
+template <class F>
+F32 timeBest(int repeats, F func) {
+	F32 best = FW_F32_MAX;
+	for (int i = 0; i < repeats; i++) {
+		Timer timer(true);
+		func();
+		best = FW::min(best, timer.getElapsed());
+	}
+	return best;
+}
+
+bool sameModel(const IndexedModel& a, const IndexedModel& b) {
+	if (a.positions.size() != b.positions.size() || a.normals.size() != b.normals.size() || a.faces.size() != b.faces.size())
+		return false;
+	for (size_t i = 0; i < a.positions.size(); i++)
+		if (a.positions[i] != b.positions[i])
+			return false;
+	for (size_t i = 0; i < a.normals.size(); i++)
+		if (a.normals[i] != b.normals[i])
+			return false;
+	return a.faces == b.faces;
+}
+
+void benchObj(int argc, char** argv) {
+	std::string filename = (argc > 0) ? argv[0] : "assets/garg.obj";
+	int repeats = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 5;
+
+	S64 size;
+	{
+		File file(filename.c_str(), File::Read);
+		if (hasError())
+			return;
+		size = file.getSize();
+	}
+	F32 megabytes = (F32)size / (1024.0f * 1024.0f);
+
+	IndexedModel streamed, mapped;
+	F32 t_streamed = timeBest(repeats, [&]() { loadObjStreamed(filename, streamed); });
+	F32 t_mapped = timeBest(repeats, [&]() { loadObjMapped(filename, mapped); });
+	if (hasError())
+		return;
+
+	FW::printf("%s: %.2f MB, %d positions, %d normals, %d triangles\n", filename.c_str(), megabytes,
+		(int)mapped.positions.size(), (int)mapped.normals.size(), (int)mapped.faces.size());
+	FW::printf("  getline/istringstream: %8.2f ms  %8.2f MB/s\n", t_streamed * 1.0e3f, megabytes / t_streamed);
+	FW::printf("  memory-mapped scanner: %8.2f ms  %8.2f MB/s\n", t_mapped * 1.0e3f, megabytes / t_mapped);
+	FW::printf("  speedup %.2fx, results %s\n", t_streamed / t_mapped, sameModel(streamed, mapped) ? "identical" : "DIFFER");
+}
+
+bool sameMesh(const Mesh<VertexPNT>& a, const Mesh<VertexPNT>& b) {
+	if (a.numVertices() != b.numVertices() || a.numSubmeshes() != b.numSubmeshes())
+		return false;
+	if (memcmp(a.getVertexPtr(), b.getVertexPtr(), a.numVertices() * sizeof(VertexPNT)) != 0)
+		return false;
+	for (int i = 0; i < a.numSubmeshes(); i++)
+		if (a.indices(i) != b.indices(i))
+			return false;
+	return true;
+}
+
+void benchWavefront(int argc, char** argv) {
+	std::string filename = (argc > 0) ? argv[0] : "assets/garg.obj";
+	int repeats = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 3;
+
+	MappedFile mapped(filename.c_str());
+	if (hasError())
+		return;
+	F32 megabytes = (F32)mapped.getSize() / (1024.0f * 1024.0f);
+
+	Mesh<VertexPNT>* reference = NULL;
+	F32 t_serial = timeBest(repeats, [&]() {
+		delete reference;
+		File file(filename.c_str(), File::Read);
+		BufferedInputStream stream(file);
+		reference = importWavefrontMesh(stream, filename.c_str());
+	});
+
+	FW::printf("%s: %.2f MB, %d vertices, %d submeshes\n", filename.c_str(), megabytes, reference->numVertices(), reference->numSubmeshes());
+	FW::printf("  serial stream    : %8.2f ms  %8.2f MB/s\n", t_serial * 1.0e3f, megabytes / t_serial);
+
+	int numCores = MulticoreLauncher::getNumCores();
+	for (int numThreads = 1;; numThreads = FW::min(numThreads * 2, numCores)) {
+		MulticoreLauncher::setNumThreads(numThreads);
+		Mesh<VertexPNT>* mesh = NULL;
+		F32 t = timeBest(repeats, [&]() {
+			delete mesh;
+			mesh = importWavefrontMesh(mapped, true);
+		});
+		FW::printf("  chunked %3d thr  : %8.2f ms  %8.2f MB/s  %.2fx  %s\n", numThreads, t * 1.0e3f, megabytes / t,
+			t_serial / t, sameMesh(*reference, *mesh) ? "identical" : "DIFFERS");
+		delete mesh;
+		if (numThreads == numCores)
+			break;
+	}
+	MulticoreLauncher::setNumThreads(numCores);
+	delete reference;
+}
+
+// Synthetic polygons for the triangulator, generated in 2D and then placed
+// on a tilted, slightly non-planar sheet in 3D.
+std::vector<Vec2f> makeStar(int n) {
+	std::vector<Vec2f> poly(n & ~1);
+	for (int i = 0; i < (int)poly.size(); i++) {
+		F32 angle = (F32)i * 2.0f * FW_PI / (F32)poly.size();
+		F32 radius = (i & 1) ? 0.35f : 1.0f;
+		poly[i] = Vec2f(FW::cos(angle), FW::sin(angle)) * radius;
+	}
+	return poly;
+}
+
+std::vector<Vec2f> makeComb(int n) {
+	std::vector<Vec2f> poly;
+	int teeth = FW::max((n - 2) / 4, 1);
+	for (int i = 0; i < teeth; i++) {
+		poly.push_back(Vec2f((F32)i, 0.0f));
+		poly.push_back(Vec2f((F32)i, 10.0f));
+		poly.push_back(Vec2f((F32)i + 0.5f, 10.0f));
+		poly.push_back(Vec2f((F32)i + 0.5f, 0.0f));
+	}
+	poly.push_back(Vec2f((F32)teeth, -1.0f));
+	poly.push_back(Vec2f(0.0f, -1.0f));
+	return poly;
+}
+
+std::vector<Vec2f> makeSpiral(int n) {
+	// Strip between two interleaved Archimedean spirals, ~8 turns.
+	int half = n / 2;
+	F32 turns = 8.0f, spacing = 1.0f / turns;
+	std::vector<Vec2f> poly(half * 2);
+	for (int i = 0; i < half; i++) {
+		F32 t = (F32)i / (F32)(half - 1);
+		F32 angle = t * turns * 2.0f * FW_PI;
+		F32 radius = 0.1f + t;
+		Vec2f dir(FW::cos(angle), FW::sin(angle));
+		poly[i] = dir * radius;
+		poly[half * 2 - 1 - i] = dir * (radius - spacing * 0.5f);
+	}
+	return poly;
+}
+
+std::vector<Vec2f> makeJaggedSquare(int n) {
+	// Nearly degenerate: long runs of almost collinear corners.
+	Random random(1);
+	std::vector<Vec2f> poly(n);
+	for (int i = 0; i < n; i++) {
+		F32 t = (F32)i * 4.0f / (F32)n;
+		int side = FW::min((int)t, 3);
+		F32 f = t - (F32)side;
+		F32 jitter = random.getF32(-1.0e-6f, 1.0e-6f);
+		switch (side) {
+		case 0:  poly[i] = Vec2f(f, jitter); break;
+		case 1:  poly[i] = Vec2f(1.0f + jitter, f); break;
+		case 2:  poly[i] = Vec2f(1.0f - f, 1.0f + jitter); break;
+		default: poly[i] = Vec2f(jitter, 1.0f - f); break;
+		}
+	}
+	return poly;
+}
+
+void benchTriangulate(int argc, char** argv) {
+	int n = (argc > 0) ? FW::max(atoi(argv[0]), 4) : 10000;
+	int repeats = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 5;
+
+	struct Shape { const char* name; std::vector<Vec2f> (*make)(int n); };
+	const Shape shapes[] = {
+		{ "star",			makeStar },
+		{ "comb",			makeComb },
+		{ "spiral",			makeSpiral },
+		{ "jagged square",	makeJaggedSquare },
+	};
+
+	Vec3f u = Vec3f(1.0f, 0.3f, -0.2f).normalized();
+	Vec3f v = cross(Vec3f(0.2f, 0.4f, 1.0f), u).normalized();
+	Vec3f w = cross(u, v);
+
+	Triangulator triangulator;
+	Array<Vec3i> tris;
+	FW::printf("Triangulating %d-corner polygons, best of %d runs\n", n, repeats);
+
+	for (const Shape& shape : shapes) {
+		std::vector<Vec2f> poly2 = shape.make(n);
+		std::vector<Vec3f> poly(poly2.size());
+		for (size_t i = 0; i < poly.size(); i++)
+			poly[i] = Vec3f(5.0f) + u * poly2[i].x + v * poly2[i].y + w * (1.0e-4f * FW::sin((F32)i));
+
+		F32 t = timeBest(repeats, [&]() {
+			tris.clear();
+			triangulator.triangulate(tris, poly.data(), NULL, (int)poly.size());
+		});
+
+		// Any triangulation has signed areas summing to the polygon's, so
+		// compare unsigned sums: they only match without flips or overlaps.
+		F64 area = 0.0, sum = 0.0;
+		for (size_t i = 0; i < poly2.size(); i++) {
+			const Vec2f& a = poly2[i];
+			const Vec2f& b = poly2[(i + 1) % poly2.size()];
+			area += 0.5 * ((F64)a.x * b.y - (F64)b.x * a.y);
+		}
+		for (int i = 0; i < tris.getSize(); i++) {
+			const Vec2f& a = poly2[tris[i].x];
+			sum += FW::abs(0.5 * (F64)(poly2[tris[i].y] - a).cross(poly2[tris[i].z] - a));
+		}
+		F64 error = FW::abs(sum - FW::abs(area)) / FW::abs(area);
+		bool valid = (tris.getSize() == (int)poly.size() - 2 && error < 1.0e-4);
+
+		FW::printf("  %-14s %6d corners: %8.3f ms  %6d tris  area err %.1e  %s\n", shape.name, (int)poly.size(),
+			t * 1.0e3f, tris.getSize(), error, valid ? "valid" : "INVALID");
+	}
+}
+
+// Closed, bumpy torus with about 'num_triangles' triangles.
+void makeTorus(int num_triangles, std::vector<Vec3f>& positions, std::vector<Vec3i>& triangles) {
+	int nu = FW::max((int)FW::sqrt((F32)num_triangles * 2.0f), 3), nv = FW::max(num_triangles / (2 * nu), 3);
+	positions.resize(nu * nv);
+	triangles.clear();
+	for (int i = 0; i < nu; i++)
+	for (int j = 0; j < nv; j++) {
+		F32 u = (F32)i * 2.0f * FW_PI / (F32)nu, v = (F32)j * 2.0f * FW_PI / (F32)nv;
+		F32 r = 0.3f + 0.02f * FW::sin(u * 17.0f) * FW::cos(v * 11.0f);
+		positions[i * nv + j] = Vec3f((1.0f + r * FW::cos(v)) * FW::cos(u), r * FW::sin(v), (1.0f + r * FW::cos(v)) * FW::sin(u));
+		int a = i * nv + j, b = ((i + 1) % nu) * nv + j, c = ((i + 1) % nu) * nv + (j + 1) % nv, d = i * nv + (j + 1) % nv;
+		triangles.push_back(Vec3i(a, b, c));
+		triangles.push_back(Vec3i(a, c, d));
+	}
+}
+
+// Torus with a texture seam along u = 0 and v = 0, a material seam at
+// u = 0.5 (submeshes 0 and 1 share the vertices there) and a rectangular
+// hole, so that all kinds of feature are present.
+void makeSeamTorus(int num_triangles, Mesh<VertexPNT>& mesh) {
+	int nu = FW::max((int)FW::sqrt((F32)num_triangles * 2.0f), 16), nv = FW::max(num_triangles / (2 * nu), 16);
+	mesh.resetVertices((nu + 1) * (nv + 1));
+	for (int i = 0; i <= nu; i++)
+	for (int j = 0; j <= nv; j++) {
+		F32 u = (F32)(i % nu) * 2.0f * FW_PI / (F32)nu, v = (F32)(j % nv) * 2.0f * FW_PI / (F32)nv;
+		F32 r = 0.3f + 0.02f * FW::sin(u * 17.0f) * FW::cos(v * 11.0f);
+		Vec3f p((1.0f + r * FW::cos(v)) * FW::cos(u), r * FW::sin(v), (1.0f + r * FW::cos(v)) * FW::sin(u));
+		mesh.setVertex(i * (nv + 1) + j, VertexPNT(p, Vec3f(0.0f), Vec2f((F32)i / (F32)nu, (F32)j / (F32)nv)));
+	}
+
+	std::vector<Vec3i> tris[2];
+	for (int i = 0; i < nu; i++)
+	for (int j = 0; j < nv; j++) {
+		if (i >= nu / 8 && i < nu / 8 + nu / 16 && j < nv / 4)
+			continue;
+		int a = i * (nv + 1) + j, b = a + nv + 1, c = b + 1, d = a + 1;
+		tris[(i < nu / 2) ? 0 : 1].push_back(Vec3i(a, b, c));
+		tris[(i < nu / 2) ? 0 : 1].push_back(Vec3i(a, c, d));
+	}
+	for (int k = 0; k < 2; k++)
+		mesh.setIndices(mesh.addSubmesh(), tris[k].data(), (int)tris[k].size());
+	mesh.recomputeNormals();
+}
+
+// Edges used by a single triangle, keyed by position.
+void findBoundaryEdges(const Mesh<VertexPNT>& mesh, std::vector<std::pair<Vec3f, Vec3f>>& edges) {
+	auto less = [](const Vec3f& a, const Vec3f& b) { return std::lexicographical_compare(a.getPtr(), a.getPtr() + 3, b.getPtr(), b.getPtr() + 3); };
+	std::vector<std::pair<std::pair<Vec3f, Vec3f>, int>> all;
+	for (int i = 0; i < mesh.numSubmeshes(); i++)
+		for (int j = 0; j < mesh.indices(i).getSize(); j++)
+			for (int k = 0; k < 3; k++) {
+				Vec3f a = mesh[mesh.indices(i)[j][k]].p, b = mesh[mesh.indices(i)[j][(k + 1) % 3]].p;
+				if (less(b, a))
+					std::swap(a, b);
+				all.push_back(std::make_pair(std::make_pair(a, b), 0));
+			}
+	auto pairLess = [&](const std::pair<std::pair<Vec3f, Vec3f>, int>& x, const std::pair<std::pair<Vec3f, Vec3f>, int>& y) {
+		return less(x.first.first, y.first.first) || (x.first.first == y.first.first && less(x.first.second, y.first.second));
+	};
+	std::sort(all.begin(), all.end(), pairLess);
+	edges.clear();
+	for (size_t i = 0, j; i < all.size(); i = j) {
+		for (j = i + 1; j < all.size() && all[j].first == all[i].first; j++);
+		if (j - i == 1)
+			edges.push_back(all[i].first);
+	}
+}
+
+// Checks the features of a simplified seam torus: no face spans a texture
+// seam, every face stays on its side of the material seam, and the hole
+// keeps its border, made of input border vertices only.
+bool checkSeamTorus(const Mesh<VertexPNT>& mesh, const std::vector<std::pair<Vec3f, Vec3f>>& input_border) {
+	for (int i = 0; i < mesh.numSubmeshes(); i++)
+		for (int j = 0; j < mesh.indices(i).getSize(); j++) {
+			const Vec3i& t = mesh.indices(i)[j];
+			Vec2f lo = FW::min(mesh[t.x].t, mesh[t.y].t, mesh[t.z].t), hi = FW::max(mesh[t.x].t, mesh[t.y].t, mesh[t.z].t);
+			if (hi.x - lo.x > 0.5f || hi.y - lo.y > 0.5f)
+				return false;
+			if ((i == 0 && hi.x > 0.501f) || (i == 1 && lo.x < 0.499f))
+				return false;
+		}
+
+	std::vector<std::pair<Vec3f, Vec3f>> border;
+	findBoundaryEdges(mesh, border);
+	std::vector<Vec3f> allowed;
+	for (auto& e : input_border) {
+		allowed.push_back(e.first);
+		allowed.push_back(e.second);
+	}
+	for (auto& e : border)
+		if (std::find(allowed.begin(), allowed.end(), e.first) == allowed.end() || std::find(allowed.begin(), allowed.end(), e.second) == allowed.end())
+			return false;
+	return !border.empty();
+}
+
+void benchQuadric(int argc, char** argv) {
+	std::string source = (argc > 0) ? argv[0] : "torus";
+	F64 target = (argc > 1) ? atof(argv[1]) : 0.1;
+	F32 max_error = (argc > 2) ? (F32)atof(argv[2]) : 0.0f;
+	int partitions = (argc > 3) ? atoi(argv[3]) : 0;
+	F32 pair_distance = (argc > 4) ? (F32)atof(argv[4]) : 0.0f;
+
+	Mesh<VertexPNT> input;
+	bool is_torus = (source == "torus");
+	if (is_torus)
+		makeSeamTorus(1000000, input);
+	else {
+		std::unique_ptr<MeshBase> loaded(importMesh(source.c_str()));
+		if (!loaded)
+			return;
+		input.set(*loaded);
+	}
+	std::vector<std::pair<Vec3f, Vec3f>> input_border;
+	if (is_torus)
+		findBoundaryEdges(input, input_border);
+
+	SimplifyParams params;
+	params.targetTriangles = (target > 1.0) ? (int)target : (int)(input.numTriangles() * target);
+	params.maxError = (max_error > 0.0f) ? max_error : FW_F32_MAX;
+	params.numPartitions = partitions;
+	params.pairDistance = pair_distance;
+	params.distanceSamples = 1 << 20;
+
+	FW::printf("%s: %d vertices, %d triangles in %d submeshes -> target %d, max error %g, pair distance %g\n", source.c_str(),
+		input.numVertices(), input.numTriangles(), input.numSubmeshes(), params.targetTriangles, params.maxError, params.pairDistance);
+
+	auto report = [&](const char* name, const SimplifyReport& r, const char* check) {
+		FW::printf("  %-16s setup %7.0f ms  collapse %7.0f ms  output %5.0f ms  total %7.0f ms  %d parts\n", name,
+			r.setupSeconds * 1.0e3f, r.collapseSeconds * 1.0e3f, r.outputSeconds * 1.0e3f,
+			(r.setupSeconds + r.collapseSeconds + r.outputSeconds) * 1.0e3f, r.numPartitions);
+		FW::printf("  %-16s collapse: slowest partition %6.0f ms, final pass %6.0f ms with %d collapses\n", "",
+			r.partitionSeconds * 1.0e3f, r.finalSeconds * 1.0e3f, r.finalCollapses);
+		FW::printf("  %-16s %d tris, %d verts, %d collapses, %d pairs, max error %.3g, Hausdorff %.3g (fwd %.3g, bwd %.3g), mean %.3g  %s\n", "",
+			r.outputTriangles, r.outputVertices, r.numCollapses, r.numPairs, r.maxError, r.distance.getHausdorff(), r.distance.forward,
+			r.distance.backward, r.distance.mean, check);
+	};
+
+	// Positions only, then with attributes, at increasing thread counts.
+	int numCores = MulticoreLauncher::getNumCores();
+	for (int numThreads = 1;; numThreads = FW::min(numThreads * 2, numCores)) {
+		MulticoreLauncher::setNumThreads(numThreads);
+		for (int attribs = 0; attribs < 2; attribs++) {
+			SimplifyParams p = params;
+			if (!attribs)
+				p.normalWeight = p.texCoordWeight = 0.0f;
+			Mesh<VertexPNT> mesh(input);
+			SimplifyReport r = simplifyQuadric(mesh, p);
+			const char* check = !is_torus ? "" : checkSeamTorus(mesh, input_border) ? "features ok" : "FEATURES BROKEN";
+			report(FW::sprintf("%d thr, %s", numThreads, attribs ? "attribs" : "positions").getPtr(), r, check);
+		}
+		if (numThreads == numCores)
+			break;
+	}
+	MulticoreLauncher::setNumThreads(numCores);
+}
+
+// LOD chain of a seam torus or a file: build time in place and in the
+// background (counting the frames a viewer could draw meanwhile), the
+// levels with their stored errors against the measured distance to the
+// full mesh, the level picked at increasing distances, and a round trip
+// through the binary format.
+void benchLod(int argc, char** argv) {
+	std::string source = (argc > 0) ? argv[0] : "torus";
+	int num_levels = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 5;
+	F32 ratio = (argc > 2) ? FW::clamp((F32)atof(argv[2]), 0.01f, 0.99f) : 0.5f;
+	F32 pixel_error = (argc > 3) ? (F32)atof(argv[3]) : 1.0f;
+
+	std::unique_ptr<MeshBase> mesh;
+	if (source == "torus") {
+		Mesh<VertexPNT>* torus = new Mesh<VertexPNT>;
+		makeSeamTorus(1000000, *torus);
+		mesh.reset(torus);
+	} else
+		mesh.reset(importMesh(source.c_str()));
+	if (!mesh)
+		return;
+	FW::printf("%s: %d vertices, %d triangles, %d submeshes, %d levels at ratio %g\n", source.c_str(), mesh->numVertices(),
+		mesh->numTriangles(), mesh->numSubmeshes(), num_levels, ratio);
+
+	std::vector<U8> vertices(mesh->getVertexPtr(), mesh->getVertexPtr(mesh->numVertices()));
+	Timer timer(true);
+	mesh->buildLods(num_levels, ratio);
+	F32 t_build = timer.end();
+	const MeshBase::Lods& lods = mesh->lods();
+	bool untouched = (memcmp(vertices.data(), mesh->getVertexPtr(), vertices.size()) == 0);
+	FW::printf("  build: %8.0f ms, %d levels, vertex buffer %s\n", t_build * 1.0e3f, lods.numLevels(), untouched ? "shared" : "CHANGED");
+
+	// Background build, polled once per simulated frame.
+
+	LodBuilder builder;
+	MeshBase::Lods background;
+	int frames = 0;
+	timer.start();
+	builder.start(*mesh, num_levels, ratio);
+	while (!builder.poll(background)) {
+		Thread::sleep(16);
+		frames++;
+	}
+	FW::printf("  background: %8.0f ms, %d frames polled meanwhile, %s\n", timer.end() * 1.0e3f, frames,
+		(background.triangles.getSize() == lods.triangles.getSize() &&
+		memcmp(background.triangles.getPtr(), lods.triangles.getPtr(), lods.triangles.getNumBytes()) == 0) ? "same levels" : "DIFFERENT LEVELS");
+
+	// Each level against the full mesh.
+
+	for (int level = 1; level < lods.numLevels(); level++) {
+		MeshBase coarse;
+		coarse.addAttribs(*mesh);
+		coarse.resetVertices(mesh->numVertices());
+		coarse.setVertices(0, mesh->getVertexPtr(), mesh->numVertices());
+		coarse.resizeSubmeshes(mesh->numSubmeshes());
+		int tris = 0;
+		bool valid = true;
+		for (int i = 0; i < mesh->numSubmeshes(); i++) {
+			const Vec2i& range = lods.ranges[(level - 1) * mesh->numSubmeshes() + i];
+			coarse.setIndices(i, lods.triangles.getPtr(range.x), range.y);
+			tris += range.y;
+			for (int j = 0; j < range.y; j++)
+				valid &= (FW::min(lods.triangles[range.x + j]) >= 0 && FW::max(lods.triangles[range.x + j]) < mesh->numVertices());
+		}
+		SurfaceDistance d = measureSurfaceDistance(*mesh, coarse);
+		FW::printf("  level %d: %8d tris (%5.1f%%), error %.3g, measured Hausdorff %.3g, mean %.3g%s\n", level, tris,
+			100.0 * tris / mesh->numTriangles(), lods.getError(level), d.getHausdorff(), d.mean,
+			!valid ? ", BAD INDICES" : (d.getHausdorff() > lods.getError(level)) ? ", ERROR UNDERESTIMATED" : "");
+	}
+
+	// Selection for a 60 degree, 1080 pixel view, from touching the
+	// bounding sphere out to 1000 radii away.
+
+	Vec3f lo, hi;
+	mesh->getBBox(lo, hi);
+	F32 radius = (hi - lo).length() * 0.5f;
+	Mat4f projection = Mat4f::perspective(60.0f, radius * 0.01f, radius * 2000.0f);
+	std::string picks;
+	int previous = 0;
+	bool monotonic = true;
+	F32 t_select = 0.0f;
+	for (F32 distance = radius * 1.5f; distance <= radius * 1000.0f; distance *= 2.0f) {
+		Mat4f posToCamera = Mat4f::translate(Vec3f(0.0f, 0.0f, -distance)) * Mat4f::translate(-(lo + hi) * 0.5f);
+		timer.start();
+		int level = mesh->selectLod(posToCamera, projection, 1080.0f, pixel_error);
+		t_select += timer.end();
+		monotonic &= (level >= previous);
+		previous = level;
+		picks += FW::sprintf(" %.0f:%d", distance / radius, level).getPtr();
+	}
+	FW::printf("  selection at %g px (radii:level):%s, %s, %.2f us each\n", pixel_error, picks.c_str(),
+		monotonic ? "monotonic" : "NOT MONOTONIC", t_select * 1.0e6f / 10.0f);
+
+	MemoryOutputStream out;
+	exportBinaryMesh(out, mesh.get());
+	MemoryInputStream in(out.getData());
+	std::unique_ptr<MeshBase> loaded(importBinaryMesh(in));
+	const MeshBase::Lods* l = (loaded) ? &loaded->lods() : NULL;
+	bool same = l && l->numLevels() == lods.numLevels() && l->triangles.getSize() == lods.triangles.getSize() &&
+		memcmp(l->ranges.getPtr(), lods.ranges.getPtr(), lods.ranges.getNumBytes()) == 0 &&
+		memcmp(l->triangles.getPtr(), lods.triangles.getPtr(), lods.triangles.getNumBytes()) == 0 &&
+		memcmp(l->errors.getPtr(), lods.errors.getPtr(), lods.errors.getNumBytes()) == 0;
+	FW::printf("  binary mesh: %d bytes, levels %s\n", out.getData().getSize(), same ? "round-trip ok" : "MISMATCH");
+}
+
+// The bulk MeshBase operations as they were written on the per-vertex,
+// per-component converting accessors, for comparison.
+void getBBoxPerVertex(const MeshBase& mesh, Vec3f& lo, Vec3f& hi) {
+	int pos_attrib = mesh.findAttrib(MeshBase::AttribType_Position);
+	lo = Vec3f(+FW_F32_MAX);
+	hi = Vec3f(-FW_F32_MAX);
+	for (int i = 0; i < mesh.numVertices(); i++) {
+		Vec4f pos = mesh.getVertexAttrib(i, pos_attrib);
+		for (int j = 0; j < 3; j++) {
+			lo[j] = FW::min(lo[j], pos[j]);
+			hi[j] = FW::max(hi[j], pos[j]);
+		}
+	}
+}
+
+void xformPositionsPerVertex(MeshBase& mesh, const Mat4f& mat) {
+	int pos_attrib = mesh.findAttrib(MeshBase::AttribType_Position);
+	for (int i = 0; i < mesh.numVertices(); i++) {
+		Vec4f pos = mat * mesh.getVertexAttrib(i, pos_attrib);
+		if (pos.w != 0.0f)
+			pos *= 1.0f / pos.w;
+		mesh.setVertexAttrib(i, pos_attrib, pos);
+	}
+}
+
+void xformNormalsPerVertex(MeshBase& mesh, const Mat3f& mat) {
+	int normal_attrib = mesh.findAttrib(MeshBase::AttribType_Normal);
+	for (int i = 0; i < mesh.numVertices(); i++) {
+		Vec3f normal = (mat * mesh.getVertexAttrib(i, normal_attrib).getXYZ()).normalized();
+		mesh.setVertexAttrib(i, normal_attrib, Vec4f(normal, 0.0f));
+	}
+}
+
+void recomputeNormalsPerVertex(MeshBase& mesh) {
+	int pos_attrib = mesh.findAttrib(MeshBase::AttribType_Position);
+	int normal_attrib = mesh.findAttrib(MeshBase::AttribType_Normal);
+	Hash<Vec3f, Vec3f> pos_to_normal;
+	for (int i = 0; i < mesh.numSubmeshes(); i++)
+		for (int j = 0; j < mesh.indices(i).getSize(); j++) {
+			const Vec3i& tri = mesh.indices(i)[j];
+			Vec3f v[3];
+			for (int k = 0; k < 3; k++)
+				v[k] = mesh.getVertexAttrib(tri[k], pos_attrib).getXYZ();
+			Vec3f normal = (v[1] - v[0]).cross(v[2] - v[0]);
+			for (int k = 0; k < 3; k++) {
+				Vec3f* found = pos_to_normal.search(v[k]);
+				if (found)
+					*found += normal;
+				else
+					pos_to_normal.add(v[k], normal);
+			}
+		}
+	for (int i = 0; i < mesh.numVertices(); i++) {
+		Vec3f* found = pos_to_normal.search(mesh.getVertexAttrib(i, pos_attrib).getXYZ());
+		if (found)
+			mesh.setVertexAttrib(i, normal_attrib, Vec4f(found->normalized(), 0.0f));
+	}
+}
+
+// Bulk mesh operations through typed attribute views versus the per-vertex
+// accessors, on a torus with about 'vertices' vertices. Each pair works on
+// identical copies, and the results must match bit for bit.
+void benchAttribs(int argc, char** argv) {
+	int num_vertices = (argc > 0) ? FW::max(atoi(argv[0]), 16) : 1000000;
+	int repeats = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 5;
+
+	std::vector<Vec3f> positions;
+	std::vector<Vec3i> triangles;
+	makeTorus(num_vertices * 2, positions, triangles);
+
+	Mesh<VertexPNT> source;
+	source.resetVertices((int)positions.size());
+	for (int i = 0; i < source.numVertices(); i++)
+		source.setVertex(i, VertexPNT(positions[i], Vec3f(0.0f, 1.0f, 0.0f), Vec2f(0.0f)));
+	source.setIndices(source.addSubmesh(), triangles.data(), (int)triangles.size());
+	int pos_attrib = source.findAttrib(MeshBase::AttribType_Position);
+
+	Mat4f mat = Mat4f::translate(Vec3f(0.1f, 0.2f, 0.3f)) * Mat4f::scale(Vec3f(1.5f, 0.5f, 2.0f));
+	mat.m30 = 0.01f;	// Projective, so that the divide by w matters.
+	Mat3f normal_mat = mat.getXYZ().transposed().inverted();
+
+	FW::printf("torus: %d vertices (%d bytes each), %d triangles, best of %d\n", source.numVertices(), source.vertexStride(),
+		(int)triangles.size(), repeats);
+	FW::printf("  %-18s %12s %12s %9s\n", "", "per-vertex", "view", "speedup");
+
+	// Bounding box: the same loop over a view with a run-time stride and
+	// over the view of Mesh<V> with a compile-time stride, then getBBox().
+	{
+		const MeshBase& base = source;
+		Vec3f lo[4], hi[4];
+		auto bbox = [](const auto& pos, Vec3f& lo, Vec3f& hi) {
+			Vec3f l(+FW_F32_MAX), h(-FW_F32_MAX);
+			for (int i = 0; i < pos.getSize(); i++) {
+				const Vec3f& p = pos[i];
+				l = Vec3f(FW::min(l.x, p.x), FW::min(l.y, p.y), FW::min(l.z, p.z));
+				h = Vec3f(FW::max(h.x, p.x), FW::max(h.y, p.y), FW::max(h.z, p.z));
+			}
+			lo = l;
+			hi = h;
+		};
+		F32 t_old = timeBest(repeats, [&]() { getBBoxPerVertex(base, lo[0], hi[0]); });
+		F32 t_view[3];
+		t_view[0] = timeBest(repeats, [&]() { bbox(base.getAttribView<Vec3f>(pos_attrib), lo[1], hi[1]); });
+		t_view[1] = timeBest(repeats, [&]() { bbox(source.getAttribView<Vec3f>(pos_attrib), lo[2], hi[2]); });
+		t_view[2] = timeBest(repeats, [&]() { base.getBBox(lo[3], hi[3]); });
+		static const char* names[] = { "bbox, run-time", "bbox, sizeof(V)", "getBBox" };
+		for (int i = 0; i < 3; i++)
+			FW::printf("  %-18s %9.2f ms %9.2f ms %8.2fx  %s\n", names[i], t_old * 1.0e3f, t_view[i] * 1.0e3f, t_old / t_view[i],
+				(lo[0] == lo[i + 1] && hi[0] == hi[i + 1]) ? "identical" : "DIFFER");
+	}
+
+	// In-place operations, timed on fresh copies of the source.
+	auto compare = [&](const char* name, const std::function<void(MeshBase&)>& old_op, const std::function<void(MeshBase&)>& new_op) {
+		Mesh<VertexPNT> a, b;
+		F32 t_old = FW_F32_MAX, t_new = FW_F32_MAX;
+		for (int i = 0; i < repeats; i++) {
+			a = source;
+			Timer timer(true);
+			old_op(a);
+			t_old = FW::min(t_old, timer.getElapsed());
+			b = source;
+			timer.start();
+			new_op(b);
+			t_new = FW::min(t_new, timer.getElapsed());
+		}
+		FW::printf("  %-18s %9.2f ms %9.2f ms %8.2fx  %s\n", name, t_old * 1.0e3f, t_new * 1.0e3f, t_old / t_new, sameMesh(a, b) ? "identical" : "DIFFER");
+	};
+	compare("xformPositions", [&](MeshBase& m) { xformPositionsPerVertex(m, mat); }, [&](MeshBase& m) { m.xformPositions(mat); });
+	compare("xformNormals", [&](MeshBase& m) { xformNormalsPerVertex(m, normal_mat); }, [&](MeshBase& m) { m.xformNormals(normal_mat); });
+	compare("recomputeNormals", recomputeNormalsPerVertex, [](MeshBase& m) { m.recomputeNormals(); });
+}
+
+// Largest distance in units in the last place between matching floats.
+U32 maxUlps(const F32* a, const F32* b, size_t num) {
+	U32 worst = 0;
+	for (size_t i = 0; i < num; i++) {
+		S32 ia = (S32)floatToBits(a[i]), ib = (S32)floatToBits(b[i]);
+		ia = (ia < 0) ? (S32)0x80000000 - ia : ia;
+		ib = (ib < 0) ? (S32)0x80000000 - ib : ib;
+		worst = FW::max(worst, (U32)FW::abs((S64)ia - ib));
+	}
+	return worst;
+}
+
+// transformPoints() and transformNormals() against the scalar Mat4f/Mat3f
+// loops that xformPositions() and xformNormals() used to run, on random
+// packed arrays and on interleaved vertices, at increasing thread counts.
+void benchXform(int argc, char** argv) {
+	int num = (argc > 0) ? FW::max(atoi(argv[0]), 1) : 4000000;
+	int repeats = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 5;
+
+	Random random(1);
+	std::vector<Vec3f> points(num), normals(num);
+	std::vector<Vec4f> points4(num);
+	std::vector<VertexPNT> vertices(num);
+	for (int i = 0; i < num; i++) {
+		points[i] = random.getVec3f(-10.0f, 10.0f);
+		normals[i] = random.getVec3f(-1.0f, 1.0f).normalized();
+		points4[i] = Vec4f(points[i], random.getF32(0.5f, 2.0f));
+		vertices[i] = VertexPNT(points[i], normals[i], Vec2f(0.0f));
+	}
+
+	Mat4f mat = Mat4f::translate(Vec3f(0.1f, 0.2f, 0.3f)) * Mat4f::scale(Vec3f(1.5f, 0.5f, 2.0f));
+	mat.m01 = 0.3f;		// Shear, so that every product contributes.
+	mat.m12 = -0.2f;
+	mat.m30 = 0.01f;	// Projective, so that the divide by w matters.
+	Mat3f normal_mat = mat.getXYZ().transposed().inverted();
+
+	std::vector<Vec3f> ref_points(num), ref_normals(num);
+	std::vector<Vec4f> ref_points4(num);
+	std::vector<VertexPNT> ref_vertices = vertices;
+	F32 t_ref[4];
+	t_ref[0] = timeBest(repeats, [&]() {
+		for (int i = 0; i < num; i++) {
+			Vec4f p = mat * Vec4f(points[i], 1.0f);
+			if (p.w != 0.0f)
+				p *= 1.0f / p.w;
+			ref_points[i] = p.getXYZ();
+		}
+	});
+	t_ref[1] = timeBest(repeats, [&]() {
+		for (int i = 0; i < num; i++) {
+			Vec4f p = mat * points4[i];
+			if (p.w != 0.0f)
+				p *= 1.0f / p.w;
+			ref_points4[i] = p;
+		}
+	});
+	t_ref[2] = timeBest(repeats, [&]() {
+		for (int i = 0; i < num; i++)
+			ref_normals[i] = (normal_mat * normals[i]).normalized();
+	});
+	t_ref[3] = timeBest(repeats, [&]() {
+		for (int i = 0; i < num; i++) {
+			VertexPNT& v = ref_vertices[i];
+			Vec4f p = mat * Vec4f(vertices[i].p, 1.0f);
+			if (p.w != 0.0f)
+				p *= 1.0f / p.w;
+			v.p = p.getXYZ();
+			v.n = (normal_mat * vertices[i].n).normalized();
+		}
+	});
+
+	FW::printf("%d elements, best of %d, %d cores\n", num, repeats, MulticoreLauncher::getNumCores());
+	FW::printf("  %-22s %10s %10s %9s %8s\n", "", "scalar", "batch", "speedup", "max ulps");
+
+	std::vector<Vec3f> out_points(num), out_normals(num);
+	std::vector<Vec4f> out_points4(num);
+	std::vector<VertexPNT> out_vertices = vertices;
+	int numCores = MulticoreLauncher::getNumCores();
+	for (int numThreads = 1;; numThreads = FW::min(numThreads * 2, numCores)) {
+		MulticoreLauncher::setNumThreads(numThreads);
+		F32 t[4];
+		t[0] = timeBest(repeats, [&]() { transformPoints(mat, &points[0].x, sizeof(Vec3f), &out_points[0].x, sizeof(Vec3f), num); });
+		t[1] = timeBest(repeats, [&]() { transformPoints(mat, &points4[0].x, sizeof(Vec4f), &out_points4[0].x, sizeof(Vec4f), num, 4); });
+		t[2] = timeBest(repeats, [&]() { transformNormals(normal_mat, &normals[0].x, sizeof(Vec3f), &out_normals[0].x, sizeof(Vec3f), num); });
+		t[3] = timeBest(repeats, [&]() {
+			transformPoints(mat, &vertices[0].p.x, sizeof(VertexPNT), &out_vertices[0].p.x, sizeof(VertexPNT), num);
+			transformNormals(normal_mat, &vertices[0].n.x, sizeof(VertexPNT), &out_vertices[0].n.x, sizeof(VertexPNT), num);
+		});
+
+		U32 ulps[4];
+		ulps[0] = maxUlps(&ref_points[0].x, &out_points[0].x, (size_t)num * 3);
+		ulps[1] = maxUlps(&ref_points4[0].x, &out_points4[0].x, (size_t)num * 4);
+		ulps[2] = maxUlps(&ref_normals[0].x, &out_normals[0].x, (size_t)num * 3);
+		ulps[3] = maxUlps(&ref_vertices[0].p.x, &out_vertices[0].p.x, (size_t)num * sizeof(VertexPNT) / sizeof(F32));
+
+		static const char* names[] = { "points xyz", "points xyzw", "normals", "interleaved PNT" };
+		for (int i = 0; i < 4; i++) {
+			String name = FW::sprintf("%s, %d thr", names[i], numThreads);
+			FW::printf("  %-22s %7.2f ms %7.2f ms %8.2fx %8u%s\n", name.getPtr(), t_ref[i] * 1.0e3f, t[i] * 1.0e3f, t_ref[i] / t[i],
+				ulps[i], (ulps[i] <= 1) ? "" : "  TOO FAR");
+		}
+		if (numThreads == numCores)
+			break;
+	}
+	MulticoreLauncher::setNumThreads(numCores);
+}
+
+// getBBox() and getSubmeshBBox() on a torus split into two submeshes: the
+// first call after positions change (the reduction) at increasing thread
+// counts, cached calls, and extending after appended vertices, all checked
+// against per-vertex loops.
+void benchBBox(int argc, char** argv) {
+	int num_vertices = (argc > 0) ? FW::max(atoi(argv[0]), 16) : 4000000;
+	int repeats = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 5;
+
+	std::vector<Vec3f> positions;
+	std::vector<Vec3i> triangles;
+	makeTorus(num_vertices * 2, positions, triangles);
+
+	Mesh<VertexPNT> mesh;
+	mesh.resetVertices((int)positions.size());
+	for (int i = 0; i < mesh.numVertices(); i++)
+		mesh.setVertex(i, VertexPNT(positions[i], Vec3f(0.0f, 1.0f, 0.0f), Vec2f(0.0f)));
+	int half = (int)triangles.size() / 2;
+	mesh.setIndices(mesh.addSubmesh(), triangles.data(), half);
+	mesh.setIndices(mesh.addSubmesh(), triangles.data() + half, (int)triangles.size() - half);
+
+	auto submeshRef = [&](int submesh, Vec3f& lo, Vec3f& hi) {
+		lo = Vec3f(+FW_F32_MAX);
+		hi = Vec3f(-FW_F32_MAX);
+		const Array<Vec3i>& tris = mesh.indices(submesh);
+		for (int i = 0; i < tris.getSize(); i++)
+			for (int k = 0; k < 3; k++) {
+				const Vec3f& p = mesh[tris[i][k]].p;
+				lo = Vec3f(FW::min(lo.x, p.x), FW::min(lo.y, p.y), FW::min(lo.z, p.z));
+				hi = Vec3f(FW::max(hi.x, p.x), FW::max(hi.y, p.y), FW::max(hi.z, p.z));
+			}
+	};
+
+	Vec3f ref_lo, ref_hi, sub_lo[2], sub_hi[2], lo, hi;
+	F32 t_ref = timeBest(repeats, [&]() { getBBoxPerVertex(mesh, ref_lo, ref_hi); });
+	F32 t_sub_ref = timeBest(repeats, [&]() { submeshRef(0, sub_lo[0], sub_hi[0]); });
+	submeshRef(1, sub_lo[1], sub_hi[1]);
+
+	FW::printf("torus: %d vertices, %d triangles in 2 submeshes, best of %d\n", mesh.numVertices(), (int)triangles.size(), repeats);
+	FW::printf("  per-vertex: mesh %.2f ms, submesh %.2f ms\n", t_ref * 1.0e3f, t_sub_ref * 1.0e3f);
+
+	// A write through getMutableVertexPtr() drops the caches, like the VBO.
+	const MeshBase& base = mesh;
+	int numCores = MulticoreLauncher::getNumCores();
+	for (int numThreads = 1;; numThreads = FW::min(numThreads * 2, numCores)) {
+		MulticoreLauncher::setNumThreads(numThreads);
+		bool same = true;
+		F32 t_mesh = timeBest(repeats, [&]() {
+			mesh.getMutableVertexPtr();
+			base.getBBox(lo, hi);
+		});
+		same = same && lo == ref_lo && hi == ref_hi;
+		F32 t_submesh = timeBest(repeats, [&]() {
+			mesh.getMutableVertexPtr();
+			base.getSubmeshBBox(0, lo, hi);
+		});
+		same = same && lo == sub_lo[0] && hi == sub_hi[0];
+		base.getSubmeshBBox(1, lo, hi);
+		same = same && lo == sub_lo[1] && hi == sub_hi[1];
+		FW::printf("  %3d thr: mesh %8.2f ms %6.2fx, submesh %8.2f ms %6.2fx  %s\n", numThreads, t_mesh * 1.0e3f, t_ref / t_mesh,
+			t_submesh * 1.0e3f, t_sub_ref / t_submesh, same ? "identical" : "DIFFER");
+		if (numThreads == numCores)
+			break;
+	}
+	MulticoreLauncher::setNumThreads(numCores);
+
+	base.getBBox(lo, hi);
+	F32 t_cached = timeBest(repeats, [&]() { base.getBBox(lo, hi); });
+	FW::printf("  cached getBBox: %.3f us\n", t_cached * 1.0e6f);
+
+	// Appending 1% of the vertices, beyond the box, only scans those.
+	int num_added = FW::max(mesh.numVertices() / 100, 1);
+	std::vector<VertexPNT> added(num_added);
+	Random random(1);
+	for (VertexPNT& v : added)
+		v = VertexPNT(random.getVec3f(-2.0f, 2.0f), Vec3f(0.0f, 1.0f, 0.0f), Vec2f(0.0f));
+	mesh.addVertices(added.data(), num_added);
+	Timer timer(true);
+	base.getBBox(lo, hi);
+	F32 t_extend = timer.end();
+	getBBoxPerVertex(mesh, ref_lo, ref_hi);
+	bool same = lo == ref_lo && hi == ref_hi;
+	base.getSubmeshBBox(0, lo, hi);
+	same = same && lo == sub_lo[0] && hi == sub_hi[0];
+
+	// Moving one vertex must show up in both kinds of box.
+	mesh.setVertexAttrib(0, mesh.findAttrib(MeshBase::AttribType_Position), Vec4f(5.0f, 0.0f, 0.0f, 1.0f));
+	base.getBBox(lo, hi);
+	same = same && hi.x == 5.0f;
+	base.getSubmeshBBox(0, lo, hi);
+	same = same && hi.x == 5.0f;
+	FW::printf("  %d vertices appended: getBBox %.3f ms, invalidation %s\n", num_added, t_extend * 1.0e3f, same ? "ok" : "WRONG");
+}
+
+// recomputeNormals() on a welded torus: the serial per-vertex hash version
+// against the sort-based one at increasing thread counts, which must match
+// it bit for bit. Then runs with crease angles.
+void benchNormals(int argc, char** argv) {
+	int num_triangles = (argc > 0) ? FW::max(atoi(argv[0]), 16) : 4000000;
+	F32 crease_degrees = (argc > 1) ? (F32)atof(argv[1]) : 30.0f;
+	int repeats = (argc > 2) ? FW::max(atoi(argv[2]), 1) : 3;
+
+	std::vector<Vec3f> positions;
+	std::vector<Vec3i> triangles;
+	makeTorus(num_triangles, positions, triangles);
+
+	Mesh<VertexPN> source;
+	source.resetVertices((int)positions.size());
+	for (int i = 0; i < source.numVertices(); i++)
+		source.setVertex(i, VertexPN(positions[i], Vec3f(0.0f)));
+	source.setIndices(source.addSubmesh(), triangles.data(), (int)triangles.size());
+	FW::printf("torus: %d vertices, %d triangles, best of %d\n", source.numVertices(), (int)triangles.size(), repeats);
+
+	Mesh<VertexPN> reference, mesh;
+	F32 t_serial = FW_F32_MAX;
+	for (int i = 0; i < repeats; i++) {
+		reference = source;
+		Timer timer(true);
+		recomputeNormalsPerVertex(reference);
+		t_serial = FW::min(t_serial, timer.getElapsed());
+	}
+	FW::printf("  serial hash    : %8.2f ms\n", t_serial * 1.0e3f);
+
+	int numCores = MulticoreLauncher::getNumCores();
+	for (int numThreads = 1;; numThreads = FW::min(numThreads * 2, numCores)) {
+		MulticoreLauncher::setNumThreads(numThreads);
+		F32 t = FW_F32_MAX;
+		for (int i = 0; i < repeats; i++) {
+			mesh = source;
+			Timer timer(true);
+			mesh.recomputeNormals();
+			t = FW::min(t, timer.getElapsed());
+		}
+		FW::printf("  sorted %3d thr : %8.2f ms  %.2fx  %s\n", numThreads, t * 1.0e3f, t_serial / t,
+			memcmp(mesh.getVertexPtr(), reference.getVertexPtr(), mesh.numVertices() * sizeof(VertexPN)) == 0 ? "identical" : "DIFFERS");
+		if (numThreads == numCores)
+			break;
+	}
+	MulticoreLauncher::setNumThreads(numCores);
+
+	// A crease angle that no edge of the closed torus reaches keeps every
+	// fan whole, so the crease path must reproduce the smooth normals.
+	mesh = source;
+	mesh.recomputeNormals(FW_PI * 0.999f);
+	FW::printf("  crease 179.8 deg: %d vertices, %s smooth\n", mesh.numVertices(),
+		(mesh.numVertices() == reference.numVertices() && memcmp(mesh.getVertexPtr(), reference.getVertexPtr(), mesh.numVertices() * sizeof(VertexPN)) == 0) ? "identical to" : "DIFFERS from");
+
+	mesh = source;
+	Timer timer(true);
+	mesh.recomputeNormals(crease_degrees * FW_PI / 180.0f);
+	F32 t = timer.getElapsed();
+
+	F32 max_degrees = 0.0f;
+	const Array<Vec3i>& tris = mesh.indices(0);
+	for (int i = 0; i < tris.getSize(); i++) {
+		const Vec3i& tri = tris[i];
+		Vec3f face = cross(mesh[tri.y].p - mesh[tri.x].p, mesh[tri.z].p - mesh[tri.x].p).normalized();
+		for (int k = 0; k < 3; k++) {
+			F32 d = FW::clamp(dot(face, mesh[tri[k]].n), -1.0f, 1.0f);
+			max_degrees = FW::max(max_degrees, FW::acos(d) * 180.0f / FW_PI);
+		}
+	}
+	FW::printf("  crease %5.1f deg: %8.2f ms  %d vertices (+%d), max corner-to-face angle %.2f deg\n", crease_degrees, t * 1.0e3f,
+		mesh.numVertices(), mesh.numVertices() - source.numVertices(), max_degrees);
+}
+
+// MeshBase::collapseVertices as it was before keys were pointed at the
+// compacted copies: compaction overwrites vertices that earlier keys still
+// point to, so some later duplicates are not found.
+void collapseVerticesOld(MeshBase& mesh) {
+	int num = mesh.numVertices(), stride = mesh.vertexStride();
+	U8* ptr = mesh.getMutableVertexPtr();
+	Hash<GenericHashKey, S32> hash;
+	Array<S32> remap;
+	hash.setCapacity(num);
+	remap.reset(num);
+	for (int i = 0; i < num; i++) {
+		GenericHashKey key(ptr + i * stride, stride);
+		S32* found = hash.search(key);
+		if (found)
+			remap[i] = *found;
+		else {
+			remap[i] = hash.getSize();
+			hash.add(key, remap[i]);
+			if (remap[i] != i)
+				memcpy(ptr + remap[i] * stride, ptr + i * stride, stride);
+		}
+	}
+	mesh.resizeVertices(hash.getSize());
+	for (int i = 0; i < mesh.numSubmeshes(); i++) {
+		Array<Vec3i>& inds = mesh.mutableIndices(i);
+		for (int j = 0; j < inds.getSize(); j++)
+			for (int k = 0; k < 3; k++)
+				inds[j][k] = remap[inds[j][k]];
+	}
+}
+
+// Welding a triangle soup (three vertices per triangle, as scanners and
+// some exporters write them) with the hash table and with the radix sort
+// at increasing thread counts. Both must produce the same mesh.
+void benchCollapse(int argc, char** argv) {
+	int num_triangles = (argc > 0) ? FW::max(atoi(argv[0]), 16) : 4000000;
+	int repeats = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 3;
+
+	std::vector<Vec3f> positions;
+	std::vector<Vec3i> triangles;
+	makeTorus(num_triangles, positions, triangles);
+
+	Mesh<VertexPNT> welded;
+	welded.resetVertices((int)positions.size());
+	for (int i = 0; i < welded.numVertices(); i++)
+		welded.setVertex(i, VertexPNT(positions[i], Vec3f(0.0f), Vec2f(positions[i].x, positions[i].z)));
+	welded.setIndices(welded.addSubmesh(), triangles.data(), (int)triangles.size());
+	welded.recomputeNormals();
+
+	Mesh<VertexPNT> source;
+	source.resetVertices((int)triangles.size() * 3);
+	Array<Vec3i> soup;
+	for (int i = 0; i < (int)triangles.size(); i++) {
+		for (int k = 0; k < 3; k++)
+			source.setVertex(i * 3 + k, welded[triangles[i][k]]);
+		soup.add(Vec3i(i * 3, i * 3 + 1, i * 3 + 2));
+	}
+	source.setIndices(source.addSubmesh(), soup);
+	FW::printf("torus soup: %d vertices (%d distinct), %d triangles, best of %d\n", source.numVertices(), welded.numVertices(),
+		(int)triangles.size(), repeats);
+
+	auto timeCollapse = [&](Mesh<VertexPNT>& mesh, const std::function<void(MeshBase&)>& op) {
+		F32 best = FW_F32_MAX;
+		for (int i = 0; i < repeats; i++) {
+			mesh = source;
+			Timer timer(true);
+			op(mesh);
+			best = FW::min(best, timer.getElapsed());
+		}
+		return best;
+	};
+
+	Mesh<VertexPNT> old_mesh, reference;
+	F32 t_old = timeCollapse(old_mesh, collapseVerticesOld);
+	F32 t_hashed = timeCollapse(reference, [](MeshBase& m) { m.collapseVertsHashed(); });
+	FW::printf("  previous hash   : %8.2f ms  %d vertices\n", t_old * 1.0e3f, old_mesh.numVertices());
+	FW::printf("  hashed          : %8.2f ms  %d vertices\n", t_hashed * 1.0e3f, reference.numVertices());
+
+	int numCores = MulticoreLauncher::getNumCores();
+	for (int numThreads = 1;; numThreads = FW::min(numThreads * 2, numCores)) {
+		MulticoreLauncher::setNumThreads(numThreads);
+		Mesh<VertexPNT> mesh;
+		F32 t = timeCollapse(mesh, [](MeshBase& m) { m.collapseVertsSorted(); });
+		FW::printf("  sorted %3d thr  : %8.2f ms  %d vertices  %.2fx  %s\n", numThreads, t * 1.0e3f, mesh.numVertices(), t_hashed / t,
+			sameMesh(mesh, reference) ? "identical" : "DIFFERS");
+		if (numThreads == numCores)
+			break;
+	}
+	MulticoreLauncher::setNumThreads(numCores);
+
+	// Meshes just above the size where collapseVertices() switches to
+	// sorting (1 << 16 vertices) get short fingerprints; collisions between
+	// distinct vertices must not split the runs of identical ones.
+
+	const int num_trials = 16, num_distinct = 1 << 16;
+	int num_same = 0;
+	Random random(1);
+	for (int trial = 0; trial < num_trials; trial++) {
+		std::vector<VertexPNT> vertices;
+		for (int i = 0; i < num_distinct * 2; i++) {
+			int v = (i < num_distinct) ? i : random.getS32(num_distinct);
+			vertices.push_back(VertexPNT(Vec3f((F32)v, (F32)trial, 0.0f), Vec3f(0.0f), Vec2f(0.0f)));
+		}
+		for (int i = (int)vertices.size() - 1; i > 0; i--)
+			std::swap(vertices[i], vertices[random.getS32(i + 1)]);
+
+		Mesh<VertexPNT> hashed;
+		hashed.resetVertices((int)vertices.size());
+		hashed.setVertices(0, vertices.data(), (int)vertices.size());
+		Array<Vec3i> tris;
+		for (int i = 0; i + 2 < (int)vertices.size(); i += 3)
+			tris.add(Vec3i(i, i + 1, i + 2));
+		hashed.setIndices(hashed.addSubmesh(), tris);
+
+		Mesh<VertexPNT> sorted = hashed;
+		hashed.collapseVertsHashed();
+		sorted.collapseVertsSorted();
+		num_same += sameMesh(sorted, hashed) ? 1 : 0;
+	}
+	FW::printf("  sorted vs hashed, %d meshes of %d vertices: %d identical%s\n", num_trials, num_distinct * 2, num_same,
+		(num_same == num_trials) ? "" : " (MISMATCH)");
+}
+
+// MeshBase::weldVertices by testing every pair of vertices, for checking
+// the grid on small meshes.
+void weldVerticesBrute(Mesh<VertexPNT>& mesh, F32 pos_tol, F32 normal_tol, F32 tex_tol) {
+	int num = mesh.numVertices();
+	UnionFind pos_groups(num), all_groups(num);
+	for (int i = 0; i < num; i++)
+		for (int j = i + 1; j < num; j++) {
+			const VertexPNT& a = mesh[i];
+			const VertexPNT& b = mesh[j];
+			if ((a.p - b.p).lenSqr() > pos_tol * pos_tol)
+				continue;
+			pos_groups.unionSets(i, j);
+			if ((a.n - b.n).lenSqr() <= normal_tol * normal_tol && (Vec3f(a.t, 0.0f) - Vec3f(b.t, 0.0f)).lenSqr() <= tex_tol * tex_tol)
+				all_groups.unionSets(i, j);
+		}
+
+	std::vector<int> first(num, -1), remap(num);
+	for (int i = 0; i < num; i++) {
+		int& f = first[pos_groups[i]];
+		if (f == -1)
+			f = i;
+		mesh[i].p = mesh[f].p;
+	}
+	first.assign(num, -1);
+	Mesh<VertexPNT> out;
+	for (int i = 0; i < num; i++) {
+		int& f = first[all_groups[i]];
+		if (f == -1) {
+			f = i;
+			remap[i] = out.numVertices();
+			out.addVertex(mesh[i]);
+		}
+		else
+			remap[i] = remap[f];
+	}
+	for (int i = 0; i < mesh.numSubmeshes(); i++) {
+		Array<Vec3i> inds = mesh.indices(i);
+		for (int j = 0; j < inds.getSize(); j++)
+			for (int k = 0; k < 3; k++)
+				inds[j][k] = remap[inds[j][k]];
+		out.setIndices(out.addSubmesh(), inds);
+	}
+	mesh = out;
+}
+
+// Triangle soup of a torus whose corners are jittered within 'jitter' times
+// the tolerances of each attribute, as in CAD exports with unwelded seams.
+// 'flat' gives every corner its face normal instead of the smooth one.
+void makeJitteredSoup(int num_triangles, F32 pos_tol, F32 normal_tol, F32 tex_tol, F32 jitter, bool flat,
+	Mesh<VertexPNT>& welded, Mesh<VertexPNT>& soup)
+{
+	std::vector<Vec3f> positions;
+	std::vector<Vec3i> triangles;
+	makeTorus(num_triangles, positions, triangles);
+
+	welded.clear();
+	welded.resetVertices((int)positions.size());
+	for (int i = 0; i < welded.numVertices(); i++)
+		welded.setVertex(i, VertexPNT(positions[i], Vec3f(0.0f), Vec2f(positions[i].x, positions[i].z)));
+	welded.setIndices(welded.addSubmesh(), triangles.data(), (int)triangles.size());
+	welded.recomputeNormals();
+
+	// Per-axis offsets up to jitter / sqrt(3) keep two corners of the same
+	// vertex within 2 * jitter of each other.
+	Random random(1);
+	auto jitterVec = [&](F32 tol) { F32 r = tol * jitter / FW::sqrt(3.0f); return Vec3f(random.getF32(-r, r), random.getF32(-r, r), random.getF32(-r, r)); };
+
+	soup.clear();
+	soup.resetVertices((int)triangles.size() * 3);
+	Array<Vec3i> inds;
+	for (int i = 0; i < (int)triangles.size(); i++) {
+		const Vec3i& tri = triangles[i];
+		Vec3f face = cross(welded[tri.y].p - welded[tri.x].p, welded[tri.z].p - welded[tri.x].p).normalized();
+		for (int k = 0; k < 3; k++) {
+			VertexPNT v = welded[tri[k]];
+			v.p += jitterVec(pos_tol);
+			v.n = (flat ? face : v.n) + jitterVec(normal_tol);
+			v.t += jitterVec(tex_tol).getXY();
+			soup.setVertex(i * 3 + k, v);
+		}
+		inds.add(Vec3i(i * 3, i * 3 + 1, i * 3 + 2));
+	}
+	soup.setIndices(soup.addSubmesh(), inds);
+}
+
+int countDistinctPositions(const Mesh<VertexPNT>& mesh) {
+	Set<Vec3f> set;
+	for (int i = 0; i < mesh.numVertices(); i++)
+		if (!set.contains(mesh[i].p))
+			set.add(mesh[i].p);
+	return set.getSize();
+}
+
+// Tolerance welding of jittered soups: checked against testing all pairs on
+// a small one, then timed on a large one with smooth normals (everything
+// should weld) and with flat normals (only positions should snap).
+void benchWeld(int argc, char** argv) {
+	int num_triangles = (argc > 0) ? FW::max(atoi(argv[0]), 16) : 4000000;
+	F32 pos_tol = (argc > 1) ? (F32)atof(argv[1]) : 1.0e-5f;
+	int repeats = (argc > 2) ? FW::max(atoi(argv[2]), 1) : 3;
+	F32 normal_tol = 1.0e-3f, tex_tol = 1.0e-5f, jitter = 0.45f;
+
+	Mesh<VertexPNT> welded, soup, mesh, reference;
+	for (int flat = 0; flat < 2; flat++) {
+		makeJitteredSoup(2000, pos_tol, normal_tol, tex_tol, jitter, flat != 0, welded, soup);
+		mesh = soup;
+		mesh.weldVertices(pos_tol, normal_tol, tex_tol);
+		reference = soup;
+		weldVerticesBrute(reference, pos_tol, normal_tol, tex_tol);
+		FW::printf("small %s soup: %d -> %d vertices, all pairs %s\n", flat ? "flat" : "smooth", soup.numVertices(), mesh.numVertices(),
+			sameMesh(mesh, reference) ? "identical" : "DIFFERS");
+	}
+
+	for (int flat = 0; flat < 2; flat++) {
+		makeJitteredSoup(num_triangles, pos_tol, normal_tol, tex_tol, jitter, flat != 0, welded, soup);
+		FW::printf("%s soup: %d vertices (%d welded positions), tolerances %g / %g / %g, best of %d\n", flat ? "flat" : "smooth",
+			soup.numVertices(), welded.numVertices(), pos_tol, normal_tol, tex_tol, repeats);
+
+		mesh = soup;
+		mesh.collapseVertices();
+		FW::printf("  collapseVertices: %d vertices\n", mesh.numVertices());
+
+		int numCores = MulticoreLauncher::getNumCores();
+		for (int numThreads = 1;; numThreads = FW::min(numThreads * 2, numCores)) {
+			MulticoreLauncher::setNumThreads(numThreads);
+			F32 t = FW_F32_MAX;
+			for (int i = 0; i < repeats; i++) {
+				mesh = soup;
+				Timer timer(true);
+				mesh.weldVertices(pos_tol, normal_tol, tex_tol);
+				t = FW::min(t, timer.getElapsed());
+			}
+			FW::printf("  weld %3d thr    : %8.2f ms  %d vertices, %d positions\n", numThreads, t * 1.0e3f, mesh.numVertices(), countDistinctPositions(mesh));
+			if (numThreads == numCores)
+				break;
+		}
+		MulticoreLauncher::setNumThreads(numCores);
+	}
+}
+
+// Triangle order optimization of a torus split into bands, one submesh
+// each, starting from grid order and from a random order. Checks that
+// every submesh keeps its triangles.
+void benchVertexCache(int argc, char** argv) {
+	int num_triangles = (argc > 0) ? FW::max(atoi(argv[0]), 16) : 1000000;
+	int cache_size = (argc > 1) ? FW::max(atoi(argv[1]), 3) : 16;
+	F32 threshold = (argc > 2) ? (F32)atof(argv[2]) : 1.05f;
+	int num_parts = (argc > 3) ? FW::max(atoi(argv[3]), 1) : 8;
+
+	std::vector<Vec3f> positions;
+	std::vector<Vec3i> triangles;
+	makeTorus(num_triangles, positions, triangles);
+
+	Mesh<VertexPN> grid;
+	grid.resetVertices((int)positions.size());
+	for (int i = 0; i < grid.numVertices(); i++)
+		grid.setVertex(i, VertexPN(positions[i], Vec3f(0.0f)));
+	for (int i = 0; i < num_parts; i++) {
+		int lo = (int)((S64)triangles.size() * i / num_parts), hi = (int)((S64)triangles.size() * (i + 1) / num_parts);
+		grid.setIndices(grid.addSubmesh(), triangles.data() + lo, hi - lo);
+	}
+
+	Mesh<VertexPN> shuffled = grid;
+	Random random(1);
+	for (int i = 0; i < shuffled.numSubmeshes(); i++) {
+		Array<Vec3i>& tris = shuffled.mutableIndices(i);
+		for (int j = tris.getSize() - 1; j > 0; j--)
+			nvswap(tris[j], tris[random.getS32(j + 1)]);
+	}
+
+	auto sameTriangles = [](const MeshBase& a, const MeshBase& b) {
+		for (int i = 0; i < a.numSubmeshes(); i++) {
+			std::vector<U64> ta, tb;
+			for (int j = 0; j < a.indices(i).getSize(); j++) {
+				const Vec3i& t = a.indices(i)[j];
+				ta.push_back(((U64)t.x << 42) ^ ((U64)t.y << 21) ^ (U64)t.z);
+			}
+			for (int j = 0; j < b.indices(i).getSize(); j++) {
+				const Vec3i& t = b.indices(i)[j];
+				tb.push_back(((U64)t.x << 42) ^ ((U64)t.y << 21) ^ (U64)t.z);
+			}
+			std::sort(ta.begin(), ta.end());
+			std::sort(tb.begin(), tb.end());
+			if (ta != tb)
+				return false;
+		}
+		return true;
+	};
+
+	FW::printf("torus: %d vertices, %d triangles in %d submeshes, FIFO cache of %d\n", grid.numVertices(), (int)triangles.size(),
+		num_parts, cache_size);
+	const char* names[] = { "grid order", "random order" };
+	const Mesh<VertexPN>* sources[] = { &grid, &shuffled };
+	for (int i = 0; i < 2; i++)
+	for (int overdraw = 0; overdraw < 2; overdraw++) {
+		Mesh<VertexPN> mesh = *sources[i];
+		Timer timer(true);
+		TriangleOrderStats stats = optimizeTriangleOrder(mesh, cache_size, overdraw ? threshold : 0.0f);
+		F32 t = timer.getElapsed();
+		VertexCacheStats check = analyzeVertexCache(mesh, cache_size);
+
+		FW::printf("  %-12s %-14s: ACMR %.3f -> %.3f  ATVR %.3f -> %.3f  %8.2f ms", names[i], overdraw ? sprintf("overdraw %.2f", threshold).getPtr() : "cache only",
+			stats.before.getACMR(), stats.after.getACMR(), stats.before.getATVR(), stats.after.getATVR(), t * 1.0e3f);
+		if (overdraw)
+			FW::printf("  %d clusters", stats.numClusters);
+		FW::printf("  %s\n", (sameTriangles(mesh, *sources[i]) && check.numTransforms == stats.after.numTransforms) ? "ok" : "MISMATCH");
+	}
+}
+
+// Vertex fetches per vertex that miss a FIFO of 'num_lines' 64-byte cache
+// lines, walking the triangles in order.
+F32 fetchMissesPerVertex(const MeshBase& mesh, int num_lines) {
+	int stride = mesh.vertexStride();
+	Array<S32> stamps(NULL, (int)(((S64)mesh.numVertices() * stride + 63) / 64));
+	memset(stamps.getPtr(), 0, stamps.getNumBytes());
+	S32 time = num_lines + 1;
+	S64 misses = 0;
+	for (int i = 0; i < mesh.numSubmeshes(); i++) {
+		const Array<Vec3i>& tris = mesh.indices(i);
+		for (int j = 0; j < tris.getSize(); j++)
+			for (int k = 0; k < 3; k++) {
+				S64 first = (S64)tris[j][k] * stride;
+				for (S64 line = first / 64; line <= (first + stride - 1) / 64; line++)
+					if (time - stamps[(int)line] > num_lines) {
+						stamps[(int)line] = time++;
+						misses++;
+					}
+			}
+	}
+	return (F32)misses / (F32)mesh.numVertices();
+}
+
+// Order-independent checksum of the triangles' corner positions.
+U64 triangleChecksum(const Mesh<VertexPN>& mesh) {
+	U64 sum = 0;
+	for (int i = 0; i < mesh.numSubmeshes(); i++) {
+		const Array<Vec3i>& tris = mesh.indices(i);
+		for (int j = 0; j < tris.getSize(); j++) {
+			U64 h = (U64)i;
+			for (int k = 0; k < 3; k++)
+				for (int c = 0; c < 3; c++)
+					h = (h ^ floatToBits(mesh[tris[j][k]].p[c])) * 0x9E3779B97F4A7C15ull;
+			sum += h ^ (h >> 29);
+		}
+	}
+	return sum;
+}
+
+// optimizeVertexFetch() on a torus whose vertices are in random order,
+// as in a file written without regard to the triangles: cost of the
+// reorder, simulated cache-line misses of the vertex fetches, and the
+// effect on a pass that walks the triangles (recomputeNormals).
+void benchVertexFetch(int argc, char** argv) {
+	int num_triangles = (argc > 0) ? FW::max(atoi(argv[0]), 16) : 4000000;
+	int repeats = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 3;
+	int num_lines = 512;	// 32 KB
+
+	std::vector<Vec3f> positions;
+	std::vector<Vec3i> triangles;
+	makeTorus(num_triangles, positions, triangles);
+
+	Array<S32> perm(NULL, (int)positions.size());
+	for (int i = 0; i < perm.getSize(); i++)
+		perm[i] = i;
+	Random random(1);
+	for (int i = perm.getSize() - 1; i > 0; i--)
+		nvswap(perm[i], perm[random.getS32(i + 1)]);
+
+	Mesh<VertexPN> shuffled;
+	shuffled.resetVertices((int)positions.size());
+	for (int i = 0; i < shuffled.numVertices(); i++)
+		shuffled.setVertex(perm[i], VertexPN(positions[i], Vec3f(0.0f)));
+	for (Vec3i& t : triangles)
+		t = Vec3i(perm[t.x], perm[t.y], perm[t.z]);
+	shuffled.setIndices(shuffled.addSubmesh(), triangles.data(), (int)triangles.size());
+	U64 checksum = triangleChecksum(shuffled);
+
+	FW::printf("torus: %d vertices in random order, %d triangles, best of %d, FIFO of %d cache lines\n", shuffled.numVertices(),
+		(int)triangles.size(), repeats, num_lines);
+
+	const char* names[] = { "file order", "first use", "Morton + first use", "vcache + first use" };
+	for (int variant = 0; variant < 4; variant++) {
+		Mesh<VertexPN> mesh;
+		F32 t_opt = FW_F32_MAX;
+		for (int i = 0; i < repeats; i++) {
+			mesh = shuffled;
+			if (variant == 3)
+				optimizeTriangleOrder(mesh);
+			Timer timer(true);
+			if (variant != 0)
+				mesh.optimizeVertexFetch(variant == 2);
+			t_opt = FW::min(t_opt, timer.getElapsed());
+		}
+
+		F32 t_normals = FW_F32_MAX;
+		for (int i = 0; i < repeats; i++) {
+			Mesh<VertexPN> copy = mesh;
+			Timer timer(true);
+			copy.recomputeNormals();
+			t_normals = FW::min(t_normals, timer.getElapsed());
+		}
+
+		FW::printf("  %-20s: reorder %8.2f ms  fetch misses %.3f / vertex  ACMR %.3f  recomputeNormals %8.2f ms  %s\n", names[variant],
+			t_opt * 1.0e3f, fetchMissesPerVertex(mesh, num_lines), analyzeVertexCache(mesh).getACMR(), t_normals * 1.0e3f,
+			triangleChecksum(mesh) == checksum ? "ok" : "MISMATCH");
+	}
+}
+
+U64 hashTriangle(int submesh, const Vec3i& tri) {
+	U64 h = (U64)submesh;
+	for (int k = 0; k < 3; k++)
+		h = (h ^ (U32)tri[k]) * 0x9E3779B97F4A7C15ull;
+	return h ^ (h >> 29);
+}
+
+// buildClusters() on a loaded mesh: build time, how full the clusters are
+// relative to the limits, a check that they hold exactly the mesh's
+// triangles, how many a camera outside the mesh culls by their normal
+// cones (and that none of those has a front-facing triangle), and a
+// round trip through the binary format.
+void benchClusters(int argc, char** argv) {
+	std::string filename = (argc > 0) ? argv[0] : "assets/garg.obj";
+	int max_vertices = (argc > 1) ? FW::clamp(atoi(argv[1]), 3, 256) : 64;
+	int max_triangles = (argc > 2) ? FW::clamp(atoi(argv[2]), 1, 256) : 124;
+	int repeats = (argc > 3) ? FW::max(atoi(argv[3]), 1) : 5;
+
+	std::unique_ptr<MeshBase> mesh(importMesh(filename.c_str()));
+	if (!mesh)
+		return;
+
+	F32 t = timeBest(repeats, [&]() { mesh->buildClusters(max_vertices, max_triangles); });
+	const MeshBase::Clusters& c = mesh->clusters();
+	int num_clusters = c.numClusters();
+	FW::printf("%s: %d vertices, %d triangles, %d submeshes, limits %d / %d\n", filename.c_str(), mesh->numVertices(),
+		mesh->numTriangles(), mesh->numSubmeshes(), max_vertices, max_triangles);
+	FW::printf("  build: %8.2f ms (best of %d), %d clusters\n", t * 1.0e3f, repeats, num_clusters);
+	if (!num_clusters)
+		return;
+
+	int full = 0;
+	for (int i = 0; i < num_clusters; i++)
+		full += (c.vertexRange[i].y == max_vertices || c.triangleRange[i].y == max_triangles) ? 1 : 0;
+	FW::printf("  fill: vertices %.1f%%, triangles %.1f%%, %.1f%% of the clusters at a limit\n",
+		100.0 * c.vertices.getSize() / ((F64)num_clusters * max_vertices),
+		100.0 * (c.triangles.getSize() / 3) / ((F64)num_clusters * max_triangles), 100.0 * full / num_clusters);
+
+	U64 expected = 0;
+	U64 actual = 0;
+	for (int i = 0; i < mesh->numSubmeshes(); i++) {
+		for (int j = 0; j < mesh->indices(i).getSize(); j++)
+			expected += hashTriangle(i, mesh->indices(i)[j]);
+		for (int j = c.submeshStart[i]; j < c.submeshStart[i + 1]; j++)
+			for (int k = c.triangleRange[j].x; k < c.triangleRange[j].x + c.triangleRange[j].y; k++) {
+				const S32* v = &c.vertices[c.vertexRange[j].x];
+				const U8* tri = &c.triangles[k * 3];
+				actual += hashTriangle(i, Vec3i(v[tri[0]], v[tri[1]], v[tri[2]]));
+			}
+	}
+
+	Vec3f lo, hi;
+	mesh->getBBox(lo, hi);
+	Vec3f eye = (lo + hi) * 0.5f + Vec3f(0.0f, 0.0f, (hi - lo).length() * 1.5f);
+	int pos_attrib = mesh->findAttrib(MeshBase::AttribType_Position);
+	int culled = 0;
+	int wrong = 0;
+	for (int i = 0; i < num_clusters; i++) {
+		if (!c.isBackfacing(i, eye))
+			continue;
+		culled++;
+		const S32* v = &c.vertices[c.vertexRange[i].x];
+		for (int k = c.triangleRange[i].x; k < c.triangleRange[i].x + c.triangleRange[i].y; k++) {
+			Vec3f p[3];
+			for (int j = 0; j < 3; j++)
+				p[j] = mesh->getVertexAttrib(v[c.triangles[k * 3 + j]], pos_attrib).getXYZ();
+			if (dot(cross(p[1] - p[0], p[2] - p[0]), p[0] - eye) < 0.0f) {
+				wrong++;
+				break;
+			}
+		}
+	}
+	FW::printf("  triangles %s, cone culling from +z: %.1f%% of the clusters, %s\n", (actual == expected) ? "ok" : "MISMATCH",
+		100.0 * culled / num_clusters, wrong ? "NOT CONSERVATIVE" : "conservative");
+
+	MemoryOutputStream out;
+	exportBinaryMesh(out, mesh.get());
+	MemoryInputStream in(out.getData());
+	std::unique_ptr<MeshBase> loaded(importBinaryMesh(in));
+	const MeshBase::Clusters* d = (loaded) ? &loaded->clusters() : NULL;
+	bool same = d && d->numClusters() == num_clusters && d->vertices.getSize() == c.vertices.getSize() &&
+		d->triangles.getSize() == c.triangles.getSize() && d->submeshStart.getSize() == c.submeshStart.getSize() &&
+		memcmp(d->vertexRange.getPtr(), c.vertexRange.getPtr(), c.vertexRange.getNumBytes()) == 0 &&
+		memcmp(d->triangleRange.getPtr(), c.triangleRange.getPtr(), c.triangleRange.getNumBytes()) == 0 &&
+		memcmp(d->vertices.getPtr(), c.vertices.getPtr(), c.vertices.getNumBytes()) == 0 &&
+		memcmp(d->triangles.getPtr(), c.triangles.getPtr(), c.triangles.getNumBytes()) == 0 &&
+		memcmp(d->spheres.getPtr(), c.spheres.getPtr(), c.spheres.getNumBytes()) == 0 &&
+		memcmp(d->cones.getPtr(), c.cones.getPtr(), c.cones.getNumBytes()) == 0;
+	FW::printf("  binary mesh: %d bytes, clusters %s\n", out.getData().getSize(), same ? "round-trip ok" : "MISMATCH");
+}
+
+// Order-independent hash of the triangles of a mesh by the contents of
+// their vertices, which survive renumbering.
+U64 hashTrianglesByContent(const MeshBase& mesh) {
+	std::vector<U32> vertex_hashes(mesh.numVertices());
+	for (int i = 0; i < mesh.numVertices(); i++) {
+		U32 h = 2166136261u;
+		for (int j = 0; j < mesh.vertexStride(); j++)
+			h = (h ^ mesh.getVertexPtr(i)[j]) * 16777619u;
+		vertex_hashes[i] = h;
+	}
+	U64 sum = 0;
+	for (int i = 0; i < mesh.numSubmeshes(); i++)
+		for (int j = 0; j < mesh.indices(i).getSize(); j++) {
+			const Vec3i& tri = mesh.indices(i)[j];
+			sum += hashTriangle(i, Vec3i(vertex_hashes[tri.x], vertex_hashes[tri.y], vertex_hashes[tri.z]));
+		}
+	return sum;
+}
+
+// Progressive mesh of a seam torus or a file, written to disk: export
+// time and size against the binary format, time until the base mesh can
+// be shown against a full binary import, refinement throughput in
+// batches of vertex splits, a check that the refined mesh has the
+// triangles of the input and one that the viewer's copy, updated with
+// each batch, has those of a full copy.
+void benchProgressive(int argc, char** argv) {
+	std::string source = (argc > 0) ? argv[0] : "torus";
+	int batch = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 4096;
+
+	std::unique_ptr<MeshBase> mesh;
+	if (source == "torus") {
+		Mesh<VertexPNT>* torus = new Mesh<VertexPNT>;
+		makeSeamTorus(2000000, *torus);
+		mesh.reset(torus);
+	} else
+		mesh.reset(importMesh(source.c_str()));
+	if (!mesh)
+		return;
+	FW::printf("%s: %d vertices, %d triangles, %d submeshes\n", source.c_str(), mesh->numVertices(), mesh->numTriangles(),
+		mesh->numSubmeshes());
+
+	const char* bin_path = "bench_progressive.bin";
+	const char* pm_path = "bench_progressive.pmesh";
+	Timer timer(true);
+	exportMesh(bin_path, mesh.get());
+	F32 t_bin_export = timer.end();
+	exportMesh(pm_path, mesh.get());
+	F32 t_pm_export = timer.end();
+	S64 bin_size = File(bin_path, File::Read).getSize();
+	S64 pm_size = File(pm_path, File::Read).getSize();
+	if (hasError())
+		return;
+
+	timer.start();
+	std::unique_ptr<MeshBase> full(importMesh(bin_path));
+	F32 t_bin_import = timer.end();
+	full.reset();
+
+	// Base mesh first, then a batch of splits per frame.
+
+	timer.start();
+	File file(pm_path, File::Read);
+	BufferedInputStream stream(file);
+	ProgressiveMeshReader reader(stream);
+	F32 t_first = timer.end();
+	if (!reader.getMesh())
+		return;
+	int base_triangles = reader.getMesh()->numTriangles();
+
+	// The viewer also updates its copy of the mesh every frame, see
+	// App::refineProgressive(); that is timed separately.
+	int frames = 0;
+	F32 t_slowest = 0.0f, t_update_slowest = 0.0f;
+	IndexedMesh view;
+	buildIndexedMesh(*reader.getMesh(), view);
+	Array<S32> moved;
+	S64 num_moved = 0;
+	Timer frame_timer(true), update_timer;
+	while (!reader.isComplete() && !hasError()) {
+		moved.clear();
+		reader.refine(batch, &moved);
+		t_slowest = FW::max(t_slowest, frame_timer.end());
+		update_timer.start();
+		updateIndexedMesh(reader, moved, view);
+		t_update_slowest = FW::max(t_update_slowest, update_timer.end());
+		num_moved += moved.getSize();
+		frame_timer.start();
+		frames++;
+	}
+	F32 t_refine = frame_timer.getTotal();
+	F32 t_update = update_timer.getTotal();
+	const MeshBase& refined = *reader.getMesh();
+
+	// The copy has the triangles of the refined mesh, in another order.
+	IndexedMesh copy;
+	buildIndexedMesh(refined, copy);
+	bool same_view = (view.vertices.size() == copy.vertices.size() && view.indices.size() == copy.indices.size() &&
+		!memcmp(view.vertices.data(), copy.vertices.data(), copy.vertexBytes()));
+	if (same_view) {
+		typedef std::array<unsigned, 3> Triangle;
+		std::vector<Triangle> a(view.indices.size() / 3), b(copy.indices.size() / 3);
+		memcpy(a.data(), view.indices.data(), view.indexBytes());
+		memcpy(b.data(), copy.indices.data(), copy.indexBytes());
+		std::sort(a.begin(), a.end());
+		std::sort(b.begin(), b.end());
+		same_view = (a == b);
+	}
+
+	FW::printf("  export: binary %8.0f ms, %10lld bytes; progressive %8.0f ms, %10lld bytes\n", t_bin_export * 1.0e3f,
+		(long long)bin_size, t_pm_export * 1.0e3f, (long long)pm_size);
+	FW::printf("  first frame: %8.2f ms with %d triangles (full binary import %.0f ms)\n", t_first * 1.0e3f, base_triangles,
+		t_bin_import * 1.0e3f);
+	FW::printf("  refine: %8.0f ms for %d splits in %d frames of %d, slowest %.2f ms; %.2f M splits/s, %.2f M triangles/s\n",
+		t_refine * 1.0e3f, reader.getNumSplits(), frames, batch, t_slowest * 1.0e3f, reader.getNumSplits() * 1.0e-6 / t_refine,
+		(refined.numTriangles() - base_triangles) * 1.0e-6 / t_refine);
+	FW::printf("  refined: %d vertices, %d triangles, %s\n", refined.numVertices(), refined.numTriangles(),
+		(hashTrianglesByContent(refined) == hashTrianglesByContent(*mesh)) ? "same triangles as the input" : "TRIANGLES DIFFER");
+	FW::printf("  viewer updates: %8.0f ms in total, slowest %.2f ms, %lld moved corners; %s\n", t_update * 1.0e3f,
+		t_update_slowest * 1.0e3f, (long long)num_moved, same_view ? "same as a full copy" : "DIFFERS FROM A FULL COPY");
+
+	remove(bin_path);
+	remove(pm_path);
+}
+
+// Largest error of the quantized attributes of 'b' relative to 'a', in
+// quantization steps of 'bits' over the range of each attribute in 'a';
+// within 0.5 plus float rounding if quantization rounds correctly.
+F32 maxQuantError(const MeshBase& a, const MeshBase& b, const BinaryMeshParams& params) {
+	F32 worst = 0.0f;
+	for (int j = 0; j < a.numAttribs(); j++) {
+		const MeshBase::AttribSpec& spec = a.attribSpec(j);
+		int bits = (spec.type == MeshBase::AttribType_Position) ? params.positionBits :
+			(spec.type == MeshBase::AttribType_Normal) ? params.normalBits :
+			(spec.type == MeshBase::AttribType_TexCoord) ? params.texCoordBits : 0;
+		if (!bits || spec.format != MeshBase::AttribFormat_F32)
+			continue;
+
+		Vec4f lo(+FW_F32_MAX), hi(-FW_F32_MAX);
+		for (int i = 0; i < a.numVertices(); i++) {
+			lo = FW::min(lo, a.getVertexAttrib(i, j));
+			hi = FW::max(hi, a.getVertexAttrib(i, j));
+		}
+		F32 extent = 0.0f;
+		for (int k = 0; k < spec.length; k++)
+			extent = FW::max(extent, hi[k] - lo[k]);
+
+		for (int k = 0; k < spec.length; k++) {
+			F32 range = (spec.type == MeshBase::AttribType_Normal) ? 2.0f : (spec.type == MeshBase::AttribType_Position) ? extent : hi[k] - lo[k];
+			F32 step = range / (F32)((1 << bits) - 1);
+			if (step <= 0.0f)
+				continue;
+			for (int i = 0; i < a.numVertices(); i++)
+				worst = FW::max(worst, FW::abs(a.getVertexAttrib(i, j)[k] - b.getVertexAttrib(i, j)[k]) / step);
+		}
+	}
+	return worst;
+}
+
+// Ratio and speed of the vertex and index codecs on the bundled assets,
+// in file order and after optimizing the triangle and vertex order, and
+// whole binary mesh files with and without compression and quantization.
+// Lossless decoding must reproduce every byte.
+void benchCodec(int argc, char** argv) {
+	static const char* default_files[] = { "assets/sphere.obj", "assets/torus.obj", "assets/garg.obj" };
+	std::vector<std::string> files;
+	for (int i = 0; i < argc; i++)
+		files.push_back(argv[i]);
+	if (files.empty())
+		files.assign(default_files, default_files + 3);
+	int repeats = 100;
+
+	for (const std::string& filename : files) {
+		std::unique_ptr<MeshBase> loaded;
+		if (filename == "torus") {
+			Mesh<VertexPNT>* torus = new Mesh<VertexPNT>;
+			makeSeamTorus(2000000, *torus);
+			loaded.reset(torus);
+		} else
+			loaded.reset(importMesh(filename.c_str()));
+		if (!loaded)
+			return;
+		FW::printf("%s: %d vertices of %d bytes, %d triangles, %d submeshes\n", filename.c_str(), loaded->numVertices(),
+			loaded->vertexStride(), loaded->numTriangles(), loaded->numSubmeshes());
+
+		for (int variant = 0; variant < 2; variant++) {
+			MeshBase mesh(*loaded);
+			if (variant == 1) {
+				optimizeTriangleOrder(mesh);
+				mesh.optimizeVertexFetch();
+			}
+
+			int stride = mesh.vertexStride();
+			int vertex_bytes = mesh.numVertices() * stride;
+			Array<U8> vdata;
+			F32 t_vencode = timeBest(1, [&]() { encodeVertices(vdata, mesh.getVertexPtr(), mesh.numVertices(), stride); });
+			Array<U8> vertices(NULL, vertex_bytes);
+			bool vok = true;
+			F32 t_vdecode = timeBest(repeats, [&]() {
+				vok &= decodeVertices(vertices.getPtr(), mesh.numVertices(), stride, vdata.getPtr(), vdata.getSize());
+			});
+			vok &= (memcmp(vertices.getPtr(), mesh.getVertexPtr(), vertex_bytes) == 0);
+
+			int index_bytes = mesh.numTriangles() * (int)sizeof(Vec3i);
+			std::vector<Array<U8>> idata(mesh.numSubmeshes());
+			F32 t_iencode = timeBest(1, [&]() {
+				for (int i = 0; i < mesh.numSubmeshes(); i++)
+					encodeIndices(idata[i], mesh.indices(i).getPtr(), mesh.indices(i).getSize());
+			});
+			int icoded = 0;
+			for (const Array<U8>& d : idata)
+				icoded += d.getSize();
+			std::vector<Array<Vec3i>> tris(mesh.numSubmeshes());
+			for (int i = 0; i < mesh.numSubmeshes(); i++)
+				tris[i].reset(mesh.indices(i).getSize());
+			bool iok = true;
+			F32 t_idecode = timeBest(repeats, [&]() {
+				for (int i = 0; i < mesh.numSubmeshes(); i++)
+					iok &= decodeIndices(tris[i].getPtr(), tris[i].getSize(), idata[i].getPtr(), idata[i].getSize());
+			});
+			for (int i = 0; i < mesh.numSubmeshes(); i++)
+				iok &= (memcmp(tris[i].getPtr(), mesh.indices(i).getPtr(), tris[i].getNumBytes()) == 0);
+
+			FW::printf("  %s\n", (variant == 0) ? "file order" : "optimized order");
+			FW::printf("    vertices: %9d -> %9d bytes (%5.1f%%), encode %7.2f ms, decode %7.2f ms = %5.2f GB/s, %s\n", vertex_bytes,
+				vdata.getSize(), 100.0 * vdata.getSize() / FW::max(vertex_bytes, 1), t_vencode * 1.0e3f, t_vdecode * 1.0e3f,
+				vertex_bytes / FW::max(t_vdecode, 1.0e-9f) * 1.0e-9f, vok ? "exact" : "MISMATCH");
+			FW::printf("    indices:  %9d -> %9d bytes (%5.1f%%, %.2f bytes/triangle), encode %7.2f ms, decode %7.2f ms = %5.2f GB/s, %s\n",
+				index_bytes, icoded, 100.0 * icoded / FW::max(index_bytes, 1), (F32)icoded / FW::max(mesh.numTriangles(), 1),
+				t_iencode * 1.0e3f, t_idecode * 1.0e3f, index_bytes / FW::max(t_idecode, 1.0e-9f) * 1.0e-9f, iok ? "exact" : "MISMATCH");
+		}
+
+		// Whole files: v5 as is, v6 lossless and v6 quantized.
+
+		BinaryMeshParams raw_params;
+		raw_params.compress = false;
+		BinaryMeshParams quant_params;
+		quant_params.positionBits = 14;
+		quant_params.normalBits = 10;
+		quant_params.texCoordBits = 12;
+		struct { const char* name; BinaryMeshParams params; } configs[] = {
+			{ "v5 raw", raw_params }, { "v6 lossless", BinaryMeshParams() }, { "v6 14/10/12 bits", quant_params } };
+
+		for (auto& config : configs) {
+			MemoryOutputStream out;
+			Timer timer(true);
+			exportBinaryMesh(out, loaded.get(), config.params);
+			F32 t_export = timer.end();
+
+			std::unique_ptr<MeshBase> back;
+			F32 t_import = timeBest(repeats / 10, [&]() {
+				MemoryInputStream in(out.getData());
+				back.reset(importBinaryMesh(in));
+			});
+			if (!back)
+				return;
+
+			bool same_tris = (back->numSubmeshes() == loaded->numSubmeshes());
+			for (int i = 0; i < loaded->numSubmeshes() && same_tris; i++)
+				same_tris = back->indices(i).getSize() == loaded->indices(i).getSize() &&
+					memcmp(back->indices(i).getPtr(), loaded->indices(i).getPtr(), loaded->indices(i).getNumBytes()) == 0;
+			std::string check;
+			if (config.params.compress && config.params.positionBits)
+				check = FW::sprintf("max error %.3f steps", maxQuantError(*loaded, *back, config.params)).getPtr();
+			else
+				check = (memcmp(back->getVertexPtr(), loaded->getVertexPtr(), loaded->numVertices() * loaded->vertexStride()) == 0) ?
+					"vertices exact" : "vertices MISMATCH";
+
+			FW::printf("  %-17s %9d bytes, export %7.2f ms, import %7.2f ms, %s, triangles %s\n", config.name,
+				out.getData().getSize(), t_export * 1.0e3f, t_import * 1.0e3f, check.c_str(), same_tris ? "exact" : "MISMATCH");
+		}
+	}
+}
+
+struct RayBatch
+{
+	const BVH*			bvh;
+	const Ray*			rays;
+	int					num_rays;
+	bool				any_hit;
+	std::vector<int>	hits;	// [task]
+};
+
+const int ray_batch_size = 4096;
+
+void traceRayBatch(MulticoreLauncher::Task& task) {
+	RayBatch& b = *(RayBatch*)task.data;
+	int end = FW::min((task.idx + 1) * ray_batch_size, b.num_rays);
+	int hits = 0;
+	for (int i = task.idx * ray_batch_size; i < end; i++) {
+		RayHit hit;
+		hits += (b.any_hit ? b.bvh->intersectAny(b.rays[i]) : b.bvh->intersect(b.rays[i], hit)) ? 1 : 0;
+	}
+	b.hits[task.idx] = hits;
+}
+
+// Returns the number of hits and the time taken on one thread or on all.
+int traceRays(const BVH& bvh, const std::vector<Ray>& rays, bool any_hit, bool multicore, F32& seconds) {
+	RayBatch b;
+	b.bvh = &bvh;
+	b.rays = rays.data();
+	b.num_rays = (int)rays.size();
+	b.any_hit = any_hit;
+	int num_batches = (b.num_rays + ray_batch_size - 1) / ray_batch_size;
+	b.hits.assign(num_batches, 0);
+
+	Timer timer(true);
+	if (multicore)
+		MulticoreLauncher().push(traceRayBatch, &b, 0, num_batches).popAll();
+	else
+		for (int i = 0; i < num_batches; i++) {
+			MulticoreLauncher::Task task;
+			task.data = &b;
+			task.idx = i;
+			traceRayBatch(task);
+		}
+	seconds = timer.getElapsed();
+
+	int hits = 0;
+	for (int h : b.hits)
+		hits += h;
+	return hits;
+}
+
+bool rayHitsTriangle(const Ray& ray, const Vec3f& a, const Vec3f& b, const Vec3f& c, F32& t) {
+	Vec3f e1 = b - a, e2 = c - a;
+	Vec3f p = cross(ray.direction, e2);
+	F64 det = dot(e1, p);
+	if (det == 0.0)
+		return false;
+	Vec3f s = ray.origin - a;
+	F64 u = dot(s, p) / det;
+	Vec3f q = cross(s, e1);
+	F64 v = dot(ray.direction, q) / det;
+	t = (F32)(dot(e2, q) / det);
+	return u >= 0.0 && v >= 0.0 && u + v <= 1.0 && t >= ray.tmin && t <= ray.tmax;
+}
+
+// BVH over a torus: build time and quality, then closest-hit and any-hit
+// rates for incoherent rays (random origins in the bounding box, random
+// directions) on one thread and on all, checked against brute force on a
+// sample. Box and sphere queries are checked against the triangles that
+// must and may overlap them.
+void benchBVH(int argc, char** argv) {
+	int num_triangles = (argc > 0) ? FW::max(atoi(argv[0]), 16) : 1000000;
+	int num_rays = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 1000000;
+
+	std::vector<Vec3f> positions;
+	std::vector<Vec3i> triangles;
+	makeTorus(num_triangles, positions, triangles);
+
+	BVH bvh;
+	F32 t_build = timeBest(3, [&]() { bvh.build(positions.data(), triangles.data(), (int)triangles.size()); });
+	const BVH::BuildStats& stats = bvh.getStats();
+	FW::printf("torus: %d triangles, %d threads\n", (int)triangles.size(), MulticoreLauncher::getNumCores());
+	FW::printf("  build: %8.2f ms, %d nodes, %d leaves (%.2f triangles), depth %d, SAH cost %.2f\n", t_build * 1.0e3f,
+		stats.numNodes, stats.numLeaves, (F32)triangles.size() / (F32)stats.numLeaves, stats.maxDepth, stats.sahCost);
+
+	Vec3f lo = bvh.node(0).lo, hi = bvh.node(0).hi;
+	Random random(1);
+	std::vector<Ray> rays(num_rays);
+	for (Ray& ray : rays) {
+		Vec3f d;
+		do d = random.getVec3f(-1.0f, 1.0f);
+		while (d.lenSqr() > 1.0f || d.lenSqr() < 1.0e-4f);
+		ray = Ray(lo + (hi - lo) * random.getVec3f(), d.normalized());
+	}
+
+	for (int any_hit = 0; any_hit < 2; any_hit++) {
+		F32 t_one, t_all;
+		int hits = traceRays(bvh, rays, any_hit != 0, false, t_one);
+		traceRays(bvh, rays, any_hit != 0, true, t_all);
+		FW::printf("  %-11s: %.1f%% hit, %6.2f Mrays/s on one thread, %6.2f Mrays/s on all\n", any_hit ? "any hit" : "closest hit",
+			100.0f * hits / num_rays, num_rays / t_one * 1.0e-6f, num_rays / t_all * 1.0e-6f);
+	}
+
+	int num_checked = FW::min(num_rays, 256);
+	int mismatches = 0;
+	for (int i = 0; i < num_checked; i++) {
+		F32 best = FW_F32_MAX;
+		for (const Vec3i& tri : triangles) {
+			F32 t;
+			if (rayHitsTriangle(rays[i], positions[tri.x], positions[tri.y], positions[tri.z], t))
+				best = FW::min(best, t);
+		}
+		RayHit hit;
+		bool found = bvh.intersect(rays[i], hit);
+		if (found != (best != FW_F32_MAX) || (found && FW::abs(hit.t - best) > 1.0e-4f * FW::max(best, 1.0f)) ||
+			found != bvh.intersectAny(rays[i]))
+			mismatches++;
+	}
+
+	int query_errors = 0;
+	int num_found = 0;
+	for (int i = 0; i < 32; i++) {
+		Vec3f c = lo + (hi - lo) * random.getVec3f();
+		Vec3f half = (hi - lo) * random.getF32(0.001f, 0.05f);
+		F32 radius = half.length();
+		Array<S32> in_box, in_sphere;
+		bvh.overlapBox(c - half, c + half, in_box);
+		bvh.overlapSphere(c, radius, in_sphere);
+		num_found += in_box.getSize() + in_sphere.getSize();
+
+		// Triangles with a corner inside must be reported; those whose bounds
+		// miss must not.
+		std::vector<U8> box_hit(triangles.size(), 0), sphere_hit(triangles.size(), 0);
+		for (int j = 0; j < in_box.getSize(); j++)
+			box_hit[in_box[j]]++;
+		for (int j = 0; j < in_sphere.getSize(); j++)
+			sphere_hit[in_sphere[j]]++;
+		for (size_t t = 0; t < triangles.size(); t++) {
+			Vec3f p[3] = { positions[triangles[t].x], positions[triangles[t].y], positions[triangles[t].z] };
+			Vec3f tlo = min(min(p[0], p[1]), p[2]), thi = max(max(p[0], p[1]), p[2]);
+			bool must_box = false, must_sphere = false;
+			for (int k = 0; k < 3; k++) {
+				must_box |= (p[k] - c).abs().max() <= half.min();
+				must_sphere |= (p[k] - c).length() <= radius;
+			}
+			bool may_box = !(tlo.x > c.x + half.x || tlo.y > c.y + half.y || tlo.z > c.z + half.z ||
+				thi.x < c.x - half.x || thi.y < c.y - half.y || thi.z < c.z - half.z);
+			bool may_sphere = (max(max(tlo - c, c - thi), Vec3f(0.0f))).length() <= radius;
+			if (box_hit[t] > 1 || sphere_hit[t] > 1 || (must_box && !box_hit[t]) || (box_hit[t] && !may_box) ||
+				(must_sphere && !sphere_hit[t]) || (sphere_hit[t] && !may_sphere))
+				query_errors++;
+		}
+	}
+
+	FW::printf("  checks: %d rays against brute force %s, 64 box and sphere queries (%d triangles) %s\n", num_checked,
+		mismatches ? "MISMATCH" : "ok", num_found, query_errors ? "MISMATCH" : "ok");
+}
+
+// Closest-hit and any-hit rates of the batched BVH queries in each trace
+// mode, on one thread, for three workloads over a torus: camera rays in
+// tiles of one packet, ambient occlusion rays from the camera hits, and
+// incoherent rays. Every mode must return the same bits as single rays.
+void benchPackets(int argc, char** argv) {
+	int num_triangles = (argc > 0) ? FW::max(atoi(argv[0]), 16) : 200000;
+	int resolution = (argc > 1) ? FW::max(atoi(argv[1]), 8) : 512;
+	const int ao_rays_per_hit = 8;
+
+	std::vector<Vec3f> positions;
+	std::vector<Vec3i> triangles;
+	makeTorus(num_triangles, positions, triangles);
+	BVH bvh;
+	bvh.build(positions.data(), triangles.data(), (int)triangles.size());
+	int width = BVH::packetWidth();
+	FW::printf("torus: %d triangles, packet width %d\n", (int)triangles.size(), width);
+
+	// Camera rays, one packet-shaped tile after another.
+
+	std::vector<Ray> primary;
+	int tile_w = (width >= 8) ? 4 : 2, tile_h = width / tile_w;
+	Vec3f eye(0.0f, 1.4f, 2.4f);
+	Vec3f forward = (-eye).normalized();
+	Vec3f right = cross(forward, Vec3f(0.0f, 1.0f, 0.0f)).normalized();
+	Vec3f up = cross(right, forward);
+	for (int ty = 0; ty < resolution; ty += tile_h)
+	for (int tx = 0; tx < resolution; tx += tile_w)
+	for (int y = ty; y < FW::min(ty + tile_h, resolution); y++)
+	for (int x = tx; x < FW::min(tx + tile_w, resolution); x++) {
+		F32 sx = ((F32)x + 0.5f) / (F32)resolution * 2.0f - 1.0f;
+		F32 sy = 1.0f - ((F32)y + 0.5f) / (F32)resolution * 2.0f;
+		primary.push_back(Ray(eye, forward * 2.0f + right * sx + up * sy));
+	}
+
+	std::vector<RayHit> primary_hits(primary.size());
+	bvh.intersect(primary.data(), primary_hits.data(), (int)primary.size(), BVH::TraceMode_Single);
+
+	// Short hemisphere rays around the geometric normal of each hit.
+
+	std::vector<Ray> ao;
+	Random random(1);
+	for (size_t i = 0; i < primary.size(); i++) {
+		const RayHit& hit = primary_hits[i];
+		if (hit.triangle == -1)
+			continue;
+		const Vec3i& tri = triangles[hit.triangle];
+		Vec3f n = cross(positions[tri.y] - positions[tri.x], positions[tri.z] - positions[tri.x]).normalized();
+		if (dot(n, primary[i].direction) > 0.0f)
+			n = -n;
+		Vec3f p = primary[i].origin + primary[i].direction * hit.t;
+		for (int j = 0; j < ao_rays_per_hit; j++) {
+			Vec3f d;
+			do d = random.getVec3f(-1.0f, 1.0f);
+			while (d.lenSqr() > 1.0f || d.lenSqr() < 1.0e-4f);
+			d = d.normalized() + n;
+			ao.push_back(Ray(p, d, 1.0e-4f, 0.5f / d.length()));
+		}
+	}
+
+	std::vector<Ray> incoherent(primary.size());
+	Vec3f lo = bvh.node(0).lo, hi = bvh.node(0).hi;
+	for (Ray& ray : incoherent) {
+		Vec3f d;
+		do d = random.getVec3f(-1.0f, 1.0f);
+		while (d.lenSqr() > 1.0f || d.lenSqr() < 1.0e-4f);
+		ray = Ray(lo + (hi - lo) * random.getVec3f(), d.normalized());
+	}
+
+	struct Workload { const char* name; const std::vector<Ray>* rays; };
+	const Workload workloads[] = { { "camera", &primary }, { "ao", &ao }, { "incoherent", &incoherent } };
+	bool identical = true;
+	for (const Workload& w : workloads) {
+		const std::vector<Ray>& rays = *w.rays;
+		int num = (int)rays.size();
+		std::vector<RayHit> hits(num), reference(num);
+		std::unique_ptr<bool[]> occluded(new bool[num]), occluded_reference(new bool[num]);
+		FW::printf("  %s: %d rays\n", w.name, num);
+
+		for (int mode = 0; mode < BVH::TraceMode_Max; mode++) {
+			BVH::TraceMode m = (BVH::TraceMode)mode;
+			int num_hits = 0, num_occluded = 0;
+			F32 t_closest = timeBest(3, [&]() { num_hits = bvh.intersect(rays.data(), hits.data(), num, m); });
+			F32 t_any = timeBest(3, [&]() { num_occluded = bvh.intersectAny(rays.data(), occluded.get(), num, m); });
+			if (m == BVH::TraceMode_Single) {
+				reference = hits;
+				memcpy(occluded_reference.get(), occluded.get(), num * sizeof(bool));
+			}
+			bool same = memcmp(hits.data(), reference.data(), num * sizeof(RayHit)) == 0 &&
+				memcmp(occluded.get(), occluded_reference.get(), num * sizeof(bool)) == 0;
+			identical &= same;
+			FW::printf("    %-7s closest %6.2f Mrays/s (%.1f%% hit), any %6.2f Mrays/s (%.1f%% hit)%s\n", BVH::getTraceModeName(m),
+				num / t_closest * 1.0e-6f, 100.0f * num_hits / FW::max(num, 1), num / t_any * 1.0e-6f,
+				100.0f * num_occluded / FW::max(num, 1), same ? "" : "  MISMATCH");
+		}
+	}
+	FW::printf("  hits of all modes %s\n", identical ? "bit-identical" : "DIFFER");
+}
+
+// AOBaker on a loaded mesh: a quick first pass, then the rest of the rays
+// accumulated on top, written into an AORadius attribute. The whole bake
+// is repeated on one thread and on three, which must give the same bits.
+void benchAO(int argc, char** argv) {
+	std::string filename = (argc > 0) ? argv[0] : "assets/garg.obj";
+	int rays_per_vertex = (argc > 1) ? FW::max(atoi(argv[1]), 2) : 256;
+	int first_pass = FW::min(16, rays_per_vertex / 2);
+
+	std::unique_ptr<MeshBase> loaded(importMesh(filename.c_str()));
+	if (!loaded)
+		return;
+	MeshBase mesh;
+	mesh.addAttribs(*loaded);
+	mesh.addAttrib(MeshBase::AttribType_AORadius, MeshBase::AttribFormat_F32, 2);
+	mesh.set(*loaded);
+
+	Timer timer(true);
+	AOBaker baker(mesh);
+	F32 t_build = timer.end();
+	baker.bake(first_pass);
+	F32 t_first = baker.getStats().seconds;
+	baker.bake(rays_per_vertex - first_pass);
+	const AOBaker::Stats& stats = baker.getStats();
+	bool written = baker.write(mesh);
+
+	F64 occlusion = 0.0;
+	for (int i = 0; i < baker.numVertices(); i++)
+		occlusion += baker.getOcclusion(i);
+	FW::printf("%s: %d vertices, %d triangles, %d threads, max distance %g\n", filename.c_str(), mesh.numVertices(),
+		mesh.numTriangles(), MulticoreLauncher::getNumCores(), baker.getMaxDistance());
+	FW::printf("  bvh %.2f s, first pass (%d rays per vertex) %.2f s, total (%d rays per vertex) %.2f s, %.2f Mrays/s\n",
+		t_build, first_pass, t_first, stats.raysPerVertex, stats.seconds, (F64)stats.numRays / stats.seconds * 1.0e-6);
+	FW::printf("  mean occlusion %.3f, attribute %s\n", occlusion / FW::max(baker.numVertices(), 1), written ? "written" : "NOT WRITTEN");
+
+	bool same = true;
+	for (int threads = 1; threads <= 3; threads += 2) {
+		MulticoreLauncher::setNumThreads(threads);
+		AOBaker again(mesh);
+		again.bake(first_pass);
+		again.bake(rays_per_vertex - first_pass);
+		for (int i = 0; i < baker.numVertices(); i++)
+			same &= again.getOcclusion(i) == baker.getOcclusion(i) && again.getRadius(i) == baker.getRadius(i);
+	}
+	MulticoreLauncher::setNumThreads(MulticoreLauncher::getNumCores());
+	FW::printf("  repeated on 1 and 3 threads: %s\n", same ? "identical" : "DIFFERENT");
+}
+
+F32 segmentDistance(const Vec3f& p, const Vec3f& a, const Vec3f& b) {
+	Vec3f ab = b - a;
+	F32 len_sqr = ab.lenSqr();
+	F32 t = (len_sqr > 0.0f) ? FW::clamp(dot(p - a, ab) / len_sqr, 0.0f, 1.0f) : 0.0f;
+	return (a + ab * t - p).length();
+}
+
+// Brute-force point-triangle distance: the projection onto the plane if
+// it falls inside, otherwise the nearest edge.
+F32 triangleDistance(const Vec3f& p, const Vec3f& a, const Vec3f& b, const Vec3f& c) {
+	Vec3f n = cross(b - a, c - a);
+	F32 area_sqr = n.lenSqr();
+	if (area_sqr > 0.0f) {
+		Vec3f q = p - n * (dot(p - a, n) / area_sqr);
+		F32 wa = dot(cross(b - q, c - q), n), wb = dot(cross(c - q, a - q), n), wc = dot(cross(a - q, b - q), n);
+		if (wa >= 0.0f && wb >= 0.0f && wc >= 0.0f)
+			return (q - p).length();
+	}
+	return FW::min(segmentDistance(p, a, b), segmentDistance(p, b, c), segmentDistance(p, c, a));
+}
+
+// Inside test by ray parity: counts every crossing along a ray.
+bool insideByParity(const BVH& bvh, const Vec3f& p, const Vec3f& d) {
+	int crossings = 0;
+	Ray ray(p, d);
+	RayHit hit;
+	while (bvh.intersect(ray, hit)) {
+		crossings++;
+		ray.tmin = hit.t * 1.00001f + 1.0e-6f;
+		hit = RayHit();
+	}
+	return (crossings & 1) != 0;
+}
+
+// DistanceField on a loaded mesh: closest-point queries per second for
+// points spread over the bounding box and for points near the surface,
+// checked against brute force, then a signed distance bake whose signs
+// are compared with ray parity, and the size of its raw export.
+void benchSDF(int argc, char** argv) {
+	std::string filename = (argc > 0) ? argv[0] : "assets/garg.obj";
+	int resolution = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 256;
+	int num_queries = (argc > 2) ? FW::max(atoi(argv[2]), 1) : 1000000;
+
+	std::unique_ptr<MeshBase> mesh(importMesh(filename.c_str()));
+	if (!mesh)
+		return;
+
+	Timer timer(true);
+	DistanceField field(*mesh);
+	F32 t_init = timer.end();
+	const BVH& bvh = field.getBVH();
+	if (bvh.isEmpty())
+		return;
+	FW::printf("%s: %d vertices, %d triangles, %d threads, setup %.2f s\n", filename.c_str(), mesh->numVertices(),
+		mesh->numTriangles(), MulticoreLauncher::getNumCores(), t_init);
+
+	Vec3f lo = bvh.node(0).lo, hi = bvh.node(0).hi;
+	Vec3f pad((hi - lo).max() * 0.05f);
+	Random random(1);
+	std::vector<Vec3f> spread(num_queries), near(num_queries);
+	for (Vec3f& p : spread)
+		p = lo - pad + (hi - lo + pad * 2.0f) * random.getVec3f();
+	for (Vec3f& p : near) {
+		const BVH::Triangle& tri = bvh.leafTriangle(random.getS32(bvh.numTriangles()));
+		F32 u = random.getF32(), v = random.getF32();
+		if (u + v > 1.0f)
+			u = 1.0f - u, v = 1.0f - v;
+		p = tri.v0 + tri.e1 * u + tri.e2 * v + random.getVec3f(-1.0f, 1.0f) * (pad.x * 0.1f);
+	}
+
+	const std::vector<Vec3f>* sets[] = { &spread, &near };
+	const char* set_names[] = { "spread", "near" };
+	int pos_attrib = mesh->findAttrib(MeshBase::AttribType_Position);
+	std::vector<ClosestPoint> single(num_queries), packet(num_queries);
+	for (int k = 0; k < 2; k++) {
+		const std::vector<Vec3f>& points = *sets[k];
+		F32 t_single = timeBest(3, [&]() { bvh.closestPoints(points.data(), single.data(), num_queries, FW_F32_MAX, false); });
+		F32 t_packet = timeBest(3, [&]() { bvh.closestPoints(points.data(), packet.data(), num_queries, FW_F32_MAX, true); });
+
+		F64 sum = 0.0;
+		bool same = true;
+		for (int i = 0; i < num_queries; i++) {
+			const ClosestPoint& a = single[i];
+			const ClosestPoint& b = packet[i];
+			sum += a.distance;
+			same = same && a.triangle == b.triangle && a.distance == b.distance && a.point == b.point &&
+				a.u == b.u && a.v == b.v && a.feature == b.feature;
+		}
+
+		int wrong = 0;
+		for (int i = 0; i < 64; i++) {
+			const Vec3f& p = points[i];
+			F32 best = FW_F32_MAX;
+			for (int j = 0; j < mesh->numSubmeshes(); j++)
+				for (int l = 0; l < mesh->indices(j).getSize(); l++) {
+					const Vec3i& tri = mesh->indices(j)[l];
+					best = FW::min(best, triangleDistance(p, mesh->getVertexAttrib(tri.x, pos_attrib).getXYZ(),
+						mesh->getVertexAttrib(tri.y, pos_attrib).getXYZ(), mesh->getVertexAttrib(tri.z, pos_attrib).getXYZ()));
+				}
+			if (FW::abs(single[i].distance - best) > 1.0e-5f * FW::max(best, (hi - lo).max()))
+				wrong++;
+		}
+		FW::printf("  closest point, %-6s: %6.2f Mqueries/s single, %6.2f packets of %d (%s), mean distance %.4f, 64 against brute force %s\n",
+			set_names[k], num_queries / t_single * 1.0e-6f, num_queries / t_packet * 1.0e-6f, BVH::packetWidth(),
+			same ? "identical" : "DIFFERENT", sum / num_queries, wrong ? "MISMATCH" : "ok");
+	}
+
+	timer.start();
+	field.bake(Vec3i(resolution));
+	F32 t_bake = timer.end();
+	int num_voxels = field.getVoxels().getSize();
+	int inside = 0;
+	for (int i = 0; i < num_voxels; i++)
+		inside += (field.getVoxels()[i] < 0.0f) ? 1 : 0;
+	FW::printf("  bake %d^3: %.2f s, %.2f Mvoxels/s, %.1f%% inside\n", resolution, t_bake, num_voxels / t_bake * 1.0e-6f,
+		100.0f * inside / num_voxels);
+
+	// Ray parity along three skewed directions, by majority.
+
+	int agree = 0;
+	const int num_checked = 512;
+	const Vec3f dirs[3] = { Vec3f(1.0f, 0.013f, 0.007f), Vec3f(-0.011f, 1.0f, 0.017f), Vec3f(0.009f, -0.019f, -1.0f) };
+	for (int i = 0; i < num_checked; i++) {
+		Vec3i idx(random.getS32(resolution), random.getS32(resolution), random.getS32(resolution));
+		Vec3f p = field.getVoxelCenter(idx);
+		int votes = 0;
+		for (int k = 0; k < 3; k++)
+			votes += insideByParity(bvh, p, dirs[k]) ? 1 : 0;
+		agree += ((votes >= 2) == (field.getVoxel(idx) < 0.0f)) ? 1 : 0;
+	}
+
+	MemoryOutputStream raw;
+	field.exportRaw(raw);
+	FW::printf("  sign agrees with ray parity at %d of %d voxels, raw export %d bytes%s\n", agree, num_checked,
+		raw.getData().getSize(), (raw.getData().getSize() == num_voxels * (int)sizeof(F32)) ? "" : " (WRONG SIZE)");
+}
+
+// Vertex and index memory of the triangle soup App used to upload versus
+// the indexed mesh, and a check that both describe the same triangles.
+void benchIndexed(int argc, char** argv) {
+	static const char* default_files[] = { "assets/sphere.obj", "assets/torus.obj", "assets/garg.obj" };
+	std::vector<std::string> files;
+	for (int i = 0; i < argc; i++)
+		files.push_back(argv[i]);
+	if (files.empty())
+		files.assign(default_files, default_files + 3);
+
+	for (const std::string& filename : files) {
+		IndexedModel model;
+		bool is_obj = filename.size() >= 3 && filename.compare(filename.size() - 3, 3, "obj") == 0;
+		if (!(is_obj ? loadObjMapped(filename, model) : loadPly(filename, model)))
+			return;
+
+		IndexedMesh mesh;
+		F32 t = timeBest(5, [&]() { buildIndexedMesh(model, mesh); });
+
+		bool same = (mesh.indices.size() == model.faces.size() * 3);
+		for (size_t i = 0; i < model.faces.size() && same; i++)
+			for (int k = 0; k < 3; k++) {
+				const Vertex& v = mesh.vertices[mesh.indices[i * 3 + k]];
+				same = same && v.position == model.positions[model.faces[i][k * 2]] && v.normal == model.normals[model.faces[i][k * 2 + 1]];
+			}
+
+		size_t soup_bytes = model.faces.size() * 3 * sizeof(Vertex);
+		size_t indexed_bytes = mesh.vertexBytes() + mesh.indexBytes();
+		FW::printf("%s: %d triangles\n", filename.c_str(), (int)model.faces.size());
+		FW::printf("  triangle soup: %8d vertices  %10d bytes\n", (int)model.faces.size() * 3, (int)soup_bytes);
+		FW::printf("  indexed:       %8d vertices  %10d bytes (%d vertex + %d index)\n", (int)mesh.vertices.size(),
+			(int)indexed_bytes, (int)mesh.vertexBytes(), (int)mesh.indexBytes());
+		FW::printf("  %.2fx smaller, built in %.2f ms, triangles %s\n", (F32)soup_bytes / (F32)indexed_bytes, t * 1.0e3f,
+			same ? "identical" : "DIFFER");
+	}
+}
+
+// Cold (miss) and warm (hit) loads through MeshCache. The cache file is
+// removed first so that the first load always processes the source.
+void benchMeshCache(int argc, char** argv) {
+	std::string filename = (argc > 0) ? argv[0] : "assets/garg.obj";
+	int repeats = (argc > 1) ? FW::max(atoi(argv[1]), 1) : 10;
+
+	MeshCache cache;
+	remove(cache.cachePath(filename, "indexed").c_str());
+
+	auto process = [&](IndexedMesh& out) {
+		IndexedModel model;
+		bool is_obj = filename.size() >= 3 && filename.compare(filename.size() - 3, 3, "obj") == 0;
+		bool ok = is_obj ? loadObjMapped(filename, model) : loadPly(filename, model);
+		buildIndexedMesh(model, out);
+		return ok;
+	};
+
+	IndexedMesh cold, warm;
+	F32 t_miss = timeBest(1, [&]() { cache.load(filename, "indexed", cold, process); });
+	F32 t_hit = timeBest(repeats, [&]() { cache.load(filename, "indexed", warm, process); });
+	if (hasError())
+		return;
+
+	bool same = cold.vertices.size() == warm.vertices.size() && cold.indices == warm.indices &&
+		memcmp(cold.vertices.data(), warm.vertices.data(), cold.vertexBytes()) == 0;
+	const MeshCacheStats& stats = cache.stats();
+	FW::printf("%s: %d vertices, %d triangles\n", filename.c_str(), (int)warm.vertices.size(), (int)warm.indices.size() / 3);
+	FW::printf("  miss (parse + index + store): %8.2f ms\n", t_miss * 1.0e3f);
+	FW::printf("  hit (best of %d):             %8.2f ms\n", repeats, t_hit * 1.0e3f);
+	FW::printf("  %d hits, %d misses, %d stores, results %s\n", stats.hits, stats.misses, stats.stores, same ? "identical" : "DIFFER");
+}
+
+// Headless stress test of AsyncMeshLoader: many loads, some simplifying
+// (which uses the thread pool from inside a pool task) and some failing,
+// interleaved with random cancellations. Every delivered mesh must match a
+// synchronous load, and no cancelled load may be delivered.
+void benchAsyncLoad(int argc, char** argv) {
+	int num_loads = (argc > 0) ? FW::max(atoi(argv[0]), 1) : 200;
+	static const char* files[] = { "assets/sphere.obj", "assets/torus.obj", "assets/garg.obj", "assets/missing.obj" };
+	const int num_files = 4;
+
+	auto load = [](const std::string& filename, bool simplified, IndexedMesh& mesh, AsyncMeshLoader::Job* job) {
+		IndexedModel model;
+		if (!loadObjMapped(filename, model) || (job && job->isCancelled()))
+			return false;
+		buildIndexedMesh(model, mesh);
+		if (simplified) {
+			if (job)
+				job->setProgress("simplifying", 0.5f);
+			SimplifyParams params;
+			params.targetTriangles = (int)mesh.indices.size() / 12;
+			params.pairDistance = 0.5f;
+			simplifyIndexedMesh(mesh, params);
+		}
+		return true;
+	};
+
+	// References, loaded synchronously.
+	IndexedMesh reference[num_files][2];
+	for (int i = 0; i < num_files; i++)
+		for (int simplified = 0; simplified < 2; simplified++)
+			load(files[i], simplified != 0, reference[i][simplified], NULL);
+	clearError();
+
+	Random random(1);
+	AsyncMeshLoader loader;
+	std::vector<Vec2i> requests;	// Per load id: (file, simplified).
+	std::vector<bool> cancelled;
+	requests.push_back(Vec2i(-1));
+	cancelled.push_back(false);
+
+	int num_checked = 0, num_failed = 0, num_wrong = 0;
+	auto check = [&](const AsyncMeshLoader::Result& result) {
+		const Vec2i& request = requests[result.id];
+		const IndexedMesh& ref = reference[request.x][request.y];
+		bool same = (result.mesh.indices == ref.indices && result.mesh.vertices.size() == ref.vertices.size() &&
+			memcmp(result.mesh.vertices.data(), ref.vertices.data(), ref.vertexBytes()) == 0);
+		bool should_fail = (request.x == num_files - 1);
+		if (cancelled[result.id] || !same || result.ok == should_fail || (!result.ok && result.error.empty()))
+			num_wrong++;
+		num_checked++;
+		num_failed += result.ok ? 0 : 1;
+	};
+
+	Timer timer(true);
+	AsyncMeshLoader::Result result;
+	for (int i = 0; i < num_loads; i++) {
+		Vec2i request(random.getS32(num_files), random.getS32(2));
+		std::string filename = files[request.x];
+		bool simplified = (request.y != 0);
+		int id = loader.start(filename, [=](IndexedMesh& mesh, AsyncMeshLoader::Job& job) {
+			return load(filename, simplified, mesh, &job);
+		});
+		requests.push_back(request);
+		cancelled.push_back(false);
+
+		F32 r = random.getF32();
+		if (r < 0.2f) {
+			int victim = 1 + random.getS32(id);
+			loader.cancel(victim);
+			cancelled[victim] = true;
+		}
+		else if (r < 0.21f) {
+			loader.cancelAll();
+			for (size_t j = 0; j < cancelled.size(); j++)
+				cancelled[j] = true;
+		}
+		while (loader.poll(result))
+			check(result);
+	}
+	loader.wait();
+	while (loader.poll(result))
+		check(result);
+
+	const AsyncMeshLoader::Stats& stats = loader.stats();
+	bool consistent = !loader.isBusy() && stats.started == num_loads && stats.delivered == num_checked &&
+		stats.delivered + stats.cancelled == stats.started;
+	FW::printf("%d loads in %.2f s: %d delivered (%d failed as expected), %d cancelled\n", num_loads, timer.end(),
+		stats.delivered, num_failed, stats.cancelled);
+	FW::printf("  %d wrong results, bookkeeping %s\n", num_wrong, consistent ? "consistent" : "INCONSISTENT");
+}
+
+const BenchmarkEntry g_benchmarks[] = {
+	{ "obj",		"obj [file.obj] [repeats]",			benchObj },
+	{ "wavefront",	"wavefront [file.obj] [repeats]",	benchWavefront },
+	{ "triangulate",	"triangulate [corners] [repeats]",	benchTriangulate },
+	{ "quadric",	"quadric [torus|file] [fraction|triangles] [max error] [partitions] [pair distance]",	benchQuadric },
+	{ "lod",		"lod [torus|file] [levels] [ratio] [pixel error]",	benchLod },
+	{ "progressive",	"progressive [torus|file] [splits per frame]",	benchProgressive },
+	{ "codec",		"codec [torus|files...]",			benchCodec },
+	{ "indexed",	"indexed [files...]",				benchIndexed },
+	{ "meshcache",	"meshcache [file] [repeats]",		benchMeshCache },
+	{ "asyncload",	"asyncload [loads]",				benchAsyncLoad },
+	{ "attribs",	"attribs [vertices] [repeats]",		benchAttribs },
+	{ "xform",		"xform [elements] [repeats]",		benchXform },
+	{ "bbox",		"bbox [vertices] [repeats]",		benchBBox },
+	{ "normals",	"normals [triangles] [crease degrees] [repeats]",	benchNormals },
+	{ "collapse",	"collapse [triangles] [repeats]",	benchCollapse },
+	{ "weld",		"weld [triangles] [tolerance] [repeats]",	benchWeld },
+	{ "vcache",		"vcache [triangles] [cache size] [overdraw threshold] [submeshes]",	benchVertexCache },
+	{ "fetch",		"fetch [triangles] [repeats]",		benchVertexFetch },
+	{ "clusters",	"clusters [file] [max vertices] [max triangles] [repeats]",	benchClusters },
+	{ "bvh",		"bvh [triangles] [rays]",			benchBVH },
+	{ "packets",	"packets [triangles] [resolution]",	benchPackets },
+	{ "ao",			"ao [file] [rays per vertex]",		benchAO },
+	{ "sdf",		"sdf [file] [resolution] [queries]",	benchSDF },
+};
+
+}
+
+bool FW::runBenchmarks(int argc, char** argv) {
+	if (argc < 2 || strcmp(argv[1], "-bench") != 0)
+		return false;
+
+	const char* name = (argc > 2) ? argv[2] : "";
+	for (const BenchmarkEntry& entry : g_benchmarks) {
+		if (strcmp(entry.name, name) == 0) {
+			entry.func(argc - 3, argv + 3);
+			if (hasError())
+				FW::printf("Error: %s\n", clearError().getPtr());
+			return true;
+		}
+	}
+
+	FW::printf("Usage: %s -bench <benchmark> [args...]\n", argv[0]);
+	for (const BenchmarkEntry& entry : g_benchmarks)
+		FW::printf("  -bench %s\n", entry.usage);
+	return true;
+}
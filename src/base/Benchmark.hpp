@@ -0,0 +1,13 @@
+#pragma once
+
+namespace FW {
+
+// Headless benchmarks, selected on the command line:
+//
+//   assignment.exe -bench <name> [args...]
+//
+// Returns true if a benchmark was requested (and run), in which case the
+// application window is not created. Results are written with FW::printf.
+bool	runBenchmarks	(int argc, char** argv);
+
+}
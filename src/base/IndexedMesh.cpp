@@ -0,0 +1,134 @@
+#include "IndexedMesh.hpp"
+#include "ModelLoader.hpp"
+
+#include "3d/QuadricSimplifier.hpp"
+#include "io/MeshProgressiveIO.hpp"
+
+#include <cstring>
+#include <unordered_map>
+
+using namespace FW;
+using namespace std;
+
+void FW::buildIndexedMesh(const vector<Vec3f>& positions, const vector<Vec3f>& normals,
+						  const vector<array<unsigned, 6>>& faces, IndexedMesh& mesh)
+{
+	mesh.clear();
+	mesh.indices.resize(faces.size() * 3);
+
+	// Closed meshes have roughly half as many vertices as faces; reserve for
+	// that and let open or faceted ones grow.
+	unordered_map<U64, unsigned> vertex_of;
+	vertex_of.reserve(faces.size());
+	mesh.vertices.reserve(faces.size() / 2 + 3);
+
+	unsigned* out = mesh.indices.data();
+	for (auto& f : faces) {
+		for (int k = 0; k < 6; k += 2) {
+			U64 key = ((U64)f[k] << 32) | f[k + 1];
+			auto it = vertex_of.emplace(key, (unsigned)mesh.vertices.size());
+			if (it.second) {
+				Vertex v;
+				v.position = positions[f[k]];
+				v.normal = normals[f[k + 1]];
+				mesh.vertices.push_back(v);
+			}
+			*out++ = it.first->second;
+		}
+	}
+}
+
+void FW::buildIndexedMesh(const IndexedModel& model, IndexedMesh& mesh) {
+	buildIndexedMesh(model.positions, model.normals, model.faces, mesh);
+}
+
+namespace {
+
+// Converts the vertices of 'source' past those 'mesh' already has.
+void appendVertices(const MeshBase& source, IndexedMesh& mesh) {
+	int pos_attrib = source.findAttrib(MeshBase::AttribType_Position);
+	int normal_attrib = source.findAttrib(MeshBase::AttribType_Normal);
+
+	// Typed views for the usual F32 attributes; anything else is converted
+	// per vertex.
+	AttribView<const Vec3f> positions = source.getAttribView<Vec3f>(pos_attrib);
+	AttribView<const Vec3f> normals = source.getAttribView<Vec3f>(normal_attrib);
+
+	int first = (int)mesh.vertices.size();
+	mesh.vertices.resize(source.numVertices());
+	for (int i = first; i < source.numVertices(); i++) {
+		Vertex& v = mesh.vertices[i];
+		v.position = positions.isValid() ? positions[i] : source.getVertexAttrib(i, pos_attrib).getXYZ();
+		if (normals.isValid())
+			v.normal = normals[i];
+		else
+			v.normal = (normal_attrib != -1) ? source.getVertexAttrib(i, normal_attrib).getXYZ() : Vec3f(0.0f);
+	}
+}
+
+}
+
+void FW::buildIndexedMesh(const MeshBase& source, IndexedMesh& mesh) {
+	mesh.clear();
+	if (source.findAttrib(MeshBase::AttribType_Position) == -1)
+		return;
+
+	appendVertices(source, mesh);
+	for (int i = 0; i < source.numSubmeshes(); i++) {
+		const Array<Vec3i>& triangles = source.indices(i);
+		size_t first = mesh.indices.size();
+		mesh.indices.resize(first + triangles.getSize() * 3);
+		if (triangles.getSize())
+			memcpy(mesh.indices.data() + first, triangles.getPtr(), triangles.getNumBytes());
+	}
+}
+
+void FW::updateIndexedMesh(const ProgressiveMeshReader& reader, const Array<S32>& moved, IndexedMesh& mesh) {
+	const MeshBase& source = *reader.getMesh();
+	if (source.findAttrib(MeshBase::AttribType_Position) == -1)
+		return;
+
+	// Room for the final counts up front, so that appending never copies.
+	mesh.vertices.reserve(reader.getFinalNumVertices());
+	mesh.indices.reserve((size_t)reader.getFinalNumTriangles() * 3);
+
+	// Corners of the new triangles are read as they are now.
+	size_t old_indices = mesh.indices.size();
+	for (int i = 0; i < moved.getSize(); i++)
+		if ((size_t)moved[i] < old_indices)
+			mesh.indices[moved[i]] = reader.getTriangle(moved[i] / 3)[moved[i] % 3];
+
+	appendVertices(source, mesh);
+	mesh.indices.resize((size_t)reader.getNumTriangles() * 3);
+	for (int i = (int)(old_indices / 3); i < reader.getNumTriangles(); i++)
+		memcpy(&mesh.indices[i * 3], reader.getTriangle(i).getPtr(), sizeof(Vec3i));
+}
+
+void FW::indexTriangleSoup(vector<Vertex>& vertices, IndexedMesh& mesh) {
+	mesh.vertices.swap(vertices);
+	mesh.indices.resize(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+		mesh.indices[i] = (unsigned)i;
+}
+
+SimplifyReport FW::simplifyIndexedMesh(IndexedMesh& mesh, const SimplifyParams& params) {
+	Mesh<VertexPN> m;
+	m.resetVertices((int)mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+		m.mutableVertex((int)i) = VertexPN(mesh.vertices[i].position, mesh.vertices[i].normal);
+	m.addSubmesh();
+	m.setIndices(0, (const S32*)mesh.indices.data(), (int)mesh.indices.size());
+
+	SimplifyReport report = simplifyQuadric(m, params);
+
+	mesh.vertices.resize(m.numVertices());
+	for (int i = 0; i < m.numVertices(); i++) {
+		mesh.vertices[i].position = m.vertex(i).p;
+		mesh.vertices[i].normal = m.vertex(i).n;
+	}
+	const Array<Vec3i>& triangles = m.indices(0);
+	mesh.indices.resize(triangles.getSize() * 3);
+	if (triangles.getSize())
+		memcpy(mesh.indices.data(), triangles.getPtr(), triangles.getNumBytes());
+	return report;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "base/Array.hpp"
+#include "base/Math.hpp"
+
+#include <array>
+#include <vector>
+
+namespace FW {
+
+class MeshBase;
+class ProgressiveMeshReader;
+struct IndexedModel;
+struct SimplifyParams;
+struct SimplifyReport;
+
+struct Vertex
+{
+	Vec3f position;
+	Vec3f normal;
+};
+
+// Vertex and index data ready for glDrawElements(GL_TRIANGLES, ...).
+struct IndexedMesh
+{
+	std::vector<Vertex>		vertices;
+	std::vector<unsigned>	indices;	// Three per triangle.
+
+	void	clear()				{ vertices.clear(); indices.clear(); }
+	size_t	vertexBytes() const	{ return vertices.size() * sizeof(Vertex); }
+	size_t	indexBytes() const	{ return indices.size() * sizeof(unsigned); }
+};
+
+// Creates one vertex per distinct (position index, normal index) pair used by
+// 'faces', found with a hash on the pair, and indexes the faces with them.
+// Vertices are numbered in order of first use.
+void	buildIndexedMesh	(const std::vector<Vec3f>& positions, const std::vector<Vec3f>& normals,
+							 const std::vector<std::array<unsigned, 6>>& faces, IndexedMesh& mesh);
+void	buildIndexedMesh	(const IndexedModel& model, IndexedMesh& mesh);
+
+// Copies the positions and normals of a framework mesh, all submeshes into
+// one index list. Vertices without a normal attribute get zero normals.
+void	buildIndexedMesh	(const MeshBase& source, IndexedMesh& mesh);
+
+// Brings a copy of a progressive mesh up to date after refine(): converts
+// the new vertices, appends the new triangles in file order and rewrites
+// the 'moved' corners (triangle * 3 + corner) that 'mesh' already had.
+// Starts from buildIndexedMesh() of the base mesh, which is in file order.
+void	updateIndexedMesh	(const ProgressiveMeshReader& reader, const Array<S32>& moved, IndexedMesh& mesh);
+
+// Takes over a triangle soup (three vertices per triangle) as is, with
+// sequential indices.
+void	indexTriangleSoup	(std::vector<Vertex>& vertices, IndexedMesh& mesh);
+
+// Runs FW::simplifyQuadric() on the mesh through a Mesh<VertexPN>. The
+// normals of the remaining vertices are solved for by the simplifier.
+SimplifyReport	simplifyIndexedMesh	(IndexedMesh& mesh, const SimplifyParams& params);
+
+}
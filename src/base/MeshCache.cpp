@@ -0,0 +1,180 @@
+#include "MeshCache.hpp"
+
+#include "base/Timer.hpp"
+#include "io/File.hpp"
+#include "io/MappedFile.hpp"
+
+#include <cstring>
+
+using namespace FW;
+using namespace std;
+
+namespace {
+
+// Bump when the layout or the meaning of cached data changes.
+const U32		cache_version		= 1;
+const char		cache_magic[8]		= { 'M', 'e', 's', 'h', 'C', 'a', 'c', 'h' };
+
+// Files up to this size are hashed in full; larger ones by sampling.
+const S64		full_hash_limit		= 1 << 20;
+const int		num_hash_samples	= 256;
+const int		hash_sample_size	= 4096;
+
+struct CacheHeader
+{
+	char	magic[8];
+	U32		version;
+	U32		vertex_size;	// sizeof(Vertex)
+	U64		source_size;
+	U64		source_time;
+	U64		source_hash;
+	U64		variant_hash;
+	U32		num_vertices;
+	U32		num_indices;
+};
+
+// Word-at-a-time multiplicative hash; not cryptographic, just fast and
+// well mixed.
+U64 hash64(const U8* ptr, size_t size, U64 h) {
+	const U64 m = 0x9E3779B97F4A7C15ull;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		U64 word;
+		memcpy(&word, ptr + i, 8);
+		h = (h ^ word) * m;
+		h ^= h >> 29;
+	}
+	for (; i < size; i++)
+		h = (h ^ ptr[i]) * m;
+	h ^= h >> 32;
+	return h;
+}
+
+U64 hashContents(const MappedFile& file) {
+	S64 size = file.getSize();
+	if (size <= full_hash_limit)
+		return hash64(file.getPtr(), (size_t)size, (U64)size);
+
+	U64 h = (U64)size;
+	S64 stride = (size - hash_sample_size) / (num_hash_samples - 1);
+	for (int i = 0; i < num_hash_samples; i++)
+		h = hash64(file.getPtr(stride * i), hash_sample_size, h);
+	return h;
+}
+
+U64 hashString(const string& s) {
+	return hash64((const U8*)s.data(), s.size(), 0);
+}
+
+bool readCache(const string& path, const CacheHeader& expected, IndexedMesh& mesh) {
+	MappedFile file(path.c_str());
+	if (file.getSize() < (S64)sizeof(CacheHeader))
+		return false;
+
+	CacheHeader header;
+	memcpy(&header, file.getPtr(), sizeof(header));
+	if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+		header.version != expected.version || header.vertex_size != expected.vertex_size ||
+		header.source_size != expected.source_size || header.source_time != expected.source_time ||
+		header.source_hash != expected.source_hash || header.variant_hash != expected.variant_hash)
+		return false;
+
+	S64 vertex_bytes = (S64)header.num_vertices * sizeof(Vertex);
+	S64 index_bytes = (S64)header.num_indices * sizeof(unsigned);
+	if (file.getSize() != (S64)sizeof(CacheHeader) + vertex_bytes + index_bytes)
+		return false;	// Truncated write.
+
+	mesh.vertices.resize(header.num_vertices);
+	mesh.indices.resize(header.num_indices);
+	memcpy(mesh.vertices.data(), file.getPtr(sizeof(CacheHeader)), (size_t)vertex_bytes);
+	memcpy(mesh.indices.data(), file.getPtr(sizeof(CacheHeader) + vertex_bytes), (size_t)index_bytes);
+	return true;
+}
+
+bool writeCache(const string& path, CacheHeader header, const IndexedMesh& mesh) {
+	header.num_vertices = (U32)mesh.vertices.size();
+	header.num_indices = (U32)mesh.indices.size();
+
+	File file(path.c_str(), File::Create);
+	file.write(&header, sizeof(header));
+	file.write(mesh.vertices.data(), (int)mesh.vertexBytes());
+	file.write(mesh.indices.data(), (int)mesh.indexBytes());
+	file.flush();
+	return !hasError();
+}
+
+}
+
+//------------------------------------------------------------------------
+
+MeshCache::MeshCache(const string& directory)
+:	directory_(directory)
+{
+}
+
+//------------------------------------------------------------------------
+
+string MeshCache::cachePath(const string& filename, const string& variant) const {
+	if (directory_.empty())
+		return filename + "." + variant + ".mcache";
+
+	String name = sprintf("%016llx", (unsigned long long)hashString(filename));
+	return directory_ + "/" + name.getPtr() + "." + variant + ".mcache";
+}
+
+//------------------------------------------------------------------------
+
+bool MeshCache::load(const string& filename, const string& variant, IndexedMesh& mesh, const ProcessFunc& process) {
+	Timer timer(true);
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, cache_magic, sizeof(header.magic));
+	header.version = cache_version;
+	header.vertex_size = sizeof(Vertex);
+	header.variant_hash = hashString(variant);
+	{
+		MappedFile source(filename.c_str());
+		if (hasError())
+			return false;
+		header.source_size = (U64)source.getSize();
+		header.source_time = source.getModifiedTime();
+		header.source_hash = hashContents(source);
+	}
+
+	// A missing or unwritable cache file is expected; keep it out of the
+	// error state.
+
+	string path = cachePath(filename, variant);
+	String old_error = clearError();
+	bool hit = readCache(path, header, mesh);
+	restoreError(old_error);
+
+	if (hit) {
+		F32 t = timer.end();
+		lock_.enter();
+		stats_.hits++;
+		stats_.hit_seconds += t;
+		lock_.leave();
+		return true;
+	}
+
+	lock_.enter();
+	stats_.misses++;
+	lock_.leave();
+
+	mesh.clear();
+	if (!process(mesh))
+		return false;
+
+	old_error = clearError();
+	bool stored = writeCache(path, header, mesh);
+	restoreError(old_error);
+
+	F32 t = timer.end();
+	lock_.enter();
+	stats_.stores += stored ? 1 : 0;
+	stats_.miss_seconds += t;
+	lock_.leave();
+	return true;
+}
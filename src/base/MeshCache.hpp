@@ -0,0 +1,62 @@
+#pragma once
+
+#include "IndexedMesh.hpp"
+
+#include "base/Thread.hpp"
+
+#include <functional>
+#include <string>
+
+namespace FW {
+
+struct MeshCacheStats
+{
+	int		hits;
+	int		misses;			// Loads that had to process the source.
+	int		stores;			// Cache files written (a miss may fail to store).
+	F32		hit_seconds;	// Total time spent serving hits.
+	F32		miss_seconds;	// Total time spent processing and storing misses.
+
+	MeshCacheStats() : hits(0), misses(0), stores(0), hit_seconds(0.0f), miss_seconds(0.0f) {}
+};
+
+// Persistent cache of processed meshes.
+//
+// An entry is keyed by the source file's size, modification time and a
+// fast 64-bit content hash (whole file up to 1 MB, evenly spaced samples
+// beyond that), plus a 'variant' string naming the processing applied, e.g.
+// "indexed" or "simplified-0.25". It holds the final IndexedMesh as one
+// versioned binary file: a fixed header followed by the raw vertex and
+// index arrays, so a hit is a memory map and two copies.
+//
+// Cache files go next to the source ("<source>.<variant>.mcache") or, if a
+// directory is given, into it. Stale or damaged entries are overwritten;
+// failing to write one is not an error. load() may run on several threads
+// at once.
+class MeshCache
+{
+public:
+	typedef std::function<bool(IndexedMesh& mesh)> ProcessFunc;
+
+	explicit				MeshCache	(const std::string& directory = "");
+
+	// Fills 'mesh' from the cache if there is an up-to-date entry, otherwise
+	// calls 'process' and stores its result. Returns false if the source
+	// cannot be read or 'process' fails; in the latter case nothing is
+	// stored and whatever 'process' produced is left in 'mesh'.
+	bool					load		(const std::string& filename, const std::string& variant, IndexedMesh& mesh, const ProcessFunc& process);
+
+	std::string				cachePath	(const std::string& filename, const std::string& variant) const;
+	MeshCacheStats			stats		() const	{ lock_.enter(); MeshCacheStats s = stats_; lock_.leave(); return s; }
+	void					resetStats	()			{ lock_.enter(); stats_ = MeshCacheStats(); lock_.leave(); }
+
+private:
+							MeshCache	(const MeshCache&);	// forbid copy
+	MeshCache&				operator=	(const MeshCache&);	// forbid assignment
+
+	std::string				directory_;
+	mutable Spinlock		lock_;		// Guards stats_.
+	MeshCacheStats			stats_;
+};
+
+}
@@ -0,0 +1,348 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "ModelLoader.hpp"
+
+#include "3d/Mesh.hpp"
+#include "io/MappedFile.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace FW;
+using namespace std;
+
+namespace {
+
+// Exact powers of ten representable in a double.
+const double pow10_table[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool isBlank(char c)		{ return c == ' ' || c == '\t' || c == '\r'; }
+inline bool isDigit(char c)		{ return (unsigned)(c - '0') < 10u; }
+
+inline void skipBlanks(const char*& p, const char* end) {
+	while (p < end && isBlank(*p))
+		p++;
+}
+
+inline const char* nextLine(const char* p, const char* end) {
+	const char* nl = (const char*)memchr(p, '\n', end - p);
+	return nl ? nl + 1 : end;
+}
+
+// Locale-independent decimal float parser. Up to 19 significant digits are
+// accumulated into an integer mantissa, which is then scaled once.
+bool scanFloat(const char*& p, const char* end, float& out) {
+	const char* s = p;
+	bool negative = false;
+	if (s < end && (*s == '-' || *s == '+'))
+		negative = (*s++ == '-');
+
+	U64 mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool any = false;
+
+	for (; s < end && isDigit(*s); s++, any = true) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*s - '0');
+			digits += (mantissa != 0);
+		} else
+			exponent++;
+	}
+	if (s < end && *s == '.') {
+		for (s++; s < end && isDigit(*s); s++, any = true) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*s - '0');
+				digits += (mantissa != 0);
+				exponent--;
+			}
+		}
+	}
+	if (!any)
+		return false;
+
+	if (s < end && (*s == 'e' || *s == 'E')) {
+		const char* e = s + 1;
+		bool expNegative = false;
+		if (e < end && (*e == '-' || *e == '+'))
+			expNegative = (*e++ == '-');
+		if (e < end && isDigit(*e)) {
+			int value = 0;
+			for (; e < end && isDigit(*e); e++)
+				if (value < 10000)
+					value = value * 10 + (*e - '0');
+			exponent += expNegative ? -value : value;
+			s = e;
+		}
+	}
+
+	double v = (double)mantissa;
+	if (mantissa != 0 && exponent != 0) {
+		if (exponent > 0)
+			v = (exponent <= 22) ? v * pow10_table[exponent] : v * std::pow(10.0, exponent);
+		else
+			v = (exponent >= -22) ? v / pow10_table[-exponent] : v * std::pow(10.0, exponent);
+	}
+	out = (float)(negative ? -v : v);
+	p = s;
+	return true;
+}
+
+bool scanInt(const char*& p, const char* end, int& out) {
+	const char* s = p;
+	bool negative = false;
+	if (s < end && (*s == '-' || *s == '+'))
+		negative = (*s++ == '-');
+	if (s >= end || !isDigit(*s))
+		return false;
+	int value = 0;
+	for (; s < end && isDigit(*s); s++)
+		value = value * 10 + (*s - '0');
+	out = negative ? -value : value;
+	p = s;
+	return true;
+}
+
+bool scanVec3(const char*& p, const char* end, Vec3f& v) {
+	for (int i = 0; i < 3; i++) {
+		skipBlanks(p, end);
+		if (!scanFloat(p, end, v[i]))
+			return false;
+	}
+	return true;
+}
+
+// OBJ indices are 1-based; negative values are relative to the current count.
+inline int resolveIndex(int idx, int count) {
+	idx = (idx < 0) ? count + idx : idx - 1;
+	return (idx >= 0 && idx < count) ? idx : -1;
+}
+
+}
+
+bool FW::loadObjStreamed(const string& filename, IndexedModel& model) {
+	model.clear();
+
+	ifstream input(filename, ios::in);
+	if (!input)
+		return false;
+
+	string line;
+	while (getline(input, line)) {
+		for (auto& c : line)
+			if (c == '/')
+				c = ' ';
+
+		array<unsigned, 6>	f;
+		string				s;
+		istringstream		iss(line);
+		iss >> s;
+
+		if (s == "v") {
+			float a, b, c;
+			iss >> a >> b >> c;
+			model.positions.push_back(Vec3f(a, b, c));
+		}
+		else if (s == "vn") {
+			float a, b, c;
+			iss >> a >> b >> c;
+			model.normals.push_back(Vec3f(a, b, c));
+		}
+		else if (s == "f") {
+			unsigned sink, temp;
+			int discarded = 0;
+			for (int i = 0; i < 9; i++) {
+				if (i % 3 == 1) {
+					iss >> sink;
+					discarded++;
+				}
+				else {
+					iss >> temp;
+					f[i - discarded] = temp - 1;
+				}
+			}
+			model.faces.push_back(f);
+		}
+	}
+	return true;
+}
+
+bool FW::parseObj(const char* begin, const char* end, IndexedModel& model) {
+	model.clear();
+
+	// Census of the line types so that the arrays can be sized up front.
+	size_t num_positions = 0, num_normals = 0, num_faces = 0;
+	for (const char* p = begin; p < end; p = nextLine(p, end)) {
+		skipBlanks(p, end);
+		if (end - p < 2)
+			continue;
+		if (p[0] == 'v' && isBlank(p[1]))
+			num_positions++;
+		else if (p[0] == 'v' && p[1] == 'n')
+			num_normals++;
+		else if (p[0] == 'f' && isBlank(p[1]))
+			num_faces++;
+	}
+	model.positions.resize(num_positions);
+	model.normals.resize(num_normals);
+	model.faces.reserve(num_faces);
+
+	Vec3f*	positions = model.positions.data();
+	Vec3f*	normals = model.normals.data();
+	int		position_count = 0, normal_count = 0;
+	bool	valid = true;
+
+	// Corner scratch space for polygons, reused across faces.
+	vector<Vec2i> corners;
+	corners.reserve(16);
+
+	for (const char* p = begin; p < end; p = nextLine(p, end)) {
+		skipBlanks(p, end);
+		if (end - p < 2)
+			continue;
+
+		if (p[0] == 'v' && isBlank(p[1])) {
+			p += 2;
+			if (!scanVec3(p, end, positions[position_count]))
+				valid = false;
+			position_count++;
+		}
+		else if (p[0] == 'v' && p[1] == 'n') {
+			p += 2;
+			if (!scanVec3(p, end, normals[normal_count]))
+				valid = false;
+			normal_count++;
+		}
+		else if (p[0] == 'f' && isBlank(p[1])) {
+			p += 2;
+			corners.clear();
+			bool has_normals = true;
+			for (;;) {
+				skipBlanks(p, end);
+				int v, vt, vn = 0;
+				if (!scanInt(p, end, v))
+					break;
+				if (p < end && *p == '/') {
+					p++;
+					scanInt(p, end, vt);
+					if (p < end && *p == '/') {
+						p++;
+						scanInt(p, end, vn);
+					}
+				}
+				v = resolveIndex(v, position_count);
+				vn = (vn != 0) ? resolveIndex(vn, normal_count) : -1;
+				if (v == -1) {
+					valid = false;
+					corners.clear();
+					break;
+				}
+				has_normals &= (vn != -1);
+				corners.push_back(Vec2i(v, vn));
+			}
+			if (corners.size() < 3)
+				continue;
+
+			// No normal indices => use the polygon normal (Newell's method).
+			// Degenerate polygons (collinear or repeated corners, common in
+			// scanned meshes) have none and cover no area; drop them.
+			if (!has_normals) {
+				Vec3f n(0.0f);
+				for (size_t i = 0; i < corners.size(); i++) {
+					const Vec3f& a = positions[corners[i].x];
+					const Vec3f& b = positions[corners[(i + 1) % corners.size()].x];
+					n += Vec3f((a.y - b.y) * (a.z + b.z), (a.z - b.z) * (a.x + b.x), (a.x - b.x) * (a.y + b.y));
+				}
+				if (!(n.lenSqr() > 0.0f))
+					continue;
+				model.normals.push_back(n.normalized());
+				normals = model.normals.data();
+				for (auto& c : corners)
+					c.y = (int)model.normals.size() - 1;
+			}
+
+			for (size_t i = 2; i < corners.size(); i++) {
+				array<unsigned, 6> f = { {
+					(unsigned)corners[0].x, (unsigned)corners[0].y,
+					(unsigned)corners[i - 1].x, (unsigned)corners[i - 1].y,
+					(unsigned)corners[i].x, (unsigned)corners[i].y } };
+				model.faces.push_back(f);
+			}
+		}
+	}
+	return valid;
+}
+
+bool FW::loadObjMapped(const string& filename, IndexedModel& model) {
+	// An error left over from an earlier call must not read as a failure to
+	// map; it is set aside and restored once the file is open.
+	String old_error = clearError();
+	MappedFile file(filename.c_str());
+	if (hasError()) {
+		model.clear();
+		return false;
+	}
+	restoreError(old_error);
+	return parseObj(file.getChars(), file.getCharsEnd(), model);
+}
+
+bool FW::loadPly(const string& filename, IndexedModel& model) {
+	model.clear();
+
+	MeshBase* mesh = importMesh(filename.c_str());
+	if (!mesh)
+		return false;
+
+	int pos_attrib = mesh->findAttrib(MeshBase::AttribType_Position);
+	int normal_attrib = mesh->findAttrib(MeshBase::AttribType_Normal);
+	if (pos_attrib == -1) {
+		delete mesh;
+		setError("No vertex positions in '%s'!", filename.c_str());
+		return false;
+	}
+
+	// Float attributes are read through typed views; other formats (rare)
+	// go through the converting per-vertex accessor.
+	AttribView<const Vec3f> positions = mesh->getAttribView<Vec3f>(pos_attrib);
+	model.positions.resize(mesh->numVertices());
+	for (int i = 0; i < mesh->numVertices(); i++)
+		model.positions[i] = positions.isValid() ? positions[i] : mesh->getVertexAttrib(i, pos_attrib).getXYZ();
+
+	// Normals are indexed like the positions. Without normals in the file,
+	// they are accumulated from the (area-weighted) face normals.
+	AttribView<const Vec3f> normals = mesh->getAttribView<Vec3f>(normal_attrib);
+	model.normals.assign(mesh->numVertices(), Vec3f(0.0f));
+	if (normal_attrib != -1)
+		for (int i = 0; i < mesh->numVertices(); i++)
+			model.normals[i] = normals.isValid() ? normals[i] : mesh->getVertexAttrib(i, normal_attrib).getXYZ();
+
+	model.faces.reserve(mesh->numTriangles());
+	for (int i = 0; i < mesh->numSubmeshes(); i++) {
+		const Array<Vec3i>& tris = mesh->indices(i);
+		for (int j = 0; j < tris.getSize(); j++) {
+			const Vec3i& t = tris[j];
+			if (normal_attrib == -1) {
+				const Vec3f& a = model.positions[t.x];
+				Vec3f n = cross(model.positions[t.y] - a, model.positions[t.z] - a);
+				model.normals[t.x] += n;
+				model.normals[t.y] += n;
+				model.normals[t.z] += n;
+			}
+			array<unsigned, 6> f = { { (unsigned)t.x, (unsigned)t.x, (unsigned)t.y, (unsigned)t.y, (unsigned)t.z, (unsigned)t.z } };
+			model.faces.push_back(f);
+		}
+	}
+
+	if (normal_attrib == -1)
+		for (Vec3f& n : model.normals) {
+			F32 len = n.length();
+			n = (len > 0.0f) ? n / len : Vec3f(0.0f, 1.0f, 0.0f);
+		}
+
+	delete mesh;
+	return true;
+}
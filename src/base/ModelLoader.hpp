@@ -0,0 +1,38 @@
+#pragma once
+
+#include "base/Math.hpp"
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace FW {
+
+// Indexed model as read from disk. Every face stores the position and
+// normal indices of its three corners in the order (p0, n0, p1, n1, p2, n2).
+struct IndexedModel
+{
+	std::vector<Vec3f>						positions;
+	std::vector<Vec3f>						normals;
+	std::vector<std::array<unsigned, 6>>	faces;
+
+	void clear() { positions.clear(); normals.clear(); faces.clear(); }
+};
+
+// Original loader: getline + istringstream, one std::string per token.
+// Kept as the reference for loadObjMapped() and for benchmarking.
+bool	loadObjStreamed	(const std::string& filename, IndexedModel& model);
+
+// Memory-maps the file and scans it in place without per-line allocations.
+// Accepts v, v/vt, v//vn and v/vt/vn corners, negative (relative) indices and
+// polygons, which are fanned into triangles. Faces without normal indices get
+// a geometric normal appended to 'normals'.
+bool	loadObjMapped	(const std::string& filename, IndexedModel& model);
+bool	parseObj		(const char* begin, const char* end, IndexedModel& model);
+
+// Reads an ascii or binary PLY file through FW::importMesh(). Normals are
+// indexed like the positions: the file's vertex normals when it has them,
+// otherwise smooth area-weighted normals of the adjacent faces.
+bool	loadPly			(const std::string& filename, IndexedModel& model);
+
+}
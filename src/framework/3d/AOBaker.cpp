@@ -0,0 +1,266 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "3d/AOBaker.hpp"
+#include "base/Hash.hpp"
+#include "base/MulticoreLauncher.hpp"
+#include "base/Random.hpp"
+#include "base/Timer.hpp"
+
+using namespace FW;
+
+//------------------------------------------------------------------------
+
+#define AO_CHUNK_SIZE       64              // Vertices per task.
+
+//------------------------------------------------------------------------
+
+namespace FW
+{
+
+struct AOBakeState
+{
+    const BVH*              bvh;
+    const Vec3f*            positions;
+    const Vec3f*            normals;
+    S32*                    numHits;
+    Vec2f*                  radius;
+    S32                     numVertices;
+    S32                     raysPerVertex;
+    F32                     maxDistance;
+    F32                     bias;
+    U32                     seed;
+    S32                     pass;
+};
+
+static void     bakeChunk           (MulticoreLauncher::Task& task);
+static void     tangentFrame        (const Vec3f& n, Vec3f& t, Vec3f& b);
+
+}
+
+//------------------------------------------------------------------------
+
+void AOBaker::init(const MeshBase& mesh, const Params& params)
+{
+    FW_ASSERT(params.maxDistance > 0.0f && params.bias >= 0.0f);
+
+    int posAttrib = mesh.findAttrib(MeshBase::AttribType_Position);
+    int normalAttrib = mesh.findAttrib(MeshBase::AttribType_Normal);
+    int num = (posAttrib != -1) ? mesh.numVertices() : 0;
+
+    m_positions.reset(num);
+    if (num)
+    {
+        AttribView<const Vec3f> posView = mesh.getAttribView<Vec3f>(posAttrib);
+        for (int i = 0; i < num; i++)
+            m_positions[i] = (posView.isValid()) ? posView[i] : mesh.getVertexAttrib(i, posAttrib).getXYZ();
+    }
+
+    // Normals from the mesh, or summed over the faces around each vertex;
+    // the cross product weights them by area.
+
+    m_normals.reset(num);
+    if (num && normalAttrib != -1)
+    {
+        AttribView<const Vec3f> normalView = mesh.getAttribView<Vec3f>(normalAttrib);
+        for (int i = 0; i < num; i++)
+            m_normals[i] = (normalView.isValid()) ? normalView[i] : mesh.getVertexAttrib(i, normalAttrib).getXYZ();
+    }
+    else if (num)
+    {
+        for (int i = 0; i < num; i++)
+            m_normals[i] = Vec3f(0.0f);
+        for (int i = 0; i < mesh.numSubmeshes(); i++)
+        {
+            const Array<Vec3i>& tris = mesh.indices(i);
+            for (int j = 0; j < tris.getSize(); j++)
+            {
+                const Vec3i& tri = tris[j];
+                Vec3f n = cross(m_positions[tri.y] - m_positions[tri.x], m_positions[tri.z] - m_positions[tri.x]);
+                for (int k = 0; k < 3; k++)
+                    m_normals[tri[k]] += n;
+            }
+        }
+    }
+
+    for (int i = 0; i < num; i++)
+    {
+        F32 len = m_normals[i].length();
+        m_normals[i] = (len > 0.0f) ? m_normals[i] / len : Vec3f(0.0f);
+    }
+
+    // Scale of the scene.
+
+    Vec3f lo(0.0f), hi(0.0f);
+    if (num)
+    {
+        lo = hi = m_positions[0];
+        for (int i = 1; i < num; i++)
+        {
+            lo = min(lo, m_positions[i]);
+            hi = max(hi, m_positions[i]);
+        }
+    }
+    F32 diagonal = (hi - lo).length();
+
+    m_bvh.build(mesh);
+    m_maxDistance = params.maxDistance * diagonal;
+    m_bias = params.bias * diagonal;
+    m_seed = params.seed;
+    m_numHits.reset(num);
+    m_radius.reset(num);
+    for (int i = 0; i < num; i++)
+    {
+        m_numHits[i] = 0;
+        m_radius[i] = Vec2f(FW_F32_MAX, 0.0f);
+    }
+    m_stats = Stats();
+}
+
+//------------------------------------------------------------------------
+
+void AOBaker::bake(int raysPerVertex)
+{
+    FW_ASSERT(raysPerVertex >= 0);
+
+    Timer timer(true);
+    AOBakeState s;
+    s.bvh           = &m_bvh;
+    s.positions     = m_positions.getPtr();
+    s.normals       = m_normals.getPtr();
+    s.numHits       = m_numHits.getPtr();
+    s.radius        = m_radius.getPtr();
+    s.numVertices   = numVertices();
+    s.raysPerVertex = raysPerVertex;
+    s.maxDistance   = m_maxDistance;
+    s.bias          = m_bias;
+    s.seed          = m_seed;
+    s.pass          = m_stats.numPasses;
+
+    int numChunks = (s.numVertices + AO_CHUNK_SIZE - 1) / AO_CHUNK_SIZE;
+    if (raysPerVertex && numChunks)
+        MulticoreLauncher().push(bakeChunk, &s, 0, numChunks).popAll();
+
+    int numCasting = 0;
+    for (int i = 0; i < s.numVertices; i++)
+        numCasting += (m_normals[i] != Vec3f(0.0f)) ? 1 : 0;
+
+    m_stats.numPasses++;
+    m_stats.raysPerVertex += raysPerVertex;
+    m_stats.numRays += (S64)numCasting * raysPerVertex;
+    m_stats.seconds += timer.getElapsed();
+}
+
+//------------------------------------------------------------------------
+
+bool AOBaker::write(MeshBase& mesh) const
+{
+    int attrib = mesh.findAttrib(MeshBase::AttribType_AORadius);
+    if (!mesh.isViewable(attrib, sizeof(Vec2f)))
+    {
+        setError("AOBaker: Mesh has no F32 AORadius attribute with two components!");
+        return false;
+    }
+    if (mesh.numVertices() != numVertices())
+    {
+        setError("AOBaker: Vertex count differs from the baked mesh!");
+        return false;
+    }
+
+    AttribView<Vec2f> view = mesh.getMutableAttribView<Vec2f>(attrib);
+    for (int i = 0; i < numVertices(); i++)
+        view[i] = getRadius(i);
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+void FW::bakeChunk(MulticoreLauncher::Task& task)
+{
+    const AOBakeState& s = *(const AOBakeState*)task.data;
+    int begin = task.idx * AO_CHUNK_SIZE;
+    int end = min(begin + AO_CHUNK_SIZE, s.numVertices);
+
+    // The rays of a vertex share their origin, which keeps packets
+    // coherent near the root.
+
+    Random random(hashBits(s.seed, (U32)s.pass, (U32)task.idx));
+    Array<Ray> rays(NULL, s.raysPerVertex);
+    Array<RayHit> hits(NULL, s.raysPerVertex);
+
+    for (int i = begin; i < end; i++)
+    {
+        const Vec3f& n = s.normals[i];
+        if (n == Vec3f(0.0f))
+            continue;
+
+        Vec3f t, b;
+        tangentFrame(n, t, b);
+        Vec3f origin = s.positions[i] + n * s.bias;
+        for (int j = 0; j < s.raysPerVertex; j++)
+        {
+            // Cosine-weighted: uniform on the unit disk, lifted onto the
+            // hemisphere (Malley's method).
+
+            F32 r2 = random.getF32();
+            F32 phi = random.getF32() * 2.0f * FW_PI;
+            F32 r = sqrt(r2);
+            Vec3f d = t * (r * cos(phi)) + b * (r * sin(phi)) + n * sqrt(max(1.0f - r2, 0.0f));
+            rays[j] = Ray(origin, d, 0.0f, s.maxDistance);
+        }
+
+        s.bvh->intersect(rays.getPtr(), hits.getPtr(), s.raysPerVertex, BVH::TraceMode_Packet);
+
+        S32 numHits = 0;
+        Vec2f radius = s.radius[i];
+        for (int j = 0; j < s.raysPerVertex; j++)
+        {
+            if (hits[j].triangle == -1)
+                continue;
+            numHits++;
+            radius.x = min(radius.x, hits[j].t);
+            radius.y = max(radius.y, hits[j].t);
+        }
+        s.numHits[i] += numHits;
+        s.radius[i] = radius;
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::tangentFrame(const Vec3f& n, Vec3f& t, Vec3f& b)
+{
+    // Orthonormal basis without branches on the axis (Duff et al. 2017).
+
+    F32 sign = (n.z >= 0.0f) ? 1.0f : -1.0f;
+    F32 a = -1.0f / (sign + n.z);
+    F32 c = n.x * n.y * a;
+    t = Vec3f(1.0f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+    b = Vec3f(c, sign + n.y * n.y * a, -n.y);
+}
+
+//------------------------------------------------------------------------
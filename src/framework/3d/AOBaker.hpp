@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include "3d/BVH.hpp"
+
+namespace FW
+{
+//------------------------------------------------------------------------
+// Per-vertex ambient occlusion, baked into MeshBase::AttribType_AORadius.
+//
+// Every vertex casts cosine-weighted rays over the hemisphere around its
+// normal against a BVH of the whole mesh. Rays longer than maxDistance do
+// not count. The baker keeps, per vertex, the fraction of rays that hit
+// and the nearest and farthest hit distances; write() stores the latter
+// pair as (min, max) and uses maxDistance for both when nothing was hit.
+//
+// bake() adds rays to what the previous calls found, so a quick pass can
+// be shown first and refined later. Each call is split into tasks over
+// runs of vertices, and every task draws from its own Random stream seeded
+// by (seed, call, task). The result therefore depends only on the seed and
+// the sequence of bake() calls, not on the number of threads.
+//------------------------------------------------------------------------
+
+class AOBaker
+{
+public:
+    struct Params
+    {
+        F32             maxDistance;        // As a fraction of the bounding box diagonal.
+        F32             bias;               // Rays start this far out, likewise.
+        U32             seed;
+
+                        Params              (void)                          : maxDistance(0.1f), bias(1.0e-4f), seed(1) {}
+    };
+
+    struct Stats
+    {
+        S32             numPasses;          // bake() calls so far.
+        S32             raysPerVertex;      // Summed over the passes.
+        S64             numRays;
+        F32             seconds;            // In bake(), BVH build excluded.
+
+                        Stats               (void)                          : numPasses(0), raysPerVertex(0), numRays(0), seconds(0.0f) {}
+    };
+
+public:
+                        AOBaker             (void)                          : m_maxDistance(0.0f), m_bias(0.0f), m_seed(0) {}
+                        AOBaker             (const MeshBase& mesh, const Params& params = Params()) { init(mesh, params); }
+                        ~AOBaker            (void)                          {}
+
+    // Snapshots the positions, normals and triangles of 'mesh' and builds
+    // the BVH. Vertices without a normal attribute get area-weighted face
+    // normals. Clears all results.
+    void                init                (const MeshBase& mesh, const Params& params = Params());
+    void                bake                (int raysPerVertex);
+
+    // Requires an F32 AORadius attribute with at least two components.
+    bool                write               (MeshBase& mesh) const;
+
+    int                 numVertices         (void) const                    { return m_positions.getSize(); }
+    F32                 getMaxDistance      (void) const                    { return m_maxDistance; }   // In mesh units.
+    F32                 getOcclusion        (int idx) const                 { return (m_stats.raysPerVertex) ? (F32)m_numHits[idx] / (F32)m_stats.raysPerVertex : 0.0f; }
+    Vec2f               getRadius           (int idx) const                 { return (m_numHits[idx]) ? m_radius[idx] : Vec2f(m_maxDistance); }
+    const BVH&          getBVH              (void) const                    { return m_bvh; }
+    const Stats&        getStats            (void) const                    { return m_stats; }
+
+private:
+                        AOBaker             (const AOBaker&); // forbidden
+    AOBaker&            operator=           (const AOBaker&); // forbidden
+
+private:
+    BVH                 m_bvh;
+    Array<Vec3f>        m_positions;
+    Array<Vec3f>        m_normals;          // Unit length, or zero for vertices that cast no rays.
+    Array<S32>          m_numHits;
+    Array<Vec2f>        m_radius;           // (nearest, farthest) hit; undefined while m_numHits is zero.
+    F32                 m_maxDistance;
+    F32                 m_bias;
+    U32                 m_seed;
+    Stats               m_stats;
+};
+
+//------------------------------------------------------------------------
+}
@@ -0,0 +1,1721 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "3d/BVH.hpp"
+#include "base/MulticoreLauncher.hpp"
+#include "base/Timer.hpp"
+#include "base/Sort.hpp"
+
+// Packet width: 8 with AVX, 4 with SSE, 4 in plain C++ otherwise.
+// Define FW_BVH_SIMD as 0 to force the plain version.
+
+#ifndef FW_BVH_SIMD
+#   if defined(__AVX__)
+#       define FW_BVH_SIMD  8
+#   elif defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#       define FW_BVH_SIMD  4
+#   else
+#       define FW_BVH_SIMD  0
+#   endif
+#endif
+
+#if (FW_BVH_SIMD == 8)
+#   include <immintrin.h>
+#   define BVH_PACKET_SIZE  8
+#elif (FW_BVH_SIMD == 4)
+#   include <xmmintrin.h>
+#   define BVH_PACKET_SIZE  4
+#else
+#   define BVH_PACKET_SIZE  4
+#endif
+
+using namespace FW;
+
+//------------------------------------------------------------------------
+
+#define BVH_NUM_BINS        16
+#define BVH_MAX_LEAF_SIZE   8
+#define BVH_TASK_MIN        4096            // Subtrees with at least this many triangles become tasks.
+#define BVH_MAX_DEPTH       64              // Deeper nodes split at the median instead.
+#define BVH_STACK_SIZE      (BVH_MAX_DEPTH + 32)
+#define BVH_CHUNK_SIZE      (1 << 15)
+#define BVH_ROBUST          1.0000008f      // Pads the exit distance of box tests by a few ulps.
+#define BVH_STREAM_BITS     9               // Per axis, in the origin keys of ray streams.
+
+//------------------------------------------------------------------------
+// Lanes of a packet. Vf holds one float per ray and Vb one mask per ray.
+// Every operation rounds exactly like its scalar counterpart, and min/max
+// pick the same operand as FW::min/max, so a lane computes the same bits
+// as the single-ray code.
+//------------------------------------------------------------------------
+
+namespace FW
+{
+
+#if (FW_BVH_SIMD == 8)
+
+typedef __m256 Vf;
+typedef __m256 Vb;
+
+static inline Vf    vload   (const F32* p)              { return _mm256_loadu_ps(p); }
+static inline Vb    vloadb  (const U32* p)              { return _mm256_loadu_ps((const F32*)p); }
+static inline Vf    vset1   (F32 a)                     { return _mm256_set1_ps(a); }
+static inline void  vstore  (F32* p, Vf a)              { _mm256_storeu_ps(p, a); }
+static inline Vf    vadd    (Vf a, Vf b)                { return _mm256_add_ps(a, b); }
+static inline Vf    vsub    (Vf a, Vf b)                { return _mm256_sub_ps(a, b); }
+static inline Vf    vmul    (Vf a, Vf b)                { return _mm256_mul_ps(a, b); }
+static inline Vf    vdiv    (Vf a, Vf b)                { return _mm256_div_ps(a, b); }
+static inline Vf    vmin    (Vf a, Vf b)                { return _mm256_min_ps(a, b); }
+static inline Vf    vmax    (Vf a, Vf b)                { return _mm256_max_ps(a, b); }
+static inline Vb    vlt     (Vf a, Vf b)                { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline Vb    vle     (Vf a, Vf b)                { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline Vb    veq     (Vf a, Vf b)                { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+static inline Vb    vneq    (Vf a, Vf b)                { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+static inline Vb    vand    (Vb a, Vb b)                { return _mm256_and_ps(a, b); }
+static inline Vb    vor     (Vb a, Vb b)                { return _mm256_or_ps(a, b); }
+static inline Vf    vselect (Vb m, Vf a, Vf b)          { return _mm256_blendv_ps(b, a, m); }
+static inline int   vbits   (Vb m)                      { return _mm256_movemask_ps(m); }
+
+#elif (FW_BVH_SIMD == 4)
+
+typedef __m128 Vf;
+typedef __m128 Vb;
+
+static inline Vf    vload   (const F32* p)              { return _mm_loadu_ps(p); }
+static inline Vb    vloadb  (const U32* p)              { return _mm_loadu_ps((const F32*)p); }
+static inline Vf    vset1   (F32 a)                     { return _mm_set1_ps(a); }
+static inline void  vstore  (F32* p, Vf a)              { _mm_storeu_ps(p, a); }
+static inline Vf    vadd    (Vf a, Vf b)                { return _mm_add_ps(a, b); }
+static inline Vf    vsub    (Vf a, Vf b)                { return _mm_sub_ps(a, b); }
+static inline Vf    vmul    (Vf a, Vf b)                { return _mm_mul_ps(a, b); }
+static inline Vf    vdiv    (Vf a, Vf b)                { return _mm_div_ps(a, b); }
+static inline Vf    vmin    (Vf a, Vf b)                { return _mm_min_ps(a, b); }
+static inline Vf    vmax    (Vf a, Vf b)                { return _mm_max_ps(a, b); }
+static inline Vb    vlt     (Vf a, Vf b)                { return _mm_cmplt_ps(a, b); }
+static inline Vb    vle     (Vf a, Vf b)                { return _mm_cmple_ps(a, b); }
+static inline Vb    veq     (Vf a, Vf b)                { return _mm_cmpeq_ps(a, b); }
+static inline Vb    vneq    (Vf a, Vf b)                { return _mm_cmpneq_ps(a, b); }
+static inline Vb    vand    (Vb a, Vb b)                { return _mm_and_ps(a, b); }
+static inline Vb    vor     (Vb a, Vb b)                { return _mm_or_ps(a, b); }
+static inline Vf    vselect (Vb m, Vf a, Vf b)          { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+static inline int   vbits   (Vb m)                      { return _mm_movemask_ps(m); }
+
+#else
+
+struct Vf { F32 e[BVH_PACKET_SIZE]; };
+struct Vb { bool e[BVH_PACKET_SIZE]; };
+
+#define BVH_LANES(EXPR) for (int i = 0; i < BVH_PACKET_SIZE; i++) r.e[i] = (EXPR); return r
+
+static inline Vf    vload   (const F32* p)              { Vf r; BVH_LANES(p[i]); }
+static inline Vb    vloadb  (const U32* p)              { Vb r; BVH_LANES(p[i] != 0); }
+static inline Vf    vset1   (F32 a)                     { Vf r; BVH_LANES(a); }
+static inline void  vstore  (F32* p, Vf a)              { for (int i = 0; i < BVH_PACKET_SIZE; i++) p[i] = a.e[i]; }
+static inline Vf    vadd    (Vf a, Vf b)                { Vf r; BVH_LANES(a.e[i] + b.e[i]); }
+static inline Vf    vsub    (Vf a, Vf b)                { Vf r; BVH_LANES(a.e[i] - b.e[i]); }
+static inline Vf    vmul    (Vf a, Vf b)                { Vf r; BVH_LANES(a.e[i] * b.e[i]); }
+static inline Vf    vdiv    (Vf a, Vf b)                { Vf r; BVH_LANES(a.e[i] / b.e[i]); }
+static inline Vf    vmin    (Vf a, Vf b)                { Vf r; BVH_LANES(min(a.e[i], b.e[i])); }
+static inline Vf    vmax    (Vf a, Vf b)                { Vf r; BVH_LANES(max(a.e[i], b.e[i])); }
+static inline Vb    vlt     (Vf a, Vf b)                { Vb r; BVH_LANES(a.e[i] < b.e[i]); }
+static inline Vb    vle     (Vf a, Vf b)                { Vb r; BVH_LANES(a.e[i] <= b.e[i]); }
+static inline Vb    veq     (Vf a, Vf b)                { Vb r; BVH_LANES(a.e[i] == b.e[i]); }
+static inline Vb    vneq    (Vf a, Vf b)                { Vb r; BVH_LANES(a.e[i] != b.e[i]); }
+static inline Vb    vand    (Vb a, Vb b)                { Vb r; BVH_LANES(a.e[i] && b.e[i]); }
+static inline Vb    vor     (Vb a, Vb b)                { Vb r; BVH_LANES(a.e[i] || b.e[i]); }
+static inline Vf    vselect (Vb m, Vf a, Vf b)          { Vf r; BVH_LANES((m.e[i]) ? a.e[i] : b.e[i]); }
+static inline int   vbits   (Vb m)                      { int r = 0; for (int i = 0; i < BVH_PACKET_SIZE; i++) r |= (m.e[i]) ? 1 << i : 0; return r; }
+
+#undef BVH_LANES
+
+#endif
+
+struct Packet                   // Rays of a packet, one per lane.
+{
+    Vf                      ox, oy, oz;
+    Vf                      dx, dy, dz;
+    Vf                      ix, iy, iz;     // See reciprocal().
+    Vf                      tmin;
+    Vf                      tmax;           // Closest hit so far.
+    Vf                      u, v;
+    S32                     best[BVH_PACKET_SIZE];
+};
+
+struct PointPacket              // Closest-point queries, one per lane.
+{
+    Vf                      px, py, pz;
+    Vf                      bestSqr;        // Squared distance of the closest point so far.
+    Vf                      qx, qy, qz;
+    Vf                      u, v;
+    Vf                      feature;
+    S32                     best[BVH_PACKET_SIZE];
+};
+
+}
+
+//------------------------------------------------------------------------
+
+namespace FW
+{
+
+struct BuildNode                // Sparse; see BVH.hpp.
+{
+    Vec3f                   lo;
+    Vec3f                   hi;
+    S32                     left;           // -1 for leaves.
+    S32                     right;
+    S32                     first;
+    S32                     count;
+};
+
+struct BuildRef                 // Bounds of a triangle. Moved rather than indexed, so that every pass is sequential.
+{
+    F32                     lo[3];
+    S32                     tri;
+    F32                     hi[3];
+    S32                     pad;
+};
+
+struct BuildState
+{
+    const Vec3f*            positions;
+    const Vec3i*            tris;
+    S32                     numTris;
+    Array<BuildRef>         refs;           // Partitioned in place; leaf order in the end.
+    Array<BuildNode>        nodes;          // A subtree of n triangles owns 2n - 1 slots from its root on.
+};
+
+struct BuildTask
+{
+    BuildState*             state;
+    S32                     node;
+    S32                     begin;          // Range of order[].
+    S32                     end;
+    S32                     depth;
+};
+
+static void     computeTriBounds    (MulticoreLauncher::Task& task);
+static void     buildSubtree        (MulticoreLauncher::Task& task);
+static void     buildNodes          (BuildTask job, MulticoreLauncher* launcher);
+static int      findSplit           (BuildState& s, const BuildTask& job, const F32* centroidLo, const F32* centroidHi, F32 area);
+static F32      halfArea            (const Vec3f& lo, const Vec3f& hi);
+static F32      halfArea            (const F32* lo, const F32* hi);
+static bool     intersectBox        (const BVH::Node& node, const Vec3f& origin, const Vec3f& invDir, F32 tmin, F32 tmax, F32& tEntry);
+static bool     intersectTriangle   (const BVH::Triangle& tri, const Ray& ray, F32 tmax, F32& t, F32& u, F32& v);
+static bool     triangleOverlapsBox (const BVH::Triangle& tri, const Vec3f& center, const Vec3f& half);
+static Vec3f    closestPointOnTriangle(const Vec3f& p, const BVH::Triangle& tri, F32& u, F32& v, S32& feature);
+static F32      boxDistanceSqr      (const BVH::Node& node, const Vec3f& p);
+static Vec3f    reciprocal          (const Vec3f& dir);
+static Vb       packetBox           (const BVH::Node& node, const Packet& p, Vf& tEntry);
+static Vb       packetTriangle      (const BVH::Triangle& tri, const Packet& p, Vf& t, Vf& u, Vf& v);
+static Vf       packetBoxDistanceSqr(const BVH::Node& node, const PointPacket& p);
+static Vf       packetClosestPoint  (const BVH::Triangle& tri, const PointPacket& p, Vf& qx, Vf& qy, Vf& qz, Vf& u, Vf& v, Vf& feature);
+static U32      streamKey           (const Ray& ray, const Vec3f& lo, const Vec3f& scale);
+
+}
+
+//------------------------------------------------------------------------
+
+void BVH::build(const MeshBase& mesh)
+{
+    int posAttrib = mesh.findAttrib(MeshBase::AttribType_Position);
+    Array<Vec3f> positions;
+    Array<Vec3i> tris;
+    Array<S32> submeshStart;
+
+    if (posAttrib != -1)
+    {
+        AttribView<const Vec3f> posView = mesh.getAttribView<Vec3f>(posAttrib);
+        positions.reset(mesh.numVertices());
+        for (int i = 0; i < mesh.numVertices(); i++)
+            positions[i] = (posView.isValid()) ? posView[i] : mesh.getVertexAttrib(i, posAttrib).getXYZ();
+
+        tris.setCapacity(mesh.numTriangles());
+        for (int i = 0; i < mesh.numSubmeshes(); i++)
+        {
+            submeshStart.add(tris.getSize());
+            tris.add(mesh.indices(i));
+        }
+    }
+    submeshStart.add(tris.getSize());
+
+    build(positions.getPtr(), tris.getPtr(), tris.getSize());
+    m_submeshStart = submeshStart;
+}
+
+//------------------------------------------------------------------------
+
+void BVH::build(const Vec3f* positions, const Vec3i* tris, int numTris)
+{
+    FW_ASSERT(numTris >= 0);
+    FW_ASSERT((positions && tris) || !numTris);
+
+    Timer timer(true);
+    clear();
+    m_submeshStart.add(0);
+    m_submeshStart.add(numTris);
+    if (!numTris)
+        return;
+
+    // Bounds and centroids of the triangles.
+
+    BuildState s;
+    s.positions = positions;
+    s.tris = tris;
+    s.numTris = numTris;
+    s.refs.reset(numTris);
+    s.nodes.reset(numTris * 2 - 1);
+
+    int numChunks = (numTris + BVH_CHUNK_SIZE - 1) / BVH_CHUNK_SIZE;
+    MulticoreLauncher launcher;
+    launcher.push(computeTriBounds, &s, 0, numChunks).popAll();
+
+    // Build the sparse tree. The root task spawns the others.
+
+    BuildTask* root = new BuildTask;
+    root->state = &s;
+    root->node = 0;
+    root->begin = 0;
+    root->end = numTris;
+    root->depth = 0;
+    launcher.push(buildSubtree, root).popAll();
+
+    // Pack the nodes depth-first with siblings adjacent.
+
+    m_nodes.setCapacity(numTris * 2 - 1);
+    m_nodes.add();
+    Array<Vec2i> stack;                     // (sparse, packed)
+    stack.add(Vec2i(0, 0));
+    while (stack.getSize())
+    {
+        Vec2i item = stack.removeLast();
+        const BuildNode& in = s.nodes[item.x];
+        Node& out = m_nodes[item.y];
+        out.lo = in.lo;
+        out.hi = in.hi;
+        out.first = in.first;
+        out.count = in.count;
+
+        if (in.left != -1)
+        {
+            out.first = m_nodes.getSize();
+            out.count = 0;
+            m_nodes.add(NULL, 2);
+            stack.add(Vec2i(in.right, out.first + 1));
+            stack.add(Vec2i(in.left, out.first));
+        }
+    }
+    m_nodes.compact();
+
+    // Copy the triangles into leaf order.
+
+    m_triIndex.reset(numTris);
+    m_tris.reset(numTris);
+    for (int i = 0; i < numTris; i++)
+    {
+        m_triIndex[i] = s.refs[i].tri;
+        const Vec3i& tri = tris[s.refs[i].tri];
+        m_tris[i].v0 = positions[tri.x];
+        m_tris[i].e1 = positions[tri.y] - positions[tri.x];
+        m_tris[i].e2 = positions[tri.z] - positions[tri.x];
+    }
+
+    computeStats();
+    m_stats.seconds = timer.getElapsed();
+}
+
+//------------------------------------------------------------------------
+
+void BVH::clear(void)
+{
+    m_nodes.reset();
+    m_tris.reset();
+    m_triIndex.reset();
+    m_submeshStart.reset();
+    m_stats = BuildStats();
+}
+
+//------------------------------------------------------------------------
+
+bool BVH::intersect(const Ray& ray, RayHit& hit) const
+{
+    if (isEmpty())
+        return false;
+
+    Vec3f invDir = reciprocal(ray.direction);
+    F32 tmax = ray.tmax;
+    F32 tEntry;
+    if (!intersectBox(m_nodes[0], ray.origin, invDir, ray.tmin, tmax, tEntry))
+        return false;
+
+    // Visit the nearer child first and skip postponed ones that start
+    // beyond the closest hit so far. Ties go to the triangle first in
+    // leaf order, so the result does not depend on the order of visits.
+
+    S32 stackNode[BVH_STACK_SIZE];
+    F32 stackT[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIdx = 0;
+    int best = -1;
+    F32 bestU = 0.0f, bestV = 0.0f;
+
+    for (;;)
+    {
+        const Node& n = m_nodes[nodeIdx];
+        if (n.isLeaf())
+        {
+            for (int i = n.first; i < n.first + n.count; i++)
+            {
+                F32 t, u, v;
+                if (intersectTriangle(m_tris[i], ray, tmax, t, u, v) && (t < tmax || best == -1 || i < best))
+                {
+                    tmax = t;
+                    best = i;
+                    bestU = u;
+                    bestV = v;
+                }
+            }
+        }
+        else
+        {
+            F32 tLeft, tRight;
+            bool hitLeft = intersectBox(m_nodes[n.first], ray.origin, invDir, ray.tmin, tmax, tLeft);
+            bool hitRight = intersectBox(m_nodes[n.first + 1], ray.origin, invDir, ray.tmin, tmax, tRight);
+            if (hitLeft && hitRight)
+            {
+                bool leftFirst = (tLeft <= tRight);
+                FW_ASSERT(stackSize < BVH_STACK_SIZE);
+                stackNode[stackSize] = (leftFirst) ? n.first + 1 : n.first;
+                stackT[stackSize++] = (leftFirst) ? tRight : tLeft;
+                nodeIdx = (leftFirst) ? n.first : n.first + 1;
+                continue;
+            }
+            if (hitLeft || hitRight)
+            {
+                nodeIdx = (hitLeft) ? n.first : n.first + 1;
+                continue;
+            }
+        }
+
+        do
+        {
+            if (!stackSize)
+            {
+                if (best == -1)
+                    return false;
+                hit.triangle = m_triIndex[best];
+                hit.t = tmax;
+                hit.u = bestU;
+                hit.v = bestV;
+                return true;
+            }
+            nodeIdx = stackNode[--stackSize];
+        }
+        while (!(stackT[stackSize] <= tmax * BVH_ROBUST));
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool BVH::intersectAny(const Ray& ray) const
+{
+    if (isEmpty())
+        return false;
+
+    Vec3f invDir = reciprocal(ray.direction);
+    F32 tEntry;
+    if (!intersectBox(m_nodes[0], ray.origin, invDir, ray.tmin, ray.tmax, tEntry))
+        return false;
+
+    S32 stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIdx = 0;
+
+    for (;;)
+    {
+        const Node& n = m_nodes[nodeIdx];
+        if (n.isLeaf())
+        {
+            for (int i = n.first; i < n.first + n.count; i++)
+            {
+                F32 t, u, v;
+                if (intersectTriangle(m_tris[i], ray, ray.tmax, t, u, v))
+                    return true;
+            }
+        }
+        else
+        {
+            F32 tLeft, tRight;
+            bool hitLeft = intersectBox(m_nodes[n.first], ray.origin, invDir, ray.tmin, ray.tmax, tLeft);
+            bool hitRight = intersectBox(m_nodes[n.first + 1], ray.origin, invDir, ray.tmin, ray.tmax, tRight);
+            if (hitLeft && hitRight)
+            {
+                FW_ASSERT(stackSize < BVH_STACK_SIZE);
+                stack[stackSize++] = n.first + 1;
+                nodeIdx = n.first;
+                continue;
+            }
+            if (hitLeft || hitRight)
+            {
+                nodeIdx = (hitLeft) ? n.first : n.first + 1;
+                continue;
+            }
+        }
+
+        if (!stackSize)
+            return false;
+        nodeIdx = stack[--stackSize];
+    }
+}
+
+//------------------------------------------------------------------------
+
+int BVH::intersect(const Ray* rays, RayHit* hits, int numRays, TraceMode mode) const
+{
+    FW_ASSERT(numRays >= 0);
+    FW_ASSERT((rays && hits) || !numRays);
+    FW_ASSERT(mode >= 0 && mode < TraceMode_Max);
+
+    for (int i = 0; i < numRays; i++)
+        hits[i] = RayHit();
+
+    if (mode == TraceMode_Single)
+    {
+        for (int i = 0; i < numRays; i++)
+            intersect(rays[i], hits[i]);
+    }
+    else if (mode == TraceMode_Packet)
+    {
+        for (int i = 0; i < numRays; i += BVH_PACKET_SIZE)
+            tracePacket(rays + i, NULL, min(numRays - i, BVH_PACKET_SIZE), hits + i, NULL);
+    }
+    else
+    {
+        Array<S32> order;
+        sortStream(rays, numRays, order);
+
+        for (int i = 0; i < numRays; i += BVH_PACKET_SIZE)
+            tracePacket(rays, order.getPtr() + i, min(numRays - i, BVH_PACKET_SIZE), hits, NULL);
+    }
+
+    int numHits = 0;
+    for (int i = 0; i < numRays; i++)
+        numHits += (hits[i].triangle != -1) ? 1 : 0;
+    return numHits;
+}
+
+//------------------------------------------------------------------------
+
+int BVH::intersectAny(const Ray* rays, bool* occluded, int numRays, TraceMode mode) const
+{
+    FW_ASSERT(numRays >= 0);
+    FW_ASSERT((rays && occluded) || !numRays);
+    FW_ASSERT(mode >= 0 && mode < TraceMode_Max);
+
+    for (int i = 0; i < numRays; i++)
+        occluded[i] = false;
+
+    if (mode == TraceMode_Single)
+    {
+        for (int i = 0; i < numRays; i++)
+            occluded[i] = intersectAny(rays[i]);
+    }
+    else if (mode == TraceMode_Packet)
+    {
+        for (int i = 0; i < numRays; i += BVH_PACKET_SIZE)
+            tracePacket(rays + i, NULL, min(numRays - i, BVH_PACKET_SIZE), NULL, occluded + i);
+    }
+    else
+    {
+        Array<S32> order;
+        sortStream(rays, numRays, order);
+
+        for (int i = 0; i < numRays; i += BVH_PACKET_SIZE)
+            tracePacket(rays, order.getPtr() + i, min(numRays - i, BVH_PACKET_SIZE), NULL, occluded);
+    }
+
+    int numOccluded = 0;
+    for (int i = 0; i < numRays; i++)
+        numOccluded += (occluded[i]) ? 1 : 0;
+    return numOccluded;
+}
+
+//------------------------------------------------------------------------
+
+int BVH::packetWidth(void)
+{
+    return BVH_PACKET_SIZE;
+}
+
+//------------------------------------------------------------------------
+
+const char* BVH::getTraceModeName(TraceMode mode)
+{
+    switch (mode)
+    {
+    case TraceMode_Single:  return "single";
+    case TraceMode_Packet:  return "packet";
+    case TraceMode_Stream:  return "stream";
+    default:                FW_ASSERT(false); return "";
+    }
+}
+
+//------------------------------------------------------------------------
+
+void BVH::sortStream(const Ray* rays, int numRays, Array<S32>& order) const
+{
+    // Group the rays by direction octant and, within an octant, by origin,
+    // so that neighbors in the order tend to visit the same nodes.
+
+    Vec3f lo(0.0f), scale(0.0f);
+    if (!isEmpty())
+    {
+        lo = m_nodes[0].lo;
+        Vec3f size = m_nodes[0].hi - lo;
+        for (int i = 0; i < 3; i++)
+            scale[i] = (size[i] > 0.0f) ? (F32)(1 << BVH_STREAM_BITS) / size[i] : 0.0f;
+    }
+
+    Array<U32> keys(NULL, numRays);
+    order.reset(numRays);
+    for (int i = 0; i < numRays; i++)
+    {
+        keys[i] = streamKey(rays[i], lo, scale);
+        order[i] = i;
+    }
+    radixSort(keys.getPtr(), order.getPtr(), numRays, BVH_STREAM_BITS * 3 + 3);
+}
+
+//------------------------------------------------------------------------
+
+void BVH::overlapBox(const Vec3f& lo, const Vec3f& hi, Array<S32>& tris) const
+{
+    if (isEmpty())
+        return;
+
+    Vec3f center = (lo + hi) * 0.5f;
+    Vec3f half = (hi - lo) * 0.5f;
+    S32 stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize)
+    {
+        const Node& n = m_nodes[stack[--stackSize]];
+        if (n.lo.x > hi.x || n.lo.y > hi.y || n.lo.z > hi.z || n.hi.x < lo.x || n.hi.y < lo.y || n.hi.z < lo.z)
+            continue;
+
+        if (!n.isLeaf())
+        {
+            FW_ASSERT(stackSize + 2 <= BVH_STACK_SIZE);
+            stack[stackSize++] = n.first + 1;
+            stack[stackSize++] = n.first;
+            continue;
+        }
+
+        for (int i = n.first; i < n.first + n.count; i++)
+            if (triangleOverlapsBox(m_tris[i], center, half))
+                tris.add(m_triIndex[i]);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void BVH::overlapSphere(const Vec3f& center, F32 radius, Array<S32>& tris) const
+{
+    if (isEmpty() || radius < 0.0f)
+        return;
+
+    F32 radius2 = radius * radius;
+    S32 stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize)
+    {
+        const Node& n = m_nodes[stack[--stackSize]];
+        Vec3f d = max(max(n.lo - center, center - n.hi), Vec3f(0.0f));
+        if (d.lenSqr() > radius2)
+            continue;
+
+        if (!n.isLeaf())
+        {
+            FW_ASSERT(stackSize + 2 <= BVH_STACK_SIZE);
+            stack[stackSize++] = n.first + 1;
+            stack[stackSize++] = n.first;
+            continue;
+        }
+
+        for (int i = n.first; i < n.first + n.count; i++)
+        {
+            F32 u, v;
+            S32 feature;
+            if ((closestPointOnTriangle(center, m_tris[i], u, v, feature) - center).lenSqr() <= radius2)
+                tris.add(m_triIndex[i]);
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool BVH::closestPoint(const Vec3f& p, ClosestPoint& hit, F32 maxDistance) const
+{
+    if (isEmpty() || !(maxDistance >= 0.0f))
+        return false;
+
+    F32 bestSqr = min(maxDistance * maxDistance, FW_F32_MAX);
+    if (!(boxDistanceSqr(m_nodes[0], p) <= bestSqr * BVH_ROBUST))
+        return false;
+
+    // Nearer child first; postponed nodes farther than the best point so
+    // far are skipped. Like the ray queries, the box tests have a little
+    // slack so that the result does not depend on the order of visits.
+
+    S32 stackNode[BVH_STACK_SIZE];
+    F32 stackDist[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIdx = 0;
+    int best = -1;
+    Vec3f bestPoint;
+    F32 bestU = 0.0f, bestV = 0.0f;
+    S32 bestFeature = 0;
+
+    for (;;)
+    {
+        const Node& n = m_nodes[nodeIdx];
+        if (n.isLeaf())
+        {
+            for (int i = n.first; i < n.first + n.count; i++)
+            {
+                F32 u, v;
+                S32 feature;
+                Vec3f q = closestPointOnTriangle(p, m_tris[i], u, v, feature);
+                F32 dx = q.x - p.x, dy = q.y - p.y, dz = q.z - p.z;
+                F32 distSqr = dx * dx + dy * dy + dz * dz;
+                if (distSqr < bestSqr || (distSqr == bestSqr && (best == -1 || i < best)))
+                {
+                    bestSqr = distSqr;
+                    best = i;
+                    bestPoint = q;
+                    bestU = u;
+                    bestV = v;
+                    bestFeature = feature;
+                }
+            }
+        }
+        else
+        {
+            F32 dLeft = boxDistanceSqr(m_nodes[n.first], p);
+            F32 dRight = boxDistanceSqr(m_nodes[n.first + 1], p);
+            bool hitLeft = (dLeft <= bestSqr * BVH_ROBUST);
+            bool hitRight = (dRight <= bestSqr * BVH_ROBUST);
+            if (hitLeft && hitRight)
+            {
+                bool leftFirst = (dLeft <= dRight);
+                FW_ASSERT(stackSize < BVH_STACK_SIZE);
+                stackNode[stackSize] = (leftFirst) ? n.first + 1 : n.first;
+                stackDist[stackSize++] = (leftFirst) ? dRight : dLeft;
+                nodeIdx = (leftFirst) ? n.first : n.first + 1;
+                continue;
+            }
+            if (hitLeft || hitRight)
+            {
+                nodeIdx = (hitLeft) ? n.first : n.first + 1;
+                continue;
+            }
+        }
+
+        do
+        {
+            if (!stackSize)
+            {
+                if (best == -1)
+                    return false;
+                hit.triangle = m_triIndex[best];
+                hit.distance = sqrt(bestSqr);
+                hit.point = bestPoint;
+                hit.u = bestU;
+                hit.v = bestV;
+                hit.feature = bestFeature;
+                return true;
+            }
+            nodeIdx = stackNode[--stackSize];
+        }
+        while (!(stackDist[stackSize] <= bestSqr * BVH_ROBUST));
+    }
+}
+
+//------------------------------------------------------------------------
+
+int BVH::closestPoints(const Vec3f* points, ClosestPoint* hits, int numPoints, F32 maxDistance, bool packets) const
+{
+    FW_ASSERT(numPoints >= 0);
+    FW_ASSERT((points && hits) || !numPoints);
+
+    for (int i = 0; i < numPoints; i++)
+        hits[i] = ClosestPoint();
+
+    if (!packets)
+    {
+        for (int i = 0; i < numPoints; i++)
+            closestPoint(points[i], hits[i], maxDistance);
+    }
+    else
+    {
+        for (int i = 0; i < numPoints; i += BVH_PACKET_SIZE)
+            closestPointPacket(points + i, min(numPoints - i, BVH_PACKET_SIZE), hits + i, maxDistance);
+    }
+
+    int numFound = 0;
+    for (int i = 0; i < numPoints; i++)
+        numFound += (hits[i].triangle != -1) ? 1 : 0;
+    return numFound;
+}
+
+//------------------------------------------------------------------------
+
+Vec2i BVH::locate(int triangle) const
+{
+    FW_ASSERT(m_submeshStart.getSize() >= 2);
+    FW_ASSERT(triangle >= 0 && triangle < m_submeshStart.getLast());
+
+    int lo = 0;
+    int hi = m_submeshStart.getSize() - 2;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) >> 1;
+        if (m_submeshStart[mid] <= triangle)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return Vec2i(lo, triangle - m_submeshStart[lo]);
+}
+
+//------------------------------------------------------------------------
+
+void BVH::computeStats(void)
+{
+    m_stats = BuildStats();
+    m_stats.numNodes = m_nodes.getSize();
+    if (isEmpty())
+        return;
+
+    F32 rootArea = halfArea(m_nodes[0].lo, m_nodes[0].hi);
+    F32 scale = (rootArea > 0.0f) ? 1.0f / rootArea : 0.0f;
+    Array<Vec2i> stack;                     // (node, depth)
+    stack.add(Vec2i(0, 0));
+    while (stack.getSize())
+    {
+        Vec2i item = stack.removeLast();
+        const Node& n = m_nodes[item.x];
+        m_stats.maxDepth = max(m_stats.maxDepth, item.y);
+        if (n.isLeaf())
+        {
+            m_stats.numLeaves++;
+            m_stats.sahCost += halfArea(n.lo, n.hi) * scale * (F32)n.count;
+        }
+        else
+        {
+            m_stats.sahCost += halfArea(n.lo, n.hi) * scale;
+            stack.add(Vec2i(n.first, item.y + 1));
+            stack.add(Vec2i(n.first + 1, item.y + 1));
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void BVH::tracePacket(const Ray* rays, const S32* index, int num, RayHit* hits, bool* occluded) const
+{
+    // Closest hits into hits[] or occlusion into occluded[], for rays[k] or
+    // rays[index[k]], k < num. Unused lanes get an empty interval.
+
+    FW_ASSERT(num > 0 && num <= BVH_PACKET_SIZE);
+    FW_ASSERT((hits != NULL) != (occluded != NULL));
+    if (isEmpty())
+        return;
+
+    F32 lanes[11][BVH_PACKET_SIZE];
+    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+    {
+        Ray ray(Vec3f(0.0f), Vec3f(0.0f, 0.0f, 1.0f), 1.0f, 0.0f);
+        if (k < num)
+            ray = rays[(index) ? index[k] : k];
+        Vec3f invDir = reciprocal(ray.direction);
+        for (int c = 0; c < 3; c++)
+        {
+            lanes[c][k] = ray.origin[c];
+            lanes[c + 3][k] = ray.direction[c];
+            lanes[c + 6][k] = invDir[c];
+        }
+        lanes[9][k] = ray.tmin;
+        lanes[10][k] = ray.tmax;
+    }
+
+    Packet p;
+    p.ox = vload(lanes[0]), p.oy = vload(lanes[1]), p.oz = vload(lanes[2]);
+    p.dx = vload(lanes[3]), p.dy = vload(lanes[4]), p.dz = vload(lanes[5]);
+    p.ix = vload(lanes[6]), p.iy = vload(lanes[7]), p.iz = vload(lanes[8]);
+    p.tmin = vload(lanes[9]);
+    p.tmax = vload(lanes[10]);
+    p.u = vset1(0.0f);
+    p.v = vset1(0.0f);
+    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+        p.best[k] = FW_S32_MAX;
+
+    // Descend into a node if any ray hits it, nearer child first by a
+    // vote of the rays that hit both. Postponed nodes keep their entry
+    // distances and are skipped once no ray can find a closer hit there.
+
+    int liveMask = (1 << num) - 1;      // Any-hit rays not yet occluded.
+    Vf robust = vset1(BVH_ROBUST);
+    Vf never = vset1(FW_F32_MAX);
+    Vf tEntry;
+    if (!vbits(packetBox(m_nodes[0], p, tEntry)))
+        return;
+
+    S32 stackNode[BVH_STACK_SIZE];
+    Vf stackT[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIdx = 0;
+
+    for (;;)
+    {
+        const Node& n = m_nodes[nodeIdx];
+        if (n.isLeaf())
+        {
+            for (int i = n.first; i < n.first + n.count; i++)
+            {
+                Vf t, u, v;
+                Vb valid = packetTriangle(m_tris[i], p, t, u, v);
+                int validMask = vbits(valid);
+                if (!validMask)
+                    continue;
+
+                if (occluded)
+                {
+                    // Retire occluded rays by emptying their intervals.
+
+                    p.tmin = vselect(valid, never, p.tmin);
+                    for (int k = 0; k < num; k++)
+                        if (validMask & (1 << k))
+                            occluded[(index) ? index[k] : k] = true;
+                    liveMask &= ~validMask;
+                    if (!liveMask)
+                        return;
+                    continue;
+                }
+
+                Vb accept = vand(valid, vlt(t, p.tmax));
+                int tieMask = vbits(vand(valid, veq(t, p.tmax)));
+                if (tieMask)
+                {
+                    U32 ties[BVH_PACKET_SIZE];
+                    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+                        ties[k] = ((tieMask & (1 << k)) && i < p.best[k]) ? ~0u : 0u;
+                    accept = vor(accept, vloadb(ties));
+                }
+
+                int acceptMask = vbits(accept);
+                if (acceptMask)
+                {
+                    p.tmax = vselect(accept, t, p.tmax);
+                    p.u = vselect(accept, u, p.u);
+                    p.v = vselect(accept, v, p.v);
+                    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+                        if (acceptMask & (1 << k))
+                            p.best[k] = i;
+                }
+            }
+        }
+        else
+        {
+            Vf tLeft, tRight;
+            Vb hitLeft = packetBox(m_nodes[n.first], p, tLeft);
+            Vb hitRight = packetBox(m_nodes[n.first + 1], p, tRight);
+            int leftMask = vbits(hitLeft);
+            int rightMask = vbits(hitRight);
+            if (leftMask && rightMask)
+            {
+                int bothMask = leftMask & rightMask;
+                int leftNearer = vbits(vle(tLeft, tRight)) & bothMask;
+                bool leftFirst = (popc8(leftNearer) * 2 >= popc8(bothMask));
+                FW_ASSERT(stackSize < BVH_STACK_SIZE);
+                stackNode[stackSize] = (leftFirst) ? n.first + 1 : n.first;
+                stackT[stackSize++] = (leftFirst) ? vselect(hitRight, tRight, never) : vselect(hitLeft, tLeft, never);
+                nodeIdx = (leftFirst) ? n.first : n.first + 1;
+                continue;
+            }
+            if (leftMask || rightMask)
+            {
+                nodeIdx = (leftMask) ? n.first : n.first + 1;
+                continue;
+            }
+        }
+
+        do
+        {
+            if (!stackSize)
+            {
+                if (hits)
+                {
+                    F32 tOut[BVH_PACKET_SIZE], uOut[BVH_PACKET_SIZE], vOut[BVH_PACKET_SIZE];
+                    vstore(tOut, p.tmax);
+                    vstore(uOut, p.u);
+                    vstore(vOut, p.v);
+                    for (int k = 0; k < num; k++)
+                    {
+                        if (p.best[k] == FW_S32_MAX)
+                            continue;
+                        RayHit& hit = hits[(index) ? index[k] : k];
+                        hit.triangle = m_triIndex[p.best[k]];
+                        hit.t = tOut[k];
+                        hit.u = uOut[k];
+                        hit.v = vOut[k];
+                    }
+                }
+                return;
+            }
+            nodeIdx = stackNode[--stackSize];
+        }
+        while (!vbits(vle(stackT[stackSize], vmul(p.tmax, robust))));
+    }
+}
+
+//------------------------------------------------------------------------
+
+void BVH::closestPointPacket(const Vec3f* points, int num, ClosestPoint* hits, F32 maxDistance) const
+{
+    // Same traversal as closestPoint(), with a node entered if it may hold
+    // a closer point for any lane. Unused lanes search nothing.
+
+    FW_ASSERT(num > 0 && num <= BVH_PACKET_SIZE);
+    if (isEmpty() || !(maxDistance >= 0.0f))
+        return;
+
+    F32 lanes[4][BVH_PACKET_SIZE];
+    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+    {
+        Vec3f p = (k < num) ? points[k] : Vec3f(0.0f);
+        lanes[0][k] = p.x;
+        lanes[1][k] = p.y;
+        lanes[2][k] = p.z;
+        lanes[3][k] = (k < num) ? min(maxDistance * maxDistance, FW_F32_MAX) : -1.0f;
+    }
+
+    PointPacket p;
+    p.px = vload(lanes[0]), p.py = vload(lanes[1]), p.pz = vload(lanes[2]);
+    p.bestSqr = vload(lanes[3]);
+    p.qx = p.qy = p.qz = p.u = p.v = p.feature = vset1(0.0f);
+    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+        p.best[k] = FW_S32_MAX;
+
+    Vf robust = vset1(BVH_ROBUST);
+    Vf never = vset1(FW_F32_MAX);
+    if (!vbits(vle(packetBoxDistanceSqr(m_nodes[0], p), vmul(p.bestSqr, robust))))
+        return;
+
+    S32 stackNode[BVH_STACK_SIZE];
+    Vf stackDist[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIdx = 0;
+
+    for (;;)
+    {
+        const Node& n = m_nodes[nodeIdx];
+        if (n.isLeaf())
+        {
+            for (int i = n.first; i < n.first + n.count; i++)
+            {
+                Vf qx, qy, qz, u, v, feature;
+                Vf distSqr = packetClosestPoint(m_tris[i], p, qx, qy, qz, u, v, feature);
+                Vb accept = vlt(distSqr, p.bestSqr);
+                int tieMask = vbits(veq(distSqr, p.bestSqr));
+                if (tieMask)
+                {
+                    U32 ties[BVH_PACKET_SIZE];
+                    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+                        ties[k] = ((tieMask & (1 << k)) && i < p.best[k]) ? ~0u : 0u;
+                    accept = vor(accept, vloadb(ties));
+                }
+
+                int acceptMask = vbits(accept);
+                if (acceptMask)
+                {
+                    p.bestSqr = vselect(accept, distSqr, p.bestSqr);
+                    p.qx = vselect(accept, qx, p.qx);
+                    p.qy = vselect(accept, qy, p.qy);
+                    p.qz = vselect(accept, qz, p.qz);
+                    p.u = vselect(accept, u, p.u);
+                    p.v = vselect(accept, v, p.v);
+                    p.feature = vselect(accept, feature, p.feature);
+                    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+                        if (acceptMask & (1 << k))
+                            p.best[k] = i;
+                }
+            }
+        }
+        else
+        {
+            Vf limit = vmul(p.bestSqr, robust);
+            Vf dLeft = packetBoxDistanceSqr(m_nodes[n.first], p);
+            Vf dRight = packetBoxDistanceSqr(m_nodes[n.first + 1], p);
+            Vb hitLeft = vle(dLeft, limit);
+            Vb hitRight = vle(dRight, limit);
+            int leftMask = vbits(hitLeft);
+            int rightMask = vbits(hitRight);
+            if (leftMask && rightMask)
+            {
+                int bothMask = leftMask & rightMask;
+                int leftNearer = vbits(vle(dLeft, dRight)) & bothMask;
+                bool leftFirst = (popc8(leftNearer) * 2 >= popc8(bothMask));
+                FW_ASSERT(stackSize < BVH_STACK_SIZE);
+                stackNode[stackSize] = (leftFirst) ? n.first + 1 : n.first;
+                stackDist[stackSize++] = (leftFirst) ? vselect(hitRight, dRight, never) : vselect(hitLeft, dLeft, never);
+                nodeIdx = (leftFirst) ? n.first : n.first + 1;
+                continue;
+            }
+            if (leftMask || rightMask)
+            {
+                nodeIdx = (leftMask) ? n.first : n.first + 1;
+                continue;
+            }
+        }
+
+        do
+        {
+            if (!stackSize)
+            {
+                F32 out[7][BVH_PACKET_SIZE];
+                vstore(out[0], p.bestSqr);
+                vstore(out[1], p.qx);
+                vstore(out[2], p.qy);
+                vstore(out[3], p.qz);
+                vstore(out[4], p.u);
+                vstore(out[5], p.v);
+                vstore(out[6], p.feature);
+                for (int k = 0; k < num; k++)
+                {
+                    if (p.best[k] == FW_S32_MAX)
+                        continue;
+                    ClosestPoint& hit = hits[k];
+                    hit.triangle = m_triIndex[p.best[k]];
+                    hit.distance = sqrt(out[0][k]);
+                    hit.point = Vec3f(out[1][k], out[2][k], out[3][k]);
+                    hit.u = out[4][k];
+                    hit.v = out[5][k];
+                    hit.feature = (S32)out[6][k];
+                }
+                return;
+            }
+            nodeIdx = stackNode[--stackSize];
+        }
+        while (!vbits(vle(stackDist[stackSize], vmul(p.bestSqr, robust))));
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::computeTriBounds(MulticoreLauncher::Task& task)
+{
+    BuildState& s = *(BuildState*)task.data;
+    int end = min((task.idx + 1) * BVH_CHUNK_SIZE, s.numTris);
+
+    for (int i = task.idx * BVH_CHUNK_SIZE; i < end; i++)
+    {
+        const Vec3i& tri = s.tris[i];
+        const Vec3f& a = s.positions[tri.x];
+        const Vec3f& b = s.positions[tri.y];
+        const Vec3f& c = s.positions[tri.z];
+        BuildRef& ref = s.refs[i];
+        for (int j = 0; j < 3; j++)
+        {
+            ref.lo[j] = min(min(a[j], b[j]), c[j]);
+            ref.hi[j] = max(max(a[j], b[j]), c[j]);
+        }
+        ref.tri = i;
+        ref.pad = 0;
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::buildSubtree(MulticoreLauncher::Task& task)
+{
+    BuildTask* job = (BuildTask*)task.data;
+    buildNodes(*job, task.launcher);
+    delete job;
+}
+
+//------------------------------------------------------------------------
+
+void FW::buildNodes(BuildTask job, MulticoreLauncher* launcher)
+{
+    BuildState& s = *job.state;
+
+    // Split one side off at a time and continue with the other; large
+    // ones become tasks, small ones are built right away.
+
+    for (;;)
+    {
+        // Centroids are kept doubled, as lo + hi.
+
+        BuildNode& node = s.nodes[job.node];
+        F32 lo[3] = { +FW_F32_MAX, +FW_F32_MAX, +FW_F32_MAX };
+        F32 hi[3] = { -FW_F32_MAX, -FW_F32_MAX, -FW_F32_MAX };
+        F32 centroidLo[3] = { +FW_F32_MAX, +FW_F32_MAX, +FW_F32_MAX };
+        F32 centroidHi[3] = { -FW_F32_MAX, -FW_F32_MAX, -FW_F32_MAX };
+        for (int i = job.begin; i < job.end; i++)
+        {
+            const BuildRef& ref = s.refs[i];
+            for (int j = 0; j < 3; j++)
+            {
+                F32 c = ref.lo[j] + ref.hi[j];
+                lo[j] = min(lo[j], ref.lo[j]);
+                hi[j] = max(hi[j], ref.hi[j]);
+                centroidLo[j] = min(centroidLo[j], c);
+                centroidHi[j] = max(centroidHi[j], c);
+            }
+        }
+
+        int num = job.end - job.begin;
+        node.lo = Vec3f(lo[0], lo[1], lo[2]);
+        node.hi = Vec3f(hi[0], hi[1], hi[2]);
+        node.left = -1;
+        node.right = -1;
+        node.first = job.begin;
+        node.count = num;
+
+        int mid = -1;
+        if (num > 1)
+            mid = findSplit(s, job, centroidLo, centroidHi, halfArea(lo, hi));
+        if (mid == -1 && num > BVH_MAX_LEAF_SIZE)
+            mid = (job.begin + job.end) >> 1;
+        if (mid == -1)
+            return;
+
+        BuildTask left = job;
+        BuildTask right = job;
+        left.node = job.node + 1;
+        left.end = mid;
+        left.depth = job.depth + 1;
+        right.node = job.node + (mid - job.begin) * 2;
+        right.begin = mid;
+        right.depth = job.depth + 1;
+        node.left = left.node;
+        node.right = right.node;
+
+        if (right.end - right.begin >= BVH_TASK_MIN)
+            launcher->push(buildSubtree, new BuildTask(right));
+        else
+            buildNodes(right, launcher);
+        job = left;
+    }
+}
+
+//------------------------------------------------------------------------
+
+int FW::findSplit(BuildState& s, const BuildTask& job, const F32* centroidLo, const F32* centroidHi, F32 area)
+{
+    int num = job.end - job.begin;
+    F32 extent[3] = { centroidHi[0] - centroidLo[0], centroidHi[1] - centroidLo[1], centroidHi[2] - centroidLo[2] };
+    if (job.depth >= BVH_MAX_DEPTH || max(max(extent[0], extent[1]), extent[2]) <= 0.0f)
+        return -1;
+
+    // Bin the centroids along each axis.
+
+    F32 scale[3];
+    for (int i = 0; i < 3; i++)
+        scale[i] = (extent[i] > 0.0f) ? (F32)BVH_NUM_BINS * 0.9999f / extent[i] : 0.0f;
+
+    S32 binCount[3][BVH_NUM_BINS];
+    F32 binLo[3][BVH_NUM_BINS][3];
+    F32 binHi[3][BVH_NUM_BINS][3];
+    for (int i = 0; i < 3; i++)
+    for (int j = 0; j < BVH_NUM_BINS; j++)
+    {
+        binCount[i][j] = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            binLo[i][j][k] = +FW_F32_MAX;
+            binHi[i][j][k] = -FW_F32_MAX;
+        }
+    }
+
+    for (int i = job.begin; i < job.end; i++)
+    {
+        const BuildRef& ref = s.refs[i];
+        for (int j = 0; j < 3; j++)
+        {
+            int bin = (int)((ref.lo[j] + ref.hi[j] - centroidLo[j]) * scale[j]);
+            F32* lo = binLo[j][bin];
+            F32* hi = binHi[j][bin];
+            binCount[j][bin]++;
+            lo[0] = min(lo[0], ref.lo[0]); hi[0] = max(hi[0], ref.hi[0]);
+            lo[1] = min(lo[1], ref.lo[1]); hi[1] = max(hi[1], ref.hi[1]);
+            lo[2] = min(lo[2], ref.lo[2]); hi[2] = max(hi[2], ref.hi[2]);
+        }
+    }
+
+    // Sweep both ways and pick the cheapest plane. A node test costs as
+    // much as a triangle test.
+
+    F32 bestCost = (num <= BVH_MAX_LEAF_SIZE) ? (F32)num : FW_F32_MAX;
+    int bestAxis = -1;
+    int bestBin = -1;
+    F32 invArea = (area > 0.0f) ? 1.0f / area : 0.0f;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (extent[axis] <= 0.0f)
+            continue;
+
+        F32 rightArea[BVH_NUM_BINS];
+        S32 rightCount[BVH_NUM_BINS];
+        F32 lo[3] = { +FW_F32_MAX, +FW_F32_MAX, +FW_F32_MAX };
+        F32 hi[3] = { -FW_F32_MAX, -FW_F32_MAX, -FW_F32_MAX };
+        int count = 0;
+        for (int j = BVH_NUM_BINS - 1; j > 0; j--)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                lo[k] = min(lo[k], binLo[axis][j][k]);
+                hi[k] = max(hi[k], binHi[axis][j][k]);
+            }
+            count += binCount[axis][j];
+            rightArea[j] = (count) ? halfArea(lo, hi) : 0.0f;
+            rightCount[j] = count;
+        }
+
+        for (int k = 0; k < 3; k++)
+        {
+            lo[k] = +FW_F32_MAX;
+            hi[k] = -FW_F32_MAX;
+        }
+        count = 0;
+        for (int j = 1; j < BVH_NUM_BINS; j++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                lo[k] = min(lo[k], binLo[axis][j - 1][k]);
+                hi[k] = max(hi[k], binHi[axis][j - 1][k]);
+            }
+            count += binCount[axis][j - 1];
+            if (!count || !rightCount[j])
+                continue;
+
+            F32 cost = 1.0f + (halfArea(lo, hi) * (F32)count + rightArea[j] * (F32)rightCount[j]) * invArea;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = j;
+            }
+        }
+    }
+
+    if (bestAxis == -1)
+        return -1;
+
+    // Partition.
+
+    BuildRef* refs = s.refs.getPtr();
+    F32 splitLo = centroidLo[bestAxis];
+    F32 splitScale = scale[bestAxis];
+    int i = job.begin;
+    int j = job.end - 1;
+    for (;;)
+    {
+        while (i <= j && (int)((refs[i].lo[bestAxis] + refs[i].hi[bestAxis] - splitLo) * splitScale) < bestBin)
+            i++;
+        while (i <= j && (int)((refs[j].lo[bestAxis] + refs[j].hi[bestAxis] - splitLo) * splitScale) >= bestBin)
+            j--;
+        if (i >= j)
+            break;
+        nvswap(refs[i], refs[j]);
+    }
+    return (i > job.begin && i < job.end) ? i : -1;
+}
+
+//------------------------------------------------------------------------
+
+F32 FW::halfArea(const Vec3f& lo, const Vec3f& hi)
+{
+    return halfArea(lo.getPtr(), hi.getPtr());
+}
+
+//------------------------------------------------------------------------
+
+F32 FW::halfArea(const F32* lo, const F32* hi)
+{
+    F32 dx = hi[0] - lo[0];
+    F32 dy = hi[1] - lo[1];
+    F32 dz = hi[2] - lo[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+//------------------------------------------------------------------------
+
+bool FW::intersectBox(const BVH::Node& node, const Vec3f& origin, const Vec3f& invDir, F32 tmin, F32 tmax, F32& tEntry)
+{
+    F32 x0 = (node.lo.x - origin.x) * invDir.x, x1 = (node.hi.x - origin.x) * invDir.x;
+    F32 y0 = (node.lo.y - origin.y) * invDir.y, y1 = (node.hi.y - origin.y) * invDir.y;
+    F32 z0 = (node.lo.z - origin.z) * invDir.z, z1 = (node.hi.z - origin.z) * invDir.z;
+    F32 t0 = max(max(min(x0, x1), min(y0, y1)), max(min(z0, z1), tmin));
+    F32 t1 = min(min(max(x0, x1), max(y0, y1)), min(max(z0, z1), tmax));
+    tEntry = t0;
+    return (t0 <= t1 * BVH_ROBUST);
+}
+
+//------------------------------------------------------------------------
+
+bool FW::intersectTriangle(const BVH::Triangle& tri, const Ray& ray, F32 tmax, F32& t, F32& u, F32& v)
+{
+    // Moeller-Trumbore, two-sided. Spelled out in the same order of
+    // operations as packetTriangle().
+
+    const Vec3f& d = ray.direction;
+    const Vec3f& e1 = tri.e1;
+    const Vec3f& e2 = tri.e2;
+    F32 px = d.y * e2.z - d.z * e2.y;
+    F32 py = d.z * e2.x - d.x * e2.z;
+    F32 pz = d.x * e2.y - d.y * e2.x;
+    F32 det = e1.x * px + e1.y * py + e1.z * pz;
+    if (!(det != 0.0f))
+        return false;
+
+    F32 invDet = 1.0f / det;
+    F32 sx = ray.origin.x - tri.v0.x;
+    F32 sy = ray.origin.y - tri.v0.y;
+    F32 sz = ray.origin.z - tri.v0.z;
+    u = (sx * px + sy * py + sz * pz) * invDet;
+    if (!(u >= 0.0f && u <= 1.0f))
+        return false;
+
+    F32 qx = sy * e1.z - sz * e1.y;
+    F32 qy = sz * e1.x - sx * e1.z;
+    F32 qz = sx * e1.y - sy * e1.x;
+    v = (d.x * qx + d.y * qy + d.z * qz) * invDet;
+    if (!(v >= 0.0f && u + v <= 1.0f))
+        return false;
+
+    t = (e2.x * qx + e2.y * qy + e2.z * qz) * invDet;
+    return (t >= ray.tmin && t <= tmax);
+}
+
+//------------------------------------------------------------------------
+
+bool FW::triangleOverlapsBox(const BVH::Triangle& tri, const Vec3f& center, const Vec3f& half)
+{
+    // Separating axes (Akenine-Moeller 2001): the box faces, the triangle
+    // plane, and the cross products of the edges with the box axes.
+
+    Vec3f v[3] = { tri.v0 - center, tri.v0 + tri.e1 - center, tri.v0 + tri.e2 - center };
+    for (int i = 0; i < 3; i++)
+        if (min(min(v[0][i], v[1][i]), v[2][i]) > half[i] || max(max(v[0][i], v[1][i]), v[2][i]) < -half[i])
+            return false;
+
+    Vec3f n = cross(tri.e1, tri.e2);
+    if (abs(dot(n, v[0])) > dot(half, abs(n)))
+        return false;
+
+    Vec3f edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+    for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+    {
+        Vec3f unit(0.0f);
+        unit[j] = 1.0f;
+        Vec3f axis = cross(unit, edges[i]);
+        F32 p0 = dot(axis, v[0]);
+        F32 p1 = dot(axis, v[1]);
+        F32 p2 = dot(axis, v[2]);
+        F32 r = dot(half, abs(axis));
+        if (min(min(p0, p1), p2) > r || max(max(p0, p1), p2) < -r)
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+Vec3f FW::closestPointOnTriangle(const Vec3f& p, const BVH::Triangle& tri, F32& u, F32& v, S32& feature)
+{
+    // Voronoi regions of the vertices, edges and face (Ericson 2005),
+    // spelled out in scalars for the sake of the inner loops.
+
+    const Vec3f& a = tri.v0;
+    const Vec3f& ab = tri.e1;
+    const Vec3f& ac = tri.e2;
+    F32 apx = p.x - a.x, apy = p.y - a.y, apz = p.z - a.z;
+    F32 d1 = ab.x * apx + ab.y * apy + ab.z * apz;
+    F32 d2 = ac.x * apx + ac.y * apy + ac.z * apz;
+    if (d1 <= 0.0f && d2 <= 0.0f)
+    {
+        u = 0.0f, v = 0.0f, feature = 1;
+        return a;
+    }
+
+    F32 abab = ab.x * ab.x + ab.y * ab.y + ab.z * ab.z;
+    F32 abac = ab.x * ac.x + ab.y * ac.y + ab.z * ac.z;
+    F32 acac = ac.x * ac.x + ac.y * ac.y + ac.z * ac.z;
+    F32 d3 = d1 - abab;                     // dot(ab, p - b)
+    F32 d4 = d2 - abac;                     // dot(ac, p - b)
+    if (d3 >= 0.0f && d4 <= d3)
+    {
+        u = 1.0f, v = 0.0f, feature = 2;
+        return a + ab;
+    }
+
+    F32 vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        u = d1 / (d1 - d3), v = 0.0f, feature = 4;
+        return Vec3f(a.x + ab.x * u, a.y + ab.y * u, a.z + ab.z * u);
+    }
+
+    F32 d5 = d1 - abac;                     // dot(ab, p - c)
+    F32 d6 = d2 - acac;                     // dot(ac, p - c)
+    if (d6 >= 0.0f && d5 <= d6)
+    {
+        u = 0.0f, v = 1.0f, feature = 3;
+        return a + ac;
+    }
+
+    F32 vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        u = 0.0f, v = d2 / (d2 - d6), feature = 6;
+        return Vec3f(a.x + ac.x * v, a.y + ac.y * v, a.z + ac.z * v);
+    }
+
+    F32 va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+    {
+        F32 w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        u = 1.0f - w, v = w, feature = 5;
+        return Vec3f(a.x + ab.x + (ac.x - ab.x) * w, a.y + ab.y + (ac.y - ab.y) * w, a.z + ab.z + (ac.z - ab.z) * w);
+    }
+
+    F32 denom = va + vb + vc;
+    if (denom == 0.0f)
+    {
+        u = 0.0f, v = 0.0f, feature = 1;
+        return a;
+    }
+    u = vb / denom, v = vc / denom, feature = 0;
+    return Vec3f(a.x + ab.x * u + ac.x * v, a.y + ab.y * u + ac.y * v, a.z + ab.z * u + ac.z * v);
+}
+
+//------------------------------------------------------------------------
+
+F32 FW::boxDistanceSqr(const BVH::Node& node, const Vec3f& p)
+{
+    F32 dx = max(max(node.lo.x - p.x, p.x - node.hi.x), 0.0f);
+    F32 dy = max(max(node.lo.y - p.y, p.y - node.hi.y), 0.0f);
+    F32 dz = max(max(node.lo.z - p.z, p.z - node.hi.z), 0.0f);
+    return dx * dx + dy * dy + dz * dz;
+}
+
+//------------------------------------------------------------------------
+
+Vec3f FW::reciprocal(const Vec3f& dir)
+{
+    // Keep zero components finite so that the slab test never computes
+    // 0 * inf.
+
+    Vec3f inv;
+    for (int i = 0; i < 3; i++)
+        inv[i] = 1.0f / ((abs(dir[i]) > 1.0e-30f) ? dir[i] : (dir[i] >= 0.0f) ? 1.0e-30f : -1.0e-30f);
+    return inv;
+}
+
+//------------------------------------------------------------------------
+
+Vb FW::packetBox(const BVH::Node& node, const Packet& p, Vf& tEntry)
+{
+    // Same as intersectBox(), one ray per lane.
+
+    Vf x0 = vmul(vsub(vset1(node.lo.x), p.ox), p.ix), x1 = vmul(vsub(vset1(node.hi.x), p.ox), p.ix);
+    Vf y0 = vmul(vsub(vset1(node.lo.y), p.oy), p.iy), y1 = vmul(vsub(vset1(node.hi.y), p.oy), p.iy);
+    Vf z0 = vmul(vsub(vset1(node.lo.z), p.oz), p.iz), z1 = vmul(vsub(vset1(node.hi.z), p.oz), p.iz);
+    Vf t0 = vmax(vmax(vmin(x0, x1), vmin(y0, y1)), vmax(vmin(z0, z1), p.tmin));
+    Vf t1 = vmin(vmin(vmax(x0, x1), vmax(y0, y1)), vmin(vmax(z0, z1), p.tmax));
+    tEntry = t0;
+    return vle(t0, vmul(t1, vset1(BVH_ROBUST)));
+}
+
+//------------------------------------------------------------------------
+
+Vb FW::packetTriangle(const BVH::Triangle& tri, const Packet& p, Vf& t, Vf& u, Vf& v)
+{
+    // Same as intersectTriangle(), one ray per lane, without early outs.
+
+    Vf e1x = vset1(tri.e1.x), e1y = vset1(tri.e1.y), e1z = vset1(tri.e1.z);
+    Vf e2x = vset1(tri.e2.x), e2y = vset1(tri.e2.y), e2z = vset1(tri.e2.z);
+    Vf px = vsub(vmul(p.dy, e2z), vmul(p.dz, e2y));
+    Vf py = vsub(vmul(p.dz, e2x), vmul(p.dx, e2z));
+    Vf pz = vsub(vmul(p.dx, e2y), vmul(p.dy, e2x));
+    Vf det = vadd(vadd(vmul(e1x, px), vmul(e1y, py)), vmul(e1z, pz));
+
+    Vf zero = vset1(0.0f);
+    Vf one = vset1(1.0f);
+    Vf invDet = vdiv(one, det);
+    Vf sx = vsub(p.ox, vset1(tri.v0.x));
+    Vf sy = vsub(p.oy, vset1(tri.v0.y));
+    Vf sz = vsub(p.oz, vset1(tri.v0.z));
+    u = vmul(vadd(vadd(vmul(sx, px), vmul(sy, py)), vmul(sz, pz)), invDet);
+
+    Vf qx = vsub(vmul(sy, e1z), vmul(sz, e1y));
+    Vf qy = vsub(vmul(sz, e1x), vmul(sx, e1z));
+    Vf qz = vsub(vmul(sx, e1y), vmul(sy, e1x));
+    v = vmul(vadd(vadd(vmul(p.dx, qx), vmul(p.dy, qy)), vmul(p.dz, qz)), invDet);
+    t = vmul(vadd(vadd(vmul(e2x, qx), vmul(e2y, qy)), vmul(e2z, qz)), invDet);
+
+    Vb valid = vand(vneq(det, zero), vand(vle(zero, u), vle(u, one)));
+    valid = vand(valid, vand(vle(zero, v), vle(vadd(u, v), one)));
+    return vand(valid, vand(vle(p.tmin, t), vle(t, p.tmax)));
+}
+
+//------------------------------------------------------------------------
+
+Vf FW::packetBoxDistanceSqr(const BVH::Node& node, const PointPacket& p)
+{
+    // Same as boxDistanceSqr(), one point per lane.
+
+    Vf zero = vset1(0.0f);
+    Vf dx = vmax(vmax(vsub(vset1(node.lo.x), p.px), vsub(p.px, vset1(node.hi.x))), zero);
+    Vf dy = vmax(vmax(vsub(vset1(node.lo.y), p.py), vsub(p.py, vset1(node.hi.y))), zero);
+    Vf dz = vmax(vmax(vsub(vset1(node.lo.z), p.pz), vsub(p.pz, vset1(node.hi.z))), zero);
+    return vadd(vadd(vmul(dx, dx), vmul(dy, dy)), vmul(dz, dz));
+}
+
+//------------------------------------------------------------------------
+
+Vf FW::packetClosestPoint(const BVH::Triangle& tri, const PointPacket& p, Vf& qx, Vf& qy, Vf& qz, Vf& u, Vf& v, Vf& feature)
+{
+    // Same as closestPointOnTriangle(), one point per lane: every region
+    // is evaluated, and the first that applies in the scalar order wins.
+    // Returns the squared distance.
+
+    Vf ax = vset1(tri.v0.x), ay = vset1(tri.v0.y), az = vset1(tri.v0.z);
+    Vf bx = vset1(tri.e1.x), by = vset1(tri.e1.y), bz = vset1(tri.e1.z);
+    Vf cx = vset1(tri.e2.x), cy = vset1(tri.e2.y), cz = vset1(tri.e2.z);
+    Vf apx = vsub(p.px, ax), apy = vsub(p.py, ay), apz = vsub(p.pz, az);
+    Vf d1 = vadd(vadd(vmul(bx, apx), vmul(by, apy)), vmul(bz, apz));
+    Vf d2 = vadd(vadd(vmul(cx, apx), vmul(cy, apy)), vmul(cz, apz));
+
+    const Vec3f& ab = tri.e1;
+    const Vec3f& ac = tri.e2;
+    Vf abab = vset1(ab.x * ab.x + ab.y * ab.y + ab.z * ab.z);
+    Vf abac = vset1(ab.x * ac.x + ab.y * ac.y + ab.z * ac.z);
+    Vf acac = vset1(ac.x * ac.x + ac.y * ac.y + ac.z * ac.z);
+    Vf d3 = vsub(d1, abab);
+    Vf d4 = vsub(d2, abac);
+    Vf d5 = vsub(d1, abac);
+    Vf d6 = vsub(d2, acac);
+    Vf va = vsub(vmul(d3, d6), vmul(d5, d4));
+    Vf vb = vsub(vmul(d5, d2), vmul(d1, d6));
+    Vf vc = vsub(vmul(d1, d4), vmul(d3, d2));
+    Vf d43 = vsub(d4, d3);
+    Vf d56 = vsub(d5, d6);
+    Vf zero = vset1(0.0f);
+    Vf one = vset1(1.0f);
+
+    // Interior.
+
+    Vf denom = vadd(vadd(va, vb), vc);
+    u = vdiv(vb, denom);
+    v = vdiv(vc, denom);
+    qx = vadd(vadd(ax, vmul(bx, u)), vmul(cx, v));
+    qy = vadd(vadd(ay, vmul(by, u)), vmul(cy, v));
+    qz = vadd(vadd(az, vmul(bz, u)), vmul(cz, v));
+    feature = zero;
+
+    // Regions from the last to the first.
+
+    Vb m = veq(denom, zero);
+    qx = vselect(m, ax, qx), qy = vselect(m, ay, qy), qz = vselect(m, az, qz);
+    u = vselect(m, zero, u), v = vselect(m, zero, v), feature = vselect(m, one, feature);
+
+    m = vand(vle(va, zero), vand(vle(zero, d43), vle(zero, d56)));
+    Vf w = vdiv(d43, vadd(d43, d56));
+    qx = vselect(m, vadd(vadd(ax, bx), vmul(vsub(cx, bx), w)), qx);
+    qy = vselect(m, vadd(vadd(ay, by), vmul(vsub(cy, by), w)), qy);
+    qz = vselect(m, vadd(vadd(az, bz), vmul(vsub(cz, bz), w)), qz);
+    u = vselect(m, vsub(one, w), u), v = vselect(m, w, v), feature = vselect(m, vset1(5.0f), feature);
+
+    m = vand(vle(vb, zero), vand(vle(zero, d2), vle(d6, zero)));
+    Vf t = vdiv(d2, vsub(d2, d6));
+    qx = vselect(m, vadd(ax, vmul(cx, t)), qx);
+    qy = vselect(m, vadd(ay, vmul(cy, t)), qy);
+    qz = vselect(m, vadd(az, vmul(cz, t)), qz);
+    u = vselect(m, zero, u), v = vselect(m, t, v), feature = vselect(m, vset1(6.0f), feature);
+
+    m = vand(vle(zero, d6), vle(d5, d6));
+    qx = vselect(m, vadd(ax, cx), qx), qy = vselect(m, vadd(ay, cy), qy), qz = vselect(m, vadd(az, cz), qz);
+    u = vselect(m, zero, u), v = vselect(m, one, v), feature = vselect(m, vset1(3.0f), feature);
+
+    m = vand(vle(vc, zero), vand(vle(zero, d1), vle(d3, zero)));
+    t = vdiv(d1, vsub(d1, d3));
+    qx = vselect(m, vadd(ax, vmul(bx, t)), qx);
+    qy = vselect(m, vadd(ay, vmul(by, t)), qy);
+    qz = vselect(m, vadd(az, vmul(bz, t)), qz);
+    u = vselect(m, t, u), v = vselect(m, zero, v), feature = vselect(m, vset1(4.0f), feature);
+
+    m = vand(vle(zero, d3), vle(d4, d3));
+    qx = vselect(m, vadd(ax, bx), qx), qy = vselect(m, vadd(ay, by), qy), qz = vselect(m, vadd(az, bz), qz);
+    u = vselect(m, one, u), v = vselect(m, zero, v), feature = vselect(m, vset1(2.0f), feature);
+
+    m = vand(vle(d1, zero), vle(d2, zero));
+    qx = vselect(m, ax, qx), qy = vselect(m, ay, qy), qz = vselect(m, az, qz);
+    u = vselect(m, zero, u), v = vselect(m, zero, v), feature = vselect(m, one, feature);
+
+    Vf dx = vsub(qx, p.px), dy = vsub(qy, p.py), dz = vsub(qz, p.pz);
+    return vadd(vadd(vmul(dx, dx), vmul(dy, dy)), vmul(dz, dz));
+}
+
+//------------------------------------------------------------------------
+
+U32 FW::streamKey(const Ray& ray, const Vec3f& lo, const Vec3f& scale)
+{
+    // Direction octant in the top bits, then the origin on a Morton curve
+    // over the root bounds.
+
+    U32 key = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        F32 cell = clamp((ray.origin[i] - lo[i]) * scale[i], 0.0f, (F32)((1 << BVH_STREAM_BITS) - 1));
+        U32 bits = (U32)cell;
+        for (int b = 0; b < BVH_STREAM_BITS; b++)
+            key |= ((bits >> b) & 1) << (b * 3 + i);
+        key |= ((ray.direction[i] < 0.0f) ? 0u : 1u) << (BVH_STREAM_BITS * 3 + i);
+    }
+    return key;
+}
+
+//------------------------------------------------------------------------
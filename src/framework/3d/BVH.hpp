@@ -0,0 +1,195 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include "3d/Mesh.hpp"
+
+namespace FW
+{
+//------------------------------------------------------------------------
+// Bounding volume hierarchy over the triangles of a mesh.
+//
+// The build bins triangle centroids into 16 slots per axis and splits
+// where the surface area heuristic is lowest (Wald 2007). Subtrees of more
+// than a few thousand triangles are built as separate tasks on the thread
+// pool. Each subtree writes into a node range reserved from its triangle
+// count, so the result does not depend on scheduling; a final pass packs
+// the nodes depth-first with siblings adjacent.
+//
+// Triangles are copied into leaf order as (v0, v1 - v0, v2 - v0), so a
+// leaf is one contiguous run of memory. Queries report triangles by their
+// index in the mesh: submesh 0 first, then submesh 1, and so on, see
+// locate(). The hierarchy is a snapshot; rebuild it after editing the
+// mesh.
+//
+// Batches of rays can also be traced as packets of packetWidth() rays
+// (8 with AVX, 4 with SSE) that walk the tree together, either in the
+// order given or after sorting the batch by direction octant and origin.
+// Every mode, the plain C++ build included, returns exactly the same hits
+// as the single-ray calls: the closest hit wins, ties go to the triangle
+// that comes first in leaf order, and box tests are padded by a few ulps
+// so that no order of traversal can cull the winner.
+//------------------------------------------------------------------------
+
+struct Ray
+{
+    Vec3f               origin;
+    F32                 tmin;
+    Vec3f               direction;          // Need not be normalized; t is in units of its length.
+    F32                 tmax;
+
+                        Ray                 (void)                          : origin(0.0f), tmin(0.0f), direction(0.0f, 0.0f, 1.0f), tmax(FW_F32_MAX) {}
+                        Ray                 (const Vec3f& o, const Vec3f& d, F32 t0 = 0.0f, F32 t1 = FW_F32_MAX) : origin(o), tmin(t0), direction(d), tmax(t1) {}
+};
+
+struct RayHit
+{
+    S32                 triangle;           // -1 if none.
+    F32                 t;
+    F32                 u;                  // Barycentrics of v1 and v2.
+    F32                 v;
+
+                        RayHit              (void)                          : triangle(-1), t(FW_F32_MAX), u(0.0f), v(0.0f) {}
+};
+
+struct ClosestPoint
+{
+    S32                 triangle;           // -1 if none.
+    F32                 distance;
+    Vec3f               point;
+    F32                 u;                  // Barycentrics of v1 and v2.
+    F32                 v;
+    S32                 feature;            // Part of the triangle 'point' lies on: 0 for the interior, 1-3 for v0-v2, 4-6 for edges v0v1, v1v2, v2v0.
+
+                        ClosestPoint        (void)                          : triangle(-1), distance(FW_F32_MAX), point(0.0f), u(0.0f), v(0.0f), feature(0) {}
+};
+
+//------------------------------------------------------------------------
+
+class BVH
+{
+public:
+    struct Node                             // 32 bytes.
+    {
+        Vec3f           lo;
+        S32             first;              // Inner: left child, the right one follows it. Leaf: first triangle.
+        Vec3f           hi;
+        S32             count;              // Triangles; 0 for inner nodes.
+
+        bool            isLeaf              (void) const                    { return (count != 0); }
+    };
+
+    struct Triangle                         // In leaf order.
+    {
+        Vec3f           v0;
+        Vec3f           e1;                 // v1 - v0
+        Vec3f           e2;                 // v2 - v0
+    };
+
+    enum TraceMode
+    {
+        TraceMode_Single = 0,               // One ray at a time.
+        TraceMode_Packet,                   // Consecutive groups of packetWidth() rays; best for coherent batches.
+        TraceMode_Stream,                   // Sorted by direction octant and then origin, then traced as packets.
+
+        TraceMode_Max
+    };
+
+    struct BuildStats
+    {
+        S32             numNodes;
+        S32             numLeaves;
+        S32             maxDepth;
+        F32             sahCost;            // Expected cost of a random ray, in triangle tests, with a node test as 1.
+        F32             seconds;
+    };
+
+public:
+                        BVH                 (void)                          { m_stats = BuildStats(); }
+                        BVH                 (const MeshBase& mesh)          { build(mesh); }
+                        ~BVH                (void)                          {}
+
+    void                build               (const MeshBase& mesh);
+    void                build               (const Vec3f* positions, const Vec3i* tris, int numTris);
+    void                clear               (void);
+
+    // Closest hit in [tmin, tmax]. Returns false and leaves 'hit' alone
+    // if there is none.
+    bool                intersect           (const Ray& ray, RayHit& hit) const;
+    // Any hit in [tmin, tmax], for shadow and occlusion rays.
+    bool                intersectAny        (const Ray& ray) const;
+    // Batched versions; 'hits' is reset for rays that miss. Return the
+    // number of rays that hit something.
+    int                 intersect           (const Ray* rays, RayHit* hits, int numRays, TraceMode mode = TraceMode_Stream) const;
+    int                 intersectAny        (const Ray* rays, bool* occluded, int numRays, TraceMode mode = TraceMode_Stream) const;
+    static int          packetWidth         (void);
+    static const char*  getTraceModeName    (TraceMode mode);
+
+    // Nearest point on the mesh within 'maxDistance' of 'p'. Returns false
+    // and leaves 'hit' alone if there is none. Ties go to the triangle first
+    // in leaf order.
+    bool                closestPoint        (const Vec3f& p, ClosestPoint& hit, F32 maxDistance = FW_F32_MAX) const;
+    // Batched version; 'hits' is reset for points with nothing in range.
+    // With 'packets', consecutive groups of packetWidth() points are
+    // searched together, which pays off for nearby points. Returns the
+    // number of points with a hit; either way the hits equal those of
+    // closestPoint().
+    int                 closestPoints       (const Vec3f* points, ClosestPoint* hits, int numPoints, F32 maxDistance = FW_F32_MAX, bool packets = true) const;
+
+    // Append the triangles that touch the box or sphere to 'tris'.
+    void                overlapBox          (const Vec3f& lo, const Vec3f& hi, Array<S32>& tris) const;
+    void                overlapSphere       (const Vec3f& center, F32 radius, Array<S32>& tris) const;
+
+    bool                isEmpty             (void) const                    { return (m_nodes.getSize() == 0); }
+    int                 numNodes            (void) const                    { return m_nodes.getSize(); }
+    const Node&         node                (int idx) const                 { return m_nodes[idx]; }
+    int                 numTriangles        (void) const                    { return m_tris.getSize(); }
+    const Triangle&     leafTriangle        (int idx) const                 { return m_tris[idx]; }   // By leaf order.
+    int                 leafTriangleIndex   (int idx) const                 { return m_triIndex[idx]; }
+    Vec2i               locate              (int triangle) const;            // (submesh, index within the submesh)
+    const BuildStats&   getStats            (void) const                    { return m_stats; }
+
+private:
+    void                computeStats        (void);
+    void                sortStream          (const Ray* rays, int numRays, Array<S32>& order) const;
+    void                tracePacket         (const Ray* rays, const S32* index, int num, RayHit* hits, bool* occluded) const;
+    void                closestPointPacket  (const Vec3f* points, int num, ClosestPoint* hits, F32 maxDistance) const;
+
+private:
+                        BVH                 (const BVH&); // forbidden
+    BVH&                operator=           (const BVH&); // forbidden
+
+private:
+    Array<Node>         m_nodes;            // Root first.
+    Array<Triangle>     m_tris;
+    Array<S32>          m_triIndex;         // [leaf order] Mesh triangle.
+    Array<S32>          m_submeshStart;     // [submesh + 1] First mesh triangle.
+    BuildStats          m_stats;
+};
+
+//------------------------------------------------------------------------
+}
@@ -0,0 +1,291 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "3d/DistanceField.hpp"
+#include "base/Hash.hpp"
+#include "base/MulticoreLauncher.hpp"
+#include "io/File.hpp"
+
+using namespace FW;
+
+//------------------------------------------------------------------------
+
+#define SDF_BOUND_SLACK     1.001f          // Grows the search bound from the previous voxel, for rounding.
+#define SDF_MAX_PACKET      8               // Upper limit of BVH::packetWidth().
+
+//------------------------------------------------------------------------
+
+namespace FW
+{
+
+struct SliceState
+{
+    const DistanceField*    field;
+    F32*                    voxels;
+};
+
+static void     bakeSlice           (MulticoreLauncher::Task& task);
+static F32      cornerAngle         (const Vec3f& a, const Vec3f& b, const Vec3f& c);
+
+}
+
+//------------------------------------------------------------------------
+
+void DistanceField::init(const MeshBase& mesh)
+{
+    m_bvh.build(mesh);
+    m_tris.reset();
+    m_faceNormals.reset();
+    m_edgeNormals.reset();
+    m_vertexNormals.reset();
+    m_resolution = 0;
+    m_lo = 0.0f;
+    m_hi = 0.0f;
+    m_voxels.reset();
+
+    int posAttrib = mesh.findAttrib(MeshBase::AttribType_Position);
+    if (posAttrib == -1)
+        return;
+
+    // Weld vertices by position.
+
+    AttribView<const Vec3f> posView = mesh.getAttribView<Vec3f>(posAttrib);
+    Hash<Vec3f, S32> weldHash;
+    Array<Vec3f> positions;
+    Array<S32> weld(NULL, mesh.numVertices());
+    for (int i = 0; i < mesh.numVertices(); i++)
+    {
+        Vec3f p = (posView.isValid()) ? posView[i] : mesh.getVertexAttrib(i, posAttrib).getXYZ();
+        S32* found = weldHash.search(p);
+        if (found)
+            weld[i] = *found;
+        else
+        {
+            weld[i] = positions.getSize();
+            weldHash.add(p, weld[i]);
+            positions.add(p);
+        }
+    }
+
+    m_tris.setCapacity(mesh.numTriangles());
+    for (int i = 0; i < mesh.numSubmeshes(); i++)
+    {
+        const Array<Vec3i>& tris = mesh.indices(i);
+        for (int j = 0; j < tris.getSize(); j++)
+            m_tris.add(Vec3i(weld[tris[j].x], weld[tris[j].y], weld[tris[j].z]));
+    }
+
+    // Face normals, and their sums around welded vertices (weighted by the
+    // corner angle) and over welded edges.
+
+    int numTris = m_tris.getSize();
+    m_faceNormals.reset(numTris);
+    m_edgeNormals.reset(numTris * 3);
+    m_vertexNormals.reset(positions.getSize());
+    for (int i = 0; i < positions.getSize(); i++)
+        m_vertexNormals[i] = Vec3f(0.0f);
+
+    Hash<Vec2i, Vec3f> edgeHash;
+    for (int i = 0; i < numTris; i++)
+    {
+        const Vec3i& tri = m_tris[i];
+        Vec3f n = cross(positions[tri.y] - positions[tri.x], positions[tri.z] - positions[tri.x]);
+        F32 len = n.length();
+        n = (len > 0.0f) ? n / len : Vec3f(0.0f);
+        m_faceNormals[i] = n;
+
+        for (int k = 0; k < 3; k++)
+        {
+            int a = tri[k];
+            int b = tri[(k + 1) % 3];
+            int c = tri[(k + 2) % 3];
+            m_vertexNormals[a] += n * cornerAngle(positions[a], positions[b], positions[c]);
+
+            Vec2i edge(min(a, b), max(a, b));
+            Vec3f* sum = edgeHash.search(edge);
+            if (sum)
+                *sum += n;
+            else
+                edgeHash.add(edge, n);
+        }
+    }
+
+    for (int i = 0; i < numTris; i++)
+        for (int k = 0; k < 3; k++)
+        {
+            int a = m_tris[i][k];
+            int b = m_tris[i][(k + 1) % 3];
+            m_edgeNormals[i * 3 + k] = edgeHash.get(Vec2i(min(a, b), max(a, b)));
+        }
+}
+
+//------------------------------------------------------------------------
+
+F32 DistanceField::signedDistance(const Vec3f& p, const ClosestPoint& hit) const
+{
+    FW_ASSERT(hit.triangle >= 0 && hit.triangle < m_tris.getSize());
+    FW_ASSERT(hit.feature >= 0 && hit.feature <= 6);
+
+    Vec3f n;
+    if (hit.feature == 0)
+        n = m_faceNormals[hit.triangle];
+    else if (hit.feature <= 3)
+        n = m_vertexNormals[m_tris[hit.triangle][hit.feature - 1]];
+    else
+        n = m_edgeNormals[hit.triangle * 3 + hit.feature - 4];
+    return (dot(p - hit.point, n) < 0.0f) ? -hit.distance : hit.distance;
+}
+
+//------------------------------------------------------------------------
+
+F32 DistanceField::signedDistance(const Vec3f& p) const
+{
+    ClosestPoint hit;
+    if (!closestPoint(p, hit))
+        return FW_F32_MAX;
+    return signedDistance(p, hit);
+}
+
+//------------------------------------------------------------------------
+
+void DistanceField::bake(const Vec3i& resolution, F32 padding)
+{
+    Vec3f lo(0.0f), hi(0.0f);
+    if (!m_bvh.isEmpty())
+    {
+        lo = m_bvh.node(0).lo;
+        hi = m_bvh.node(0).hi;
+    }
+    Vec3f pad((hi - lo).max() * padding);
+    bake(lo - pad, hi + pad, resolution);
+}
+
+//------------------------------------------------------------------------
+
+void DistanceField::bake(const Vec3f& lo, const Vec3f& hi, const Vec3i& resolution)
+{
+    FW_ASSERT(resolution.min() >= 0);
+
+    m_resolution = resolution;
+    m_lo = lo;
+    m_hi = hi;
+    m_voxels.reset(resolution.x * resolution.y * resolution.z);
+    if (!m_voxels.getSize())
+        return;
+
+    SliceState s;
+    s.field = this;
+    s.voxels = m_voxels.getPtr();
+    MulticoreLauncher().push(bakeSlice, &s, 0, resolution.z).popAll();
+}
+
+//------------------------------------------------------------------------
+
+void DistanceField::exportRaw(OutputStream& stream) const
+{
+    // One slice at a time, so that huge volumes stay within int sizes.
+
+    int sliceSize = m_resolution.x * m_resolution.y;
+    for (int z = 0; z < m_resolution.z; z++)
+        stream.write(m_voxels.getPtr(z * sliceSize), sliceSize * sizeof(F32));
+}
+
+//------------------------------------------------------------------------
+
+bool DistanceField::exportRaw(const String& fileName) const
+{
+    File file(fileName, File::Create);
+    exportRaw(file);
+    file.flush();
+    return !hasError();
+}
+
+//------------------------------------------------------------------------
+
+void FW::bakeSlice(MulticoreLauncher::Task& task)
+{
+    const SliceState& s = *(const SliceState*)task.data;
+    const DistanceField& field = *s.field;
+    Vec3i res = field.getResolution();
+    Vec3f step = field.getVoxelSize();
+    int z = task.idx;
+
+    // A voxel is at most one step farther from the mesh than its neighbor,
+    // so each packet of voxels along x is searched within a bound from the
+    // previous one. Voxels with nothing inside the bound are redone.
+
+    const BVH& bvh = field.getBVH();
+    int width = BVH::packetWidth();
+    Vec3f points[SDF_MAX_PACKET];
+    ClosestPoint hits[SDF_MAX_PACKET];
+    FW_ASSERT(width <= SDF_MAX_PACKET);
+
+    F32 rowStart = FW_F32_MAX;
+    for (int y = 0; y < res.y; y++)
+    {
+        F32* out = s.voxels + (z * res.y + y) * res.x;
+        F32 prev = (rowStart < FW_F32_MAX) ? abs(rowStart) : FW_F32_MAX;
+        F32 reach = step.y;
+        for (int x = 0; x < res.x; x += width)
+        {
+            int num = min(res.x - x, width);
+            for (int i = 0; i < num; i++)
+                points[i] = field.getVoxelCenter(Vec3i(x + i, y, z));
+
+            F32 bound = (prev < FW_F32_MAX) ? prev + (reach + step.x * (F32)(num - 1)) * SDF_BOUND_SLACK : FW_F32_MAX;
+            bvh.closestPoints(points, hits, num, bound);
+
+            for (int i = 0; i < num; i++)
+            {
+                if (hits[i].triangle == -1 && !bvh.closestPoint(points[i], hits[i]))
+                    out[x + i] = FW_F32_MAX;
+                else
+                    out[x + i] = field.signedDistance(points[i], hits[i]);
+            }
+            prev = hits[num - 1].distance;
+            reach = step.x;
+        }
+        rowStart = out[0];
+    }
+}
+
+//------------------------------------------------------------------------
+
+F32 FW::cornerAngle(const Vec3f& a, const Vec3f& b, const Vec3f& c)
+{
+    // Angle at 'a'; zero for degenerate corners.
+
+    Vec3f u = b - a;
+    Vec3f v = c - a;
+    F32 lu = u.length();
+    F32 lv = v.length();
+    if (lu == 0.0f || lv == 0.0f)
+        return 0.0f;
+    return acos(clamp(dot(u, v) / (lu * lv), -1.0f, 1.0f));
+}
+
+//------------------------------------------------------------------------
@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include "3d/BVH.hpp"
+#include "io/Stream.hpp"
+
+namespace FW
+{
+//------------------------------------------------------------------------
+// Distances to a mesh and signed distance volumes.
+//
+// Closest-point queries descend a BVH nearest child first and test points
+// against triangles by their Voronoi regions. The sign comes from the
+// angle-weighted pseudonormal of the feature the closest point lies on
+// (Baerentzen and Aanaes 2005): the face normal in the interior, the sum
+// of the two face normals on an edge, and the angle-weighted sum around a
+// vertex. Vertices are welded by exact position first, so attribute seams
+// do not break the topology. The sign is exact for closed, consistently
+// oriented meshes; near holes it follows the nearest surface.
+//
+// bake() samples the signed distance at the voxel centers of a box, one
+// task per z slice. Along a row, the distance at the previous voxel plus
+// the step bounds the search, which keeps most queries short. Voxels are
+// stored x fastest, then y, then z; exportRaw() writes them as bare 32-bit
+// floats in the machine's byte order.
+//------------------------------------------------------------------------
+
+class DistanceField
+{
+public:
+                        DistanceField       (void)                          : m_resolution(0), m_lo(0.0f), m_hi(0.0f) {}
+    explicit            DistanceField       (const MeshBase& mesh)          : m_resolution(0), m_lo(0.0f), m_hi(0.0f) { init(mesh); }
+                        ~DistanceField      (void)                          {}
+
+    // Snapshots the mesh: BVH, welded triangles and pseudonormals. Clears
+    // the volume.
+    void                init                (const MeshBase& mesh);
+
+    bool                closestPoint        (const Vec3f& p, ClosestPoint& hit, F32 maxDistance = FW_F32_MAX) const { return m_bvh.closestPoint(p, hit, maxDistance); }
+    F32                 signedDistance      (const Vec3f& p, const ClosestPoint& hit) const;   // Negative inside.
+    F32                 signedDistance      (const Vec3f& p) const;                             // FW_F32_MAX for an empty mesh.
+
+    // Bake over the mesh's bounding box, grown by 'padding' times its
+    // largest extent on every side, or over a given box.
+    void                bake                (const Vec3i& resolution, F32 padding = 0.05f);
+    void                bake                (const Vec3f& lo, const Vec3f& hi, const Vec3i& resolution);
+    void                exportRaw           (OutputStream& stream) const;
+    bool                exportRaw           (const String& fileName) const;
+
+    const BVH&          getBVH              (void) const                    { return m_bvh; }
+    const Vec3i&        getResolution       (void) const                    { return m_resolution; }
+    const Vec3f&        getLo               (void) const                    { return m_lo; }
+    const Vec3f&        getHi               (void) const                    { return m_hi; }
+    Vec3f               getVoxelSize        (void) const                    { return (m_hi - m_lo) / Vec3f(max(m_resolution, Vec3i(1))); }
+    Vec3f               getVoxelCenter      (const Vec3i& idx) const        { return m_lo + (Vec3f(idx) + 0.5f) * getVoxelSize(); }
+    const Array<F32>&   getVoxels           (void) const                    { return m_voxels; }
+    F32                 getVoxel            (const Vec3i& idx) const        { return m_voxels[(idx.z * m_resolution.y + idx.y) * m_resolution.x + idx.x]; }
+
+private:
+                        DistanceField       (const DistanceField&); // forbidden
+    DistanceField&      operator=           (const DistanceField&); // forbidden
+
+private:
+    BVH                 m_bvh;
+    Array<Vec3i>        m_tris;             // [mesh triangle] Welded vertices.
+    Array<Vec3f>        m_faceNormals;      // [mesh triangle] Unit length or zero.
+    Array<Vec3f>        m_edgeNormals;      // [mesh triangle * 3 + edge] Edges v0v1, v1v2, v2v0.
+    Array<Vec3f>        m_vertexNormals;    // [welded vertex]
+
+    Vec3i               m_resolution;
+    Vec3f               m_lo;
+    Vec3f               m_hi;
+    Array<F32>          m_voxels;
+};
+
+//------------------------------------------------------------------------
+}
@@ -0,0 +1,108 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "3d/LodBuilder.hpp"
+#include "base/Timer.hpp"
+
+using namespace FW;
+
+//------------------------------------------------------------------------
+
+void LodBuilder::start(const MeshBase& mesh, int numLevels, F32 ratio)
+{
+    wait();
+
+    // Only what the simplifier reads; materials and clusters stay behind.
+
+    m_mesh.clear();
+    m_mesh.addAttribs(mesh);
+    m_mesh.resetVertices(mesh.numVertices());
+    if (mesh.numVertices())
+        m_mesh.setVertices(0, mesh.getVertexPtr(), mesh.numVertices());
+    m_mesh.resizeSubmeshes(mesh.numSubmeshes());
+    for (int i = 0; i < mesh.numSubmeshes(); i++)
+        m_mesh.setIndices(i, mesh.indices(i));
+
+    m_numLevels = numLevels;
+    m_ratio = ratio;
+    m_isBusy = true;
+    m_isDone = false;
+    m_seconds = 0.0f;
+    m_error = "";
+    m_launcher.push(runTask, this);
+}
+
+//------------------------------------------------------------------------
+
+bool LodBuilder::poll(MeshBase::Lods& lods)
+{
+    collectFinished();
+    if (!m_isDone)
+        return false;
+
+    lods = m_mesh.lods();
+    m_mesh.clear();
+    m_isBusy = false;
+    m_isDone = false;
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+void LodBuilder::wait(void)
+{
+    while (m_launcher.getNumTasks())
+        m_launcher.pop();
+    collectFinished();
+}
+
+//------------------------------------------------------------------------
+
+void LodBuilder::runTask(MulticoreLauncher::Task& task)
+{
+    LodBuilder& b = *(LodBuilder*)task.data;
+
+    // The pool fails on errors left behind by a task; keep them here.
+
+    Timer timer(true);
+    b.m_mesh.buildLods(b.m_numLevels, b.m_ratio);
+    b.m_seconds = timer.end();
+    b.m_error = clearError();
+    if (b.m_error.getLength())
+        b.m_mesh.setLods(MeshBase::Lods());
+}
+
+//------------------------------------------------------------------------
+
+void LodBuilder::collectFinished(void)
+{
+    while (m_launcher.getNumFinished())
+        m_launcher.pop();
+    m_isDone = (m_isBusy && !m_launcher.getNumTasks());
+}
+
+//------------------------------------------------------------------------
@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include "3d/Mesh.hpp"
+#include "base/MulticoreLauncher.hpp"
+
+namespace FW
+{
+//------------------------------------------------------------------------
+// Runs MeshBase::buildLods() as a task on the thread pool, so that a
+// viewer can keep drawing the full mesh while the levels are built.
+//
+// start() snapshots the vertices and indices of the mesh; later changes
+// to it do not affect the build, which itself splits into further tasks
+// on the same pool. poll() never blocks and hands the levels over once,
+// to be set on the mesh as long as its vertices and indices are still
+// those of the snapshot. Errors set during the build are kept instead of
+// being left on the pool thread; the levels are empty then.
+//
+// All member functions must be called from the owning thread.
+//------------------------------------------------------------------------
+
+class LodBuilder
+{
+public:
+                        LodBuilder          (void)                          : m_numLevels(0), m_ratio(0.0f), m_isBusy(false), m_isDone(false), m_seconds(0.0f) {}
+                        ~LodBuilder         (void)                          { wait(); }
+
+    void                start               (const MeshBase& mesh, int numLevels = 5, F32 ratio = 0.5f); // Drops the result of a previous build, waiting for it if needed.
+    bool                poll                (MeshBase::Lods& lods);         // True once the build has finished.
+    void                wait                (void);                         // Until the build has finished; poll() then returns the result.
+
+    bool                isBusy              (void) const                    { return m_isBusy; } // Started and not yet handed over.
+    F32                 getSeconds          (void) const                    { return m_seconds; } // Of the last build, once finished.
+    const String&       getError            (void) const                    { return m_error; }
+
+private:
+    static void         runTask             (MulticoreLauncher::Task& task);
+    void                collectFinished     (void);
+
+private:
+                        LodBuilder          (const LodBuilder&); // forbidden
+    LodBuilder&         operator=           (const LodBuilder&); // forbidden
+
+private:
+    MulticoreLauncher   m_launcher;
+    MeshBase            m_mesh;             // Snapshot, then the result.
+    S32                 m_numLevels;
+    F32                 m_ratio;
+    bool                m_isBusy;
+    bool                m_isDone;           // Finished, not yet handed over.
+    F32                 m_seconds;
+    String              m_error;
+};
+
+//------------------------------------------------------------------------
+}
@@ -26,16 +26,134 @@
  */
 
 #include "3d/Mesh.hpp"
+#include "3d/QuadricSimplifier.hpp"
 #include "io/File.hpp"
+#include "io/MappedFile.hpp"
 #include "io/MeshBinaryIO.hpp"
+#include "io/MeshPlyIO.hpp"
+#include "io/MeshProgressiveIO.hpp"
 #include "io/MeshWavefrontIO.hpp"
 #include "base/UnionFind.hpp"
-#include "base/BinaryHeap.hpp"
+#include "base/MulticoreLauncher.hpp"
+#include "base/Sort.hpp"
 
 using namespace FW;
 
 //------------------------------------------------------------------------
 
+#define CHUNK_SIZE          (1 << 15)
+#define COLLAPSE_SORT_MIN   (1 << 16)
+#define WELD_CELL_BITS      21              // Max per axis in the packed cell key.
+#define LOD_SAMPLES         (1 << 18)       // Per direction, between consecutive levels.
+#define LOD_MIN_REDUCTION   0.9f            // A level must keep fewer triangles than this times those of the one before.
+
+//------------------------------------------------------------------------
+
+namespace FW
+{
+
+struct NormalState : ChunkState
+{
+    const MeshBase*         mesh;
+    S32                     posAttrib;
+    AttribView<const Vec3f> posView;
+    AttribView<Vec3f>       normalView;
+    F32                     cosCrease;      // -1 => no creases.
+
+    Array<Vec3f>            pos;            // [vertex]
+    Array<U32>              posKey;         // Hash of the position; sorted along with posOrder.
+    Array<S32>              posOrder;
+    Array<S32>              rep;            // [vertex] Lowest-index vertex with a bitwise identical position.
+    Array<Vec3i>            tris;           // Of all submeshes.
+    Array<Vec3f>            faceNormal;     // [triangle] Area-weighted.
+    Array<U32>              cornerKey;      // Rep of the corner's vertex; sorted along with cornerIdx.
+    Array<S32>              cornerIdx;      // 3 * triangle + corner
+    Array<Vec3f>            repNormal;      // [rep]
+    Array<U8>               repUsed;        // [rep]
+    Array<Vec3f>            cornerNormal;   // [3 * triangle + corner] If there are creases.
+};
+
+struct CollapseState : ChunkState
+{
+    const U8*               vertices;
+    S32                     stride;
+    S32                     numOut;
+
+    U64                     keyMask;        // Fingerprint bits that are sorted.
+    Array<U64>              key;            // Fingerprint of the vertex; sorted along with order.
+    Array<S32>              order;
+    Array<S32>              remap;          // [vertex] First identical vertex, then output index.
+    Array<S32>              chunkOut;       // [chunk] First output index.
+    Array<U8>               out;
+    Array<Vec3i>*           tris;           // Of the submesh being remapped.
+};
+
+struct WeldState : CollapseState
+{
+    const MeshBase*         mesh;
+    S32                     posAttrib;
+    S32                     normalAttrib;
+    S32                     texCoordAttrib;
+    F32                     posTol2;        // Squared tolerances.
+    F32                     normalTol2;
+    F32                     texCoordTol2;
+    Vec3f                   gridLo;
+    F32                     invCellSize;
+    S32                     cellBits;       // Per axis in the packed cell key.
+    Array<Vec2i>            exact;          // (offset, bytes) of the attributes compared bitwise.
+
+    Array<Vec3f>            pos;            // [vertex]
+    Array<Vec3f>            normal;         // [vertex] Empty if there are no normals.
+    Array<Vec3f>            texCoord;       // [vertex] Empty if there are no texcoords.
+    Array<Array<Vec3i> >    pairs;          // [chunk] (vertex, vertex, whether all attributes are within tolerance)
+};
+
+struct FetchState : CollapseState
+{
+    AttribView<const Vec3f> posView;
+    Vec3f                   gridLo;
+    F32                     gridScale;      // Maps the bounding box to [0, 1024).
+    Array<U32>              triKey;         // Morton code of the centroid; sorted along with triOrder.
+    Array<S32>              triOrder;
+    Array<Vec3i>            triOut;
+};
+
+struct ClusterState
+{
+    const MeshBase*         mesh;
+    AttribView<const Vec3f> posView;
+    S32                     maxVertices;
+    S32                     maxTriangles;
+    Array<MeshBase::Clusters> parts;        // [submesh]
+};
+
+static void     gatherPositions     (MulticoreLauncher::Task& task);
+static void     weldPositions       (MulticoreLauncher::Task& task);
+static void     computeFaceNormals  (MulticoreLauncher::Task& task);
+static void     sumFaceNormals      (MulticoreLauncher::Task& task);
+static void     writeNormals        (MulticoreLauncher::Task& task);
+static U64      fingerprint         (const U8* ptr, int size);
+static void     fingerprintVertices (MulticoreLauncher::Task& task);
+static void     findFirstVertices   (MulticoreLauncher::Task& task);
+static void     countOutVertices    (MulticoreLauncher::Task& task);
+static void     compactVertices     (MulticoreLauncher::Task& task);
+static void     remapIndices        (MulticoreLauncher::Task& task);
+static void     finishCollapse      (MeshBase& mesh, CollapseState& s);
+static void     gatherWeldAttribs   (MulticoreLauncher::Task& task);
+static void     findWeldPairs       (MulticoreLauncher::Task& task);
+static int      testWeldPair        (const WeldState& s, int v, int w);
+static int      findLocalSet        (Array<S32>& sets, int idx);
+static U32      mortonCode          (const Vec3f& p);
+static void     mortonTriangles     (MulticoreLauncher::Task& task);
+static void     permuteTriangles    (MulticoreLauncher::Task& task);
+static void     permuteVertices     (MulticoreLauncher::Task& task);
+static void     buildSubmeshClusters(MulticoreLauncher::Task& task);
+static void     boundCluster        (MeshBase::Clusters& out, const AttribView<const Vec3f>& pos, int cluster);
+
+}
+
+//------------------------------------------------------------------------
+
 int MeshBase::addAttrib(AttribType type, AttribFormat format, int length)
 {
     FW_ASSERT(format >= 0 && format < AttribFormat_Max);
@@ -114,6 +232,8 @@ void MeshBase::set(const MeshBase& other)
     {
         append(other);
         compact();
+        m_clusters = other.m_clusters;
+        m_lods = other.m_lods;
         return;
     }
 
@@ -128,6 +248,8 @@ void MeshBase::set(const MeshBase& other)
         *m_submeshes[i].indices = *other.m_submeshes[i].indices;
         m_submeshes[i].material = other.m_submeshes[i].material;
     }
+    m_clusters = other.m_clusters;
+    m_lods = other.m_lods;
 }
 
 //------------------------------------------------------------------------
@@ -220,6 +342,9 @@ void MeshBase::resetVertices(int num)
         memset(m_vertices.getPtr(m_numVertices * m_stride), 0, (num - m_numVertices) * m_stride);
     m_numVertices = num;
     freeVBO();
+    m_clusters.clear();
+    m_lods.clear();
+    m_bboxVersion++;
 }
 
 //------------------------------------------------------------------------
@@ -229,11 +354,17 @@ void MeshBase::resizeVertices(int num)
     FW_ASSERT(num >= 0);
     FW_ASSERT(isInMemory());
 
+    // Growing keeps the cached box; getBBox() extends it.
+
+    if (num < m_numVertices)
+        m_bboxVersion++;
     m_vertices.resize(num * m_stride);
     if (num > m_numVertices)
         memset(m_vertices.getPtr(m_numVertices * m_stride), 0, (num - m_numVertices) * m_stride);
     m_numVertices = num;
     freeVBO();
+    m_clusters.clear();
+    m_lods.clear();
 }
 
 //------------------------------------------------------------------------
@@ -294,7 +425,10 @@ void MeshBase::resizeSubmeshes(int num)
     }
 
     m_submeshes.resize(num);
+    m_submeshBBoxes.resize(num);
     freeVBO();
+    m_clusters.clear();
+    m_lods.clear();
 
     for (int i = old; i < num; i++)
     {
@@ -302,6 +436,7 @@ void MeshBase::resizeSubmeshes(int num)
         sm.indices      = new Array<Vec3i>;
         sm.ofsInVBO     = 0;
         sm.sizeInVBO    = 0;
+        m_submeshBBoxes[i].numVertices = -1;
     }
 }
 
@@ -320,6 +455,8 @@ Buffer& MeshBase::getVBO(void)
         m_submeshes[i].sizeInVBO = m_submeshes[i].indices->getSize() * 3;
         ofs += m_submeshes[i].indices->getNumBytes();
     }
+    m_lodsOfsInVBO = ofs;
+    ofs += m_lods.triangles.getNumBytes();
 
     m_vbo.resizeDiscard(ofs);
     memcpy(m_vbo.getMutablePtr(), m_vertices.getPtr(), m_vertices.getSize());
@@ -330,6 +467,7 @@ Buffer& MeshBase::getVBO(void)
             m_submeshes[i].indices->getPtr(),
             m_submeshes[i].indices->getNumBytes());
     }
+    memcpy(m_vbo.getMutablePtr(m_lodsOfsInVBO), m_lods.triangles.getPtr(), m_lods.triangles.getNumBytes());
 
     m_vbo.setOwner(Buffer::GL, false);
     m_vbo.free(Buffer::CPU);
@@ -364,9 +502,10 @@ void MeshBase::setGLAttrib(GLContext* gl, int attrib, int loc)
 
 //------------------------------------------------------------------------
 
-void MeshBase::draw(GLContext* gl, const Mat4f& posToCamera, const Mat4f& projection, GLContext::Program* prog, bool gouraud)
+void MeshBase::draw(GLContext* gl, const Mat4f& posToCamera, const Mat4f& projection, GLContext::Program* prog, bool gouraud, int lod)
 {
     FW_ASSERT(gl);
+    FW_ASSERT(lod >= -1);
     const char* progId = (!gouraud) ? "MeshBase::draw_generic" : "MeshBase::draw_gouraud";
     if (!prog)
         prog = gl->getProgram(progId);
@@ -519,8 +658,12 @@ void MeshBase::draw(GLContext* gl, const Mat4f& posToCamera, const Mat4f& projec
     else
         glVertexAttrib2f(prog->getAttribLoc("texCoordAttrib"), 0.0f, 0.0f);
 
-    // Render each submesh.
+    // Render each submesh, from the index set of the level of detail. Pick
+    // the level from the current view unless the caller did.
 
+    if (lod == -1)
+        lod = selectLod(posToCamera, projection, (F32)gl->getViewSize().y, 1.0f);
+    lod = min(lod, m_lods.numLevels() - 1);
     for (int i = 0; i < numSubmeshes(); i++)
     {
         const Material& mat = material(i);
@@ -536,7 +679,13 @@ void MeshBase::draw(GLContext* gl, const Mat4f& posToCamera, const Mat4f& projec
         glBindTexture(GL_TEXTURE_2D, mat.textures[TextureType_Alpha].getGLTexture());
         gl->setUniform(prog->getUniformLoc("hasAlphaTexture"), mat.textures[TextureType_Alpha].exists());
 
-        glDrawElements(GL_TRIANGLES, vboIndexSize(i), GL_UNSIGNED_INT, (void*)(UPTR)vboIndexOffset(i));
+        if (lod == 0)
+            glDrawElements(GL_TRIANGLES, vboIndexSize(i), GL_UNSIGNED_INT, (void*)(UPTR)vboIndexOffset(i));
+        else
+        {
+            const Vec2i& range = m_lods.ranges[(lod - 1) * numSubmeshes() + i];
+            glDrawElements(GL_TRIANGLES, range.y * 3, GL_UNSIGNED_INT, (void*)(UPTR)(m_lodsOfsInVBO + range.x * (int)sizeof(Vec3i)));
+        }
     }
 
     gl->resetAttribs();
@@ -619,6 +768,7 @@ void MeshBase::freeMemory(void)
 
     m_isInMemory = false;
     m_vertices.reset();
+    m_bboxVersion++;
     for (int i = 0; i < m_submeshes.getSize(); i++)
     {
         delete m_submeshes[i].indices;
@@ -634,6 +784,19 @@ void MeshBase::xformPositions(const Mat4f& mat)
     if (posAttrib == -1)
         return;
 
+    m_clusters.clear();
+    m_lods.clear();
+    int numComponents = (isViewable(posAttrib, sizeof(Vec4f))) ? 4 : (isViewable(posAttrib, sizeof(Vec3f))) ? 3 : 0;
+    if (numComponents)
+    {
+        AttribView<F32> pos = getMutableAttribView<F32>(posAttrib);
+        if (pos.getSize())
+            transformPoints(mat, &pos[0], pos.getStride(), &pos[0], pos.getStride(), pos.getSize(), numComponents);
+        return;
+    }
+
+    // Other formats go through the converting accessors.
+
     for (int i = 0; i < numVertices(); i++)
     {
         Vec4f pos = getVertexAttrib(i, posAttrib);
@@ -652,6 +815,14 @@ void MeshBase::xformNormals(const Mat3f& mat, bool normalize)
     if (normalAttrib == -1)
         return;
 
+    AttribView<Vec3f> normalView = getMutableAttribView<Vec3f>(normalAttrib);
+    if (normalView.isValid())
+    {
+        if (normalView.getSize())
+            transformNormals(mat, &normalView[0].x, normalView.getStride(), &normalView[0].x, normalView.getStride(), normalView.getSize(), normalize);
+        return;
+    }
+
     for (int i = 0; i < numVertices(); i++)
     {
         Vec3f normal = getVertexAttrib(i, normalAttrib).getXYZ();
@@ -666,534 +837,1587 @@ void MeshBase::xformNormals(const Mat3f& mat, bool normalize)
 
 void MeshBase::getBBox(Vec3f& lo, Vec3f& hi) const
 {
-    lo = Vec3f(+FW_F32_MAX);
-    hi = Vec3f(-FW_F32_MAX);
+    m_bboxLock.enter();
+    BBoxCache& c = m_bbox;
+    if (c.version != m_bboxVersion || c.numVertices > m_numVertices)
+    {
+        c.lo = Vec3f(+FW_F32_MAX);
+        c.hi = Vec3f(-FW_F32_MAX);
+        c.numVertices = 0;
+        c.version = m_bboxVersion;
+    }
 
-    int posAttrib = -1;
-    for (int i = 0; i < numAttribs(); i++)
-        if (attribSpec(i).type == AttribType_Position)
-            posAttrib = i;
+    // Only vertices added since the last call are new.
 
-    if (posAttrib == -1)
-        return;
+    if (c.numVertices < m_numVertices)
+    {
+        boundVertices(c.lo, c.hi, c.numVertices, NULL, m_numVertices - c.numVertices);
+        c.numVertices = m_numVertices;
+    }
 
-    for (int i = 0; i < numVertices(); i++)
+    lo = c.lo;
+    hi = c.hi;
+    m_bboxLock.leave();
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::getSubmeshBBox(int submesh, Vec3f& lo, Vec3f& hi) const
+{
+    FW_ASSERT(submesh >= 0 && submesh < numSubmeshes());
+
+    m_bboxLock.enter();
+    BBoxCache& c = m_submeshBBoxes[submesh];
+    if (c.version != m_bboxVersion || c.numVertices == -1)
     {
-        Vec4f pos = getVertexAttrib(i, posAttrib);
-        for (int j = 0; j < 3; j++)
-        {
-            lo[j] = min(lo[j], pos[j]);
-            hi[j] = max(hi[j], pos[j]);
-        }
+        const Array<Vec3i>& tris = indices(submesh);
+        c.lo = Vec3f(+FW_F32_MAX);
+        c.hi = Vec3f(-FW_F32_MAX);
+        boundVertices(c.lo, c.hi, 0, (const S32*)tris.getPtr(), tris.getSize() * 3);
+        c.numVertices = m_numVertices;
+        c.version = m_bboxVersion;
     }
+
+    lo = c.lo;
+    hi = c.hi;
+    m_bboxLock.leave();
 }
 
 //------------------------------------------------------------------------
 
-void MeshBase::recomputeNormals(void)
+void MeshBase::boundVertices(Vec3f& lo, Vec3f& hi, int first, const S32* indices, int numIndices) const
 {
+    // Grows the box by vertices [first, first + numIndices), or by those
+    // listed in 'indices'.
+
     int posAttrib = findAttrib(AttribType_Position);
-    int normalAttrib = findAttrib(AttribType_Normal);
-    if (posAttrib == -1 || normalAttrib == -1)
+    if (posAttrib == -1 || !numIndices)
         return;
 
-    // Calculate average normal for each vertex position.
-
-    Hash<Vec3f, Vec3f> posToNormal;
-    Vec3f v[3];
-
-    for (int i = 0; i < numSubmeshes(); i++)
+    if (isViewable(posAttrib, sizeof(Vec3f)))
     {
-        const Array<Vec3i>& tris = indices(i);
-        for (int j = 0; j < tris.getSize(); j++)
-        {
-            const Vec3i& tri = tris[j];
-            for (int k = 0; k < 3; k++)
-                v[k] = getVertexAttrib(tri[k], posAttrib).getXYZ();
-
-            Vec3f triNormal = (v[1] - v[0]).cross(v[2] - v[0]);
-            for (int k = 0; k < 3; k++)
-            {
-                Vec3f* vertNormal = posToNormal.search(v[k]);
-                if (vertNormal)
-                    *vertNormal += triNormal;
-                else
-                    posToNormal.add(v[k], triNormal);
-            }
-        }
+        const F32* pos = (const F32*)(getVertexPtr(first) + attribSpec(posAttrib).offset);
+        boundPoints(pos, m_stride, m_numVertices - first, lo, hi, indices, numIndices);
+        return;
     }
 
-    // Output normals.
-
-    for (int i = 0; i < numVertices(); i++)
+    for (int i = 0; i < numIndices; i++)
     {
-        Vec3f pos = getVertexAttrib(i, posAttrib).getXYZ();
-        Vec3f* normal = posToNormal.search(pos);
-        if (normal)
-            setVertexAttrib(i, normalAttrib, Vec4f((*normal).normalized(), 0.0f));
+        Vec4f pos = getVertexAttrib((indices) ? indices[i] : first + i, posAttrib);
+        for (int j = 0; j < 3; j++)
+        {
+            lo[j] = min(lo[j], pos[j]);
+            hi[j] = max(hi[j], pos[j]);
+        }
     }
 }
 
 //------------------------------------------------------------------------
 
-void MeshBase::flipTriangles(void)
+void FW::gatherPositions(MulticoreLauncher::Task& task)
 {
-    for (int i = 0; i < numSubmeshes(); i++)
+    NormalState& s = *(NormalState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+
+    for (int i = range.x; i < range.y; i++)
     {
-        Array<Vec3i>& tris = mutableIndices(i);
-        for (int j = 0; j < tris.getSize(); j++)
-            nvswap(tris[j].x, tris[j].y);
+        s.pos[i] = (s.posView.isValid()) ? s.posView[i] : s.mesh->getVertexAttrib(i, s.posAttrib).getXYZ();
+        s.posKey[i] = hash<Vec3f>(s.pos[i]);
+        s.posOrder[i] = i;
     }
 }
 
 //------------------------------------------------------------------------
 
-void MeshBase::clean(void)
+void FW::weldPositions(MulticoreLauncher::Task& task)
 {
-    // Remove degenerate triangles and empty submeshes.
+    // Vertices are sorted by position hash, in index order within a run of
+    // equal hashes. The first vertex of each distinct position in a run
+    // represents it; colliding positions are told apart by comparing bits.
 
-    int submeshOut = 0;
-    for (int submeshIn = 0; submeshIn < numSubmeshes(); submeshIn++)
-    {
-        Array<Vec3i>& inds = mutableIndices(submeshIn);
-        int indOut = 0;
-        for (int i = 0; i < inds.getSize(); i++)
-        {
-            const Vec3i& v = inds[i];
-            if (v.x != v.y && v.x != v.z && v.y != v.z)
-                inds[indOut++] = v;
-        }
+    NormalState& s = *(NormalState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    int lo = alignToRun(s.posKey, range.x);
+    int hi = alignToRun(s.posKey, range.y);
+    Array<S32> distinct;
 
-        if (indOut)
+    for (int start = lo, end; start < hi; start = end)
+    {
+        distinct.clear();
+        for (end = start; end < s.numItems && s.posKey[end] == s.posKey[start]; end++)
         {
-            inds.resize(indOut);
-            if (submeshOut != submeshIn)
+            int v = s.posOrder[end];
+            s.rep[v] = v;
+            for (int j = 0; j < distinct.getSize(); j++)
             {
-                material(submeshOut) = material(submeshIn);
-                mutableIndices(submeshOut) = inds;
+                if (equals<Vec3f>(s.pos[distinct[j]], s.pos[v]))
+                {
+                    s.rep[v] = distinct[j];
+                    break;
+                }
             }
-            mutableIndices(submeshOut).compact();
-            submeshOut++;
+            if (s.rep[v] == v)
+                distinct.add(v);
         }
     }
-    resizeSubmeshes(submeshOut);
+}
 
-    // Tag referenced vertices.
+//------------------------------------------------------------------------
 
-    Array<U8> vertUsed;
-    vertUsed.reset(numVertices());
-    memset(vertUsed.getPtr(), 0, vertUsed.getNumBytes());
+void FW::computeFaceNormals(MulticoreLauncher::Task& task)
+{
+    NormalState& s = *(NormalState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
 
-    for (int submeshIn = 0; submeshIn < numSubmeshes(); submeshIn++)
+    for (int i = range.x; i < range.y; i++)
     {
-        const Array<Vec3i>& inds = indices(submeshIn);
-        for (int i = 0; i < inds.getSize(); i++)
-            for (int j = 0; j < 3; j++)
-                vertUsed[inds[i][j]] = 1;
+        const Vec3i& tri = s.tris[i];
+        s.faceNormal[i] = (s.pos[tri.y] - s.pos[tri.x]).cross(s.pos[tri.z] - s.pos[tri.x]);
+        for (int k = 0; k < 3; k++)
+        {
+            s.cornerKey[i * 3 + k] = s.rep[tri[k]];
+            s.cornerIdx[i * 3 + k] = i * 3 + k;
+        }
     }
+}
 
-    // Compact vertex array.
+//------------------------------------------------------------------------
 
-    Array<S32> vertRemap;
-    vertRemap.reset(numVertices());
-    memset(vertRemap.getPtr(), -1, vertRemap.getNumBytes());
-    U8* vertPtr = getMutableVertexPtr();
-    int vertStride = vertexStride();
+void FW::sumFaceNormals(MulticoreLauncher::Task& task)
+{
+    // Corners are sorted by rep, in triangle order within a rep. Summing in
+    // that order matches the serial accumulation exactly.
 
-    int vertOut = 0;
-    for (int vertIn = 0; vertIn < vertUsed.getSize(); vertIn++)
+    NormalState& s = *(NormalState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    int lo = alignToRun(s.cornerKey, range.x);
+    int hi = alignToRun(s.cornerKey, range.y);
+    Array<S32> fan;
+    Array<Vec3f> fanSum;
+
+    for (int start = lo, end; start < hi; start = end)
     {
-        if (!vertUsed[vertIn])
+        Vec3f sum = s.faceNormal[s.cornerIdx[start] / 3];
+        for (end = start + 1; end < s.numItems && s.cornerKey[end] == s.cornerKey[start]; end++)
+            sum += s.faceNormal[s.cornerIdx[end] / 3];
+        s.repNormal[s.cornerKey[start]] = sum.normalized();
+        s.repUsed[s.cornerKey[start]] = 1;
+
+        // Creases => split the corners around the position into fans of
+        // triangles that are connected by edges through it and whose normals
+        // are within the crease angle of each other. Each fan gets its own
+        // normal.
+
+        if (s.cosCrease == -1.0f)
             continue;
 
-        vertRemap[vertIn] = vertOut;
-        if (vertOut != vertIn)
-            memcpy(vertPtr + vertOut * vertStride, vertPtr + vertIn * vertStride, vertStride);
-        vertOut++;
-    }
-    resizeVertices(vertOut);
+        int n = end - start;
+        fan.reset(n);
+        for (int i = 0; i < n; i++)
+            fan[i] = i;
 
-    // Remap indices.
+        for (int i = 0; i < n; i++)
+        for (int j = i + 1; j < n; j++)
+        {
+            int ci = s.cornerIdx[start + i];
+            int cj = s.cornerIdx[start + j];
+            const Vec3i& ti = s.tris[ci / 3];
+            const Vec3i& tj = s.tris[cj / 3];
+            int ai = s.rep[ti[(ci + 1) % 3]], bi = s.rep[ti[(ci + 2) % 3]];
+            int aj = s.rep[tj[(cj + 1) % 3]], bj = s.rep[tj[(cj + 2) % 3]];
+            if (ai != aj && ai != bj && bi != aj && bi != bj)
+                continue;
 
-    for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
-    {
-        Array<Vec3i>& inds = mutableIndices(submeshIdx);
-        for (int i = 0; i < inds.getSize(); i++)
-            for (int j = 0; j < 3; j++)
-                inds[i][j] = vertRemap[inds[i][j]];
+            const Vec3f& ni = s.faceNormal[ci / 3];
+            const Vec3f& nj = s.faceNormal[cj / 3];
+            if (dot(ni, nj) < s.cosCrease * ni.length() * nj.length())
+                continue;
+
+            int ri = i, rj = j;
+            while (fan[ri] != ri)
+                ri = fan[ri];
+            while (fan[rj] != rj)
+                rj = fan[rj];
+            fan[max(ri, rj)] = min(ri, rj);
+        }
+
+        // Sum each fan in corner order; a single fan equals the smooth normal.
+
+        fanSum.reset(n);
+        for (int i = 0; i < n; i++)
+        {
+            int root = i;
+            while (fan[root] != root)
+                root = fan[root];
+            fan[i] = root;
+            const Vec3f& normal = s.faceNormal[s.cornerIdx[start + i] / 3];
+            fanSum[root] = (root == i) ? normal : fanSum[root] + normal;
+        }
+        for (int i = 0; i < n; i++)
+            s.cornerNormal[s.cornerIdx[start + i]] = fanSum[fan[i]].normalized();
     }
 }
 
 //------------------------------------------------------------------------
 
-void MeshBase::collapseVertices(void)
+void FW::writeNormals(MulticoreLauncher::Task& task)
 {
-    // Collapse vertices.
+    NormalState& s = *(NormalState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
 
-    int num = numVertices();
-    U8* vertPtr = getMutableVertexPtr();
-    int vertStride = vertexStride();
+    for (int i = range.x; i < range.y; i++)
+        if (s.repUsed[s.rep[i]])
+            s.normalView[i] = s.repNormal[s.rep[i]];
+}
 
-    Hash<GenericHashKey, S32> hash;
-    Array<S32> remap;
-    hash.setCapacity(num);
-    remap.reset(num);
+//------------------------------------------------------------------------
 
-    for (int i = 0; i < num; i++)
+U64 FW::fingerprint(const U8* ptr, int size)
+{
+    U64 h = (U64)size * 0x9E3779B97F4A7C15ull;
+    int i = 0;
+    for (; i + 8 <= size; i += 8)
     {
-        GenericHashKey key(vertPtr + i * vertStride, vertStride);
-        S32* found = hash.search(key);
-        if (found)
-            remap[i] = *found;
-        else
-        {
-            remap[i] = hash.getSize();
-            hash.add(key, remap[i]);
-            if (remap[i] != i)
-                memcpy(vertPtr + remap[i] * vertStride, vertPtr + i * vertStride, vertStride);
-        }
+        U64 word;
+        memcpy(&word, ptr + i, 8);
+        h = (h ^ word) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
     }
+    for (; i < size; i++)
+        h = (h ^ ptr[i]) * 0xFF51AFD7ED558CCDull;
 
-    resizeVertices(hash.getSize());
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
 
-    // Remap indices.
+//------------------------------------------------------------------------
 
-    for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
+void FW::fingerprintVertices(MulticoreLauncher::Task& task)
+{
+    CollapseState& s = *(CollapseState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+
+    for (int i = range.x; i < range.y; i++)
     {
-        Array<Vec3i>& inds = mutableIndices(submeshIdx);
-        for (int i = 0; i < inds.getSize(); i++)
-            for (int j = 0; j < 3; j++)
-                inds[i][j] = remap[inds[i][j]];
+        s.key[i] = fingerprint(s.vertices + (size_t)i * s.stride, s.stride) & s.keyMask;
+        s.order[i] = i;
     }
 }
 
 //------------------------------------------------------------------------
 
-void MeshBase::dupVertsPerSubmesh(void)
+void FW::findFirstVertices(MulticoreLauncher::Task& task)
 {
-    // Find shared vertices and remap indices.
+    // Within a run of equal fingerprints, vertices are in index order. Each
+    // one maps to the first identical vertex, stored as ~index; the first
+    // ones map to themselves.
 
-    int num = numVertices();
-    Array<Vec2i> remap;
-    Array<S32> dup;
-    remap.reset(num);
-    memset(remap.getPtr(), -1, remap.getNumBytes());
+    CollapseState& s = *(CollapseState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    int lo = alignToRun(s.key, range.x);
+    int hi = alignToRun(s.key, range.y);
+    Array<S32> distinct;
 
-    for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
+    for (int start = lo, end; start < hi; start = end)
     {
-        Array<Vec3i>& inds = mutableIndices(submeshIdx);
-        for (int i = 0; i < inds.getSize(); i++)
-        for (int j = 0; j < 3; j++)
+        distinct.clear();
+        for (end = start; end < s.numItems && s.key[end] == s.key[start]; end++)
         {
-            int v = inds[i][j];
-            if (remap[v].x != submeshIdx)
+            int v = s.order[end];
+            const U8* ptr = s.vertices + (size_t)v * s.stride;
+            s.remap[v] = v;
+            for (int j = 0; j < distinct.getSize(); j++)
             {
-                remap[v].x = submeshIdx;
-                if (remap[v].y == -1)
-                    remap[v].y = v;
-                else
+                if (memcmp(s.vertices + (size_t)distinct[j] * s.stride, ptr, s.stride) == 0)
                 {
-                    remap[v].y = num + dup.getSize();
-                    dup.add(v);
+                    s.remap[v] = ~distinct[j];
+                    break;
                 }
             }
-            inds[i][j] = remap[v].y;
+            if (s.remap[v] == v)
+                distinct.add(v);
         }
     }
+}
 
-    // Duplicate vertices.
+//------------------------------------------------------------------------
 
-    resizeVertices(num + dup.getSize());
-    U8* vertPtr = getMutableVertexPtr();
-    int vertStride = vertexStride();
+void FW::countOutVertices(MulticoreLauncher::Task& task)
+{
+    CollapseState& s = *(CollapseState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+
+    S32 count = 0;
+    for (int i = range.x; i < range.y; i++)
+        if (s.remap[i] >= 0)
+            count++;
+    s.chunkOut[task.idx] = count;
+}
 
-    for (int i = 0; i < dup.getSize(); i++)
-        memcpy(vertPtr + (num + i) * vertStride, vertPtr + dup[i] * vertStride, vertStride);
+//------------------------------------------------------------------------
+
+void FW::compactVertices(MulticoreLauncher::Task& task)
+{
+    CollapseState& s = *(CollapseState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    S32 outIdx = s.chunkOut[task.idx];
+
+    for (int i = range.x; i < range.y; i++)
+    {
+        if (s.remap[i] < 0)
+            continue;
+        memcpy(s.out.getPtr() + (size_t)outIdx * s.stride, s.vertices + (size_t)i * s.stride, s.stride);
+        s.remap[i] = outIdx++;
+    }
 }
 
 //------------------------------------------------------------------------
 
-void MeshBase::fixMaterialColors(void)
+void FW::remapIndices(MulticoreLauncher::Task& task)
 {
-    for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
+    CollapseState& s = *(CollapseState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    Array<Vec3i>& tris = *s.tris;
+
+    for (int i = range.x; i < range.y; i++)
     {
-        Material& mat = material(submeshIdx);
-        Texture tex = mat.textures[TextureType_Diffuse];
-        if (tex.exists())
+        for (int j = 0; j < 3; j++)
         {
-            Vec4f avg = tex.getMipLevel(64).getImage()->getVec4f(0);
-            mat.diffuse = Vec4f(avg.getXYZ(), mat.diffuse.w);
+            S32 r = s.remap[tris[i][j]];
+            tris[i][j] = (r >= 0) ? r : s.remap[~r];
         }
     }
 }
 
 //------------------------------------------------------------------------
 
-void MeshBase::simplify(F32 maxError)
+void FW::finishCollapse(MeshBase& mesh, CollapseState& s)
 {
-    struct Vertex
+    // Number the vertices that map to themselves in index order and compact
+    // them.
+
+    int num = mesh.numVertices();
+    s.chunkOut.reset(maxChunks());
+    launchChunks(countOutVertices, s, num, CHUNK_SIZE);
+    s.numOut = 0;
+    for (int i = 0; i < s.numChunks; i++)
     {
-        Vec3f   pos;
-        F32     error;
-        F32     posWeight;
-        F32     outWeight;
-        S32     firstEdge;
-        S32     timeStamp;
-        S32     outIdx;
-    };
+        S32 count = s.chunkOut[i];
+        s.chunkOut[i] = s.numOut;
+        s.numOut += count;
+    }
 
-    struct Edge
-    {
-        Vec2i   verts;
-        Vec2i   next;
-    };
+    s.out.reset(s.numOut * s.stride);
+    launchChunks(compactVertices, s, num, CHUNK_SIZE);
+    mesh.resizeVertices(s.numOut);
+    memcpy(mesh.getMutableVertexPtr(), s.out.getPtr(), s.out.getNumBytes());
+    s.out.reset();
 
-    // Find attributes.
+    // Remap indices.
 
-    int posAttrib = findAttrib(MeshBase::AttribType_Position);
-    int normalAttrib = findAttrib(MeshBase::AttribType_Normal);
-    if (posAttrib == -1)
-        return;
+    for (int submeshIdx = 0; submeshIdx < mesh.numSubmeshes(); submeshIdx++)
+    {
+        s.tris = &mesh.mutableIndices(submeshIdx);
+        launchChunks(remapIndices, s, s.tris->getSize(), CHUNK_SIZE);
+    }
+}
 
-    // Group vertices.
+//------------------------------------------------------------------------
 
-    Array<Vertex> verts(NULL, numVertices());
-    UnionFind posGroups(numVertices()); // by position
-    UnionFind outGroups(numVertices()); // by all attributes
+void FW::gatherWeldAttribs(MulticoreLauncher::Task& task)
+{
+    WeldState& s = *(WeldState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    const MeshBase& mesh = *s.mesh;
+    AttribView<const Vec3f> posView = mesh.getAttribView<Vec3f>(s.posAttrib);
+    AttribView<const Vec3f> normalView = mesh.getAttribView<Vec3f>(s.normalAttrib);
+    F32 maxCell = (F32)((1 << s.cellBits) - 1);
+
+    for (int i = range.x; i < range.y; i++)
     {
-        Hash<Vec3f, S32> posHash;
-        Hash<GenericHashKey, S32> outHash;
-        for (int i = 0; i < verts.getSize(); i++)
-        {
-            Vertex& v   = verts[i];
-            v.pos       = getVertexAttrib(i, posAttrib).getXYZ();
-            v.error     = 0.0f;
-            v.posWeight = 0.0f;
-            v.outWeight = 0.0f;
-            v.firstEdge = -1;
-            v.timeStamp = -1;
-            v.outIdx    = -1;
-
-            S32* group = posHash.search(v.pos);
-            posGroups.unionSets(i, (group) ? *group : posHash.add(v.pos, i));
-
-            GenericHashKey outKey(getVertexPtr(i), vertexStride());
-            group = outHash.search(outKey);
-            outGroups.unionSets(i, (group) ? *group : outHash.add(outKey, i));
-        }
+        Vec3f& pos = s.pos[i];
+        pos = (posView.isValid()) ? posView[i] : mesh.getVertexAttrib(i, s.posAttrib).getXYZ();
+        if (s.normal.getSize())
+            s.normal[i] = (normalView.isValid()) ? normalView[i] : mesh.getVertexAttrib(i, s.normalAttrib).getXYZ();
+        if (s.texCoord.getSize())
+            s.texCoord[i] = mesh.getVertexAttrib(i, s.texCoordAttrib).getXYZ();
+
+        U64 key = 0;
+        for (int j = 2; j >= 0; j--)
+            key = (key << s.cellBits) | (U64)clamp((pos[j] - s.gridLo[j]) * s.invCellSize, 0.0f, maxCell);
+        s.key[i] = key;
+        s.order[i] = i;
     }
+}
 
-    // Collect edges and accumulate weights.
+//------------------------------------------------------------------------
 
-    Array<Edge> edges;
+void FW::findWeldPairs(MulticoreLauncher::Task& task)
+{
+    // Each chunk is a slab of whole cells in key order (z, y, x). Vertices
+    // within the position tolerance of each other are in the same or in
+    // adjacent cells. Pairs within a cell are tested directly, and so are
+    // pairs with the 13 neighbours that come later in key order. Each of
+    // those neighbours is found with its own cursor, which only ever moves
+    // forward.
+
+    static const Vec3i neighbors[] =
     {
-        Set<Vec2i> edgeSet;
-        for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
-        {
-            const Array<Vec3i>& tris = indices(submeshIdx);
-            for (int triIdx = 0; triIdx < tris.getSize(); triIdx++)
-            {
-                const Vec3i& tri = tris[triIdx];
-                F32 area = max(length(cross(verts[tri.y].pos - verts[tri.x].pos, verts[tri.z].pos - verts[tri.x].pos)), 1.0e-8f);
-                for (int i = 0; i < 3; i++)
-                {
-                    Vec2i vi = Vec2i(posGroups[tri[i]], posGroups[tri[(i == 2) ? 0 : (i + 1)]]);
-                    verts[vi.x].posWeight += area;
-                    verts[outGroups[tri[i]]].outWeight += area;
+        Vec3i(1, 0, 0),
+        Vec3i(-1, 1, 0), Vec3i(0, 1, 0), Vec3i(1, 1, 0),
+        Vec3i(-1, -1, 1), Vec3i(0, -1, 1), Vec3i(1, -1, 1),
+        Vec3i(-1, 0, 1), Vec3i(0, 0, 1), Vec3i(1, 0, 1),
+        Vec3i(-1, 1, 1), Vec3i(0, 1, 1), Vec3i(1, 1, 1),
+    };
+    const int numNeighbors = (int)(sizeof(neighbors) / sizeof(neighbors[0]));
 
-                    if (vi.x > vi.y)
-                        nvswap(vi.x, vi.y);
-                    if (vi.x == vi.y || edgeSet.contains(vi))
-                        continue;
+    WeldState& s = *(WeldState*)task.data;
+    int maxCell = (1 << s.cellBits) - 1;
+    Array<Vec3i>& pairs = s.pairs[task.idx];
+    Vec2i range = chunkRange(s, task.idx);
+    int lo = alignToRun(s.key, range.x);
+    int hi = alignToRun(s.key, range.y);
+    pairs.setCapacity(hi - lo);
 
-                    edgeSet.add(vi);
-                    int ei = edges.getSize();
-                    Edge& e = edges.add();
-                    e.verts = vi;
+    int cursor[numNeighbors];
+    for (int j = 0; j < numNeighbors; j++)
+        cursor[j] = -1;
 
-                    for (int j = 0; j < 2; j++)
-                    {
-                        S32* prevSlot = &verts[vi[j]].firstEdge;
-                        if (*prevSlot == -1)
-                            e.next[j] = ei;
-                        else
-                        {
-                            prevSlot = &edges[*prevSlot].next[(edges[*prevSlot].verts.x == vi[j]) ? 0 : 1];
-                            e.next[j] = *prevSlot;
-                        }
-                        *prevSlot = ei;
-                    }
+    Array<S32> posSets;                 // Within the cell.
+    Array<S32> allSets;
+
+    for (int start = lo, end; start < hi; start = end)
+    {
+        U64 key = s.key[start];
+        for (end = start + 1; end < hi && s.key[end] == key; end++);
+
+        // Within the cell, only output pairs that connect something new.
+        // A cluster of k vertices then costs k - 1 pairs rather than k^2 / 2.
+
+        posSets.reset(end - start);
+        allSets.reset(end - start);
+        for (int i = 0; i < posSets.getSize(); i++)
+            posSets[i] = allSets[i] = i;
+
+        for (int b = 1; b < end - start; b++)
+        for (int a = 0; a < b; a++)
+        {
+            if (findLocalSet(allSets, a) == findLocalSet(allSets, b))
+                continue;
+
+            int match = testWeldPair(s, s.order[start + a], s.order[start + b]);
+            bool newPos = (match && findLocalSet(posSets, a) != findLocalSet(posSets, b));
+            if (match == 2)
+                allSets[findLocalSet(allSets, b)] = findLocalSet(allSets, a);
+            if (newPos)
+                posSets[findLocalSet(posSets, b)] = findLocalSet(posSets, a);
+            if (match == 2 || newPos)
+                pairs.add(Vec3i(s.order[start + a], s.order[start + b], match - 1));
+        }
+
+        // Between cells.
+
+        Vec3i cell((int)key & maxCell, (int)(key >> s.cellBits) & maxCell, (int)(key >> (2 * s.cellBits)));
+        for (int j = 0; j < numNeighbors; j++)
+        {
+            Vec3i other = cell + neighbors[j];
+            if (other.min() < 0 || other.max() > maxCell)
+                continue;
+
+            U64 otherKey = ((U64)other.z << (2 * s.cellBits)) | ((U64)other.y << s.cellBits) | (U64)other.x;
+            int& k = cursor[j];
+            if (k == -1)
+            {
+                // First use => binary search.
+
+                int kEnd = s.numItems;
+                for (k = end; k < kEnd;)
+                {
+                    int mid = k + (kEnd - k) / 2;
+                    if (s.key[mid] < otherKey)
+                        k = mid + 1;
+                    else
+                        kEnd = mid;
                 }
             }
+
+            while (k < s.numItems && s.key[k] < otherKey)
+                k++;
+            for (int b = k; b < s.numItems && s.key[b] == otherKey; b++)
+            for (int a = start; a < end; a++)
+            {
+                int match = testWeldPair(s, s.order[a], s.order[b]);
+                if (match)
+                    pairs.add(Vec3i(s.order[a], s.order[b], match - 1));
+            }
         }
     }
+}
 
-    // Create binary heap of edges.
+//------------------------------------------------------------------------
 
-    BinaryHeap<F32> edgeHeap;
-    for (int i = 0; i < edges.getSize(); i++)
+int FW::testWeldPair(const WeldState& s, int v, int w)
+{
+    // 0 = too far apart, 1 = positions within tolerance, 2 = all attributes.
+
+    if ((s.pos[v] - s.pos[w]).lenSqr() > s.posTol2)
+        return 0;
+    if (s.normal.getSize() && (s.normal[v] - s.normal[w]).lenSqr() > s.normalTol2)
+        return 1;
+    if (s.texCoord.getSize() && (s.texCoord[v] - s.texCoord[w]).lenSqr() > s.texCoordTol2)
+        return 1;
+
+    const U8* ptrV = s.vertices + (size_t)v * s.stride;
+    const U8* ptrW = s.vertices + (size_t)w * s.stride;
+    for (int i = 0; i < s.exact.getSize(); i++)
+        if (memcmp(ptrV + s.exact[i].x, ptrW + s.exact[i].x, s.exact[i].y) != 0)
+            return 1;
+    return 2;
+}
+
+//------------------------------------------------------------------------
+
+int FW::findLocalSet(Array<S32>& sets, int idx)
+{
+    while (sets[idx] != idx)
     {
-        const Vertex& va = verts[edges[i].verts.x];
-        const Vertex& vb = verts[edges[i].verts.y];
-        F32 error = max(va.posWeight, vb.posWeight) * length(va.pos - vb.pos) / (va.posWeight + vb.posWeight);
-        if (error <= maxError)
-            edgeHeap.add(i, error);
+        sets[idx] = sets[sets[idx]];
+        idx = sets[idx];
     }
+    return idx;
+}
+
+//------------------------------------------------------------------------
 
-    // Collapse edges.
+U32 FW::mortonCode(const Vec3f& p)
+{
+    // Interleave the low 10 bits of each coordinate.
 
-    for (int timeStamp = 0; !edgeHeap.isEmpty(); timeStamp++)
+    U32 code = 0;
+    for (int i = 0; i < 3; i++)
     {
-        // Group removed vertices to form a new one.
+        U32 x = (U32)clamp((int)p[i], 0, 1023);
+        x = (x | (x << 16)) & 0x030000FFu;
+        x = (x | (x << 8)) & 0x0300F00Fu;
+        x = (x | (x << 4)) & 0x030C30C3u;
+        x = (x | (x << 2)) & 0x09249249u;
+        code |= x << (2 - i);
+    }
+    return code;
+}
 
-        int removedEdge = edgeHeap.getMinIndex();
-        const Vec2i& removedVerts = edges[removedEdge].verts;
-        const Vertex& va = verts[removedVerts.x];
-        const Vertex& vb = verts[removedVerts.y];
+//------------------------------------------------------------------------
 
-        int vi      = posGroups.unionSets(removedVerts.x, removedVerts.y);
-        Vertex& v   = verts[vi];
-        v.pos       = (va.pos * va.posWeight + vb.pos * vb.posWeight) / (va.posWeight + vb.posWeight);
-        v.error     = edgeHeap.remove(removedEdge);
-        v.posWeight = va.posWeight + vb.posWeight;
-        v.firstEdge = -1;
+void FW::mortonTriangles(MulticoreLauncher::Task& task)
+{
+    FetchState& s = *(FetchState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    const Array<Vec3i>& tris = *s.tris;
 
-        // Update connected edges.
+    for (int i = range.x; i < range.y; i++)
+    {
+        const Vec3i& tri = tris[i];
+        Vec3f centroid = (s.posView[tri.x] + s.posView[tri.y] + s.posView[tri.z]) * (1.0f / 3.0f);
+        s.triKey[i] = mortonCode((centroid - s.gridLo) * s.gridScale);
+        s.triOrder[i] = i;
+    }
+}
+
+//------------------------------------------------------------------------
 
-        for (int i = 0; i < 2; i++)
+void FW::permuteTriangles(MulticoreLauncher::Task& task)
+{
+    FetchState& s = *(FetchState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    const Array<Vec3i>& tris = *s.tris;
+
+    for (int i = range.x; i < range.y; i++)
+        s.triOut[i] = tris[s.triOrder[i]];
+}
+
+//------------------------------------------------------------------------
+
+void FW::permuteVertices(MulticoreLauncher::Task& task)
+{
+    FetchState& s = *(FetchState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+
+    for (int i = range.x; i < range.y; i++)
+        memcpy(s.out.getPtr() + (size_t)i * s.stride, s.vertices + (size_t)s.order[i] * s.stride, s.stride);
+}
+
+//------------------------------------------------------------------------
+
+void FW::buildSubmeshClusters(MulticoreLauncher::Task& task)
+{
+    ClusterState& s = *(ClusterState*)task.data;
+    const Array<Vec3i>& tris = s.mesh->indices(task.idx);
+    MeshBase::Clusters& out = s.parts[task.idx];
+    int numTris = tris.getSize();
+    int numCorners = numTris * 3;
+
+    // Renumber the vertices the submesh uses 0, 1, 2, ... After sorting,
+    // the corners of each vertex are consecutive, which makes them its
+    // list of adjacent triangles.
+
+    int keyBits = 1;
+    while (keyBits < 32 && ((S64)1 << keyBits) < s.mesh->numVertices())
+        keyBits++;
+
+    Array<U32> keys(NULL, numCorners);
+    Array<S32> corners(NULL, numCorners);
+    for (int i = 0; i < numCorners; i++)
+    {
+        keys[i] = tris[i / 3][i % 3];
+        corners[i] = i;
+    }
+    radixSort(keys.getPtr(), corners.getPtr(), numCorners, keyBits);
+
+    Array<S32> global;
+    Array<S32> adjStart;                    // [vertex + 1] Into corners.
+    Array<Vec3i> local(NULL, numTris);
+    for (int i = 0; i < numCorners; i++)
+    {
+        if (i == 0 || keys[i] != keys[i - 1])
         {
-            int nextEdge = edges[removedEdge].next[i];
-            while (nextEdge != removedEdge)
+            global.add(keys[i]);
+            adjStart.add(i);
+        }
+        local[corners[i] / 3][corners[i] % 3] = global.getSize() - 1;
+    }
+    adjStart.add(numCorners);
+    keys.reset();
+
+    int numVerts = global.getSize();
+    Array<S32> live(NULL, numVerts);        // Triangles not yet in a cluster.
+    Array<S32> stamp(NULL, numVerts);       // Last cluster the vertex was added to.
+    Array<S32> slot(NULL, numVerts);        // Index within that cluster.
+    Array<S32> queued(NULL, numTris);       // Last cluster the triangle was a candidate for.
+    Array<U8> emitted(NULL, numTris);
+    Array<Vec3f> centroids(NULL, numTris);
+    for (int i = 0; i < numVerts; i++)
+        live[i] = adjStart[i + 1] - adjStart[i];
+    for (int i = 0; i < numTris; i++)
+        centroids[i] = (s.posView[tris[i].x] + s.posView[tris[i].y] + s.posView[tris[i].z]) * (1.0f / 3.0f);
+    memset(stamp.getPtr(), -1, stamp.getNumBytes());
+    memset(queued.getPtr(), -1, queued.getNumBytes());
+    memset(emitted.getPtr(), 0, emitted.getNumBytes());
+
+    // Grow one cluster at a time from a seed triangle. Each step adds the
+    // candidate that brings in the fewest new vertices, breaking ties by
+    // distance to the cluster's centroid to keep it round. The distance is
+    // scaled down for triangles whose new vertices have few free triangles
+    // left: those sit in corners left by earlier clusters, and taking them
+    // now avoids closing them in as slivers. Clusters close at a limit or
+    // when they run out of neighbours.
+
+    Array<S32> verts;                       // Of the current cluster.
+    Array<S32> candidates;                  // Triangles touching the current cluster.
+    int numEmitted = 0;
+    int cursor = 0;
+
+    while (numEmitted < numTris)
+    {
+        // Seed at the previous cluster's vertex with the fewest free
+        // triangles, otherwise at the first free triangle in input order.
+
+        int tri = -1;
+        int bestLive = FW_S32_MAX;
+        for (int i = 0; i < verts.getSize(); i++)
+        {
+            int v = verts[i];
+            if (live[v] && live[v] < bestLive)
             {
-                int currEdge = nextEdge;
-                Edge& e = edges[currEdge];
-                int c = (e.verts.x == removedVerts[i]) ? 0 : 1;
-                nextEdge = e.next[c];
-                edgeHeap.remove(currEdge);
+                bestLive = live[v];
+                for (int j = adjStart[v];; j++)
+                    if (!emitted[corners[j] / 3])
+                    {
+                        tri = corners[j] / 3;
+                        break;
+                    }
+            }
+        }
+
+        while (tri == -1)
+            if (!emitted[cursor++])
+                tri = cursor - 1;
 
-                // Duplicate => discard.
+        int cluster = out.numClusters();
+        int firstTri = out.triangles.getSize() / 3;
+        Vec3f sum(0.0f);
+        verts.clear();
+        candidates.clear();
 
-                int otherVertex = e.verts[1 - c];
-                if (otherVertex == -1 || verts[otherVertex].timeStamp == timeStamp)
+        for (;;)
+        {
+            emitted[tri] = 1;
+            numEmitted++;
+            for (int k = 0; k < 3; k++)
+            {
+                int v = local[tri][k];
+                live[v]--;
+                if (stamp[v] != cluster)
+                {
+                    stamp[v] = cluster;
+                    slot[v] = verts.getSize();
+                    verts.add(v);
+                    sum += s.posView[global[v]];
+                    for (int j = adjStart[v]; j < adjStart[v + 1]; j++)
+                    {
+                        int t = corners[j] / 3;
+                        if (!emitted[t] && queued[t] != cluster)
+                        {
+                            queued[t] = cluster;
+                            candidates.add(t);
+                        }
+                    }
+                }
+                out.triangles.add((U8)slot[v]);
+            }
+
+            if (out.triangles.getSize() / 3 - firstTri == s.maxTriangles)
+                break;
+
+            Vec3f center = sum * (1.0f / (F32)verts.getSize());
+            int bestNew = 3;
+            F32 bestScore = FW_F32_MAX;
+            tri = -1;
+            for (int i = 0; i < candidates.getSize();)
+            {
+                int t = candidates[i];
+                if (emitted[t])
                 {
-                    e.verts[c] = -1;
+                    candidates[i] = candidates.getLast();
+                    candidates.removeLast();
                     continue;
                 }
+                i++;
 
-                // Update the edge.
+                const Vec3i& lt = local[t];
+                int numNew = (stamp[lt.x] != cluster) + (stamp[lt.y] != cluster) + (stamp[lt.z] != cluster);
+                if (numNew > bestNew || verts.getSize() + numNew > s.maxVertices)
+                    continue;
 
-                Vertex& vo = verts[otherVertex];
-                vo.timeStamp = timeStamp;
-                e.verts[c] = vi;
+                int minLive = FW_S32_MAX;
+                for (int k = 0; k < 3; k++)
+                    if (stamp[lt[k]] != cluster)
+                        minLive = min(minLive, live[lt[k]]);
 
-                S32* prevSlot = &v.firstEdge;
-                if (*prevSlot == -1)
-                    e.next[c] = currEdge;
-                else
+                F32 score = (centroids[t] - center).lenSqr() * ((minLive <= 3) ? (F32)minLive : 6.0f);
+                if (numNew < bestNew || score < bestScore)
                 {
-                    prevSlot = &edges[*prevSlot].next[(edges[*prevSlot].verts.x == vi) ? 0 : 1];
-                    e.next[c] = *prevSlot;
+                    tri = t;
+                    bestNew = numNew;
+                    bestScore = score;
                 }
-                *prevSlot = currEdge;
+            }
+            if (tri == -1)
+                break;
+        }
+
+        out.vertexRange.add(Vec2i(out.vertices.getSize(), verts.getSize()));
+        out.triangleRange.add(Vec2i(firstTri, out.triangles.getSize() / 3 - firstTri));
+        for (int i = 0; i < verts.getSize(); i++)
+            out.vertices.add(global[verts[i]]);
+        out.spheres.add();
+        out.cones.add();
+        boundCluster(out, s.posView, cluster);
+    }
+}
 
-                // Add to the heap.
+//------------------------------------------------------------------------
 
-                F32 coef = length(v.pos - vo.pos) / (v.posWeight + vo.posWeight);
-                F32 error = max(v.error + vo.posWeight * coef, vo.error + v.posWeight * coef);
-                if (error <= maxError)
-                    edgeHeap.add(currEdge, error);
+void FW::boundCluster(MeshBase::Clusters& out, const AttribView<const Vec3f>& pos, int cluster)
+{
+    const S32* verts = out.vertices.getPtr(out.vertexRange[cluster].x);
+    const U8* tris = out.triangles.getPtr(out.triangleRange[cluster].x * 3);
+    int numVerts = out.vertexRange[cluster].y;
+    int numTris = out.triangleRange[cluster].y;
+
+    // Bounding sphere (Ritter): start from the farthest apart pair of
+    // axis extremes, then grow to cover the remaining points.
+
+    int lo[3] = { 0, 0, 0 };
+    int hi[3] = { 0, 0, 0 };
+    for (int i = 1; i < numVerts; i++)
+    for (int j = 0; j < 3; j++)
+    {
+        if (pos[verts[i]][j] < pos[verts[lo[j]]][j]) lo[j] = i;
+        if (pos[verts[i]][j] > pos[verts[hi[j]]][j]) hi[j] = i;
+    }
+
+    int axis = 0;
+    for (int j = 1; j < 3; j++)
+        if ((pos[verts[hi[j]]] - pos[verts[lo[j]]]).lenSqr() > (pos[verts[hi[axis]]] - pos[verts[lo[axis]]]).lenSqr())
+            axis = j;
+
+    Vec3f center = (pos[verts[lo[axis]]] + pos[verts[hi[axis]]]) * 0.5f;
+    F32 radius = (pos[verts[hi[axis]]] - center).length();
+    for (int i = 0; i < numVerts; i++)
+    {
+        F32 dist = (pos[verts[i]] - center).length();
+        if (dist > radius)
+        {
+            F32 grown = (radius + dist) * 0.5f;
+            center += (pos[verts[i]] - center) * ((grown - radius) / dist);
+            radius = grown;
+        }
+    }
+    out.spheres[cluster] = Vec4f(center, radius);
+
+    // Normal cone: the mean of the unit face normals, widened to the
+    // farthest one. Clusters that turn by 90 degrees or more are never
+    // culled.
+
+    Vec3f sum(0.0f);
+    for (int i = 0; i < numTris; i++)
+    {
+        const Vec3f& a = pos[verts[tris[i * 3 + 0]]];
+        Vec3f n = cross(pos[verts[tris[i * 3 + 1]]] - a, pos[verts[tris[i * 3 + 2]]] - a);
+        if (n.lenSqr() > 0.0f)
+            sum += n.normalized();
+    }
+
+    out.cones[cluster] = Vec4f(0.0f, 0.0f, 0.0f, 1.0f);
+    if (sum.lenSqr() == 0.0f)
+        return;
+
+    Vec3f coneAxis = sum.normalized();
+    F32 minDot = 1.0f;
+    for (int i = 0; i < numTris; i++)
+    {
+        const Vec3f& a = pos[verts[tris[i * 3 + 0]]];
+        Vec3f n = cross(pos[verts[tris[i * 3 + 1]]] - a, pos[verts[tris[i * 3 + 2]]] - a);
+        if (n.lenSqr() > 0.0f)
+            minDot = min(minDot, dot(n.normalized(), coneAxis));
+    }
+
+    if (minDot > 0.0f)
+        out.cones[cluster] = Vec4f(coneAxis, sqrt(max(1.0f - minDot * minDot, 0.0f)));
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::recomputeNormals(F32 creaseAngle)
+{
+    int posAttrib = findAttrib(AttribType_Position);
+    int normalAttrib = findAttrib(AttribType_Normal);
+    if (posAttrib == -1 || normalAttrib == -1)
+        return;
+
+    NormalState s;
+    s.mesh = this;
+    s.posAttrib = posAttrib;
+    s.posView = getAttribView<Vec3f>(posAttrib);
+    s.cosCrease = (creaseAngle < FW_PI) ? cos(max(creaseAngle, 0.0f)) : -1.0f;
+
+    // Weld positions: sort the vertices by position hash, then pick one
+    // representative per distinct position.
+
+    int num = numVertices();
+    s.pos.reset(num);
+    s.posKey.reset(num);
+    s.posOrder.reset(num);
+    s.rep.reset(num);
+    launchChunks(gatherPositions, s, num, CHUNK_SIZE);
+    radixSort(s.posKey.getPtr(), s.posOrder.getPtr(), num, 32, true);
+    launchChunks(weldPositions, s, num, CHUNK_SIZE);
+    s.posKey.reset();
+    s.posOrder.reset();
+
+    // Compute face normals and sort the corners by representative.
+
+    int numTris = 0;
+    for (int i = 0; i < numSubmeshes(); i++)
+        numTris += indices(i).getSize();
+
+    s.tris.setCapacity(numTris);
+    for (int i = 0; i < numSubmeshes(); i++)
+        s.tris.add(indices(i));
+
+    s.faceNormal.reset(numTris);
+    s.cornerKey.reset(numTris * 3);
+    s.cornerIdx.reset(numTris * 3);
+    launchChunks(computeFaceNormals, s, numTris, CHUNK_SIZE);
+
+    int repBits = 0;
+    while (((S64)1 << repBits) < num)
+        repBits++;
+    radixSort(s.cornerKey.getPtr(), s.cornerIdx.getPtr(), numTris * 3, repBits, true);
+
+    // Sum the face normals around each position.
+
+    s.repNormal.reset(num);
+    s.repUsed.reset(num);
+    memset(s.repUsed.getPtr(), 0, s.repUsed.getNumBytes());
+    if (s.cosCrease != -1.0f)
+        s.cornerNormal.reset(numTris * 3);
+    launchChunks(sumFaceNormals, s, numTris * 3, CHUNK_SIZE);
+
+    // Output smooth normals for every vertex whose position is used.
+
+    s.normalView = getMutableAttribView<Vec3f>(normalAttrib);
+    if (s.normalView.isValid())
+        launchChunks(writeNormals, s, num, CHUNK_SIZE);
+    else
+    {
+        for (int i = 0; i < num; i++)
+            if (s.repUsed[s.rep[i]])
+                setVertexAttrib(i, normalAttrib, Vec4f(s.repNormal[s.rep[i]], 0.0f));
+    }
+
+    if (s.cosCrease == -1.0f)
+        return;
+
+    // Creases => give each corner its own normal, duplicating a vertex for
+    // every distinct normal among the corners that use it.
+
+    Array<Vec3f> vertNormal(NULL, num);
+    Array<S32> nextDup(NULL, num);      // Chain of duplicates per vertex.
+    Array<S32> dupSource;
+    memset(nextDup.getPtr(), -1, nextDup.getNumBytes());
+    Array<U8> assigned(NULL, num);
+    memset(assigned.getPtr(), 0, assigned.getNumBytes());
+
+    for (int submeshIdx = 0, corner = 0; submeshIdx < numSubmeshes(); submeshIdx++)
+    {
+        Array<Vec3i>& inds = mutableIndices(submeshIdx);
+        for (int i = 0; i < inds.getSize(); i++)
+        for (int k = 0; k < 3; k++, corner++)
+        {
+            const Vec3f& normal = s.cornerNormal[corner];
+            int v = inds[i][k];
+            if (!assigned[v])
+            {
+                assigned[v] = 1;
+                vertNormal[v] = normal;
+                continue;
             }
+
+            int prev = v;
+            while (v != -1 && !equals<Vec3f>(vertNormal[v], normal))
+            {
+                prev = v;
+                v = nextDup[v];
+            }
+            if (v == -1)
+            {
+                v = num + dupSource.getSize();
+                dupSource.add(inds[i][k]);
+                nextDup[prev] = v;
+                nextDup.add(-1);
+                vertNormal.add(normal);
+            }
+            inds[i][k] = v;
         }
     }
 
-    // For each degenerate edge, remove triangle and group vertices.
+    resizeVertices(num + dupSource.getSize());
+    for (int i = 0; i < dupSource.getSize(); i++)
+        memcpy(getMutableVertexPtr(num + i), getVertexPtr(dupSource[i]), m_stride);
 
-    for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
+    s.normalView = getMutableAttribView<Vec3f>(normalAttrib);
+    for (int i = 0; i < numVertices(); i++)
+    {
+        if (i < num && !assigned[i])
+            continue;
+        if (s.normalView.isValid())
+            s.normalView[i] = vertNormal[i];
+        else
+            setVertexAttrib(i, normalAttrib, Vec4f(vertNormal[i], 0.0f));
+    }
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::flipTriangles(void)
+{
+    for (int i = 0; i < numSubmeshes(); i++)
+    {
+        Array<Vec3i>& tris = mutableIndices(i);
+        for (int j = 0; j < tris.getSize(); j++)
+            nvswap(tris[j].x, tris[j].y);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::clean(void)
+{
+    // Remove degenerate triangles and empty submeshes.
+
+    int submeshOut = 0;
+    for (int submeshIn = 0; submeshIn < numSubmeshes(); submeshIn++)
     {
-        Array<Vec3i>& tris = mutableIndices(submeshIdx);
-        for (int triIdx = tris.getSize() - 1; triIdx >= 0; triIdx--)
+        Array<Vec3i>& inds = mutableIndices(submeshIn);
+        int indOut = 0;
+        for (int i = 0; i < inds.getSize(); i++)
         {
-            const Vec3i& tri = tris[triIdx];
-            bool degen = false;
-            for (int i = 0; i < 3; i++)
+            const Vec3i& v = inds[i];
+            if (v.x != v.y && v.x != v.z && v.y != v.z)
+                inds[indOut++] = v;
+        }
+
+        if (indOut)
+        {
+            inds.resize(indOut);
+            if (submeshOut != submeshIn)
             {
-                int j = (i == 2) ? 0 : (i + 1);
-                if (posGroups[tri[i]] != posGroups[tri[j]])
-                    continue;
-                degen = true;
-                outGroups.unionSets(tri[i], tri[j]);
+                material(submeshOut) = material(submeshIn);
+                mutableIndices(submeshOut) = inds;
             }
-            if (degen)
-                tris.removeSwap(triIdx);
+            mutableIndices(submeshOut).compact();
+            submeshOut++;
         }
-        tris.compact();
+    }
+    resizeSubmeshes(submeshOut);
+
+    // Tag referenced vertices.
+
+    Array<U8> vertUsed;
+    vertUsed.reset(numVertices());
+    memset(vertUsed.getPtr(), 0, vertUsed.getNumBytes());
+
+    for (int submeshIn = 0; submeshIn < numSubmeshes(); submeshIn++)
+    {
+        const Array<Vec3i>& inds = indices(submeshIn);
+        for (int i = 0; i < inds.getSize(); i++)
+            for (int j = 0; j < 3; j++)
+                vertUsed[inds[i][j]] = 1;
     }
 
-    // Assign output vertices.
+    // Compact vertex array.
+
+    Array<S32> vertRemap;
+    vertRemap.reset(numVertices());
+    memset(vertRemap.getPtr(), -1, vertRemap.getNumBytes());
+    U8* vertPtr = getMutableVertexPtr();
+    int vertStride = vertexStride();
+
+    int vertOut = 0;
+    for (int vertIn = 0; vertIn < vertUsed.getSize(); vertIn++)
+    {
+        if (!vertUsed[vertIn])
+            continue;
+
+        vertRemap[vertIn] = vertOut;
+        if (vertOut != vertIn)
+            memcpy(vertPtr + vertOut * vertStride, vertPtr + vertIn * vertStride, vertStride);
+        vertOut++;
+    }
+    resizeVertices(vertOut);
+
+    // Remap indices.
+
+    for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
+    {
+        Array<Vec3i>& inds = mutableIndices(submeshIdx);
+        for (int i = 0; i < inds.getSize(); i++)
+            for (int j = 0; j < 3; j++)
+                inds[i][j] = vertRemap[inds[i][j]];
+    }
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::collapseVertices(void)
+{
+    if (numVertices() >= COLLAPSE_SORT_MIN)
+        collapseVertsSorted();
+    else
+        collapseVertsHashed();
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::collapseVertsHashed(void)
+{
+    // Collapse vertices. The hash keys point to the compacted copies, which
+    // are never overwritten.
+
+    int num = numVertices();
+    U8* vertPtr = getMutableVertexPtr();
+    int vertStride = vertexStride();
+
+    Hash<GenericHashKey, S32> hash;
+    Array<S32> remap;
+    hash.setCapacity(num);
+    remap.reset(num);
+
+    for (int i = 0; i < num; i++)
+    {
+        GenericHashKey key(vertPtr + i * vertStride, vertStride);
+        S32* found = hash.search(key);
+        if (found)
+            remap[i] = *found;
+        else
+        {
+            remap[i] = hash.getSize();
+            if (remap[i] != i)
+                memcpy(vertPtr + remap[i] * vertStride, vertPtr + i * vertStride, vertStride);
+            hash.add(GenericHashKey(vertPtr + remap[i] * vertStride, vertStride), remap[i]);
+        }
+    }
+
+    resizeVertices(hash.getSize());
+
+    // Remap indices.
+
+    for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
+    {
+        Array<Vec3i>& inds = mutableIndices(submeshIdx);
+        for (int i = 0; i < inds.getSize(); i++)
+            for (int j = 0; j < 3; j++)
+                inds[i][j] = remap[inds[i][j]];
+    }
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::collapseVertsSorted(void)
+{
+    CollapseState s;
+    int num = numVertices();
+    s.vertices = getVertexPtr();
+    s.stride = vertexStride();
+
+    // Sort the vertices by fingerprint and find the first of each distinct
+    // vertex. Fingerprint bits beyond what the vertex count needs would only
+    // add sorting passes, so they are dropped; the runs of equal keys must
+    // see the same bits as the sort. The rare collisions are resolved by
+    // comparing the vertices.
+
+    int keyBits = 16;
+    while (keyBits < 64 && ((S64)1 << (keyBits - 16)) < num)
+        keyBits++;
+    s.keyMask = (keyBits < 64) ? ((U64)1 << keyBits) - 1 : ~(U64)0;
+
+    s.key.reset(num);
+    s.order.reset(num);
+    s.remap.reset(num);
+    launchChunks(fingerprintVertices, s, num, CHUNK_SIZE);
+    radixSort(s.key.getPtr(), s.order.getPtr(), num, keyBits, true);
+    launchChunks(findFirstVertices, s, num, CHUNK_SIZE);
+    s.key.reset();
+    s.order.reset();
+    finishCollapse(*this, s);
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::weldVertices(F32 posTolerance, F32 normalTolerance, F32 texCoordTolerance)
+{
+    int posAttrib = findAttrib(AttribType_Position);
+    if (posAttrib == -1)
+        return;
+
+    int num = numVertices();
+    if (!num)
+        return;
+
+    WeldState s;
+    s.mesh              = this;
+    s.posAttrib         = posAttrib;
+    s.normalAttrib      = findAttrib(AttribType_Normal);
+    s.texCoordAttrib    = findAttrib(AttribType_TexCoord);
+    s.posTol2           = sqr(max(posTolerance, 0.0f));
+    s.normalTol2        = sqr(max(normalTolerance, 0.0f));
+    s.texCoordTol2      = sqr(max(texCoordTolerance, 0.0f));
+    s.vertices          = getVertexPtr();
+    s.stride            = vertexStride();
+
+    for (int i = 0; i < numAttribs(); i++)
+        if (i != s.posAttrib && i != s.normalAttrib && i != s.texCoordAttrib)
+            s.exact.add(Vec2i(attribSpec(i).offset, attribSpec(i).bytes));
+
+    // Cells are at least as wide as the tolerance (a little wider, so that
+    // rounding cannot put two vertices within it two cells apart), and
+    // there are few enough of them per axis to pack a cell into a key.
+    // Tight keys save radix sort passes.
+
+    Vec3f lo, hi;
+    getBBox(lo, hi);
+    F32 extent = (hi - lo).max();
+    F32 cellSize = max(posTolerance * 1.01f, extent / (F32)((1 << WELD_CELL_BITS) - 2));
+    s.gridLo = lo;
+    s.invCellSize = (cellSize > 0.0f) ? 1.0f / cellSize : 1.0f;
+    s.cellBits = 1;
+    while (s.cellBits < WELD_CELL_BITS && (F32)(1 << s.cellBits) <= extent * s.invCellSize + 1.0f)
+        s.cellBits++;
+
+    // Bin the vertices and find the pairs within tolerance, in parallel
+    // over slabs of cells.
+
+    s.pos.reset(num);
+    if (s.normalAttrib != -1)
+        s.normal.reset(num);
+    if (s.texCoordAttrib != -1)
+        s.texCoord.reset(num);
+    s.key.reset(num);
+    s.order.reset(num);
+    launchChunks(gatherWeldAttribs, s, num, CHUNK_SIZE);
+    radixSort(s.key.getPtr(), s.order.getPtr(), num, 3 * s.cellBits, true);
+
+    s.pairs.reset(maxChunks());
+    launchChunks(findWeldPairs, s, num, CHUNK_SIZE);
+    s.key.reset();
+    s.order.reset();
+
+    // Cluster: by position alone, and by all attributes.
+
+    UnionFind posGroups(num);
+    UnionFind allGroups(num);
+    for (int i = 0; i < s.numChunks; i++)
+    {
+        const Array<Vec3i>& pairs = s.pairs[i];
+        for (int j = 0; j < pairs.getSize(); j++)
+        {
+            posGroups.unionSets(pairs[j].x, pairs[j].y);
+            if (pairs[j].z)
+                allGroups.unionSets(pairs[j].x, pairs[j].y);
+        }
+    }
+    s.pairs.reset();
+
+    // Snap positions to the lowest-index vertex of their cluster, then
+    // collapse each cluster of all attributes into its lowest-index vertex.
+
+    const AttribSpec& posSpec = attribSpec(posAttrib);
+    U8* vertPtr = getMutableVertexPtr();
+    Array<S32> first(NULL, num);
+    memset(first.getPtr(), -1, first.getNumBytes());
+    for (int i = 0; i < num; i++)
+    {
+        S32& f = first[posGroups[i]];
+        if (f == -1)
+            f = i;
+        else
+            memcpy(vertPtr + (size_t)i * s.stride + posSpec.offset, vertPtr + (size_t)f * s.stride + posSpec.offset, posSpec.bytes);
+    }
+
+    s.remap.reset(num);
+    memset(first.getPtr(), -1, first.getNumBytes());
+    for (int i = 0; i < num; i++)
+    {
+        S32& f = first[allGroups[i]];
+        if (f == -1)
+            f = i;
+        s.remap[i] = (f == i) ? i : ~f;
+    }
+
+    s.vertices = vertPtr;
+    finishCollapse(*this, s);
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::optimizeVertexFetch(bool spatialSort)
+{
+    FetchState s;
+    int num = numVertices();
+    s.stride = vertexStride();
+
+    // Sort the triangles of each submesh along a Morton curve through
+    // their centroids.
+
+    int posAttrib = findAttrib(AttribType_Position);
+    if (spatialSort && posAttrib != -1 && num)
+    {
+        Array<Vec3f> pos;
+        s.posView = getAttribView<Vec3f>(posAttrib);
+        if (!s.posView.isValid())
+        {
+            pos.reset(num);
+            for (int i = 0; i < num; i++)
+                pos[i] = getVertexAttrib(i, posAttrib).getXYZ();
+            s.posView = AttribView<const Vec3f>(pos.getPtr(), sizeof(Vec3f), num);
+        }
+
+        Vec3f lo, hi;
+        getBBox(lo, hi);
+        F32 extent = (hi - lo).max();
+        s.gridLo = lo;
+        s.gridScale = (extent > 0.0f) ? 1023.0f / extent : 0.0f;
+
+        for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
+        {
+            s.tris = &mutableIndices(submeshIdx);
+            int numTris = s.tris->getSize();
+            s.triKey.reset(numTris);
+            s.triOrder.reset(numTris);
+            s.triOut.reset(numTris);
+            launchChunks(mortonTriangles, s, numTris, CHUNK_SIZE);
+            radixSort(s.triKey.getPtr(), s.triOrder.getPtr(), numTris, 30, true);
+            launchChunks(permuteTriangles, s, numTris, CHUNK_SIZE);
+            memcpy(s.tris->getPtr(), s.triOut.getPtr(), s.triOut.getNumBytes());
+        }
+        s.triKey.reset();
+        s.triOrder.reset();
+        s.triOut.reset();
+    }
+
+    // Number the vertices in order of first use; unused ones go last. This
+    // is one sequential pass over the indices; the copying is parallel.
+
+    s.order.reset(num);
+    s.remap.reset(num);
+    memset(s.remap.getPtr(), -1, s.remap.getNumBytes());
+    int numOut = 0;
 
-    int numOutVerts = 0;
     for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
     {
-        Array<Vec3i>& tris = mutableIndices(submeshIdx);
-        for (int triIdx = 0; triIdx < tris.getSize(); triIdx++)
+        const Array<Vec3i>& inds = indices(submeshIdx);
+        for (int i = 0; i < inds.getSize(); i++)
+        for (int j = 0; j < 3; j++)
         {
-            Vec3i& tri = tris[triIdx];
-            for (int i = 0; i < 3; i++)
+            S32& r = s.remap[inds[i][j]];
+            if (r == -1)
             {
-                S32& idx = verts[outGroups[tri[i]]].outIdx;
-                if (idx == -1)
-                    idx = numOutVerts++;
-                tri[i] = idx;
+                r = numOut;
+                s.order[numOut++] = inds[i][j];
             }
         }
     }
 
-    // Initialize output vertices.
+    bool identity = true;
+    for (int i = 0; i < num; i++)
+    {
+        if (s.remap[i] == -1)
+        {
+            s.remap[i] = numOut;
+            s.order[numOut++] = i;
+        }
+        identity = (identity && s.remap[i] == i);
+    }
+    if (identity)
+        return;
 
-    int numAttrib = numAttribs();
-    Array<Vec4f> outAttribs(NULL, numOutVerts * numAttrib);
-    Array<F32> outDenom(NULL, numOutVerts);
-    memset(outAttribs.getPtr(), 0, outAttribs.getNumBytes());
-    memset(outDenom.getPtr(), 0, outDenom.getNumBytes());
+    s.vertices = getVertexPtr();
+    s.out.reset(num * s.stride);
+    launchChunks(permuteVertices, s, num, CHUNK_SIZE);
+    memcpy(getMutableVertexPtr(), s.out.getPtr(), s.out.getNumBytes());
+    s.out.reset();
 
-    // Accumulate vertex attributes.
+    for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
+    {
+        s.tris = &mutableIndices(submeshIdx);
+        launchChunks(remapIndices, s, s.tris->getSize(), CHUNK_SIZE);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::buildClusters(int maxVertices, int maxTriangles)
+{
+    FW_ASSERT(maxVertices >= 3 && maxVertices <= 256);
+    FW_ASSERT(maxTriangles >= 1 && maxTriangles <= 256);
+    m_clusters.clear();
 
-    for (int i = 0; i < verts.getSize(); i++)
+    int posAttrib = findAttrib(AttribType_Position);
+    if (posAttrib == -1)
+        return;
+
+    ClusterState s;
+    Array<Vec3f> pos;
+    s.mesh = this;
+    s.posView = getAttribView<Vec3f>(posAttrib);
+    s.maxVertices = maxVertices;
+    s.maxTriangles = maxTriangles;
+    s.parts.reset(numSubmeshes());
+
+    if (!s.posView.isValid())
     {
-        const Vertex& v = verts[outGroups[i]];
-        if (v.outIdx == -1 || v.outWeight == 0.0f)
-            continue;
+        pos.reset(numVertices());
+        for (int i = 0; i < numVertices(); i++)
+            pos[i] = getVertexAttrib(i, posAttrib).getXYZ();
+        s.posView = AttribView<const Vec3f>(pos.getPtr(), sizeof(Vec3f), numVertices());
+    }
 
-        Vec4f* ptr = outAttribs.getPtr(v.outIdx * numAttrib);
-        for (int j = 0; j < numAttrib; j++)
-            if (j == posAttrib)
-                ptr[j] = Vec4f(verts[posGroups[i]].pos, 1.0f);
-            else
-                ptr[j] += getVertexAttrib(i, j) * v.outWeight;
-        outDenom[v.outIdx] += v.outWeight;
+    if (numSubmeshes() > 1)
+        MulticoreLauncher().push(buildSubmeshClusters, &s, 0, numSubmeshes()).popAll();
+    else if (numSubmeshes() == 1)
+    {
+        MulticoreLauncher::Task task;
+        task.data = &s;
+        task.idx = 0;
+        buildSubmeshClusters(task);
+    }
+
+    // Concatenate the submeshes' clusters.
+
+    Clusters& c = m_clusters;
+    for (int i = 0; i < numSubmeshes(); i++)
+    {
+        const Clusters& part = s.parts[i];
+        int firstVertex = c.vertices.getSize();
+        int firstTri = c.triangles.getSize() / 3;
+
+        c.submeshStart.add(c.numClusters());
+        for (int j = 0; j < part.numClusters(); j++)
+        {
+            c.vertexRange.add(part.vertexRange[j] + Vec2i(firstVertex, 0));
+            c.triangleRange.add(part.triangleRange[j] + Vec2i(firstTri, 0));
+        }
+        c.vertices.add(part.vertices);
+        c.triangles.add(part.triangles);
+        c.spheres.add(part.spheres);
+        c.cones.add(part.cones);
+    }
+    c.submeshStart.add(c.numClusters());
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::buildLods(int numLevels, F32 ratio)
+{
+    FW_ASSERT(numLevels >= 1);
+    FW_ASSERT(ratio > 0.0f && ratio < 1.0f);
+    m_lods.clear();
+    freeVBO();
+
+    int numTris = numTriangles();
+    if (findAttrib(AttribType_Position) == -1 || !numTris)
+        return;
+
+    // Each level simplifies the one before, sliding vertices onto their
+    // neighbors so that the vertex buffer stays as it is. A level may be
+    // as far from the one before as the larger of its quadric error and
+    // the sampled surface distance; the errors add up along the chain.
+
+    MeshBase work(*this);
+    SimplifyParams params;
+    params.keepVertices = true;
+    params.distanceSamples = LOD_SAMPLES;
+
+    F32 error = 0.0f;
+    F64 target = numTris;
+    for (int level = 1; level < numLevels; level++)
+    {
+        target *= ratio;
+        params.targetTriangles = max((int)target, 1);
+        SimplifyReport report = simplifyQuadric(work, params);
+
+        // Stalled => the rest would be near copies.
+
+        if ((F32)report.outputTriangles > (F32)report.inputTriangles * LOD_MIN_REDUCTION)
+            break;
+
+        error += max(report.maxError, report.distance.getHausdorff());
+        for (int i = 0; i < numSubmeshes(); i++)
+        {
+            m_lods.ranges.add(Vec2i(m_lods.triangles.getSize(), work.indices(i).getSize()));
+            m_lods.triangles.add(work.indices(i));
+        }
+        m_lods.errors.add(error);
+    }
+}
+
+//------------------------------------------------------------------------
+
+int MeshBase::selectLod(const Mat4f& posToCamera, const Mat4f& projection, F32 viewportHeight, F32 pixelError) const
+{
+    Vec3f lo, hi;
+    getBBox(lo, hi);
+    if (m_lods.numLevels() == 1 || lo.x > hi.x)
+        return 0;
+
+    // Bounding sphere in camera space; scaling the mesh scales the errors
+    // too.
+
+    Mat3f m = posToCamera.getXYZ();
+    F32 scale = sqrt(max(m.getCol(0).lenSqr(), m.getCol(1).lenSqr(), m.getCol(2).lenSqr()));
+    Vec3f center = (posToCamera * Vec4f((lo + hi) * 0.5f, 1.0f)).getXYZ();
+    F32 radius = (hi - lo).length() * 0.5f * scale;
+
+    // Pixels per mesh unit at the near side of the sphere. The clip w of a
+    // perspective projection grows with the depth, that of an orthographic
+    // one does not. Eye inside the sphere => full detail.
+
+    F32 depth = -center.z - radius;
+    F32 w = projection.get(3, 2) * -depth + projection.get(3, 3);
+    if ((depth <= 0.0f && projection.get(3, 2) != 0.0f) || w <= 0.0f)
+        return 0;
+
+    F32 pixelsPerUnit = abs(projection.get(1, 1)) * viewportHeight * 0.5f * scale / w;
+    int level = 0;
+    while (level + 1 < m_lods.numLevels() && m_lods.getError(level + 1) * pixelsPerUnit <= pixelError)
+        level++;
+    return level;
+}
+
+//------------------------------------------------------------------------
+
+void MeshBase::dupVertsPerSubmesh(void)
+{
+    // Find shared vertices and remap indices.
+
+    int num = numVertices();
+    Array<Vec2i> remap;
+    Array<S32> dup;
+    remap.reset(num);
+    memset(remap.getPtr(), -1, remap.getNumBytes());
+
+    for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
+    {
+        Array<Vec3i>& inds = mutableIndices(submeshIdx);
+        for (int i = 0; i < inds.getSize(); i++)
+        for (int j = 0; j < 3; j++)
+        {
+            int v = inds[i][j];
+            if (remap[v].x != submeshIdx)
+            {
+                remap[v].x = submeshIdx;
+                if (remap[v].y == -1)
+                    remap[v].y = v;
+                else
+                {
+                    remap[v].y = num + dup.getSize();
+                    dup.add(v);
+                }
+            }
+            inds[i][j] = remap[v].y;
+        }
     }
 
-    // Output vertices.
+    // Duplicate vertices.
+
+    resizeVertices(num + dup.getSize());
+    U8* vertPtr = getMutableVertexPtr();
+    int vertStride = vertexStride();
+
+    for (int i = 0; i < dup.getSize(); i++)
+        memcpy(vertPtr + (num + i) * vertStride, vertPtr + dup[i] * vertStride, vertStride);
+}
+
+//------------------------------------------------------------------------
 
-    resetVertices(numOutVerts);
-    for (int i = 0; i < numOutVerts; i++)
+void MeshBase::fixMaterialColors(void)
+{
+    for (int submeshIdx = 0; submeshIdx < numSubmeshes(); submeshIdx++)
     {
-        const Vec4f* ptr = outAttribs.getPtr(i * numAttrib);
-        F32 coef = 1.0f / outDenom[i];
-        for (int j = 0; j < numAttrib; j++)
+        Material& mat = material(submeshIdx);
+        Texture tex = mat.textures[TextureType_Diffuse];
+        if (tex.exists())
         {
-            Vec4f v = ptr[j];
-            if (j == normalAttrib)
-                v = Vec4f(normalize(v.getXYZ()), 0.0f);
-            else if (j != posAttrib)
-                v *= coef;
-            setVertexAttrib(i, j, v);
+            Vec4f avg = tex.getMipLevel(64).getImage()->getVec4f(0);
+            mat.diffuse = Vec4f(avg.getXYZ(), mat.diffuse.w);
         }
     }
 }
 
 //------------------------------------------------------------------------
 
+void MeshBase::simplify(F32 maxError)
+{
+    SimplifyParams params;
+    params.maxError = maxError;
+    simplifyQuadric(*this, params);
+}
+
+//------------------------------------------------------------------------
+
 void FW::addCubeToMesh(Mesh<VertexPNC>& mesh, int submesh, const Vec3f& lo, const Vec3f& hi, const Vec4f& color, bool forceNormal, const Vec3f& normal)
 {
     VertexPNC vertexArray[] =
@@ -1257,9 +2481,13 @@ MeshBase* FW::importMesh(const String& fileName)
     String lower = fileName.toLower();
 
 #define STREAM(CALL) { File file(fileName, File::Read); BufferedInputStream stream(file); return CALL; }
+#define MAPPED(CALL) { MappedFile file(fileName); return CALL; }
     if (lower.endsWith(".bin")) STREAM(importBinaryMesh(stream))
-    if (lower.endsWith(".obj")) STREAM(importWavefrontMesh(stream, fileName))
+    if (lower.endsWith(".obj")) MAPPED(importWavefrontMesh(file))
+    if (lower.endsWith(".ply")) STREAM(importPlyMesh(stream))
+    if (lower.endsWith(".pmesh")) STREAM(importProgressiveMesh(stream))
 #undef STREAM
+#undef MAPPED
 
     setError("importMesh(): Unsupported file extension '%s'!", fileName.getPtr());
     return NULL;
@@ -1275,6 +2503,8 @@ void FW::exportMesh(const String& fileName, const MeshBase* mesh)
 #define STREAM(CALL) { File file(fileName, File::Create); BufferedOutputStream stream(file); CALL; stream.flush(); return; }
     if (lower.endsWith(".bin")) STREAM(exportBinaryMesh(stream, mesh))
     if (lower.endsWith(".obj")) STREAM(exportWavefrontMesh(stream, mesh, fileName))
+    if (lower.endsWith(".ply")) STREAM(exportPlyMesh(stream, mesh))
+    if (lower.endsWith(".pmesh")) STREAM(exportProgressiveMesh(stream, mesh))
 #undef STREAM
 
     setError("exportMesh(): Unsupported file extension '%s'!", fileName.getPtr());
@@ -1286,7 +2516,9 @@ String FW::getMeshImportFilter(void)
 {
     return
         "obj:Wavefront Mesh,"
-        "bin:Binary Mesh";
+        "ply:Stanford Triangle Format,"
+        "bin:Binary Mesh,"
+        "pmesh:Progressive Mesh";
 }
 
 //------------------------------------------------------------------------
@@ -1295,7 +2527,9 @@ String FW::getMeshExportFilter(void)
 {
     return
         "obj:Wavefront Mesh,"
-        "bin:Binary Mesh";
+        "ply:Stanford Triangle Format,"
+        "bin:Binary Mesh,"
+        "pmesh:Progressive Mesh";
 }
 
 //------------------------------------------------------------------------
@@ -28,9 +28,34 @@
 #pragma once
 #include "3d/Texture.hpp"
 #include "gpu/GLContext.hpp"
+#include "base/Thread.hpp"
 
 namespace FW
 {
+//------------------------------------------------------------------------
+// Typed view of one vertex attribute across all vertices, e.g.
+// AttribView<Vec3f> for F32 positions. Obtain it once per bulk operation
+// instead of calling getVertexAttrib() per vertex. A nonzero Stride fixes
+// the distance between vertices at compile time, see Mesh<V>.
+
+template <class T, int Stride = 0> class AttribView
+{
+public:
+                        AttribView          (void)                          : m_ptr(NULL), m_stride(0), m_size(0) {}
+                        AttribView          (T* ptr, int stride, int size)  : m_ptr((U8*)ptr), m_stride(stride), m_size(size) { FW_ASSERT(stride > 0 && (!Stride || stride == Stride)); }
+
+    bool                isValid             (void) const                    { return (m_stride != 0); }
+    int                 getSize             (void) const                    { return m_size; }
+    int                 getStride           (void) const                    { return (Stride) ? Stride : m_stride; }
+    T&                  get                 (int idx) const                 { FW_ASSERT(idx >= 0 && idx < m_size); return *(T*)(m_ptr + idx * getStride()); }
+    T&                  operator[]          (int idx) const                 { return get(idx); }
+
+private:
+    U8*                 m_ptr;
+    S32                 m_stride;
+    S32                 m_size;
+};
+
 //------------------------------------------------------------------------
 
 class MeshBase
@@ -96,6 +121,44 @@ public:
         }
     };
 
+    // Meshlets: small groups of triangles, each with its own vertex list
+    // and bounds, for cluster culling and mesh shaders. The clusters of
+    // submesh i are [submeshStart[i], submeshStart[i + 1]). Built by
+    // buildClusters(); dropped when the indices, the vertex count or the
+    // positions (via xformPositions()) change.
+
+    struct Clusters
+    {
+        Array<S32>      submeshStart;   // [submesh + 1]
+        Array<Vec2i>    vertexRange;    // [cluster] (first, count) in vertices.
+        Array<Vec2i>    triangleRange;  // [cluster] (first, count) in triangles.
+        Array<S32>      vertices;       // Mesh vertex indices.
+        Array<U8>       triangles;      // 3 per triangle, relative to the cluster's first vertex.
+        Array<Vec4f>    spheres;        // [cluster] (center, radius)
+        Array<Vec4f>    cones;          // [cluster] (axis, sine of the normals' spread); 1 => never backfacing.
+
+        int             numClusters     (void) const                    { return spheres.getSize(); }
+        void            clear           (void)                          { submeshStart.reset(); vertexRange.reset(); triangleRange.reset(); vertices.reset(); triangles.reset(); spheres.reset(); cones.reset(); }
+        bool            isBackfacing    (int cluster, const Vec3f& eye) const { const Vec4f& c = cones[cluster]; const Vec4f& b = spheres[cluster]; Vec3f d = b.getXYZ() - eye; return (c.w < 1.0f && dot(d, c.getXYZ()) >= c.w * d.length() + b.w); }
+    };
+
+    // Discrete levels of detail: coarser index sets over the same vertex
+    // buffer, each with the largest distance from the full mesh that it
+    // may show, in mesh units. Level 0 is the mesh itself and is not
+    // stored. Built by buildLods() or LodBuilder; dropped with the
+    // clusters.
+
+    struct Lods
+    {
+        Array<Vec2i>    ranges;         // [(level - 1) * numSubmeshes + submesh] (first, count) in triangles.
+        Array<Vec3i>    triangles;      // Mesh vertex indices.
+        Array<F32>      errors;         // [level - 1] Increasing.
+
+        int             numLevels       (void) const                    { return errors.getSize() + 1; }
+        F32             getError        (int level) const               { return (level > 0) ? errors[level - 1] : 0.0f; }
+        void            clear           (void)                          { ranges.reset(); triangles.reset(); errors.reset(); }
+    };
+
 private:
     struct Submesh
     {
@@ -129,7 +192,7 @@ public:
     void                clearVertices       (void)                          { resizeVertices(0); }
     void                resizeVertices      (int num);
     const U8*           getVertexPtr        (int idx = 0) const             { FW_ASSERT(isInMemory() && idx >= 0 && idx <= numVertices()); return m_vertices.getPtr() + idx * m_stride; }
-    U8*                 getMutableVertexPtr (int idx = 0)                   { FW_ASSERT(isInMemory() && idx >= 0 && idx <= numVertices()); freeVBO(); return m_vertices.getPtr() + idx * m_stride; }
+    U8*                 getMutableVertexPtr (int idx = 0)                   { FW_ASSERT(isInMemory() && idx >= 0 && idx <= numVertices()); freeVBO(); m_bboxVersion++; return m_vertices.getPtr() + idx * m_stride; }
     const U8*           vertex              (int idx) const                 { FW_ASSERT(isInMemory() && idx >= 0 && idx < numVertices()); return getVertexPtr(idx); }
     U8*                 mutableVertex       (int idx)                       { FW_ASSERT(isInMemory() && idx >= 0 && idx < numVertices()); return getMutableVertexPtr(idx); }
     void                setVertex           (int idx, const void* ptr)      { setVertices(idx, ptr, 1); }
@@ -138,13 +201,19 @@ public:
     U8*                 addVertices         (const void* ptr, int num)      { FW_ASSERT(isInMemory() && num >= 0); freeVBO(); m_numVertices += num; U8* slot = m_vertices.add(NULL, num * m_stride); if (ptr) memcpy(slot, ptr, num * m_stride); return slot; }
     Vec4f               getVertexAttrib     (int idx, int attrib) const;
     void                setVertexAttrib     (int idx, int attrib, const Vec4f& v);
+    bool                isViewable          (int attrib, int bytes) const   { return (attrib >= 0 && attrib < numAttribs() && attribSpec(attrib).format == AttribFormat_F32 && attribSpec(attrib).length * (int)sizeof(F32) >= bytes); }
+
+    // The views are invalid unless isViewable(attrib, sizeof(T)). They stay
+    // usable until the vertex array is resized.
+    template <class T, int Stride = 0> AttribView<const T, Stride> getAttribView(int attrib) const { FW_ASSERT(isInMemory()); if (!isViewable(attrib, sizeof(T))) return AttribView<const T, Stride>(); return AttribView<const T, Stride>((const T*)(m_vertices.getPtr() + attribSpec(attrib).offset), m_stride, m_numVertices); }
+    template <class T, int Stride = 0> AttribView<T, Stride> getMutableAttribView(int attrib) { FW_ASSERT(isInMemory()); if (!isViewable(attrib, sizeof(T))) return AttribView<T, Stride>(); freeVBO(); if (attribSpec(attrib).type == AttribType_Position) m_bboxVersion++; return AttribView<T, Stride>((T*)(m_vertices.getPtr() + attribSpec(attrib).offset), m_stride, m_numVertices); }
 
     int                 numSubmeshes        (void) const                    { return m_submeshes.getSize(); }
     int                 numTriangles        (void) const                    { int res = 0; for (int i = 0; i < m_submeshes.getSize(); i++) res += m_submeshes[i].indices->getSize(); return res; }
     void                resizeSubmeshes     (int num);
     void                clearSubmeshes      (void)                          { resizeSubmeshes(0); }
     const Array<Vec3i>& indices             (int submesh) const             { FW_ASSERT(isInMemory()); return *m_submeshes[submesh].indices; }
-    Array<Vec3i>&       mutableIndices      (int submesh)                   { FW_ASSERT(isInMemory()); freeVBO(); return *m_submeshes[submesh].indices; }
+    Array<Vec3i>&       mutableIndices      (int submesh)                   { FW_ASSERT(isInMemory()); freeVBO(); m_clusters.clear(); m_lods.clear(); m_submeshBBoxes[submesh].numVertices = -1; return *m_submeshes[submesh].indices; }
     void                setIndices          (int submesh, const Vec3i* ptr, int size) { mutableIndices(submesh).set(ptr, size); }
     void                setIndices          (int submesh, const S32* ptr, int size) { FW_ASSERT(size % 3 == 0); mutableIndices(submesh).set((const Vec3i*)ptr, size / 3); }
     void                setIndices          (int submesh, const Array<Vec3i>& v) { mutableIndices(submesh).set(v); }
@@ -159,7 +228,7 @@ public:
     int                 vboIndexSize        (int submesh)                   { getVBO(); return m_submeshes[submesh].sizeInVBO; }
 
     void                setGLAttrib         (GLContext* gl, int attrib, int loc);
-    void                draw                (GLContext* gl, const Mat4f& posToCamera, const Mat4f& projection, GLContext::Program* prog = NULL, bool gouraud = false);
+    void                draw                (GLContext* gl, const Mat4f& posToCamera, const Mat4f& projection, GLContext::Program* prog = NULL, bool gouraud = false, int lod = -1); // lod = -1 => selectLod() for one pixel of error in the current viewport.
     void                drawTEST            (GLContext* gl, const Mat4f& posToCamera, const Mat4f& projection, GLContext::Program* prog = NULL, bool gouraud = false);
 
     bool                isInMemory          (void) const                    { return m_isInMemory; }
@@ -171,14 +240,32 @@ public:
     void                xformNormals        (const Mat3f& mat, bool normalize = true);
     void                xform               (const Mat4f& mat)              { xformPositions(mat); xformNormals(mat.getXYZ().transposed().inverted()); }
 
+    // Bounds of all vertices, or of those used by a submesh; empty boxes
+    // have lo > hi. Cached, and dropped by the same calls that drop the
+    // VBO, except that added vertices only extend the mesh's box. Writes
+    // through pointers kept from before a call are not noticed.
     void                getBBox             (Vec3f& lo, Vec3f& hi) const;
-    void                recomputeNormals    (void);
+    void                getSubmeshBBox      (int submesh, Vec3f& lo, Vec3f& hi) const;
+    void                recomputeNormals    (F32 creaseAngle = FW_PI);      // Smooth; split where face normals differ by more than creaseAngle (radians).
     void                flipTriangles       (void);
     void                clean               (void);                         // Remove empty submeshes, degenerate triangles, and unreferenced vertices.
-    void                collapseVertices    (void);                         // Collapse duplicate vertices.
+    void                collapseVertices    (void);                         // Collapse duplicate vertices. Picks one of the below by size.
+    void                collapseVertsHashed (void);                         // Serial, with a hash table.
+    void                collapseVertsSorted (void);                         // Parallel, by radix sorting vertex fingerprints.
+    void                weldVertices        (F32 posTolerance, F32 normalTolerance = 0.0f, F32 texCoordTolerance = 0.0f); // Snap positions within tolerance together, then collapse vertices whose normals and texcoords are within their tolerances. May leave degenerate triangles.
+    void                optimizeVertexFetch (bool spatialSort = false);     // Renumber vertices in order of first use. Optionally sort each submesh's triangles along a Morton curve first.
     void                dupVertsPerSubmesh  (void);                         // If a vertex is shared between multiple submeshes, duplicate it for each.
     void                fixMaterialColors   (void);                         // If a material is textured, override diffuse color with average over texels.
-    void                simplify            (F32 maxError);                 // Collapse short edges. Do not allow vertices to drift more than maxError.
+    void                simplify            (F32 maxError);                 // Quadric error simplification up to maxError; see simplifyQuadric() for more control.
+
+    const Clusters&     clusters            (void) const                    { return m_clusters; }
+    void                setClusters         (const Clusters& clusters)      { m_clusters = clusters; }
+    void                buildClusters       (int maxVertices = 64, int maxTriangles = 124); // Greedy over triangle adjacency, one task per submesh. Limits are at most 256.
+
+    const Lods&         lods                (void) const                    { return m_lods; }
+    void                setLods             (const Lods& lods)              { freeVBO(); m_lods = lods; }
+    void                buildLods           (int numLevels = 5, F32 ratio = 0.5f); // Each level keeps 'ratio' of the triangles of the one before; fewer levels if simplification stalls.
+    int                 selectLod           (const Mat4f& posToCamera, const Mat4f& projection, F32 viewportHeight, F32 pixelError) const; // Coarsest level whose error projects to at most pixelError pixels at the near side of the bounding sphere.
 
     const U8*           operator[]          (int vidx) const                { return vertex(vidx); }
     U8*                 operator[]          (int vidx)                      { return mutableVertex(vidx); }
@@ -186,7 +273,16 @@ public:
     MeshBase&           operator+=          (const MeshBase& other)         { append(other); return *this; }
 
 private:
-    void                init                (void)                          { m_stride = 0; m_numVertices = 0; m_isInMemory = true; m_isInVBO = false; }
+    void                init                (void)                          { m_stride = 0; m_numVertices = 0; m_isInMemory = true; m_isInVBO = false; m_lodsOfsInVBO = 0; m_bboxVersion = 0; m_bbox.version = ~0u; }
+    void                boundVertices       (Vec3f& lo, Vec3f& hi, int first, const S32* indices, int numIndices) const;
+
+    struct BBoxCache
+    {
+        Vec3f           lo;
+        Vec3f           hi;
+        S32             numVertices;        // Covered by the mesh's box; -1 if a submesh's box is stale.
+        U32             version;            // m_bboxVersion when computed.
+    };
 
 private:
     S32                 m_stride;           // Bytes per vertex in m_vertices and m_vbo.
@@ -198,6 +294,14 @@ private:
     Array<U8>           m_vertices;
     Array<Submesh>      m_submeshes;
     Buffer              m_vbo;
+    Clusters            m_clusters;         // Empty unless built or imported.
+    Lods                m_lods;             // Same.
+    S32                 m_lodsOfsInVBO;
+
+    U32                 m_bboxVersion;      // Bumped whenever positions may change.
+    mutable Spinlock    m_bboxLock;         // Guards the caches below.
+    mutable BBoxCache   m_bbox;
+    mutable Array<BBoxCache> m_submeshBBoxes; // [submesh]
 };
 
 //------------------------------------------------------------------------
@@ -218,6 +322,8 @@ public:
     V&                  addVertex           (const V& value)                { V* slot = (V*)MeshBase::addVertex(NULL); *slot = value; return *slot; }
     V&                  addVertex           (void)                          { return *(V*)MeshBase::addVertex(NULL); }
     V*                  addVertices         (const V* ptr, int num)         { V* slot = (V*)MeshBase::addVertices(ptr, num); if (ptr) for (int i = 0; i < num; i++) slot[i] = ptr[i]; return slot; }
+    template <class T> AttribView<const T, sizeof(V)> getAttribView(int attrib) const { return MeshBase::getAttribView<T, sizeof(V)>(attrib); }
+    template <class T> AttribView<T, sizeof(V)> getMutableAttribView(int attrib) { return MeshBase::getMutableAttribView<T, sizeof(V)>(attrib); }
 
     const V&            operator[]          (int vidx) const                { return vertex(vidx); }
     V&                  operator[]          (int vidx)                      { return mutableVertex(vidx); }
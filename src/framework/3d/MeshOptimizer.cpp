@@ -0,0 +1,458 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "3d/MeshOptimizer.hpp"
+#include "base/MulticoreLauncher.hpp"
+#include "base/Sort.hpp"
+
+using namespace FW;
+
+//------------------------------------------------------------------------
+
+namespace FW
+{
+
+struct TriangleOrderState
+{
+    MeshBase*               mesh;
+    S32                     cacheSize;
+    F32                     overdrawThreshold;
+    Array<Vec3f>            positions;      // [vertex] Empty unless optimizing overdraw.
+    Array<Array<Vec3i>*>    tris;           // [submesh]
+    Array<VertexCacheStats> before;         // [submesh]
+    Array<VertexCacheStats> after;          // [submesh]
+    Array<S32>              numClusters;    // [submesh]
+};
+
+static int      cacheMisses         (Array<S32>& stamps, S32& time, int cacheSize, const Vec3i& tri);
+static U32      descendingKey       (F32 v);
+static void     optimizeSubmesh     (MulticoreLauncher::Task& task);
+
+}
+
+//------------------------------------------------------------------------
+
+int FW::cacheMisses(Array<S32>& stamps, S32& time, int cacheSize, const Vec3i& tri)
+{
+    // A vertex is in the FIFO if fewer than cacheSize vertices have been
+    // inserted after it. Advancing 'time' by cacheSize + 1 flushes it.
+
+    int misses = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        S32& stamp = stamps[tri[k]];
+        if (time - stamp > cacheSize)
+        {
+            stamp = time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+//------------------------------------------------------------------------
+
+U32 FW::descendingKey(F32 v)
+{
+    // Unsigned order of the result = descending order of the float.
+
+    U32 bits = floatToBits(-v);
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+//------------------------------------------------------------------------
+
+VertexCacheStats FW::analyzeVertexCache(const Vec3i* tris, int numTris, int numVertices, int cacheSize)
+{
+    FW_ASSERT(numTris == 0 || tris);
+    FW_ASSERT(cacheSize > 0);
+
+    VertexCacheStats stats;
+    stats.numTriangles = numTris;
+
+    Array<S32> stamps(NULL, numVertices);
+    memset(stamps.getPtr(), 0, stamps.getNumBytes());
+    S32 time = cacheSize + 1;
+
+    for (int i = 0; i < numTris; i++)
+    {
+        for (int k = 0; k < 3; k++)
+            if (!stamps[tris[i][k]])
+                stats.numVertices++;
+        stats.numTransforms += cacheMisses(stamps, time, cacheSize, tris[i]);
+    }
+    return stats;
+}
+
+//------------------------------------------------------------------------
+
+VertexCacheStats FW::analyzeVertexCache(const MeshBase& mesh, int cacheSize)
+{
+    VertexCacheStats stats;
+    for (int i = 0; i < mesh.numSubmeshes(); i++)
+        stats += analyzeVertexCache(mesh.indices(i).getPtr(), mesh.indices(i).getSize(), mesh.numVertices(), cacheSize);
+    return stats;
+}
+
+//------------------------------------------------------------------------
+
+void FW::optimizeVertexCache(Vec3i* tris, int numTris, int numVertices, int cacheSize, Array<S32>* clusters)
+{
+    FW_ASSERT(numTris == 0 || tris);
+    FW_ASSERT(cacheSize > 0);
+
+    if (clusters)
+        clusters->clear();
+    if (!numTris)
+        return;
+
+    // Triangles around each vertex, and how many of them are still to be
+    // output ("live").
+
+    Array<S32> live(NULL, numVertices);
+    Array<S32> adjStart(NULL, numVertices + 1);
+    Array<S32> adjTris(NULL, numTris * 3);
+    memset(live.getPtr(), 0, live.getNumBytes());
+    for (int i = 0; i < numTris; i++)
+        for (int k = 0; k < 3; k++)
+            live[tris[i][k]]++;
+
+    adjStart[0] = 0;
+    for (int i = 0; i < numVertices; i++)
+        adjStart[i + 1] = adjStart[i] + live[i];
+    for (int i = 0; i < numTris; i++)
+        for (int k = 0; k < 3; k++)
+            adjTris[adjStart[tris[i][k]]++] = i;
+    for (int i = numVertices; i > 0; i--)
+        adjStart[i] = adjStart[i - 1];
+    adjStart[0] = 0;
+
+    // Fan around one vertex at a time.
+
+    Array<S32> stamps(NULL, numVertices);
+    Array<U8> emitted(NULL, numTris);
+    memset(stamps.getPtr(), 0, stamps.getNumBytes());
+    memset(emitted.getPtr(), 0, emitted.getNumBytes());
+
+    Array<Vec3i> out;
+    Array<S32> deadEnds;                // Stack of recently used vertices.
+    Array<S32> candidates;              // Vertices of the current fan.
+    out.setCapacity(numTris);
+    S32 time = cacheSize + 1;
+    int cursor = 0;                     // Input triangles before this have been output.
+    int fan = tris[0].x;
+    if (clusters)
+        clusters->add(0);
+
+    while (fan != -1)
+    {
+        candidates.clear();
+        for (int i = adjStart[fan]; i < adjStart[fan + 1]; i++)
+        {
+            int t = adjTris[i];
+            if (emitted[t])
+                continue;
+
+            emitted[t] = 1;
+            out.add(tris[t]);
+            for (int k = 0; k < 3; k++)
+            {
+                int v = tris[t][k];
+                deadEnds.add(v);
+                candidates.add(v);
+                live[v]--;
+            }
+            cacheMisses(stamps, time, cacheSize, tris[t]);
+        }
+
+        // Next, fan around the candidate that has been in the cache longest
+        // among those whose live triangles would still hit it. If none
+        // would, any candidate with live triangles will do.
+
+        fan = -1;
+        int bestPriority = -1;
+        for (int i = 0; i < candidates.getSize(); i++)
+        {
+            int v = candidates[i];
+            if (!live[v])
+                continue;
+
+            int priority = 0;
+            if (time - stamps[v] + 2 * live[v] <= cacheSize)
+                priority = time - stamps[v];
+            if (priority > bestPriority)
+            {
+                fan = v;
+                bestPriority = priority;
+            }
+        }
+
+        // Dead end => continue from the most recently used vertex that has
+        // live triangles, or else from the next triangle in input order.
+        // Either way, a new cluster starts.
+
+        if (fan == -1)
+        {
+            while (fan == -1 && deadEnds.getSize())
+            {
+                int v = deadEnds.removeLast();
+                if (live[v])
+                    fan = v;
+            }
+            while (fan == -1 && cursor < numTris)
+            {
+                if (!emitted[cursor])
+                    fan = tris[cursor].x;
+                cursor++;
+            }
+            if (fan != -1 && clusters)
+                clusters->add(out.getSize());
+        }
+    }
+
+    FW_ASSERT(out.getSize() == numTris);
+    memcpy(tris, out.getPtr(), out.getNumBytes());
+}
+
+//------------------------------------------------------------------------
+
+int FW::optimizeOverdraw(Vec3i* tris, int numTris, const Vec3f* positions, const Array<S32>& clusters, int cacheSize, F32 threshold)
+{
+    FW_ASSERT(numTris == 0 || (tris && positions));
+    FW_ASSERT(cacheSize > 0);
+
+    if (!numTris)
+        return 0;
+
+    int numVertices = 0;
+    for (int i = 0; i < numTris; i++)
+        numVertices = max(numVertices, tris[i].max() + 1);
+
+    Array<S32> stamps(NULL, numVertices);
+    memset(stamps.getPtr(), 0, stamps.getNumBytes());
+    S32 time = cacheSize + 1;
+
+    // Split each cluster as soon as the part since the previous split has
+    // an ACMR (with a cold cache) within 'threshold' of the whole cluster.
+
+    Array<S32> starts;
+    for (int c = 0; c < clusters.getSize(); c++)
+    {
+        int lo = clusters[c];
+        int hi = (c + 1 < clusters.getSize()) ? clusters[c + 1] : numTris;
+
+        int misses = 0;
+        time += cacheSize + 1;
+        for (int i = lo; i < hi; i++)
+            misses += cacheMisses(stamps, time, cacheSize, tris[i]);
+        F32 limit = threshold * (F32)misses / (F32)(hi - lo);
+
+        starts.add(lo);
+        time += cacheSize + 1;
+        misses = 0;
+        for (int i = lo; i < hi - 1; i++)
+        {
+            misses += cacheMisses(stamps, time, cacheSize, tris[i]);
+            if ((F32)misses <= limit * (F32)(i + 1 - starts.getLast()))
+            {
+                starts.add(i + 1);
+                time += cacheSize + 1;
+                misses = 0;
+            }
+        }
+    }
+    if (!starts.getSize() || starts[0] != 0)
+        starts.insert(0, 0);
+
+    // Area-weighted centroids and normals.
+
+    Vec3f meshCentroid = 0.0f;
+    F32 meshArea = 0.0f;
+    Array<Vec3f> centroid(NULL, starts.getSize());
+    Array<Vec3f> normal(NULL, starts.getSize());
+
+    for (int c = 0; c < starts.getSize(); c++)
+    {
+        int lo = starts[c];
+        int hi = (c + 1 < starts.getSize()) ? starts[c + 1] : numTris;
+        Vec3f sum = 0.0f;
+        F32 area = 0.0f;
+        normal[c] = 0.0f;
+
+        for (int i = lo; i < hi; i++)
+        {
+            const Vec3f& a = positions[tris[i].x];
+            const Vec3f& b = positions[tris[i].y];
+            const Vec3f& d = positions[tris[i].z];
+            Vec3f n = cross(b - a, d - a);
+            F32 w = n.length();
+            sum += (a + b + d) * (w / 3.0f);
+            area += w;
+            normal[c] += n;
+        }
+
+        meshCentroid += sum;
+        meshArea += area;
+        centroid[c] = (area > 0.0f) ? sum / area : positions[tris[lo].x];
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Draw the clusters that face away from the centroid the most first.
+
+    Array<U32> keys(NULL, starts.getSize());
+    Array<S32> order(NULL, starts.getSize());
+    for (int c = 0; c < starts.getSize(); c++)
+    {
+        F32 len = normal[c].length();
+        keys[c] = descendingKey((len > 0.0f) ? dot(centroid[c] - meshCentroid, normal[c]) / len : 0.0f);
+        order[c] = c;
+    }
+    radixSort(keys.getPtr(), order.getPtr(), starts.getSize());
+
+    Array<Vec3i> out;
+    out.setCapacity(numTris);
+    for (int i = 0; i < order.getSize(); i++)
+    {
+        int c = order[i];
+        int lo = starts[c];
+        int hi = (c + 1 < starts.getSize()) ? starts[c + 1] : numTris;
+        out.add(tris + lo, hi - lo);
+    }
+    memcpy(tris, out.getPtr(), out.getNumBytes());
+    return starts.getSize();
+}
+
+//------------------------------------------------------------------------
+
+TriangleOrderStats FW::optimizeTriangleOrder(MeshBase& mesh, int cacheSize, F32 overdrawThreshold)
+{
+    TriangleOrderState s;
+    int numSubmeshes = mesh.numSubmeshes();
+    s.mesh = &mesh;
+    s.cacheSize = cacheSize;
+    s.overdrawThreshold = overdrawThreshold;
+    s.tris.reset(numSubmeshes);
+    s.before.reset(numSubmeshes);
+    s.after.reset(numSubmeshes);
+    s.numClusters.reset(numSubmeshes);
+
+    for (int i = 0; i < numSubmeshes; i++)
+        s.tris[i] = &mesh.mutableIndices(i);
+
+    int posAttrib = mesh.findAttrib(MeshBase::AttribType_Position);
+    if (overdrawThreshold > 0.0f && posAttrib != -1)
+    {
+        AttribView<const Vec3f> posView = mesh.getAttribView<Vec3f>(posAttrib);
+        s.positions.reset(mesh.numVertices());
+        for (int i = 0; i < mesh.numVertices(); i++)
+            s.positions[i] = (posView.isValid()) ? posView[i] : mesh.getVertexAttrib(i, posAttrib).getXYZ();
+    }
+
+    if (numSubmeshes > 1)
+        MulticoreLauncher().push(optimizeSubmesh, &s, 0, numSubmeshes).popAll();
+    else if (numSubmeshes == 1)
+    {
+        MulticoreLauncher::Task task;
+        task.data = &s;
+        task.idx = 0;
+        optimizeSubmesh(task);
+    }
+
+    TriangleOrderStats stats;
+    stats.numClusters = 0;
+    for (int i = 0; i < numSubmeshes; i++)
+    {
+        stats.before += s.before[i];
+        stats.after += s.after[i];
+        stats.numClusters += s.numClusters[i];
+    }
+    return stats;
+}
+
+//------------------------------------------------------------------------
+
+void FW::optimizeSubmesh(MulticoreLauncher::Task& task)
+{
+    TriangleOrderState& s = *(TriangleOrderState*)task.data;
+    Array<Vec3i>& tris = *s.tris[task.idx];
+    int numTris = tris.getSize();
+    int numCorners = numTris * 3;
+
+    // Renumber the vertices the submesh uses 0, 1, 2, ... in index order,
+    // so that the work is proportional to the submesh rather than to the
+    // whole mesh.
+
+    int keyBits = 1;
+    while (keyBits < 32 && ((S64)1 << keyBits) < s.mesh->numVertices())
+        keyBits++;
+
+    Array<U32> keys(NULL, numCorners);
+    Array<S32> corners(NULL, numCorners);
+    for (int i = 0; i < numCorners; i++)
+    {
+        keys[i] = tris[i / 3][i % 3];
+        corners[i] = i;
+    }
+    radixSort(keys.getPtr(), corners.getPtr(), numCorners, keyBits);
+
+    Array<S32> global;
+    Array<Vec3i> local(NULL, numTris);
+    for (int i = 0; i < numCorners; i++)
+    {
+        if (i == 0 || keys[i] != keys[i - 1])
+            global.add(keys[i]);
+        local[corners[i] / 3][corners[i] % 3] = global.getSize() - 1;
+    }
+    keys.reset();
+    corners.reset();
+
+    // Optimize.
+
+    s.before[task.idx] = analyzeVertexCache(local.getPtr(), numTris, global.getSize(), s.cacheSize);
+    s.numClusters[task.idx] = 0;
+
+    if (!s.positions.getSize())
+        optimizeVertexCache(local.getPtr(), numTris, global.getSize(), s.cacheSize);
+    else
+    {
+        Array<S32> clusters;
+        Array<Vec3f> positions(NULL, global.getSize());
+        for (int i = 0; i < global.getSize(); i++)
+            positions[i] = s.positions[global[i]];
+
+        optimizeVertexCache(local.getPtr(), numTris, global.getSize(), s.cacheSize, &clusters);
+        s.numClusters[task.idx] = optimizeOverdraw(local.getPtr(), numTris, positions.getPtr(), clusters, s.cacheSize, s.overdrawThreshold);
+    }
+
+    s.after[task.idx] = analyzeVertexCache(local.getPtr(), numTris, global.getSize(), s.cacheSize);
+    for (int i = 0; i < numTris; i++)
+        for (int k = 0; k < 3; k++)
+            tris[i][k] = global[local[i][k]];
+}
+
+//------------------------------------------------------------------------
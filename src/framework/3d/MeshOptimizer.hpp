@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include "3d/Mesh.hpp"
+
+namespace FW
+{
+//------------------------------------------------------------------------
+// Triangle order optimization for the post-transform vertex cache and for
+// overdraw.
+//
+// The cache is modeled as a FIFO of 'cacheSize' vertices, starting empty
+// for every submesh (draw call). ACMR is the number of vertex transforms
+// (cache misses) per triangle, ATVR per distinct vertex referenced; 0.5
+// and 1.0 are the ideals for a large closed mesh.
+//
+// optimizeVertexCache() is Tipsify (Sander, Nehab and Barczak 2007):
+// it fans around the vertex that will stay in the cache longest and falls
+// back to recently used vertices at dead ends. It runs in linear time.
+// The dead ends also delimit clusters of locally connected triangles.
+// optimizeOverdraw() splits these clusters further, as long as ACMR grows
+// by no more than 'threshold' times, and then draws the clusters that face
+// away from the mesh centroid first. Those are the least likely to be
+// occluded.
+//------------------------------------------------------------------------
+
+struct VertexCacheStats
+{
+    S32                 numTriangles;
+    S32                 numVertices;        // Distinct vertices referenced, summed over submeshes.
+    S32                 numTransforms;      // Cache misses.
+
+                        VertexCacheStats    (void)                          : numTriangles(0), numVertices(0), numTransforms(0) {}
+
+    F32                 getACMR             (void) const                    { return (numTriangles) ? (F32)numTransforms / (F32)numTriangles : 0.0f; }
+    F32                 getATVR             (void) const                    { return (numVertices) ? (F32)numTransforms / (F32)numVertices : 0.0f; }
+    VertexCacheStats&   operator+=          (const VertexCacheStats& other) { numTriangles += other.numTriangles; numVertices += other.numVertices; numTransforms += other.numTransforms; return *this; }
+};
+
+struct TriangleOrderStats
+{
+    VertexCacheStats    before;
+    VertexCacheStats    after;
+    S32                 numClusters;        // Drawn in overdraw order; 0 if not requested.
+};
+
+//------------------------------------------------------------------------
+
+VertexCacheStats    analyzeVertexCache      (const Vec3i* tris, int numTris, int numVertices, int cacheSize = 16);
+VertexCacheStats    analyzeVertexCache      (const MeshBase& mesh, int cacheSize = 16);
+
+// Reorders 'tris' in place. If 'clusters' is given, it receives the index
+// of the first triangle of every cluster, ascending.
+void                optimizeVertexCache     (Vec3i* tris, int numTris, int numVertices, int cacheSize = 16, Array<S32>* clusters = NULL);
+
+// Reorders the clusters of 'tris', typically those from
+// optimizeVertexCache(). Returns the final number of clusters.
+int                 optimizeOverdraw        (Vec3i* tris, int numTris, const Vec3f* positions, const Array<S32>& clusters, int cacheSize = 16, F32 threshold = 1.05f);
+
+// Both of the above for every submesh, in parallel across submeshes.
+// 'overdrawThreshold' <= 0 skips optimizeOverdraw().
+TriangleOrderStats  optimizeTriangleOrder   (MeshBase& mesh, int cacheSize = 16, F32 overdrawThreshold = 0.0f);
+
+//------------------------------------------------------------------------
+}
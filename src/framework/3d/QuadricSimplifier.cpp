@@ -0,0 +1,1999 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "3d/QuadricSimplifier.hpp"
+#include "3d/BVH.hpp"
+#include "base/BinaryHeap.hpp"
+#include "base/MulticoreLauncher.hpp"
+#include "base/Sort.hpp"
+#include "base/Timer.hpp"
+
+using namespace FW;
+
+//------------------------------------------------------------------------
+
+#define SIMPLIFY_CHUNK_SIZE     (1 << 14)
+#define SIMPLIFY_MIN_PARTITION  65536           // Triangles; smaller meshes take a single pass.
+#define SIMPLIFY_PARTITION_SIZE 16384           // Triangles per partition at least, unless requested otherwise.
+#define SIMPLIFY_PER_CORE       4               // Partitions by default; small ones balance the load and stay in cache.
+#define SIMPLIFY_MAX_ATTRIBS    5               // Normal and texcoord components.
+#define SIMPLIFY_MAX_QUADRIC    (SIMPLIFY_MAX_ATTRIBS * 4 + 1)
+#define SIMPLIFY_MAX_PAIRS      16              // Close pairs found per point, however dense the grid cells.
+#define DISTANCE_BATCH          1024            // Samples per BVH::closestPoints() call.
+
+//------------------------------------------------------------------------
+
+namespace FW
+{
+
+enum PointKind
+{
+    PointKind_Interior = 0,                     // One vertex, no feature edges.
+    PointKind_Feature,                          // Exactly two feature edges.
+    PointKind_Locked                            // Anything else.
+};
+
+enum CollapseMode
+{
+    CollapseMode_Merge = 0,                     // Both ends move to the target; v[0] survives.
+    CollapseMode_Into1,                         // v[0] slides onto v[1].
+    CollapseMode_Into0                          // v[1] slides onto v[0].
+};
+
+struct Quadric                                  // Symmetric 4x4 over the position, upper triangle.
+{
+    F64                     a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+    void                    clear       (void)  { a2 = ab = ac = ad = b2 = bc = bd = c2 = cd = d2 = 0.0; }
+    void                    addPlane    (const Vec3d& n, F64 d, F64 w);     // w * (dot(n, p) + d)^2; n need not be normalized.
+    void                    operator+=  (const Quadric& q);
+    F64                     eval        (const Vec3d& p) const;
+    bool                    optimum     (Vec3d& p) const;                   // Minimizer of eval(); false if (nearly) singular.
+};
+
+struct CollapseEdge
+{
+    S32                     v[2];               // Points.
+    Vec3f                   target;
+    S32                     mode;               // CollapseMode.
+};
+
+struct PointNeighbor                            // Seen from the faces of a point, see classifyPoint().
+{
+    S32                     point;
+    S32                     count;              // Faces on the edge to it.
+    S32                     vertex;             // At the neighbor, on the first of them.
+    S32                     ownVertex;          // At the point itself, same face.
+    S32                     submesh;            // Of the same face.
+    bool                    seam;               // Another face differs in one of the above.
+};
+
+struct PointInfo
+{
+    S32                     kind;               // PointKind.
+    S32                     feature[2];         // Neighbors along the feature edges, for PointKind_Feature.
+    Array<S32>              vertices;           // Distinct, on the faces of the point.
+};
+
+struct CollapseScratch                          // Per task.
+{
+    Array<PointNeighbor>    neighbors;
+    PointInfo               info[3];            // Of the ends of the edge last evaluated, and of a point shared by several.
+    Array<Vec2i>            vertexMap[2];       // (removed, surviving) vertex, for CollapseMode_Into1 and _Into0.
+};
+
+struct FeaturePlane                             // Constraint along a feature edge.
+{
+    S32                     v[2];               // Points.
+    Vec3d                   normal;
+    F64                     offset;
+    F64                     weight;
+};
+
+struct CollapseWorker                           // A partition, or the final pass over the whole mesh.
+{
+    S32                     partition;          // -1 for the final pass.
+    BinaryHeap<F32>         heap;               // Keyed by local edge index in partitions.
+    Array<S32>              localEdges;         // [local index] Edge.
+    S32                     targetTriangles;
+
+    S32                     triCursor;          // Merged reference lists go to [cursor, end) of the
+    S32                     triEnd;             // shared arrays, or are appended if 'end' is -1.
+    S32                     edgeCursor;
+    S32                     edgeEnd;
+
+    S32                     stamp;
+    S32                     ownedTriangles;     // Whose lowest point is in the partition.
+    S32                     interiorTriangles;  // Owned, without border points.
+    S32                     liveTriangles;
+    S32                     numCollapses;
+    F32                     maxKey;
+    F32                     seconds;
+    CollapseScratch         scratch;
+    SimplifyLog             log;                // Collapses only; appended to SimplifyParams::log afterwards.
+};
+
+struct SimplifyState : ChunkState
+{
+    MeshBase*               mesh;
+    SimplifyParams          params;
+    S32                     posAttrib;
+    S32                     normalAttrib;       // -1 if not in the quadrics.
+    S32                     texCoordAttrib;     // -1 if not in the quadrics.
+    S32                     numAttribs;         // Components per vertex in 'attribs'.
+    S32                     quadricStride;      // F64s per vertex in 'vertexQuadrics'.
+    F32                     normalScale;        // Of the attributes in 'attribs'.
+    F32                     texCoordScale;
+    F32                     maxKey;             // Squared maxError.
+    AttribView<const Vec3f> posView;
+    Vec3f                   lo;                 // Bounding box of the vertices.
+    Vec3f                   hi;
+
+    Array<Vec3f>            vertexPos;          // [vertex] Freed after welding.
+    Array<U32>              posKey;             // Hash of the position; sorted along with posOrder.
+    Array<S32>              posOrder;
+    Array<S32>              rep;                // [vertex] Lowest-index vertex with a bitwise identical position.
+    Array<S32>              pointOf;            // [vertex]
+    Array<F32>              attribs;            // [vertex * numAttribs] Scaled normal, then texcoord.
+    Array<F64>              vertexQuadrics;     // [vertex * quadricStride] Gradients, offsets, area.
+    Array<U8>               vertexSolved;       // [vertex] Attributes solved by a merge.
+
+    Array<Vec3f>            pos;                // [point]
+    Array<U8>               moved;              // [point]
+    Array<Quadric>          quadrics;           // [point]
+    Array<F64>              areas;              // [point] Of the faces merged into the point.
+    Array<S32>              stamps;             // [point]
+
+    Array<Vec3i>            tris;               // Vertices; x = -1 once collapsed.
+    Array<Vec3i>            triPoints;          // pointOf[] of the corners, saving the lookups.
+    Array<S32>              triSubmesh;
+    S32                     liveTriangles;
+
+    // Point -> face and point -> edge references. A point's list is a
+    // range of refs; on collapse the merged list is written elsewhere.
+
+    Array<S32>              triStart;
+    Array<S32>              triCount;
+    Array<S32>              triRefs;
+    Array<S32>              edgeStart;
+    Array<S32>              edgeCount;
+    Array<S32>              edgeRefs;
+
+    Array<CollapseEdge>     edges;
+    Array<F32>              edgeKey;            // Squared error; -1 if the edge cannot collapse.
+    Array<U8>               edgeDead;
+    S32                     numPairs;           // Close pairs, at the end of 'edges'.
+
+    // Partitions: consecutive point ranges in Morton order, starting at
+    // an offset and wrapping around. Edges with both ends inside one
+    // partition and away from its border collapse concurrently; everything
+    // else waits for the next round or the final pass.
+
+    S32                     numPartitions;
+    Array<S32>              partition;          // [point]
+    Array<U8>               border;             // [point]
+    Array<S32>              edgePartition;      // -1 if not collapsed concurrently.
+    Array<S32>              edgeLocal;
+    Array<CollapseWorker>   workers;
+
+    // Close pairs: the points sorted by the key of their grid cell.
+
+    F64                     pairDistance;       // In mesh units.
+    Array<U64>              cellKey;
+    Array<S32>              cellOrder;
+
+    Array<CollapseScratch>  chunkScratch;       // [chunk]
+    Array<Array<Vec2i> >    chunkEdges;         // Edges, then close pairs.
+    Array<Array<FeaturePlane> > chunkPlanes;
+};
+
+struct DistanceState : ChunkState
+{
+    const BVH*              bvh;
+    const Vec3f*            samples;
+    Array<F32>              chunkMax;           // [chunk]
+    Array<F64>              chunkSum;
+};
+
+static U32      spreadBits          (U32 x);
+static Vec3i    cellOf              (const SimplifyState& s, const Vec3f& pos);
+static U64      cellKeyOf           (const Vec3i& cell);
+
+static void     gatherVertices      (MulticoreLauncher::Task& task);
+static void     weldPoints          (MulticoreLauncher::Task& task);
+static void     computeQuadrics     (MulticoreLauncher::Task& task);
+static void     findEdges           (MulticoreLauncher::Task& task);
+static void     gridPoints          (MulticoreLauncher::Task& task);
+static void     findPairs           (MulticoreLauncher::Task& task);
+static void     evaluateEdges       (MulticoreLauncher::Task& task);
+static void     findBorders         (MulticoreLauncher::Task& task);
+static void     runPartition        (MulticoreLauncher::Task& task);
+
+static void     setupPoints         (SimplifyState& s);
+static void     setupTriangles      (SimplifyState& s);
+static void     setupEdges          (SimplifyState& s);
+static void     setupPairs          (SimplifyState& s, F64 meanEdgeLength);
+static void     setupPartitions     (SimplifyState& s, int offset);
+static void     runCollapses        (SimplifyState& s, SimplifyReport& report);
+static void     writeOutput         (SimplifyState& s);
+
+static int      cornerOf            (const Vec3i& points, int point);
+static bool     sharesFace          (const SimplifyState& s, int a, int b);
+static void     classifyPoint       (const SimplifyState& s, int point, PointInfo& info, Array<PointNeighbor>& neighbors);
+static bool     mapVertices         (const SimplifyState& s, int from, int to, const PointInfo& fromInfo, Array<Vec2i>& map);
+static F64      attribError         (const SimplifyState& s, const F64* vq, const Vec3d& p, const F32* a);
+static F64      slideCost           (const SimplifyState& s, const Quadric& q, int to, const PointInfo& toInfo, const Array<Vec2i>& map);
+static bool     evaluateEdge        (SimplifyState& s, int edge, CollapseScratch& scratch, int known = -1);
+static bool     flipsFaces          (const SimplifyState& s, int point, int other, const Vec3f& target);
+static bool     keepsManifold       (SimplifyState& s, CollapseWorker& worker, int a, int b);
+static int      heapIndex           (const SimplifyState& s, const CollapseWorker& worker, int edge);
+static bool     contract            (SimplifyState& s, CollapseWorker& worker, int edge);
+static void     runWorker           (SimplifyState& s, CollapseWorker& worker);
+static void     appendLog           (SimplifyLog& dst, const SimplifyLog& src);
+
+static void     gatherMesh          (const MeshBase& mesh, Array<Vec3f>& positions, Array<Vec3i>& tris);
+static void     sampleSurface       (Array<Vec3f>& samples, const Array<Vec3f>& positions, const Array<Vec3i>& tris, int maxSamples);
+static void     measureSamples      (MulticoreLauncher::Task& task);
+static void     measureDirected     (const BVH& bvh, const Array<Vec3f>& samples, F32& maxDistance, F64& sum);
+static SurfaceDistance measureDistance(const Array<Vec3f>& posA, const Array<Vec3i>& trisA, const BVH& bvhA, const Array<Vec3f>& posB, const Array<Vec3i>& trisB, const BVH& bvhB, int maxSamples);
+
+}
+
+//------------------------------------------------------------------------
+
+void Quadric::addPlane(const Vec3d& n, F64 d, F64 w)
+{
+    a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+    b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+    c2 += w * n.z * n.z; cd += w * n.z * d;
+    d2 += w * d * d;
+}
+
+//------------------------------------------------------------------------
+
+void Quadric::operator+=(const Quadric& q)
+{
+    a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+    b2 += q.b2; bc += q.bc; bd += q.bd;
+    c2 += q.c2; cd += q.cd;
+    d2 += q.d2;
+}
+
+//------------------------------------------------------------------------
+
+F64 Quadric::eval(const Vec3d& p) const
+{
+    return a2 * p.x * p.x + 2.0 * ab * p.x * p.y + 2.0 * ac * p.x * p.z + 2.0 * ad * p.x
+        + b2 * p.y * p.y + 2.0 * bc * p.y * p.z + 2.0 * bd * p.y
+        + c2 * p.z * p.z + 2.0 * cd * p.z
+        + d2;
+}
+
+//------------------------------------------------------------------------
+
+bool Quadric::optimum(Vec3d& p) const
+{
+    F64 c00 = b2 * c2 - bc * bc;
+    F64 c01 = ac * bc - ab * c2;
+    F64 c02 = ab * bc - ac * b2;
+    F64 det = a2 * c00 + ab * c01 + ac * c02;
+    F64 scale = max(max(a2, b2), c2);
+    if (!(abs(det) > 1.0e-10 * scale * scale * scale))
+        return false;
+
+    F64 c11 = a2 * c2 - ac * ac;
+    F64 c12 = ab * ac - a2 * bc;
+    F64 c22 = a2 * b2 - ab * ab;
+    F64 inv = -1.0 / det;
+    p = Vec3d(
+        (c00 * ad + c01 * bd + c02 * cd) * inv,
+        (c01 * ad + c11 * bd + c12 * cd) * inv,
+        (c02 * ad + c12 * bd + c22 * cd) * inv);
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+U32 FW::spreadBits(U32 x)
+{
+    // Interleave the low 10 bits of x with two zero bits each.
+
+    x &= 0x3FF;
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+//------------------------------------------------------------------------
+
+Vec3i FW::cellOf(const SimplifyState& s, const Vec3f& pos)
+{
+    Vec3d c = (Vec3d(pos) - Vec3d(s.lo)) / s.pairDistance;
+    return Vec3i(min((int)c.x, 0x1FFFFF), min((int)c.y, 0x1FFFFF), min((int)c.z, 0x1FFFFF));
+}
+
+//------------------------------------------------------------------------
+
+U64 FW::cellKeyOf(const Vec3i& cell)
+{
+    return ((U64)cell.x << 42) | ((U64)cell.y << 21) | (U64)cell.z;
+}
+
+//------------------------------------------------------------------------
+
+void FW::gatherVertices(MulticoreLauncher::Task& task)
+{
+    SimplifyState& s = *(SimplifyState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+
+    for (int i = range.x; i < range.y; i++)
+    {
+        s.vertexPos[i] = (s.posView.isValid()) ? s.posView[i] : s.mesh->getVertexAttrib(i, s.posAttrib).getXYZ();
+        s.posKey[i] = hash<Vec3f>(s.vertexPos[i]);
+        s.posOrder[i] = i;
+
+        F32* a = s.attribs.getPtr(i * s.numAttribs);
+        if (s.normalAttrib != -1)
+        {
+            Vec3f n = s.mesh->getVertexAttrib(i, s.normalAttrib).getXYZ() * s.normalScale;
+            *a++ = n.x;
+            *a++ = n.y;
+            *a++ = n.z;
+        }
+        if (s.texCoordAttrib != -1)
+        {
+            Vec4f t = s.mesh->getVertexAttrib(i, s.texCoordAttrib) * s.texCoordScale;
+            *a++ = t.x;
+            *a++ = t.y;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::weldPoints(MulticoreLauncher::Task& task)
+{
+    // Vertices are sorted by position hash, in index order within a run of
+    // equal hashes. The first vertex of each distinct position in a run
+    // represents it; colliding positions are told apart by comparing bits.
+
+    SimplifyState& s = *(SimplifyState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    int lo = alignToRun(s.posKey, range.x);
+    int hi = alignToRun(s.posKey, range.y);
+    Array<S32> distinct;
+
+    for (int start = lo, end; start < hi; start = end)
+    {
+        distinct.clear();
+        for (end = start; end < s.numItems && s.posKey[end] == s.posKey[start]; end++)
+        {
+            int v = s.posOrder[end];
+            s.rep[v] = v;
+            for (int j = 0; j < distinct.getSize(); j++)
+            {
+                if (equals<Vec3f>(s.vertexPos[distinct[j]], s.vertexPos[v]))
+                {
+                    s.rep[v] = distinct[j];
+                    break;
+                }
+            }
+            if (s.rep[v] == v)
+                distinct.add(v);
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::computeQuadrics(MulticoreLauncher::Task& task)
+{
+    // Sum the plane quadrics of the faces of each point, and the attribute
+    // quadrics of each face into the vertex at the point. The face's
+    // attribute gradients add to the point quadric as extra planes. A
+    // vertex is only used by faces of its own point => no conflicts.
+
+    SimplifyState& s = *(SimplifyState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    int m = s.numAttribs;
+
+    for (int p = range.x; p < range.y; p++)
+    {
+        Quadric& q = s.quadrics[p];
+        q.clear();
+        s.areas[p] = 0.0;
+
+        for (int i = 0; i < s.triCount[p]; i++)
+        {
+            int t = s.triRefs[s.triStart[p] + i];
+            const Vec3i& tri = s.tris[t];
+            const Vec3i& pts = s.triPoints[t];
+            Vec3d p0 = s.pos[pts.x];
+            Vec3d e1 = Vec3d(s.pos[pts.y]) - p0;
+            Vec3d e2 = Vec3d(s.pos[pts.z]) - p0;
+            Vec3d n = cross(e1, e2);
+            F64 lenSqr = n.lenSqr();
+            if (lenSqr == 0.0)
+                continue;
+
+            F64 len = sqrt(lenSqr);
+            F64 w = len * 0.5;
+            Vec3d un = n / len;
+            q.addPlane(un, -dot(un, p0), w);
+            s.areas[p] += w;
+            if (!m)
+                continue;
+
+            // Gradient g of attribute j over the face, with
+            // s_j(x) = dot(g, x) + d on the plane of the face.
+
+            const F32* a0 = s.attribs.getPtr(tri.x * m);
+            const F32* a1 = s.attribs.getPtr(tri.y * m);
+            const F32* a2 = s.attribs.getPtr(tri.z * m);
+            Vec3d c1 = cross(e2, n) / lenSqr;
+            Vec3d c2 = cross(n, e1) / lenSqr;
+            F64* vq = s.vertexQuadrics.getPtr(tri[cornerOf(pts, p)] * s.quadricStride);
+
+            for (int j = 0; j < m; j++)
+            {
+                Vec3d g = c1 * (F64)(a1[j] - a0[j]) + c2 * (F64)(a2[j] - a0[j]);
+                F64 d = (F64)a0[j] - dot(g, p0);
+                q.addPlane(g, d, w);
+                vq[j * 3 + 0] -= w * g.x;
+                vq[j * 3 + 1] -= w * g.y;
+                vq[j * 3 + 2] -= w * g.z;
+                vq[m * 3 + j] -= w * d;
+            }
+            vq[m * 4] += w;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::findEdges(MulticoreLauncher::Task& task)
+{
+    // Each edge is emitted by its lower point, along with the constraint
+    // planes of its faces if it is a feature.
+
+    SimplifyState& s = *(SimplifyState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    CollapseScratch& scratch = s.chunkScratch[task.idx];
+    Array<Vec2i>& edges = s.chunkEdges[task.idx];
+    Array<FeaturePlane>& planes = s.chunkPlanes[task.idx];
+    edges.clear();
+    planes.clear();
+
+    for (int p = range.x; p < range.y; p++)
+    {
+        classifyPoint(s, p, scratch.info[0], scratch.neighbors);
+        for (int i = 0; i < scratch.neighbors.getSize(); i++)
+        {
+            const PointNeighbor& nb = scratch.neighbors[i];
+            if (nb.point < p)
+                continue;
+
+            edges.add(Vec2i(p, nb.point));
+            if (nb.count == 2 && !nb.seam)
+                continue;
+
+            Vec3d pp = s.pos[p];
+            Vec3d edge = Vec3d(s.pos[nb.point]) - pp;
+            for (int j = 0; j < s.triCount[p]; j++)
+            {
+                const Vec3i& pts = s.triPoints[s.triRefs[s.triStart[p] + j]];
+                if (cornerOf(pts, nb.point) == -1)
+                    continue;
+
+                Vec3d p0 = s.pos[pts.x];
+                Vec3d faceNormal = cross(Vec3d(s.pos[pts.y]) - p0, Vec3d(s.pos[pts.z]) - p0);
+                Vec3d n = cross(edge, faceNormal);
+                F64 len = n.length();
+                if (len == 0.0)
+                    continue;
+
+                FeaturePlane& plane = planes.add();
+                plane.v[0] = p;
+                plane.v[1] = nb.point;
+                plane.normal = n / len;
+                plane.offset = -dot(plane.normal, pp);
+                plane.weight = s.params.featureWeight * edge.lenSqr() / nb.count;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::gridPoints(MulticoreLauncher::Task& task)
+{
+    SimplifyState& s = *(SimplifyState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+
+    for (int p = range.x; p < range.y; p++)
+    {
+        s.cellKey[p] = cellKeyOf(cellOf(s, s.pos[p]));
+        s.cellOrder[p] = p;
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::findPairs(MulticoreLauncher::Task& task)
+{
+    // Each pair is emitted by its lower point, which looks for higher ones
+    // in the 27 cells around its own that share no face with it.
+
+    SimplifyState& s = *(SimplifyState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    Array<Vec2i>& pairs = s.chunkEdges[task.idx];
+    int numPoints = s.pos.getSize();
+    F64 maxDistSqr = sqr(s.pairDistance);
+    pairs.clear();
+
+    for (int p = range.x; p < range.y; p++)
+    {
+        Vec3i c = cellOf(s, s.pos[p]);
+        int numFound = 0;
+        for (int i = 0; i < 27 && numFound < SIMPLIFY_MAX_PAIRS; i++)
+        {
+            Vec3i n = c + Vec3i(i % 3 - 1, (i / 3) % 3 - 1, i / 9 - 1);
+            if (n.x < 0 || n.y < 0 || n.z < 0)
+                continue;
+
+            U64 key = cellKeyOf(n);
+            int lo = 0;
+            int hi = numPoints;
+            while (lo < hi)
+            {
+                int mid = (lo + hi) >> 1;
+                if (s.cellKey[mid] < key)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+
+            for (int j = lo; j < numPoints && s.cellKey[j] == key && numFound < SIMPLIFY_MAX_PAIRS; j++)
+            {
+                int q = s.cellOrder[j];
+                if (q <= p || (Vec3d(s.pos[q]) - Vec3d(s.pos[p])).lenSqr() >= maxDistSqr || sharesFace(s, p, q))
+                    continue;
+                pairs.add(Vec2i(p, q));
+                numFound++;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::evaluateEdges(MulticoreLauncher::Task& task)
+{
+    // Edges come grouped by their lower point => classify it once per
+    // group.
+
+    SimplifyState& s = *(SimplifyState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    CollapseScratch& scratch = s.chunkScratch[task.idx];
+    int known = -1;
+
+    for (int i = range.x; i < range.y; i++)
+    {
+        int p = s.edges[i].v[0];
+        if (p != known)
+        {
+            classifyPoint(s, p, scratch.info[2], scratch.neighbors);
+            known = p;
+        }
+        evaluateEdge(s, i, scratch, known);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::findBorders(MulticoreLauncher::Task& task)
+{
+    // A point is on a border if any of its faces or edges reaches into
+    // another partition. Edges touching a border point are left for the
+    // final pass, so that concurrent collapses never share data.
+
+    SimplifyState& s = *(SimplifyState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+
+    for (int p = range.x; p < range.y; p++)
+    {
+        int part = s.partition[p];
+        bool isBorder = false;
+        for (int i = 0; i < s.triCount[p] && !isBorder; i++)
+        {
+            int t = s.triRefs[s.triStart[p] + i];
+            if (s.tris[t].x >= 0)
+                for (int k = 0; k < 3; k++)
+                    isBorder |= (s.partition[s.triPoints[t][k]] != part);
+        }
+        for (int i = 0; i < s.edgeCount[p] && !isBorder; i++)
+        {
+            int e = s.edgeRefs[s.edgeStart[p] + i];
+            if (!s.edgeDead[e])
+                for (int k = 0; k < 2; k++)
+                    isBorder |= (s.partition[s.edges[e].v[k]] != part);
+        }
+        s.border[p] = (isBorder) ? 1 : 0;
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::runPartition(MulticoreLauncher::Task& task)
+{
+    SimplifyState& s = *(SimplifyState*)task.data;
+    Timer timer(true);
+    runWorker(s, s.workers[task.idx]);
+    s.workers[task.idx].seconds = timer.getElapsed();
+}
+
+//------------------------------------------------------------------------
+
+void FW::setupPoints(SimplifyState& s)
+{
+    MeshBase& mesh = *s.mesh;
+    int numVertices = mesh.numVertices();
+
+    // Gather positions and scaled attributes, then weld: sort the vertices
+    // by position hash and pick one representative per distinct position.
+
+    s.vertexPos.reset(numVertices);
+    s.posKey.reset(numVertices);
+    s.posOrder.reset(numVertices);
+    s.rep.reset(numVertices);
+    s.attribs.reset(numVertices * s.numAttribs);
+    launchChunks(gatherVertices, s, numVertices, SIMPLIFY_CHUNK_SIZE);
+    radixSort(s.posKey.getPtr(), s.posOrder.getPtr(), numVertices, 32, true);
+    launchChunks(weldPoints, s, numVertices, SIMPLIFY_CHUNK_SIZE);
+
+    // Number the points in Morton order of their position, so that
+    // neighborhoods are close in memory and partitions are compact.
+
+    s.lo = FW_F32_MAX;
+    s.hi = -FW_F32_MAX;
+    boundPoints((const F32*)s.vertexPos.getPtr(), sizeof(Vec3f), numVertices, s.lo, s.hi);
+    Vec3f scale = Vec3f(1023.0f) / max(s.hi - s.lo, Vec3f(FW_F32_MIN));
+
+    Array<U32>& pointKey = s.posKey;
+    Array<S32>& pointOrder = s.posOrder;
+    pointKey.clear();
+    pointOrder.clear();
+    for (int i = 0; i < numVertices; i++)
+    {
+        if (s.rep[i] != i)
+            continue;
+        Vec3f c = (s.vertexPos[i] - s.lo) * scale;
+        pointKey.add(spreadBits((U32)c.x) | (spreadBits((U32)c.y) << 1) | (spreadBits((U32)c.z) << 2));
+        pointOrder.add(i);
+    }
+
+    int numPoints = pointOrder.getSize();
+    radixSort(pointKey.getPtr(), pointOrder.getPtr(), numPoints, 30, true);
+
+    s.pointOf.reset(numVertices);
+    s.pos.reset(numPoints);
+    for (int i = 0; i < numPoints; i++)
+    {
+        s.pointOf[pointOrder[i]] = i;
+        s.pos[i] = s.vertexPos[pointOrder[i]];
+    }
+    for (int i = 0; i < numVertices; i++)
+        s.pointOf[i] = s.pointOf[s.rep[i]];
+
+    s.vertexPos.reset();
+    s.posKey.reset();
+    s.posOrder.reset();
+    s.rep.reset();
+
+    s.moved.reset(numPoints);
+    memset(s.moved.getPtr(), 0, s.moved.getNumBytes());
+    s.quadrics.reset(numPoints);
+    s.areas.reset(numPoints);
+    s.stamps.reset(numPoints);
+    memset(s.stamps.getPtr(), 0, s.stamps.getNumBytes());
+
+    s.vertexQuadrics.reset(numVertices * s.quadricStride);
+    memset(s.vertexQuadrics.getPtr(), 0, s.vertexQuadrics.getNumBytes());
+    s.vertexSolved.reset(numVertices);
+    memset(s.vertexSolved.getPtr(), 0, s.vertexSolved.getNumBytes());
+}
+
+//------------------------------------------------------------------------
+
+void FW::setupTriangles(SimplifyState& s)
+{
+    const MeshBase& mesh = *s.mesh;
+    int numPoints = s.pos.getSize();
+
+    // Faces of all submeshes by their lowest point, with a counting sort.
+    // Faces with two corners at the same point are dropped.
+
+    Array<S32> offsets(NULL, numPoints + 1);
+    memset(offsets.getPtr(), 0, offsets.getNumBytes());
+    int numTris = 0;
+    for (int i = 0; i < mesh.numSubmeshes(); i++)
+    {
+        const Array<Vec3i>& tris = mesh.indices(i);
+        for (int j = 0; j < tris.getSize(); j++)
+        {
+            Vec3i p(s.pointOf[tris[j].x], s.pointOf[tris[j].y], s.pointOf[tris[j].z]);
+            if (p.x != p.y && p.y != p.z && p.z != p.x)
+            {
+                offsets[min(p.x, p.y, p.z) + 1]++;
+                numTris++;
+            }
+        }
+    }
+    for (int i = 0; i < numPoints; i++)
+        offsets[i + 1] += offsets[i];
+
+    s.tris.reset(numTris);
+    s.triPoints.reset(numTris);
+    s.triSubmesh.reset(numTris);
+    for (int i = 0; i < mesh.numSubmeshes(); i++)
+    {
+        const Array<Vec3i>& tris = mesh.indices(i);
+        for (int j = 0; j < tris.getSize(); j++)
+        {
+            Vec3i p(s.pointOf[tris[j].x], s.pointOf[tris[j].y], s.pointOf[tris[j].z]);
+            if (p.x != p.y && p.y != p.z && p.z != p.x)
+            {
+                int t = offsets[min(p.x, p.y, p.z)]++;
+                s.tris[t] = tris[j];
+                s.triPoints[t] = p;
+                s.triSubmesh[t] = i;
+            }
+        }
+    }
+    s.liveTriangles = numTris;
+
+    // Point -> face references.
+
+    s.triStart.reset(numPoints);
+    s.triCount.reset(numPoints);
+    memset(s.triCount.getPtr(), 0, s.triCount.getNumBytes());
+    for (int i = 0; i < numTris; i++)
+        for (int k = 0; k < 3; k++)
+            s.triCount[s.triPoints[i][k]]++;
+
+    int offset = 0;
+    for (int i = 0; i < numPoints; i++)
+    {
+        s.triStart[i] = offset;
+        offset += s.triCount[i];
+        s.triCount[i] = 0;
+    }
+
+    s.triRefs.reset(offset);
+    for (int i = 0; i < numTris; i++)
+        for (int k = 0; k < 3; k++)
+        {
+            int p = s.triPoints[i][k];
+            s.triRefs[s.triStart[p] + s.triCount[p]++] = i;
+        }
+}
+
+//------------------------------------------------------------------------
+
+void FW::setupEdges(SimplifyState& s)
+{
+    int numPoints = s.pos.getSize();
+
+    s.chunkScratch.reset(maxChunks());
+    s.chunkEdges.reset(maxChunks());
+    s.chunkPlanes.reset(maxChunks());
+    launchChunks(findEdges, s, numPoints, SIMPLIFY_CHUNK_SIZE);
+
+    // Concatenate the edges and add the constraint planes of features.
+
+    int numEdges = 0;
+    for (int i = 0; i < s.numChunks; i++)
+        numEdges += s.chunkEdges[i].getSize();
+
+    s.edges.reset(numEdges);
+    s.edgeStart.reset(numPoints);
+    s.edgeCount.reset(numPoints);
+    memset(s.edgeCount.getPtr(), 0, s.edgeCount.getNumBytes());
+
+    int edgeIdx = 0;
+    F64 lengthSum = 0.0;
+    for (int i = 0; i < s.numChunks; i++)
+    {
+        const Array<Vec2i>& edges = s.chunkEdges[i];
+        for (int j = 0; j < edges.getSize(); j++)
+        {
+            CollapseEdge& edge = s.edges[edgeIdx++];
+            edge.v[0] = edges[j].x;
+            edge.v[1] = edges[j].y;
+            edge.target = s.pos[edge.v[0]];
+            edge.mode = CollapseMode_Merge;
+            s.edgeCount[edge.v[0]]++;
+            s.edgeCount[edge.v[1]]++;
+            if (s.params.pairDistance > 0.0f)
+                lengthSum += (Vec3d(s.pos[edge.v[1]]) - Vec3d(s.pos[edge.v[0]])).length();
+        }
+
+        const Array<FeaturePlane>& planes = s.chunkPlanes[i];
+        for (int j = 0; j < planes.getSize(); j++)
+        {
+            const FeaturePlane& plane = planes[j];
+            Quadric q;
+            q.clear();
+            q.addPlane(plane.normal, plane.offset, plane.weight);
+            s.quadrics[plane.v[0]] += q;
+            s.quadrics[plane.v[1]] += q;
+        }
+    }
+    s.chunkPlanes.reset();
+
+    s.numPairs = 0;
+    if (s.params.pairDistance > 0.0f && numEdges)
+        setupPairs(s, lengthSum / numEdges);
+    s.chunkEdges.reset();
+    numEdges = s.edges.getSize();
+
+    // Point -> edge references.
+
+    int offset = 0;
+    for (int i = 0; i < numPoints; i++)
+    {
+        s.edgeStart[i] = offset;
+        offset += s.edgeCount[i];
+        s.edgeCount[i] = 0;
+    }
+
+    s.edgeRefs.reset(offset);
+    for (int i = 0; i < numEdges; i++)
+        for (int k = 0; k < 2; k++)
+        {
+            int p = s.edges[i].v[k];
+            s.edgeRefs[s.edgeStart[p] + s.edgeCount[p]++] = i;
+        }
+
+    // Initial errors.
+
+    s.edgeKey.reset(numEdges);
+    s.edgeDead.reset(numEdges);
+    memset(s.edgeDead.getPtr(), 0, s.edgeDead.getNumBytes());
+    launchChunks(evaluateEdges, s, numEdges, SIMPLIFY_CHUNK_SIZE);
+}
+
+//------------------------------------------------------------------------
+
+void FW::setupPairs(SimplifyState& s, F64 meanEdgeLength)
+{
+    // Bucket the points in a grid of pairDistance-sized cells, sorted by
+    // cell, and append the pairs found there after the edges. Like the
+    // edges, they count towards the reference lists of their ends.
+
+    int numPoints = s.pos.getSize();
+    s.pairDistance = s.params.pairDistance * meanEdgeLength;
+    if (!(s.pairDistance > 0.0))
+        return;
+
+    s.cellKey.reset(numPoints);
+    s.cellOrder.reset(numPoints);
+    launchChunks(gridPoints, s, numPoints, SIMPLIFY_CHUNK_SIZE);
+    radixSort(s.cellKey.getPtr(), s.cellOrder.getPtr(), numPoints, 63, true);
+    launchChunks(findPairs, s, numPoints, SIMPLIFY_CHUNK_SIZE);
+    s.cellKey.reset();
+    s.cellOrder.reset();
+
+    for (int i = 0; i < s.numChunks; i++)
+    {
+        const Array<Vec2i>& pairs = s.chunkEdges[i];
+        for (int j = 0; j < pairs.getSize(); j++)
+        {
+            CollapseEdge& edge = s.edges.add();
+            edge.v[0] = pairs[j].x;
+            edge.v[1] = pairs[j].y;
+            edge.target = s.pos[edge.v[0]];
+            edge.mode = CollapseMode_Merge;
+            s.edgeCount[edge.v[0]]++;
+            s.edgeCount[edge.v[1]]++;
+        }
+        s.numPairs += pairs.getSize();
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::setupPartitions(SimplifyState& s, int offset)
+{
+    int numPoints = s.pos.getSize();
+    int numEdges = s.edges.getSize();
+    int numPartitions = s.numPartitions;
+    s.edgePartition.reset(numEdges);
+    s.edgeLocal.reset(numEdges);
+    for (int i = 0; i < numEdges; i++)
+        s.edgePartition[i] = s.edgeLocal[i] = -1;
+
+    s.partition.reset(numPoints);
+    for (int i = 0; i < numPoints; i++)
+        s.partition[i] = (int)((S64)(i + offset) * numPartitions / numPoints) % numPartitions;
+
+    s.border.reset(numPoints);
+    launchChunks(findBorders, s, numPoints, SIMPLIFY_CHUNK_SIZE);
+
+    s.workers.reset(numPartitions);
+    for (int i = 0; i < numPartitions; i++)
+    {
+        CollapseWorker& worker = s.workers[i];
+        worker.partition = i;
+        worker.liveTriangles = 0;
+        worker.interiorTriangles = 0;
+    }
+
+    for (int i = 0; i < s.tris.getSize(); i++)
+    {
+        if (s.tris[i].x < 0)
+            continue;
+        const Vec3i& p = s.triPoints[i];
+        CollapseWorker& worker = s.workers[s.partition[min(p.x, p.y, p.z)]];
+        worker.liveTriangles++;
+        if (!s.border[p.x] && !s.border[p.y] && !s.border[p.z])
+            worker.interiorTriangles++;
+    }
+
+    for (int i = 0; i < numEdges; i++)
+    {
+        const CollapseEdge& edge = s.edges[i];
+        if (s.edgeDead[i] || s.border[edge.v[0]] || s.border[edge.v[1]])
+            continue;
+        int part = s.partition[edge.v[0]];
+        CollapseWorker& worker = s.workers[part];
+        s.edgePartition[i] = part;
+        s.edgeLocal[i] = worker.localEdges.getSize();
+        worker.localEdges.add(i);
+    }
+    s.border.reset();
+
+    // Each partition writes its merged reference lists to a region of
+    // twice the size of its current ones; a worker whose region fills up
+    // stops early.
+
+    Array<Vec2i> numRefs(NULL, numPartitions);
+    memset(numRefs.getPtr(), 0, numRefs.getNumBytes());
+    for (int p = 0; p < numPoints; p++)
+        numRefs[s.partition[p]] += Vec2i(s.triCount[p], s.edgeCount[p]);
+    s.partition.reset();
+
+    for (int i = 0; i < numPartitions; i++)
+    {
+        CollapseWorker& worker = s.workers[i];
+        worker.triCursor = s.triRefs.getSize();
+        worker.triEnd = worker.triCursor + numRefs[i].x * 2 + 64;
+        worker.edgeCursor = s.edgeRefs.getSize();
+        worker.edgeEnd = worker.edgeCursor + numRefs[i].y * 2 + 64;
+        s.triRefs.resize(worker.triEnd);
+        s.edgeRefs.resize(worker.edgeEnd);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::runCollapses(SimplifyState& s, SimplifyReport& report)
+{
+    F32 maxKey = 0.0f;
+
+    // Partition interiors concurrently, in two rounds. Each partition
+    // removes its share of interior faces only; the borders are left at
+    // full resolution, so they must not be compensated for here. The second
+    // round shifts the partitions by half their size, which puts most of
+    // the first borders inside a partition and leaves little for the final
+    // pass, the only part that runs on one thread. Stamps only need to be
+    // unique per partition.
+
+    int numPoints = s.pos.getSize();
+    for (int round = 0; round < 2 && s.numPartitions > 1; round++)
+    {
+        if (s.liveTriangles <= s.params.targetTriangles)
+            break;
+
+        setupPartitions(s, (round == 0) ? 0 : numPoints / (s.numPartitions * 2));
+        F64 fraction = (F64)s.params.targetTriangles / (F64)max(s.liveTriangles, 1);
+        for (int i = 0; i < s.numPartitions; i++)
+        {
+            CollapseWorker& worker = s.workers[i];
+            worker.ownedTriangles = worker.liveTriangles;
+            worker.targetTriangles = worker.liveTriangles - (int)(worker.interiorTriangles * (1.0 - fraction));
+            worker.stamp = 0;
+            worker.heap.clear();
+            for (int j = 0; j < worker.localEdges.getSize(); j++)
+                if (s.edgeKey[worker.localEdges[j]] >= 0.0f)
+                    worker.heap.add(j, s.edgeKey[worker.localEdges[j]]);
+        }
+
+        MulticoreLauncher().push(runPartition, &s, 0, s.numPartitions).popAll();
+
+        // Partitions never touch the same faces => their collapses can be
+        // logged one partition after another.
+
+        F32 slowest = 0.0f;
+        for (int i = 0; i < s.numPartitions; i++)
+        {
+            const CollapseWorker& worker = s.workers[i];
+            s.liveTriangles -= worker.ownedTriangles - worker.liveTriangles;
+            report.numCollapses += worker.numCollapses;
+            slowest = max(slowest, worker.seconds);
+            maxKey = max(maxKey, worker.maxKey);
+            if (s.params.log)
+                appendLog(*s.params.log, worker.log);
+        }
+        report.partitionSeconds += slowest;
+        s.workers.reset();
+        memset(s.stamps.getPtr(), 0, s.stamps.getNumBytes());
+    }
+
+    // Final pass over everything left, borders included.
+
+    CollapseWorker global;
+    global.partition = -1;
+    global.targetTriangles = s.params.targetTriangles;
+    global.triCursor = global.triEnd = -1;
+    global.edgeCursor = global.edgeEnd = -1;
+    global.stamp = 0;
+    global.liveTriangles = s.liveTriangles;
+
+    for (int i = 0; i < s.edges.getSize(); i++)
+        if (!s.edgeDead[i] && s.edgeKey[i] >= 0.0f)
+            global.heap.add(i, s.edgeKey[i]);
+
+    Timer timer(true);
+    runWorker(s, global);
+    report.finalSeconds = timer.getElapsed();
+    report.finalCollapses = global.numCollapses;
+    if (s.params.log)
+        appendLog(*s.params.log, global.log);
+    s.liveTriangles = global.liveTriangles;
+    report.numCollapses += global.numCollapses;
+    report.maxError = sqrt(max(maxKey, global.maxKey));
+}
+
+//------------------------------------------------------------------------
+
+void FW::writeOutput(SimplifyState& s)
+{
+    MeshBase& mesh = *s.mesh;
+    int numSubmeshes = mesh.numSubmeshes();
+    int stride = mesh.vertexStride();
+
+    // Faces by submesh, in the working order, and the vertices they use in
+    // order of first use.
+
+    Array<Array<Vec3i> > tris(NULL, numSubmeshes);
+    for (int i = 0; i < s.tris.getSize(); i++)
+        if (s.tris[i].x >= 0)
+            tris[s.triSubmesh[i]].add(s.tris[i]);
+
+    if (s.params.keepVertices)
+    {
+        for (int i = 0; i < numSubmeshes; i++)
+            mesh.setIndices(i, tris[i]);
+        return;
+    }
+
+    Array<S32> outIdx(NULL, mesh.numVertices());
+    for (int i = 0; i < outIdx.getSize(); i++)
+        outIdx[i] = -1;
+
+    Array<S32> outVertices;
+    for (int i = 0; i < numSubmeshes; i++)
+        for (int j = 0; j < tris[i].getSize(); j++)
+            for (int k = 0; k < 3; k++)
+            {
+                S32& idx = outIdx[tris[i][j][k]];
+                if (idx == -1)
+                {
+                    idx = outVertices.getSize();
+                    outVertices.add(tris[i][j][k]);
+                }
+                tris[i][j][k] = idx;
+            }
+
+    // Copy the surviving vertices, then update moved positions and solved
+    // attributes.
+
+    int numOut = outVertices.getSize();
+    Array<U8> vertices(NULL, numOut * stride);
+    for (int i = 0; i < numOut; i++)
+        memcpy(vertices.getPtr(i * stride), mesh.getVertexPtr(outVertices[i]), stride);
+
+    mesh.resetVertices(numOut);
+    mesh.setVertices(0, vertices.getPtr(), numOut);
+    vertices.reset();
+
+    for (int i = 0; i < numOut; i++)
+    {
+        int v = outVertices[i];
+        int p = s.pointOf[v];
+        if (s.moved[p])
+            mesh.setVertexAttrib(i, s.posAttrib, Vec4f(s.pos[p], 1.0f));
+        if (!s.vertexSolved[v])
+            continue;
+
+        const F32* a = s.attribs.getPtr(v * s.numAttribs);
+        if (s.normalAttrib != -1)
+        {
+            Vec3f n = Vec3f(a[0], a[1], a[2]);
+            F32 len = n.length();
+            if (len > 0.0f)
+                mesh.setVertexAttrib(i, s.normalAttrib, Vec4f(n / len, 0.0f));
+            a += 3;
+        }
+        if (s.texCoordAttrib != -1)
+        {
+            Vec4f t = mesh.getVertexAttrib(i, s.texCoordAttrib);
+            t.x = a[0] / s.texCoordScale;
+            t.y = a[1] / s.texCoordScale;
+            mesh.setVertexAttrib(i, s.texCoordAttrib, t);
+        }
+    }
+
+    for (int i = 0; i < numSubmeshes; i++)
+        mesh.setIndices(i, tris[i]);
+}
+
+//------------------------------------------------------------------------
+
+int FW::cornerOf(const Vec3i& points, int point)
+{
+    for (int k = 0; k < 3; k++)
+        if (points[k] == point)
+            return k;
+    return -1;
+}
+
+//------------------------------------------------------------------------
+
+bool FW::sharesFace(const SimplifyState& s, int a, int b)
+{
+    for (int i = 0; i < s.triCount[a]; i++)
+    {
+        int t = s.triRefs[s.triStart[a] + i];
+        if (s.tris[t].x >= 0 && cornerOf(s.triPoints[t], b) != -1)
+            return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------
+
+void FW::classifyPoint(const SimplifyState& s, int point, PointInfo& info, Array<PointNeighbor>& neighbors)
+{
+    // Walk the live faces of the point and tally the edges to its
+    // neighbors. An edge is a feature unless it has exactly two faces that
+    // agree on the vertices at both ends and on the submesh.
+
+    neighbors.clear();
+    info.vertices.clear();
+
+    for (int i = 0; i < s.triCount[point]; i++)
+    {
+        int t = s.triRefs[s.triStart[point] + i];
+        const Vec3i& tri = s.tris[t];
+        if (tri.x < 0)
+            continue;
+
+        const Vec3i& pts = s.triPoints[t];
+        int k = cornerOf(pts, point);
+        int own = tri[k];
+        int j = 0;
+        while (j < info.vertices.getSize() && info.vertices[j] != own)
+            j++;
+        if (j == info.vertices.getSize())
+            info.vertices.add(own);
+
+        for (int c = 1; c < 3; c++)
+        {
+            int vertex = tri[(k + c) % 3];
+            int other = pts[(k + c) % 3];
+            j = 0;
+            while (j < neighbors.getSize() && neighbors[j].point != other)
+                j++;
+
+            if (j == neighbors.getSize())
+            {
+                PointNeighbor& nb = neighbors.add();
+                nb.point = other;
+                nb.count = 1;
+                nb.vertex = vertex;
+                nb.ownVertex = own;
+                nb.submesh = s.triSubmesh[t];
+                nb.seam = false;
+            }
+            else
+            {
+                PointNeighbor& nb = neighbors[j];
+                nb.count++;
+                if (nb.vertex != vertex || nb.ownVertex != own || nb.submesh != s.triSubmesh[t])
+                    nb.seam = true;
+            }
+        }
+    }
+
+    int numFeatures = 0;
+    bool manifold = true;
+    for (int i = 0; i < neighbors.getSize(); i++)
+    {
+        const PointNeighbor& nb = neighbors[i];
+        manifold &= (nb.count <= 2);
+        if (nb.count == 2 && !nb.seam)
+            continue;
+        if (numFeatures < 2)
+            info.feature[numFeatures] = nb.point;
+        numFeatures++;
+    }
+
+    if (!manifold)
+        info.kind = PointKind_Locked;
+    else if (numFeatures == 0)
+        info.kind = (info.vertices.getSize() == 1) ? PointKind_Interior : PointKind_Locked;
+    else
+        info.kind = (numFeatures == 2) ? PointKind_Feature : PointKind_Locked;
+}
+
+//------------------------------------------------------------------------
+
+bool FW::mapVertices(const SimplifyState& s, int from, int to, const PointInfo& fromInfo, Array<Vec2i>& map)
+{
+    // Sliding 'from' onto 'to' hands each of its vertices to the vertex at
+    // 'to' on a face they share. Every vertex must find exactly one.
+
+    map.clear();
+    for (int i = 0; i < s.triCount[from]; i++)
+    {
+        int t = s.triRefs[s.triStart[from] + i];
+        const Vec3i& tri = s.tris[t];
+        if (tri.x < 0)
+            continue;
+
+        int kt = cornerOf(s.triPoints[t], to);
+        if (kt == -1)
+            continue;
+
+        int w = tri[cornerOf(s.triPoints[t], from)];
+        int j = 0;
+        while (j < map.getSize() && map[j].x != w)
+            j++;
+        if (j == map.getSize())
+            map.add(Vec2i(w, tri[kt]));
+        else if (map[j].y != tri[kt])
+            return false;
+    }
+    return (map.getSize() == fromInfo.vertices.getSize());
+}
+
+//------------------------------------------------------------------------
+
+F64 FW::attribError(const SimplifyState& s, const F64* vq, const Vec3d& p, const F32* a)
+{
+    // Attribute part of a vertex quadric at position p and attributes a.
+
+    int m = s.numAttribs;
+    F64 alpha = vq[m * 4];
+    F64 error = 0.0;
+    for (int j = 0; j < m; j++)
+    {
+        F64 g = vq[j * 3 + 0] * p.x + vq[j * 3 + 1] * p.y + vq[j * 3 + 2] * p.z;
+        error += a[j] * (2.0 * (g + vq[m * 3 + j]) + alpha * a[j]);
+    }
+    return error;
+}
+
+//------------------------------------------------------------------------
+
+F64 FW::slideCost(const SimplifyState& s, const Quadric& q, int to, const PointInfo& toInfo, const Array<Vec2i>& map)
+{
+    // The position and the vertices at 'to' stay; every vertex there takes
+    // on the quadrics of those mapped to it.
+
+    Vec3d p = s.pos[to];
+    F64 cost = q.eval(p);
+    if (!s.numAttribs)
+        return cost;
+
+    F64 vq[SIMPLIFY_MAX_QUADRIC];
+    for (int i = 0; i < toInfo.vertices.getSize(); i++)
+    {
+        int u = toInfo.vertices[i];
+        memcpy(vq, s.vertexQuadrics.getPtr(u * s.quadricStride), s.quadricStride * sizeof(F64));
+        for (int j = 0; j < map.getSize(); j++)
+        {
+            if (map[j].y != u)
+                continue;
+            const F64* other = s.vertexQuadrics.getPtr(map[j].x * s.quadricStride);
+            for (int k = 0; k < s.quadricStride; k++)
+                vq[k] += other[k];
+        }
+        cost += attribError(s, vq, p, s.attribs.getPtr(u * s.numAttribs));
+    }
+    return cost;
+}
+
+//------------------------------------------------------------------------
+
+bool FW::evaluateEdge(SimplifyState& s, int edgeIdx, CollapseScratch& scratch, int known)
+{
+    // 'known' is an end already classified into scratch.info[2].
+
+    CollapseEdge& edge = s.edges[edgeIdx];
+    int a = edge.v[0];
+    int b = edge.v[1];
+    const PointInfo* info[2] = { &scratch.info[(a == known) ? 2 : 0], &scratch.info[(b == known) ? 2 : 1] };
+    const PointInfo& ia = *info[0];
+    const PointInfo& ib = *info[1];
+    if (a != known)
+        classifyPoint(s, a, scratch.info[0], scratch.neighbors);
+    if (b != known)
+        classifyPoint(s, b, scratch.info[1], scratch.neighbors);
+
+    Quadric q = s.quadrics[a];
+    q += s.quadrics[b];
+    F64 best = FW_F64_MAX;
+
+    if (ia.kind == PointKind_Interior && ib.kind == PointKind_Interior && !s.params.keepVertices)
+    {
+        // Both ends free => minimize over the attributes first, which
+        // leaves a quadric over the position (Hoppe 1999), then place the
+        // point at its optimum if that is well-conditioned and stays near
+        // the edge; otherwise at the best of the ends and the midpoint.
+
+        int m = s.numAttribs;
+        if (m)
+        {
+            const F64* qa = s.vertexQuadrics.getPtr(ia.vertices[0] * s.quadricStride);
+            const F64* qb = s.vertexQuadrics.getPtr(ib.vertices[0] * s.quadricStride);
+            F64 alpha = qa[m * 4] + qb[m * 4];
+            if (alpha > 0.0)
+                for (int j = 0; j < m; j++)
+                {
+                    Vec3d g(qa[j * 3 + 0] + qb[j * 3 + 0], qa[j * 3 + 1] + qb[j * 3 + 1], qa[j * 3 + 2] + qb[j * 3 + 2]);
+                    q.addPlane(g, qa[m * 3 + j] + qb[m * 3 + j], -1.0 / alpha);
+                }
+        }
+
+        Vec3d pa = s.pos[a];
+        Vec3d pb = s.pos[b];
+        Vec3d mid = (pa + pb) * 0.5;
+        Vec3d target;
+        if (q.optimum(target) && (target - mid).lenSqr() <= 4.0 * (pb - pa).lenSqr())
+            best = q.eval(target);
+        else
+        {
+            target = mid;
+            best = q.eval(mid);
+            F64 costA = q.eval(pa);
+            F64 costB = q.eval(pb);
+            if (costA < best) { target = pa; best = costA; }
+            if (costB < best) { target = pb; best = costB; }
+        }
+        edge.mode = CollapseMode_Merge;
+        edge.target = Vec3f(target);
+    }
+    else
+    {
+        // Slide one end onto the other; a feature point only along its
+        // feature. The ends of a close pair have no faces in common to
+        // slide along, so either may jump onto the other if both have a
+        // single vertex.
+
+        bool pair = (s.params.pairDistance > 0.0f && !sharesFace(s, a, b));
+        for (int dir = 0; dir < 2; dir++)
+        {
+            int from = edge.v[dir];
+            int to = edge.v[dir ^ 1];
+            const PointInfo& fi = *info[dir];
+            Array<Vec2i>& map = scratch.vertexMap[dir];
+            if (pair)
+            {
+                if (fi.vertices.getSize() != 1 || info[dir ^ 1]->vertices.getSize() != 1)
+                    continue;
+                map.clear();
+                map.add(Vec2i(fi.vertices[0], info[dir ^ 1]->vertices[0]));
+            }
+            else
+            {
+                bool canSlide = (fi.kind == PointKind_Interior || (fi.kind == PointKind_Feature && (fi.feature[0] == to || fi.feature[1] == to)));
+                if (!canSlide || !mapVertices(s, from, to, fi, map))
+                    continue;
+            }
+
+            F64 cost = slideCost(s, q, to, *info[dir ^ 1], map);
+            if (cost < best)
+            {
+                best = cost;
+                edge.mode = (dir == 0) ? CollapseMode_Into1 : CollapseMode_Into0;
+                edge.target = s.pos[to];
+            }
+        }
+    }
+
+    if (best == FW_F64_MAX)
+    {
+        s.edgeKey[edgeIdx] = -1.0f;
+        return false;
+    }
+
+    // Normalize by area => roughly a squared distance.
+
+    F64 area = s.areas[a] + s.areas[b];
+    best = max(best, 0.0);
+    s.edgeKey[edgeIdx] = (F32)min((area > 0.0) ? best / area : best, (F64)FW_F32_MAX);
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+bool FW::flipsFaces(const SimplifyState& s, int point, int other, const Vec3f& target)
+{
+    for (int i = 0; i < s.triCount[point]; i++)
+    {
+        int t = s.triRefs[s.triStart[point] + i];
+        const Vec3i& pts = s.triPoints[t];
+        if (s.tris[t].x < 0 || cornerOf(pts, other) != -1)
+            continue;   // Dead, or removed by the collapse.
+
+        Vec3f p[3] = { s.pos[pts.x], s.pos[pts.y], s.pos[pts.z] };
+        Vec3f before = cross(p[1] - p[0], p[2] - p[0]);
+        p[cornerOf(pts, point)] = target;
+        Vec3f after = cross(p[1] - p[0], p[2] - p[0]);
+
+        if (dot(before, after) <= 0.0f && before.lenSqr() > 0.0f)
+            return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------
+
+bool FW::keepsManifold(SimplifyState& s, CollapseWorker& worker, int a, int b)
+{
+    // Link condition: the only points adjacent to both ends are the third
+    // corners of the faces on the edge.
+
+    int stampA = ++worker.stamp;
+    for (int i = 0; i < s.triCount[a]; i++)
+    {
+        int t = s.triRefs[s.triStart[a] + i];
+        if (s.tris[t].x >= 0)
+            for (int k = 0; k < 3; k++)
+                s.stamps[s.triPoints[t][k]] = stampA;
+    }
+
+    int stampB = ++worker.stamp;
+    int numCommon = 0;
+    int numShared = 0;
+    for (int i = 0; i < s.triCount[b]; i++)
+    {
+        int t = s.triRefs[s.triStart[b] + i];
+        if (s.tris[t].x < 0)
+            continue;
+
+        bool shared = false;
+        for (int k = 0; k < 3; k++)
+        {
+            int p = s.triPoints[t][k];
+            if (p == a)
+                shared = true;
+            else if (p != b)
+            {
+                if (s.stamps[p] == stampA)
+                    numCommon++;
+                s.stamps[p] = stampB;
+            }
+        }
+        if (shared)
+            numShared++;
+    }
+    return (numCommon == numShared);
+}
+
+//------------------------------------------------------------------------
+
+int FW::heapIndex(const SimplifyState& s, const CollapseWorker& worker, int edge)
+{
+    if (worker.partition == -1)
+        return edge;
+    return (s.edgePartition[edge] == worker.partition) ? s.edgeLocal[edge] : -1;
+}
+
+//------------------------------------------------------------------------
+
+bool FW::contract(SimplifyState& s, CollapseWorker& worker, int edgeIdx)
+{
+    // Uses the scratch of the evaluateEdge() call just made for the edge.
+
+    const CollapseEdge& edge = s.edges[edgeIdx];
+    CollapseScratch& scratch = worker.scratch;
+    bool merge = (edge.mode == CollapseMode_Merge);
+    int keep = (edge.mode == CollapseMode_Into1) ? edge.v[1] : edge.v[0];
+    int gone = edge.v[0] + edge.v[1] - keep;
+
+    // Out of room for the merged lists => leave it to the final pass.
+
+    if (worker.triEnd != -1 && (worker.triCursor + s.triCount[keep] + s.triCount[gone] > worker.triEnd ||
+        worker.edgeCursor + s.edgeCount[keep] + s.edgeCount[gone] > worker.edgeEnd))
+        return false;
+
+    Array<Vec2i>& map = scratch.vertexMap[(edge.mode == CollapseMode_Into0) ? 1 : 0];
+    if (merge)
+    {
+        map.clear();
+        map.add(Vec2i(scratch.info[1].vertices[0], scratch.info[0].vertices[0]));
+    }
+
+    // Merge the quadrics.
+
+    s.quadrics[keep] += s.quadrics[gone];
+    s.areas[keep] += s.areas[gone];
+    for (int i = 0; i < map.getSize(); i++)
+    {
+        F64* dst = s.vertexQuadrics.getPtr(map[i].y * s.quadricStride);
+        const F64* src = s.vertexQuadrics.getPtr(map[i].x * s.quadricStride);
+        for (int k = 0; k < s.quadricStride; k++)
+            dst[k] += src[k];
+    }
+
+    // A merge moves the point and solves the attributes there.
+
+    if (merge)
+    {
+        s.pos[keep] = edge.target;
+        s.moved[keep] = 1;
+
+        int m = s.numAttribs;
+        int v = map[0].y;
+        const F64* vq = s.vertexQuadrics.getPtr(v * s.quadricStride);
+        if (m && vq[m * 4] > 0.0)
+        {
+            Vec3d p = edge.target;
+            F32* a = s.attribs.getPtr(v * m);
+            for (int j = 0; j < m; j++)
+                a[j] = (F32)(-(vq[j * 3 + 0] * p.x + vq[j * 3 + 1] * p.y + vq[j * 3 + 2] * p.z + vq[m * 3 + j]) / vq[m * 4]);
+            s.vertexSolved[v] = 1;
+        }
+    }
+
+    // Faces: those spanning both points disappear, the rest of the removed
+    // point's move to the mapped vertices.
+
+    SimplifyLog* log = (s.params.log) ? &worker.log : NULL;
+    if (log)
+    {
+        SimplifyLog::Collapse& c = log->collapses.add();
+        c.firstRemoved = log->removedFaces.getSize();
+        c.firstMoved = log->movedCorners.getSize();
+    }
+
+    for (int i = 0; i < s.triCount[gone]; i++)
+    {
+        int t = s.triRefs[s.triStart[gone] + i];
+        Vec3i& tri = s.tris[t];
+        Vec3i& pts = s.triPoints[t];
+        if (tri.x < 0)
+            continue;
+        if (cornerOf(pts, keep) != -1)
+        {
+            if (log)
+                log->removedFaces.add(t);
+            tri = Vec3i(-1);
+            worker.liveTriangles--;
+            continue;
+        }
+
+        int k = cornerOf(pts, gone);
+        for (int j = 0; j < map.getSize(); j++)
+            if (map[j].x == tri[k])
+            {
+                if (log)
+                    log->movedCorners.add(Vec4i(t, k, map[j].x, map[j].y));
+                tri[k] = map[j].y;
+                pts[k] = keep;
+                break;
+            }
+    }
+
+    if (log)
+    {
+        SimplifyLog::Collapse& c = log->collapses.getLast();
+        c.numRemoved = log->removedFaces.getSize() - c.firstRemoved;
+        c.numMoved = log->movedCorners.getSize() - c.firstMoved;
+    }
+
+    int start = (worker.triEnd == -1) ? s.triRefs.getSize() : worker.triCursor;
+    int count = 0;
+    for (int side = 0; side < 2; side++)
+    {
+        int p = (side == 0) ? keep : gone;
+        for (int i = 0; i < s.triCount[p]; i++)
+        {
+            int t = s.triRefs[s.triStart[p] + i];
+            if (s.tris[t].x < 0)
+                continue;
+            if (worker.triEnd == -1)
+                s.triRefs.add(t);
+            else
+                s.triRefs[start + count] = t;
+            count++;
+        }
+    }
+    s.triStart[keep] = start;
+    s.triCount[keep] = count;
+    s.triCount[gone] = 0;
+    if (worker.triEnd != -1)
+        worker.triCursor += count;
+
+    // Edges: those of the removed point are redirected; the collapsed edge
+    // and any that now duplicate another die.
+
+    worker.stamp++;
+    start = (worker.edgeEnd == -1) ? s.edgeRefs.getSize() : worker.edgeCursor;
+    count = 0;
+    for (int side = 0; side < 2; side++)
+    {
+        int p = (side == 0) ? keep : gone;
+        for (int i = 0; i < s.edgeCount[p]; i++)
+        {
+            int e = s.edgeRefs[s.edgeStart[p] + i];
+            if (s.edgeDead[e])
+                continue;
+
+            CollapseEdge& other = s.edges[e];
+            int end = (other.v[0] == p) ? 0 : 1;
+            int far = other.v[end ^ 1];
+            if (far == keep || far == gone || s.stamps[far] == worker.stamp)
+            {
+                s.edgeDead[e] = 1;
+                int idx = heapIndex(s, worker, e);
+                if (idx != -1)
+                    worker.heap.remove(idx);
+                continue;
+            }
+
+            other.v[end] = keep;
+            s.stamps[far] = worker.stamp;
+            if (worker.edgeEnd == -1)
+                s.edgeRefs.add(e);
+            else
+                s.edgeRefs[start + count] = e;
+            count++;
+        }
+    }
+    s.edgeStart[keep] = start;
+    s.edgeCount[keep] = count;
+    s.edgeCount[gone] = 0;
+    if (worker.edgeEnd != -1)
+        worker.edgeCursor += count;
+
+    // The surviving edges see a new point, classified once for all of them.
+
+    classifyPoint(s, keep, scratch.info[2], scratch.neighbors);
+    for (int i = 0; i < count; i++)
+    {
+        int e = s.edgeRefs[start + i];
+        int idx = heapIndex(s, worker, e);
+        if (evaluateEdge(s, e, scratch, keep))
+        {
+            if (idx != -1)
+                worker.heap.add(idx, s.edgeKey[e]);
+        }
+        else if (idx != -1)
+            worker.heap.remove(idx);
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+void FW::runWorker(SimplifyState& s, CollapseWorker& worker)
+{
+    worker.numCollapses = 0;
+    worker.maxKey = 0.0f;
+
+    while (worker.liveTriangles > worker.targetTriangles && !worker.heap.isEmpty())
+    {
+        int idx = worker.heap.getMinIndex();
+        F32 key = worker.heap.get(idx);
+        if (key > s.maxKey)
+            break;
+        worker.heap.remove(idx);
+
+        // Collapses nearby may have changed the ends since the edge was
+        // evaluated => evaluate again, and requeue it if it got worse.
+        // Edges that cannot collapse stay out of the heap until a collapse
+        // next to them evaluates them again.
+
+        int e = (worker.partition == -1) ? idx : worker.localEdges[idx];
+        if (!evaluateEdge(s, e, worker.scratch))
+            continue;
+        if (s.edgeKey[e] > key)
+        {
+            worker.heap.add(idx, s.edgeKey[e]);
+            continue;
+        }
+
+        const CollapseEdge& edge = s.edges[e];
+        if ((edge.mode != CollapseMode_Into0 && flipsFaces(s, edge.v[0], edge.v[1], edge.target)) ||
+            (edge.mode != CollapseMode_Into1 && flipsFaces(s, edge.v[1], edge.v[0], edge.target)) ||
+            !keepsManifold(s, worker, edge.v[0], edge.v[1]))
+            continue;
+
+        F32 edgeKey = s.edgeKey[e];
+        if (!contract(s, worker, e))
+            break;
+        worker.numCollapses++;
+        worker.maxKey = max(worker.maxKey, edgeKey);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::appendLog(SimplifyLog& dst, const SimplifyLog& src)
+{
+    int numRemoved = dst.removedFaces.getSize();
+    int numMoved = dst.movedCorners.getSize();
+    for (int i = 0; i < src.collapses.getSize(); i++)
+    {
+        SimplifyLog::Collapse& c = dst.collapses.add(src.collapses[i]);
+        c.firstRemoved += numRemoved;
+        c.firstMoved += numMoved;
+    }
+    dst.removedFaces.add(src.removedFaces);
+    dst.movedCorners.add(src.movedCorners);
+}
+
+//------------------------------------------------------------------------
+
+void FW::gatherMesh(const MeshBase& mesh, Array<Vec3f>& positions, Array<Vec3i>& tris)
+{
+    int posAttrib = mesh.findAttrib(MeshBase::AttribType_Position);
+    positions.reset(mesh.numVertices());
+    tris.reset();
+    if (posAttrib == -1)
+        return;
+
+    AttribView<const Vec3f> posView = mesh.getAttribView<Vec3f>(posAttrib);
+    for (int i = 0; i < positions.getSize(); i++)
+        positions[i] = (posView.isValid()) ? posView[i] : mesh.getVertexAttrib(i, posAttrib).getXYZ();
+
+    tris.setCapacity(mesh.numTriangles());
+    for (int i = 0; i < mesh.numSubmeshes(); i++)
+        tris.add(mesh.indices(i));
+}
+
+//------------------------------------------------------------------------
+
+void FW::sampleSurface(Array<Vec3f>& samples, const Array<Vec3f>& positions, const Array<Vec3i>& tris, int maxSamples)
+{
+    // The first corner and the centroid of every face, or an even subset.
+
+    S64 num = (S64)tris.getSize() * 2;
+    S64 step = max((num + maxSamples - 1) / max(maxSamples, 1), (S64)1);
+    samples.clear();
+    samples.setCapacity((int)((num + step - 1) / step));
+
+    for (S64 i = 0; i < num; i += step)
+    {
+        const Vec3i& tri = tris[(int)(i >> 1)];
+        if (i & 1)
+            samples.add((positions[tri.x] + positions[tri.y] + positions[tri.z]) * (1.0f / 3.0f));
+        else
+            samples.add(positions[tri.x]);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::measureSamples(MulticoreLauncher::Task& task)
+{
+    DistanceState& s = *(DistanceState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    ClosestPoint hits[DISTANCE_BATCH];
+    F32 maxDistance = 0.0f;
+    F64 sum = 0.0;
+
+    for (int i = range.x; i < range.y; i += DISTANCE_BATCH)
+    {
+        int num = min(range.y - i, DISTANCE_BATCH);
+        s.bvh->closestPoints(s.samples + i, hits, num);
+        for (int j = 0; j < num; j++)
+        {
+            maxDistance = max(maxDistance, hits[j].distance);
+            sum += hits[j].distance;
+        }
+    }
+
+    s.chunkMax[task.idx] = maxDistance;
+    s.chunkSum[task.idx] = sum;
+}
+
+//------------------------------------------------------------------------
+
+void FW::measureDirected(const BVH& bvh, const Array<Vec3f>& samples, F32& maxDistance, F64& sum)
+{
+    DistanceState s;
+    s.bvh = &bvh;
+    s.samples = samples.getPtr();
+    s.chunkMax.reset(maxChunks());
+    s.chunkSum.reset(maxChunks());
+    launchChunks(measureSamples, s, samples.getSize(), SIMPLIFY_CHUNK_SIZE);
+
+    for (int i = 0; i < s.numChunks; i++)
+    {
+        maxDistance = max(maxDistance, s.chunkMax[i]);
+        sum += s.chunkSum[i];
+    }
+}
+
+//------------------------------------------------------------------------
+
+SurfaceDistance FW::measureDistance(const Array<Vec3f>& posA, const Array<Vec3i>& trisA, const BVH& bvhA, const Array<Vec3f>& posB, const Array<Vec3i>& trisB, const BVH& bvhB, int maxSamples)
+{
+    SurfaceDistance res;
+    if (!trisA.getSize() || !trisB.getSize())
+        return res;
+
+    Array<Vec3f> samples;
+    F64 sum = 0.0;
+
+    sampleSurface(samples, posA, trisA, maxSamples);
+    measureDirected(bvhB, samples, res.forward, sum);
+    res.numSamples += samples.getSize();
+
+    sampleSurface(samples, posB, trisB, maxSamples);
+    measureDirected(bvhA, samples, res.backward, sum);
+    res.numSamples += samples.getSize();
+
+    res.mean = (F32)(sum / max(res.numSamples, 1));
+    return res;
+}
+
+//------------------------------------------------------------------------
+
+SimplifyReport FW::simplifyQuadric(MeshBase& mesh, const SimplifyParams& params)
+{
+    SimplifyReport report;
+    memset(&report, 0, sizeof(report));
+    report.inputTriangles = report.outputTriangles = mesh.numTriangles();
+    report.inputVertices = report.outputVertices = mesh.numVertices();
+
+    FW_ASSERT(!params.log || params.keepVertices);
+    if (params.log)
+        params.log->clear();
+
+    int posAttrib = mesh.findAttrib(MeshBase::AttribType_Position);
+    if (posAttrib == -1 || !report.inputTriangles)
+        return report;
+
+    Timer timer(true);
+    Array<Vec3f> inputPos;
+    Array<Vec3i> inputTris;
+    {
+        SimplifyState s;
+        s.mesh = &mesh;
+        s.params = params;
+        s.posAttrib = posAttrib;
+        s.posView = mesh.getAttribView<Vec3f>(posAttrib);
+
+        // Attributes in the quadrics, scaled by their weight and the mesh
+        // size.
+
+        Vec3f lo, hi;
+        mesh.getBBox(lo, hi);
+        F32 size = max(hi.x - lo.x, hi.y - lo.y, hi.z - lo.z);
+
+        s.normalScale = params.normalWeight * size;
+        s.texCoordScale = params.texCoordWeight * size;
+        s.normalAttrib = (s.normalScale > 0.0f) ? mesh.findAttrib(MeshBase::AttribType_Normal) : -1;
+        s.texCoordAttrib = (s.texCoordScale > 0.0f) ? mesh.findAttrib(MeshBase::AttribType_TexCoord) : -1;
+        s.numAttribs = ((s.normalAttrib != -1) ? 3 : 0) + ((s.texCoordAttrib != -1) ? 2 : 0);
+        s.quadricStride = (s.numAttribs) ? s.numAttribs * 4 + 1 : 0;
+        s.maxKey = (params.maxError < sqrt(FW_F32_MAX)) ? sqr(max(params.maxError, 0.0f)) : FW_F32_MAX;
+
+        // Set up.
+
+        setupPoints(s);
+        setupTriangles(s);
+        if (params.log)
+        {
+            params.log->faces = s.tris;
+            params.log->faceSubmesh = s.triSubmesh;
+        }
+        launchChunks(computeQuadrics, s, s.pos.getSize(), SIMPLIFY_CHUNK_SIZE);
+        setupEdges(s);
+
+        int numPartitions = params.numPartitions;
+        if (numPartitions <= 0)
+            numPartitions = (s.liveTriangles >= SIMPLIFY_MIN_PARTITION) ? min(MulticoreLauncher::getNumCores() * SIMPLIFY_PER_CORE, s.liveTriangles / SIMPLIFY_PARTITION_SIZE) : 1;
+        numPartitions = clamp(numPartitions, 1, max(s.liveTriangles / 1024, 1));
+        s.numPartitions = numPartitions;
+
+        report.numPoints = s.pos.getSize();
+        report.numEdges = s.edges.getSize();
+        report.numPairs = s.numPairs;
+        report.numPartitions = numPartitions;
+
+        // Snapshot the welded input for measuring the result.
+
+        if (params.distanceSamples > 0)
+        {
+            inputPos = s.pos;
+            inputTris.reset(s.tris.getSize());
+            for (int i = 0; i < inputTris.getSize(); i++)
+                inputTris[i] = s.triPoints[i];
+        }
+        report.setupSeconds = timer.end();
+
+        // Collapse and write out.
+
+        runCollapses(s, report);
+        report.collapseSeconds = timer.end();
+
+        writeOutput(s);
+        report.outputTriangles = mesh.numTriangles();
+        report.outputVertices = mesh.numVertices();
+        report.outputSeconds = timer.end();
+    }
+
+    // Measure against the input.
+
+    if (params.distanceSamples > 0)
+    {
+        BVH inputBVH;
+        inputBVH.build(inputPos.getPtr(), inputTris.getPtr(), inputTris.getSize());
+        BVH outputBVH(mesh);
+        Array<Vec3f> outputPos;
+        Array<Vec3i> outputTris;
+        gatherMesh(mesh, outputPos, outputTris);
+        report.distance = measureDistance(inputPos, inputTris, inputBVH, outputPos, outputTris, outputBVH, params.distanceSamples);
+        report.distanceSeconds = timer.end();
+    }
+    return report;
+}
+
+//------------------------------------------------------------------------
+
+SurfaceDistance FW::measureSurfaceDistance(const MeshBase& a, const MeshBase& b, int maxSamples)
+{
+    Array<Vec3f> posA, posB;
+    Array<Vec3i> trisA, trisB;
+    gatherMesh(a, posA, trisA);
+    gatherMesh(b, posB, trisB);
+    BVH bvhA(a);
+    BVH bvhB(b);
+    return measureDistance(posA, trisA, bvhA, posB, trisB, bvhB, maxSamples);
+}
+
+//------------------------------------------------------------------------
@@ -0,0 +1,173 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include "3d/Mesh.hpp"
+
+namespace FW
+{
+//------------------------------------------------------------------------
+
+struct SimplifyLog;
+
+//------------------------------------------------------------------------
+// Quadric error simplification of meshes.
+//
+// Vertices are welded by exact position into points. Every point carries
+// the area-weighted plane quadric of its faces (Garland and Heckbert
+// 1997), and every vertex at it the quadric of its normal and texcoord
+// over its own faces (Hoppe 1999), so that attributes can be solved for
+// any position. Edges between points are collapsed cheapest first, from
+// an indexed min-heap. When neither end lies on a feature, both move to
+// the position minimizing the summed quadric and the vertex attributes
+// are solved there. Features are open boundaries, attribute seams (the
+// faces on an edge use different vertices) and material seams (the faces
+// belong to different submeshes). Their edges add constraint planes
+// perpendicular to the faces, and a point on exactly two feature edges
+// may only slide onto one of the two neighbors, keeping the vertices on
+// either side of the seam apart. Points where features meet and
+// non-manifold points never move. Collapses that would flip a face or
+// break the link condition are skipped.
+//
+// With 'pairDistance', points closer than that many mean edge lengths
+// are also paired up without an edge between them, found by bucketing
+// the points in a sorted grid of cells that size. Contracting such a pair
+// removes no faces but joins the surfaces at the point, so that separate
+// parts close together can merge and go on simplifying as one. A pair
+// merges like an edge when both ends are free; otherwise either end may
+// slide onto the other, provided both have a single vertex.
+//
+// The error of a collapse is the square root of its quadric over the
+// area of the faces involved, roughly a distance in mesh units; the
+// constraint planes make features more expensive. Simplification stops
+// at 'targetTriangles' or before the first collapse above 'maxError',
+// whichever comes first. Other vertex attributes are kept from the
+// vertex that survives.
+//
+// With 'keepVertices', every collapse slides one end onto the other and
+// the vertex buffer is left alone: the new indices refer to the input
+// vertices, so that several index sets can share one buffer. The
+// collapses done can then also be logged, e.g. to build a progressive
+// mesh that undoes them one by one.
+//
+// Large meshes are split into spatial partitions along a Morton curve,
+// several per core. Edges away from partition borders are collapsed by
+// one task per partition, each down to its share of the target. A second
+// round does the same with the partitions shifted by half their size, so
+// that most of the first borders lie inside one. A final pass over the
+// whole mesh then handles what is left and finishes the job. That pass
+// runs on one thread, which bounds the speedup from more cores.
+//
+// measureSurfaceDistance() estimates how far two meshes are apart. It
+// samples the corners and centroids of the triangles of each, finds the
+// closest point on the other through a BVH, and reports the largest
+// distance each way. The larger of the two is a lower bound of the
+// Hausdorff distance that tightens with more samples.
+//------------------------------------------------------------------------
+
+struct SimplifyParams
+{
+    S32                 targetTriangles;    // Stop at this many triangles; 0 = no limit.
+    F32                 maxError;           // Stop before a collapse with a larger error, see above.
+    F32                 normalWeight;       // Error of a unit change of the normal, relative to the mesh size. 0 = ignore normals.
+    F32                 texCoordWeight;     // Same for texcoords.
+    F32                 featureWeight;      // Of the constraint planes along features, relative to the faces.
+    F32                 pairDistance;       // Also contract points this many mean edge lengths apart, see above; 0 = edges only.
+    S32                 numPartitions;      // 0 = several per core for large meshes, 1 = single pass.
+    S32                 distanceSamples;    // Per direction for measuring the result against the input; 0 = skip.
+    bool                keepVertices;       // Only replace the indices, see above.
+    SimplifyLog*        log;                // Receives the collapses if not NULL; requires keepVertices.
+
+                        SimplifyParams      (void)                          : targetTriangles(0), maxError(FW_F32_MAX), normalWeight(0.25f), texCoordWeight(1.0f), featureWeight(1000.0f), pairDistance(0.0f), numPartitions(0), distanceSamples(0), keepVertices(false), log(NULL) {}
+};
+
+struct SurfaceDistance
+{
+    F32                 forward;            // Largest distance from a sample on the first mesh to the second.
+    F32                 backward;           // The other way.
+    F32                 mean;               // Over the samples of both.
+    S32                 numSamples;         // Both ways.
+
+                        SurfaceDistance     (void)                          : forward(0.0f), backward(0.0f), mean(0.0f), numSamples(0) {}
+
+    F32                 getHausdorff        (void) const                    { return max(forward, backward); }
+};
+
+struct SimplifyReport
+{
+    S32                 inputTriangles;
+    S32                 outputTriangles;
+    S32                 inputVertices;
+    S32                 outputVertices;
+    S32                 numPoints;          // Welded input vertices.
+    S32                 numEdges;           // Close pairs included.
+    S32                 numPairs;
+    S32                 numCollapses;
+    S32                 numPartitions;
+    F32                 maxError;           // Largest error of a collapse done.
+    SurfaceDistance     distance;           // Input to output; if requested.
+    F32                 setupSeconds;       // Welding, quadrics and initial errors.
+    F32                 collapseSeconds;
+    F32                 partitionSeconds;   // Of collapseSeconds, in the slowest partition task of each round, summed.
+    F32                 finalSeconds;       // Of collapseSeconds, in the final pass.
+    S32                 finalCollapses;     // Of numCollapses, in the final pass.
+    F32                 outputSeconds;
+    F32                 distanceSeconds;
+};
+
+// The collapses of a simplification with keepVertices. Faces are numbered
+// as in 'faces': those of the input in an arbitrary order, without any
+// that had two corners at one position. Each collapse removes some faces
+// and moves corners of others to a different vertex; replaying them in
+// order leads from 'faces' to the output.
+
+struct SimplifyLog
+{
+    struct Collapse
+    {
+        S32             firstRemoved;       // In removedFaces.
+        S32             numRemoved;
+        S32             firstMoved;         // In movedCorners.
+        S32             numMoved;
+    };
+
+    Array<Vec3i>        faces;              // [face] Vertices before simplification.
+    Array<S32>          faceSubmesh;        // [face]
+    Array<Collapse>     collapses;
+    Array<S32>          removedFaces;
+    Array<Vec4i>        movedCorners;       // (face, corner, old vertex, new vertex)
+
+    void                clear               (void)                          { faces.reset(); faceSubmesh.reset(); collapses.reset(); removedFaces.reset(); movedCorners.reset(); }
+};
+
+//------------------------------------------------------------------------
+
+SimplifyReport          simplifyQuadric         (MeshBase& mesh, const SimplifyParams& params);
+SurfaceDistance         measureSurfaceDistance  (const MeshBase& a, const MeshBase& b, int maxSamples = 1 << 20);
+
+//------------------------------------------------------------------------
+}
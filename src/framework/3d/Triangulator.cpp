@@ -0,0 +1,371 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "3d/Triangulator.hpp"
+
+using namespace FW;
+
+//------------------------------------------------------------------------
+
+#define TRI_EPSILON     1.0e-10     // Corners turning less than this (in radians) are flat.
+#define TRI_MAX_GRID    1024        // Maximum grid resolution per axis.
+
+//------------------------------------------------------------------------
+
+void Triangulator::triangulate(Array<Vec3i>& tris, const Vec3f* positions, const S32* indices, int numCorners)
+{
+    FW_ASSERT(numCorners == 0 || positions);
+    int n = numCorners;
+    if (n < 3)
+        return;
+
+    if (n == 3)
+    {
+        tris.add((indices) ? Vec3i(indices[0], indices[1], indices[2]) : Vec3i(0, 1, 2));
+        return;
+    }
+
+    // Best-fit plane. The Newell normal is the vector area of the polygon,
+    // so the projection onto (u, v) is always counterclockwise.
+
+    Vec3d normal = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        Vec3d a = positions[i];
+        Vec3d b = positions[(i + 1 < n) ? i + 1 : 0];
+        normal += Vec3d((a.y - b.y) * (a.z + b.z), (a.z - b.z) * (a.x + b.x), (a.x - b.x) * (a.y + b.y));
+    }
+
+    F64 len = normal.length();
+    if (!(len > 0.0))
+    {
+        for (int i = 2; i < n; i++)
+            tris.add((indices) ? Vec3i(indices[0], indices[i - 1], indices[i]) : Vec3i(0, i - 1, i));
+        return;
+    }
+
+    normal /= len;
+    Vec3d u = (abs(normal.x) > abs(normal.z)) ? Vec3d(-normal.y, normal.x, 0.0) : Vec3d(0.0, -normal.z, normal.y);
+    u.normalize();
+    Vec3d v = cross(normal, u);
+
+    // Project relative to the first corner and set up the linked list.
+
+    Vec3d origin = positions[0];
+    Vec2d lo = +FW_F64_MAX;
+    Vec2d hi = -FW_F64_MAX;
+
+    m_points.resize(n);
+    m_prev.resize(n);
+    m_next.resize(n);
+    m_state.resize(n);
+
+    for (int i = 0; i < n; i++)
+    {
+        Vec3d p = Vec3d(positions[i]) - origin;
+        m_points[i] = Vec2d(dot(p, u), dot(p, v));
+        m_prev[i] = (i > 0) ? i - 1 : n - 1;
+        m_next[i] = (i + 1 < n) ? i + 1 : 0;
+        lo = min(lo, m_points[i]);
+        hi = max(hi, m_points[i]);
+    }
+
+    m_gridLo = lo;
+    m_gridExtent = hi - lo;
+
+    // Classify corners and bucket the candidates.
+
+    m_candidates.clear();
+    m_queue.clear();
+    m_numCandidates = 0;
+    for (int i = 0; i < n; i++)
+    {
+        m_state[i] = State_Removed;
+        classify(i);
+        if (m_state[i] == State_Candidate)
+            m_candidates.add(i);
+        m_queue.add(i);
+    }
+
+    buildGrid();
+
+    // Clip ears until only one triangle is left.
+
+    int remaining = n;
+    int head = 0;
+    int last = 0;
+    bool rescanned = false;
+
+    while (remaining > 3)
+    {
+        int ear;
+        if (head < m_queue.getSize())
+        {
+            ear = m_queue[head++];
+            if (m_state[ear] != State_Convex || !isEar(ear))
+                continue;
+            rescanned = false;
+        }
+        else if (!rescanned)
+        {
+            // A corner can also become an ear when a reflex corner inside
+            // its triangle turns convex. Rare; retest everything.
+
+            while (m_state[last] == State_Removed)
+                last = m_next[last];
+            m_queue.clear();
+            head = 0;
+            for (int i = 0, j = last; i < remaining; i++, j = m_next[j])
+                m_queue.add(j);
+            rescanned = true;
+            continue;
+        }
+        else
+        {
+            // No proper ear left => degenerate or self-intersecting.
+
+            ear = findFallback(last);
+        }
+
+        last = m_prev[ear];
+        clip(tris, indices, ear);
+        remaining--;
+
+        // Drop stale grid entries once most candidates are gone.
+
+        if (m_numCandidates * 4 < m_cellItems.getSize())
+        {
+            m_candidates.clear();
+            for (int i = 0; i < m_cellItems.getSize(); i++)
+                if (m_state[m_cellItems[i]] == State_Candidate)
+                    m_candidates.add(m_cellItems[i]);
+            buildGrid();
+        }
+    }
+
+    int b = last;
+    while (m_state[b] == State_Removed)
+        b = m_next[b];
+    int a = m_prev[b];
+    int c = m_next[b];
+    tris.add((indices) ? Vec3i(indices[a], indices[b], indices[c]) : Vec3i(a, b, c));
+}
+
+//------------------------------------------------------------------------
+
+F64 Triangulator::cornerSin(int idx) const
+{
+    // Sine of the turning angle; positive for convex corners. Being
+    // relative to the edge lengths, it is independent of polygon size
+    // and tessellation density.
+
+    Vec2d e0 = m_points[idx] - m_points[m_prev[idx]];
+    Vec2d e1 = m_points[m_next[idx]] - m_points[idx];
+    F64 len = sqrt(e0.lenSqr() * e1.lenSqr());
+    return (len > 0.0) ? e0.cross(e1) / len : 0.0;
+}
+
+//------------------------------------------------------------------------
+
+void Triangulator::classify(int idx)
+{
+    // Flat corners block ears too: one lying on the new diagonal would
+    // otherwise be left stranded in a zero-area remainder.
+
+    bool wasCandidate = (m_state[idx] == State_Candidate);
+    m_state[idx] = (U8)((cornerSin(idx) > TRI_EPSILON) ? State_Convex : State_Candidate);
+    m_numCandidates += (int)(m_state[idx] == State_Candidate) - (int)wasCandidate;
+}
+
+//------------------------------------------------------------------------
+
+void Triangulator::buildGrid(void)
+{
+    // About one candidate per cell.
+
+    int numCandidates = m_candidates.getSize();
+    m_gridRes = clamp((int)sqrt((F64)numCandidates), 1, TRI_MAX_GRID);
+    F64 minExtent = max(m_gridExtent.x, m_gridExtent.y) * 1.0e-6;
+    m_gridScale = Vec2d((F64)m_gridRes / max(m_gridExtent.x, minExtent), (F64)m_gridRes / max(m_gridExtent.y, minExtent));
+
+    // Counting sort of the candidates into cells.
+
+    int numCells = m_gridRes * m_gridRes;
+    m_cellStart.resize(numCells + 1);
+    m_cellItems.resize(numCandidates);
+    m_candidateCells.resize(numCandidates);
+    memset(m_cellStart.getPtr(), 0, m_cellStart.getNumBytes());
+
+    for (int i = 0; i < numCandidates; i++)
+    {
+        Vec2d p = (m_points[m_candidates[i]] - m_gridLo) * m_gridScale;
+        int cell = clamp((int)p.x, 0, m_gridRes - 1) + clamp((int)p.y, 0, m_gridRes - 1) * m_gridRes;
+        m_candidateCells[i] = cell;
+        m_cellStart[cell + 1]++;
+    }
+
+    for (int i = 0; i < numCells; i++)
+        m_cellStart[i + 1] += m_cellStart[i];
+    for (int i = 0; i < numCandidates; i++)
+        m_cellItems[m_cellStart[m_candidateCells[i]]++] = m_candidates[i];
+    for (int i = numCells; i > 0; i--)
+        m_cellStart[i] = m_cellStart[i - 1];
+    m_cellStart[0] = 0;
+}
+
+//------------------------------------------------------------------------
+
+bool Triangulator::isEar(int idx) const
+{
+    if (!m_numCandidates)
+        return true;
+
+    int ia = m_prev[idx];
+    int ic = m_next[idx];
+    const Vec2d& a = m_points[ia];
+    const Vec2d& b = m_points[idx];
+    const Vec2d& c = m_points[ic];
+
+    // Visit only the cells each grid row of the triangle overlaps, so
+    // long slivers stay cheap. Spans are padded by a cell for rounding.
+
+    Vec2d lo = (min(min(a, b), c) - m_gridLo) * m_gridScale;
+    Vec2d hi = (max(max(a, b), c) - m_gridLo) * m_gridScale;
+    int y0 = clamp((int)lo.y, 0, m_gridRes - 1);
+    int y1 = clamp((int)hi.y, 0, m_gridRes - 1);
+    Vec2d verts[3] = { (a - m_gridLo) * m_gridScale, (b - m_gridLo) * m_gridScale, (c - m_gridLo) * m_gridScale };
+
+    for (int y = y0; y <= y1; y++)
+    {
+        F64 spanLo = (y == y0) ? -FW_F64_MAX : (F64)y;
+        F64 spanHi = (y == y1) ? +FW_F64_MAX : (F64)(y + 1);
+        F64 xlo = +FW_F64_MAX;
+        F64 xhi = -FW_F64_MAX;
+
+        for (int i = 0; i < 3; i++)
+        {
+            const Vec2d& p = verts[i];
+            const Vec2d& q = verts[(i < 2) ? i + 1 : 0];
+            F64 ylo = max(spanLo, min(p.y, q.y));
+            F64 yhi = min(spanHi, max(p.y, q.y));
+            if (ylo > yhi)
+                continue;
+
+            F64 t0 = 0.0;
+            F64 t1 = 1.0;
+            if (p.y != q.y)
+            {
+                t0 = clamp((ylo - p.y) / (q.y - p.y), 0.0, 1.0);
+                t1 = clamp((yhi - p.y) / (q.y - p.y), 0.0, 1.0);
+            }
+
+            F64 x0 = p.x + (q.x - p.x) * t0;
+            F64 x1 = p.x + (q.x - p.x) * t1;
+            xlo = min(xlo, min(x0, x1));
+            xhi = max(xhi, max(x0, x1));
+        }
+
+        if (xlo > xhi)
+            continue;
+
+        int cx0 = clamp((int)xlo - 1, 0, m_gridRes - 1);
+        int cx1 = clamp((int)xhi + 1, 0, m_gridRes - 1);
+        for (int x = cx0; x <= cx1; x++)
+        {
+            int cell = x + y * m_gridRes;
+            for (int i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++)
+            {
+                int j = m_cellItems[i];
+                if (m_state[j] != State_Candidate || j == ia || j == ic)
+                    continue;
+
+                // Closed containment test. Corners coinciding with the
+                // ear itself (self-touching polygons) do not block it.
+
+                const Vec2d& p = m_points[j];
+                if (p == a || p == b || p == c)
+                    continue;
+                if ((b - a).cross(p - a) >= 0.0 && (c - b).cross(p - b) >= 0.0 && (a - c).cross(p - c) >= 0.0)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+int Triangulator::findFallback(int start) const
+{
+    while (m_state[start] == State_Removed)
+        start = m_next[start];
+
+    // Prefer zero-area ears, then corners that are at least not reflex.
+
+    int idx = start;
+    do
+    {
+        if (abs(cornerSin(idx)) <= TRI_EPSILON)
+            return idx;
+        idx = m_next[idx];
+    }
+    while (idx != start);
+
+    do
+    {
+        if (cornerSin(idx) >= -TRI_EPSILON)
+            return idx;
+        idx = m_next[idx];
+    }
+    while (idx != start);
+
+    return start;
+}
+
+//------------------------------------------------------------------------
+
+void Triangulator::clip(Array<Vec3i>& tris, const S32* indices, int idx)
+{
+    int a = m_prev[idx];
+    int c = m_next[idx];
+    tris.add((indices) ? Vec3i(indices[a], indices[idx], indices[c]) : Vec3i(a, idx, c));
+
+    if (m_state[idx] == State_Candidate)
+        m_numCandidates--;
+    m_state[idx] = State_Removed;
+    m_next[a] = c;
+    m_prev[c] = a;
+
+    // Only the neighbors' corners changed; retest them.
+
+    classify(a);
+    classify(c);
+    m_queue.add(a);
+    m_queue.add(c);
+}
+
+//------------------------------------------------------------------------
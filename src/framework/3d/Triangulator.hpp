@@ -0,0 +1,100 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include "base/Array.hpp"
+#include "base/Math.hpp"
+
+namespace FW
+{
+//------------------------------------------------------------------------
+// Ear clipping triangulator for planar or nearly planar polygons.
+//
+// The polygon is projected onto its best-fit plane (Newell normal) and
+// clipped over a doubly linked list. Only reflex and flat corners can make
+// an ear invalid, so those are bucketed into a uniform grid and each ear
+// test only visits the cells overlapped by the candidate triangle.
+// Clipping an ear only changes the status of its two neighbors, which are
+// queued for a retest; every other corner is tested once. For typical
+// polygons this runs in linear time.
+//
+// Degenerate input never fails: when no proper ear is left, flat corners
+// are clipped as zero-area triangles, then containment is ignored, and as
+// a last resort any corner is clipped. A polygon with N corners therefore
+// always yields N-2 triangles with the winding of the input.
+//------------------------------------------------------------------------
+
+class Triangulator
+{
+public:
+                        Triangulator        (void)                              {}
+                        ~Triangulator       (void)                              {}
+
+    // Appends the triangles to 'tris'. 'positions' holds one entry per
+    // corner; output triangles reference indices[i], or i if 'indices'
+    // is NULL.
+    void                triangulate         (Array<Vec3i>& tris, const Vec3f* positions, const S32* indices, int numCorners);
+
+private:
+    enum State
+    {
+        State_Convex = 0,
+        State_Candidate,                    // Reflex or flat; may block ears.
+        State_Removed,
+    };
+
+    F64                 cornerSin           (int idx) const;
+    void                classify            (int idx);
+    void                buildGrid           (void);
+    bool                isEar               (int idx) const;
+    int                 findFallback        (int start) const;
+    void                clip                (Array<Vec3i>& tris, const S32* indices, int idx);
+
+private:
+                        Triangulator        (const Triangulator&); // forbidden
+    Triangulator&       operator=           (const Triangulator&); // forbidden
+
+private:
+    Array<Vec2d>        m_points;
+    Array<S32>          m_prev;
+    Array<S32>          m_next;
+    Array<U8>           m_state;
+    Array<S32>          m_queue;            // Corners to test, oldest first.
+    S32                 m_numCandidates;    // Corners currently in State_Candidate.
+
+    Array<S32>          m_candidates;
+    Array<S32>          m_candidateCells;
+    Vec2d               m_gridLo;
+    Vec2d               m_gridExtent;
+    Vec2d               m_gridScale;
+    S32                 m_gridRes;
+    Array<S32>          m_cellStart;        // m_gridRes^2 + 1 offsets into m_cellItems.
+    Array<S32>          m_cellItems;
+};
+
+//------------------------------------------------------------------------
+}
@@ -26,11 +26,112 @@
  */
 
 #include "base/Math.hpp"
+#include "base/Array.hpp"
+#include "base/MulticoreLauncher.hpp"
+
+// Batch transforms: 8 lanes with AVX, 4 with SSE, one element at a time
+// in plain C++ otherwise. Define FW_XFORM_SIMD as 0 to force the latter.
+
+#ifndef FW_XFORM_SIMD
+#   if defined(__AVX__)
+#       define FW_XFORM_SIMD    8
+#   elif defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#       define FW_XFORM_SIMD    4
+#   else
+#       define FW_XFORM_SIMD    0
+#   endif
+#endif
+
+#if (FW_XFORM_SIMD == 8)
+#   include <immintrin.h>
+#elif (FW_XFORM_SIMD == 4)
+#   include <xmmintrin.h>
+#endif
 
 using namespace FW;
 
 //------------------------------------------------------------------------
 
+#define XFORM_CHUNK_SIZE    (1 << 14)       // At least, per chunk.
+#define BOUND_CHUNK_SIZE    (1 << 16)
+
+//------------------------------------------------------------------------
+// Lanes of the batch transforms. Each operation rounds like its scalar
+// counterpart, and the kernels keep the scalar order of operations.
+//------------------------------------------------------------------------
+
+namespace FW
+{
+
+#if (FW_XFORM_SIMD == 8)
+
+typedef __m256 Vf;
+
+static inline Vf    vload   (const F32* p)              { return _mm256_loadu_ps(p); }
+static inline Vf    vset1   (F32 a)                     { return _mm256_set1_ps(a); }
+static inline void  vstore  (F32* p, Vf a)              { _mm256_storeu_ps(p, a); }
+static inline Vf    vadd    (Vf a, Vf b)                { return _mm256_add_ps(a, b); }
+static inline Vf    vmul    (Vf a, Vf b)                { return _mm256_mul_ps(a, b); }
+static inline Vf    vdiv    (Vf a, Vf b)                { return _mm256_div_ps(a, b); }
+static inline Vf    vsqrt   (Vf a)                      { return _mm256_sqrt_ps(a); }
+static inline Vf    vnonzero(Vf a, Vf b, Vf c)          { return _mm256_blendv_ps(c, b, _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_NEQ_UQ)); }  // (a != 0) ? b : c
+
+#elif (FW_XFORM_SIMD == 4)
+
+typedef __m128 Vf;
+
+static inline Vf    vload   (const F32* p)              { return _mm_loadu_ps(p); }
+static inline Vf    vset1   (F32 a)                     { return _mm_set1_ps(a); }
+static inline void  vstore  (F32* p, Vf a)              { _mm_storeu_ps(p, a); }
+static inline Vf    vadd    (Vf a, Vf b)                { return _mm_add_ps(a, b); }
+static inline Vf    vmul    (Vf a, Vf b)                { return _mm_mul_ps(a, b); }
+static inline Vf    vdiv    (Vf a, Vf b)                { return _mm_div_ps(a, b); }
+static inline Vf    vsqrt   (Vf a)                      { return _mm_sqrt_ps(a); }
+static inline Vf    vnonzero(Vf a, Vf b, Vf c)          { Vf m = _mm_cmpneq_ps(a, _mm_setzero_ps()); return _mm_or_ps(_mm_and_ps(m, b), _mm_andnot_ps(m, c)); }  // (a != 0) ? b : c
+
+#endif
+
+struct XformState : ChunkState
+{
+    Mat4f               mat4;
+    Mat3f               mat3;
+    const U8*           in;
+    S32                 inStride;
+    U8*                 out;
+    S32                 outStride;
+    S32                 numComponents;      // Of points.
+    bool                normalize;          // Normals.
+};
+
+static void     xformPointsRange    (const XformState& s, int begin, int end);
+static void     xformNormalsRange   (const XformState& s, int begin, int end);
+static void     xformPointsTask     (MulticoreLauncher::Task& task);
+static void     xformNormalsTask    (MulticoreLauncher::Task& task);
+
+struct BoundState : ChunkState
+{
+    const U8*           points;
+    S32                 stride;
+    S32                 numPoints;
+    const S32*          indices;            // NULL => all points.
+    Array<Vec3f>        lo;                 // [chunk]
+    Array<Vec3f>        hi;                 // [chunk]
+};
+
+static void     boundRange          (const BoundState& s, int begin, int end, Vec3f& lo, Vec3f& hi);
+static void     boundTask           (MulticoreLauncher::Task& task);
+
+#if (FW_XFORM_SIMD != 0)
+static void     loadQuad            (const U8* ptr, int stride, __m128* c);
+static void     storeQuad           (U8* ptr, int stride, int numComponents, __m128* c);
+static void     loadLanes           (const U8* base, int stride, int i, int num, int numComponents, bool whole, Vf* c);
+static void     storeLanes          (U8* base, int stride, int i, int num, int numComponents, Vf* c);
+#endif
+
+}
+
+//------------------------------------------------------------------------
+
 Vec4f Vec4f::fromABGR(U32 abgr)
 {
     return Vec4f(
@@ -114,3 +215,367 @@ Mat3d Mat3d::rotation(const Vec3d& axis, F64 angle)
 	R(2,0) = axis.z*axis.x*(1.0-cosa) - axis.y*sina;	R(2,1) = axis.z*axis.y*(1.0-cosa) + axis.x*sina;	R(2,2) = cosa + sqr(axis.z)*(1.0-cosa);
 	return R;
 }
+
+//------------------------------------------------------------------------
+
+void FW::transformPoints(const Mat4f& mat, const F32* in, int inStride, F32* out, int outStride, int num, int numComponents)
+{
+    FW_ASSERT(num >= 0);
+    FW_ASSERT(numComponents == 3 || numComponents == 4);
+    FW_ASSERT((in && out) || !num);
+
+    XformState s;
+    s.mat4          = mat;
+    s.in            = (const U8*)in;
+    s.inStride      = inStride;
+    s.out           = (U8*)out;
+    s.outStride     = outStride;
+    s.numComponents = numComponents;
+    s.normalize     = false;
+    launchChunks(xformPointsTask, s, num, XFORM_CHUNK_SIZE);
+}
+
+//------------------------------------------------------------------------
+
+void FW::transformNormals(const Mat3f& mat, const F32* in, int inStride, F32* out, int outStride, int num, bool normalize)
+{
+    FW_ASSERT(num >= 0);
+    FW_ASSERT((in && out) || !num);
+
+    XformState s;
+    s.mat3          = mat;
+    s.in            = (const U8*)in;
+    s.inStride      = inStride;
+    s.out           = (U8*)out;
+    s.outStride     = outStride;
+    s.numComponents = 3;
+    s.normalize     = normalize;
+    launchChunks(xformNormalsTask, s, num, XFORM_CHUNK_SIZE);
+}
+
+//------------------------------------------------------------------------
+
+void FW::xformPointsTask(MulticoreLauncher::Task& task)
+{
+    const XformState& s = *(const XformState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    xformPointsRange(s, range.x, range.y);
+}
+
+//------------------------------------------------------------------------
+
+void FW::xformNormalsTask(MulticoreLauncher::Task& task)
+{
+    const XformState& s = *(const XformState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    xformNormalsRange(s, range.x, range.y);
+}
+
+//------------------------------------------------------------------------
+
+#if (FW_XFORM_SIMD != 0)
+
+void FW::loadQuad(const U8* ptr, int stride, __m128* c)
+{
+    // Four elements of four floats, transposed to one component per vector.
+
+    c[0] = _mm_loadu_ps((const F32*)ptr);
+    c[1] = _mm_loadu_ps((const F32*)(ptr + stride));
+    c[2] = _mm_loadu_ps((const F32*)(ptr + stride * 2));
+    c[3] = _mm_loadu_ps((const F32*)(ptr + stride * 3));
+    _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+}
+
+//------------------------------------------------------------------------
+
+void FW::storeQuad(U8* ptr, int stride, int numComponents, __m128* c)
+{
+    _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+    for (int k = 0; k < 4; k++)
+    {
+        F32* p = (F32*)(ptr + stride * k);
+        if (numComponents == 4)
+            _mm_storeu_ps(p, c[k]);
+        else
+        {
+            _mm_storel_pi((__m64*)p, c[k]);
+            _mm_store_ss(p + 2, _mm_movehl_ps(c[k], c[k]));
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::loadLanes(const U8* base, int stride, int i, int num, int numComponents, bool whole, Vf* c)
+{
+    // Components of elements [i, i + FW_XFORM_SIMD), element by element
+    // for a partial group or if reading a whole vector per element could
+    // run past the array. Missing elements repeat the last one.
+
+    const U8* ptr = base + (size_t)i * stride;
+    if (whole && num == FW_XFORM_SIMD)
+    {
+#if (FW_XFORM_SIMD == 8)
+        __m128 lo[4], hi[4];
+        loadQuad(ptr, stride, lo);
+        loadQuad(ptr + stride * 4, stride, hi);
+        for (int j = 0; j < 4; j++)
+            c[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo[j]), hi[j], 1);
+#else
+        loadQuad(ptr, stride, c);
+#endif
+        return;
+    }
+
+    F32 lanes[4][FW_XFORM_SIMD];
+    for (int k = 0; k < FW_XFORM_SIMD; k++)
+    {
+        const F32* p = (const F32*)(ptr + (size_t)min(k, num - 1) * stride);
+        for (int j = 0; j < numComponents; j++)
+            lanes[j][k] = p[j];
+    }
+    for (int j = 0; j < numComponents; j++)
+        c[j] = vload(lanes[j]);
+}
+
+//------------------------------------------------------------------------
+
+void FW::storeLanes(U8* base, int stride, int i, int num, int numComponents, Vf* c)
+{
+    U8* ptr = base + (size_t)i * stride;
+    if (num == FW_XFORM_SIMD)
+    {
+#if (FW_XFORM_SIMD == 8)
+        __m128 lo[4], hi[4];
+        for (int j = 0; j < 4; j++)
+        {
+            lo[j] = _mm256_castps256_ps128(c[j]);
+            hi[j] = _mm256_extractf128_ps(c[j], 1);
+        }
+        storeQuad(ptr, stride, numComponents, lo);
+        storeQuad(ptr + stride * 4, stride, numComponents, hi);
+#else
+        storeQuad(ptr, stride, numComponents, c);
+#endif
+        return;
+    }
+
+    F32 lanes[4][FW_XFORM_SIMD];
+    for (int j = 0; j < numComponents; j++)
+        vstore(lanes[j], c[j]);
+    for (int k = 0; k < num; k++)
+    {
+        F32* p = (F32*)(ptr + (size_t)k * stride);
+        for (int j = 0; j < numComponents; j++)
+            p[j] = lanes[j][k];
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::xformPointsRange(const XformState& s, int begin, int end)
+{
+    // Computes mat * Vec4f(p, w) one row at a time, with w = 1 for three
+    // components, and multiplies by 1 / w unless w is zero. Each group is
+    // read before it is written, so in-place transforms work.
+
+    const Mat4f& m = s.mat4;
+    Vf zero = vset1(0.0f);
+    Vf one = vset1(1.0f);
+    Vf rows[4][4];
+    for (int j = 0; j < 4; j++)
+        for (int k = 0; k < 4; k++)
+            rows[j][k] = vset1(m(j, k));
+
+    // Whole-vector loads read a fourth float past three components, which
+    // is still inside the array unless the element is the very last one.
+
+    int wholeEnd = (s.numComponents == 4 || s.inStride >= 16) ? end : min(end, s.numItems - 1);
+
+    for (int i = begin; i < end; i += FW_XFORM_SIMD)
+    {
+        int num = min(end - i, FW_XFORM_SIMD);
+        Vf c[4];
+        loadLanes(s.in, s.inStride, i, num, s.numComponents, (i + num <= wholeEnd), c);
+        if (s.numComponents == 3)
+            c[3] = one;
+
+        Vf r[4];
+        for (int j = 0; j < 4; j++)
+            r[j] = vadd(vadd(vadd(vadd(zero, vmul(rows[j][0], c[0])), vmul(rows[j][1], c[1])), vmul(rows[j][2], c[2])), vmul(rows[j][3], c[3]));
+
+        Vf scale = vdiv(one, r[3]);
+        for (int j = 0; j < 4; j++)
+            c[j] = vnonzero(r[3], vmul(r[j], scale), r[j]);
+        storeLanes(s.out, s.outStride, i, num, s.numComponents, c);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::xformNormalsRange(const XformState& s, int begin, int end)
+{
+    // Computes mat * n one row at a time and, if requested, multiplies by
+    // 1 / length, or by zero for zero-length results, like normalized().
+
+    const Mat3f& m = s.mat3;
+    Vf zero = vset1(0.0f);
+    Vf one = vset1(1.0f);
+    Vf rows[3][3];
+    for (int j = 0; j < 3; j++)
+        for (int k = 0; k < 3; k++)
+            rows[j][k] = vset1(m(j, k));
+
+    int wholeEnd = (s.inStride >= 16) ? end : min(end, s.numItems - 1);
+
+    for (int i = begin; i < end; i += FW_XFORM_SIMD)
+    {
+        int num = min(end - i, FW_XFORM_SIMD);
+        Vf c[4];
+        loadLanes(s.in, s.inStride, i, num, 3, (i + num <= wholeEnd), c);
+
+        Vf r[4];
+        for (int j = 0; j < 3; j++)
+            r[j] = vadd(vadd(vadd(zero, vmul(rows[j][0], c[0])), vmul(rows[j][1], c[1])), vmul(rows[j][2], c[2]));
+        r[3] = zero;
+
+        if (s.normalize)
+        {
+            Vf len = vsqrt(vadd(vadd(vadd(zero, vmul(r[0], r[0])), vmul(r[1], r[1])), vmul(r[2], r[2])));
+            Vf scale = vnonzero(len, vdiv(one, len), zero);
+            for (int j = 0; j < 3; j++)
+                r[j] = vmul(r[j], scale);
+        }
+        storeLanes(s.out, s.outStride, i, num, 3, r);
+    }
+}
+
+//------------------------------------------------------------------------
+
+#else
+
+void FW::xformPointsRange(const XformState& s, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        const F32* in = (const F32*)(s.in + (size_t)i * s.inStride);
+        Vec4f p = s.mat4 * Vec4f(in[0], in[1], in[2], (s.numComponents == 4) ? in[3] : 1.0f);
+        if (p.w != 0.0f)
+            p *= 1.0f / p.w;
+
+        F32* out = (F32*)(s.out + (size_t)i * s.outStride);
+        for (int j = 0; j < s.numComponents; j++)
+            out[j] = p[j];
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::xformNormalsRange(const XformState& s, int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        const F32* in = (const F32*)(s.in + (size_t)i * s.inStride);
+        Vec3f n = s.mat3 * Vec3f(in[0], in[1], in[2]);
+        if (s.normalize)
+            n = n.normalized();
+
+        F32* out = (F32*)(s.out + (size_t)i * s.outStride);
+        out[0] = n.x;
+        out[1] = n.y;
+        out[2] = n.z;
+    }
+}
+
+#endif
+
+//------------------------------------------------------------------------
+
+void FW::boundPoints(const F32* points, int stride, int numPoints, Vec3f& lo, Vec3f& hi, const S32* indices, int numIndices)
+{
+    FW_ASSERT(numPoints >= 0 && numIndices >= 0);
+    FW_ASSERT(points || !numPoints);
+
+    BoundState s;
+    s.points    = (const U8*)points;
+    s.stride    = stride;
+    s.numPoints = numPoints;
+    s.indices   = indices;
+    splitChunks(s, (indices) ? numIndices : numPoints, BOUND_CHUNK_SIZE);
+
+    if (s.numChunks == 1)
+    {
+        boundRange(s, 0, s.numItems, lo, hi);
+        return;
+    }
+
+    // One box per chunk, merged in order.
+
+    s.lo.reset(s.numChunks);
+    s.hi.reset(s.numChunks);
+    launchChunks(boundTask, s);
+    for (int i = 0; i < s.numChunks; i++)
+    {
+        lo = min(lo, s.lo[i]);
+        hi = max(hi, s.hi[i]);
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::boundTask(MulticoreLauncher::Task& task)
+{
+    BoundState& s = *(BoundState*)task.data;
+    Vec2i range = chunkRange(s, task.idx);
+    Vec3f lo(+FW_F32_MAX), hi(-FW_F32_MAX);
+    boundRange(s, range.x, range.y, lo, hi);
+    s.lo[task.idx] = lo;
+    s.hi[task.idx] = hi;
+}
+
+//------------------------------------------------------------------------
+
+void FW::boundRange(const BoundState& s, int begin, int end, Vec3f& lo, Vec3f& hi)
+{
+#if (FW_XFORM_SIMD != 0)
+
+    // One point per vector, in two interleaved accumulators. A whole-vector
+    // load reads one float past three components, which is outside the
+    // array only for the very last point.
+
+    int wholeEnd = (s.stride >= 16) ? s.numPoints : s.numPoints - 1;
+    __m128 l[2], h[2];
+    l[0] = l[1] = _mm_setr_ps(lo.x, lo.y, lo.z, 0.0f);
+    h[0] = h[1] = _mm_setr_ps(hi.x, hi.y, hi.z, 0.0f);
+
+    for (int i = begin; i < end; i++)
+    {
+        int idx = (s.indices) ? s.indices[i] : i;
+        FW_ASSERT(idx >= 0 && idx < s.numPoints);
+        const F32* p = (const F32*)(s.points + (size_t)idx * s.stride);
+        __m128 v = (idx < wholeEnd) ? _mm_loadu_ps(p) : _mm_setr_ps(p[0], p[1], p[2], 0.0f);
+        l[i & 1] = _mm_min_ps(l[i & 1], v);
+        h[i & 1] = _mm_max_ps(h[i & 1], v);
+    }
+
+    F32 out[2][4];
+    _mm_storeu_ps(out[0], _mm_min_ps(l[0], l[1]));
+    _mm_storeu_ps(out[1], _mm_max_ps(h[0], h[1]));
+    lo = Vec3f(out[0][0], out[0][1], out[0][2]);
+    hi = Vec3f(out[1][0], out[1][1], out[1][2]);
+
+#else
+
+    for (int i = begin; i < end; i++)
+    {
+        int idx = (s.indices) ? s.indices[i] : i;
+        FW_ASSERT(idx >= 0 && idx < s.numPoints);
+        const F32* p = (const F32*)(s.points + (size_t)idx * s.stride);
+        lo = Vec3f(min(lo.x, p[0]), min(lo.y, p[1]), min(lo.z, p[2]));
+        hi = Vec3f(max(hi.x, p[0]), max(hi.y, p[1]), max(hi.z, p[2]));
+    }
+
+#endif
+}
+
+//------------------------------------------------------------------------
@@ -801,6 +801,29 @@ template <class T, int L, class S> FW_CUDA_FUNC S operator^     (const T& a, con
 template <class T, int L, class S> FW_CUDA_FUNC S operator<<    (const T& a, const MatrixBase<T, L, S>& b)  { S r; for (int i = 0; i < L * L; i++) r.get(i) = a << b.get(i); return r; }
 template <class T, int L, class S> FW_CUDA_FUNC S operator>>    (const T& a, const MatrixBase<T, L, S>& b)  { S r; for (int i = 0; i < L * L; i++) r.get(i) = a >> b.get(i); return r; }
 
+//------------------------------------------------------------------------
+// Batch transforms of strided arrays, 'stride' being the distance in bytes
+// between consecutive elements. 'out' may be 'in' with the same stride.
+// Vectorized (8 at a time with AVX, 4 with SSE) and spread over the cores
+// for large batches. Each element comes out as from the scalar expression:
+//
+//   transformPoints:   p = mat * Vec4f(x, y, z, (numComponents == 4) ? w : 1),
+//                      times 1 / p.w unless p.w is zero; writes numComponents.
+//   transformNormals:  mat * n, normalized() if requested.
+//   transformVectors:  mat * v.
+//------------------------------------------------------------------------
+
+#if !FW_CUDA
+void    transformPoints     (const Mat4f& mat, const F32* in, int inStride, F32* out, int outStride, int num, int numComponents = 3);
+void    transformNormals    (const Mat3f& mat, const F32* in, int inStride, F32* out, int outStride, int num, bool normalize = true);
+inline void transformVectors(const Mat3f& mat, const F32* in, int inStride, F32* out, int outStride, int num) { transformNormals(mat, in, inStride, out, outStride, num, false); }
+
+// Grows lo and hi to contain the points (x, y, z at the start of each
+// element), or only those listed in 'indices'. Same layout and
+// parallelism as the transforms.
+void    boundPoints         (const F32* points, int stride, int numPoints, Vec3f& lo, Vec3f& hi, const S32* indices = NULL, int numIndices = 0);
+#endif
+
 //------------------------------------------------------------------------
 
 FW_CUDA_CONST int c_popc8LUT[] =
@@ -43,7 +43,8 @@ S32                             MulticoreLauncher::s_numThreads     = 0;
 //------------------------------------------------------------------------
 
 MulticoreLauncher::MulticoreLauncher(void)
-:   m_numTasks  (0)
+:   m_numTasks      (0),
+    m_numPending    (0)
 {
     s_lock.enter();
 
@@ -112,6 +113,7 @@ MulticoreLauncher& MulticoreLauncher::push(TaskFunc func, void* data, int firstI
         task.result   = NULL;
     }
     m_numTasks += numTasks;
+    m_numPending += numTasks;
 
     applyNumThreads();
     s_monitor->notifyAll();
@@ -126,10 +128,25 @@ MulticoreLauncher::Task MulticoreLauncher::pop(void)
     FW_ASSERT(getNumTasks());
     s_monitor->enter();
 
-    // Wait for a task to finish.
+    // Wait for a task to finish. Pool threads execute pending tasks of this
+    // launcher in the meantime, so that a task can launch subtasks and wait
+    // for them even when every thread is busy. Tasks of other launchers are
+    // left alone; running, say, a whole queued job inline would delay the
+    // waiting task by an unrelated one and nest arbitrarily deep. The
+    // waiting task's error state is set aside while the subtask runs.
 
+    bool isPoolThread = (Thread::getCurrent()->getUserData("MulticoreLauncher") != NULL);
     while (!getNumFinished())
-        s_monitor->wait();
+    {
+        if (isPoolThread && m_numPending)
+        {
+            String oldError = clearError();
+            runTask(takePending());
+            restoreError(oldError);
+        }
+        else
+            s_monitor->wait();
+    }
 
     // Pop from the queue.
 
@@ -223,10 +240,48 @@ void MulticoreLauncher::applyNumThreads(void) // Must have the monitor.
 
 //------------------------------------------------------------------------
 
+MulticoreLauncher::Task MulticoreLauncher::takePending(void) // Must have the monitor.
+{
+    // Tasks of other launchers queued ahead of the first one of this
+    // launcher are put back in their order.
+
+    FW_ASSERT(m_numPending);
+    Array<Task> skipped;
+    while (s_pending.getFirst().launcher != this)
+        skipped.add(s_pending.removeFirst());
+
+    Task task = s_pending.removeFirst();
+    for (int i = skipped.getSize() - 1; i >= 0; i--)
+        s_pending.addFirst(skipped[i]);
+
+    m_numPending--;
+    return task;
+}
+
+//------------------------------------------------------------------------
+
+void MulticoreLauncher::runTask(Task task) // Must have the monitor.
+{
+    // Execute.
+
+    s_monitor->leave();
+    task.func(task);
+    failIfError();
+    s_monitor->enter();
+
+    // Mark as finished.
+
+    task.launcher->m_finished.addLast(task);
+    s_monitor->notifyAll();
+}
+
+//------------------------------------------------------------------------
+
 void MulticoreLauncher::threadFunc(void* param)
 {
     FW_UNREF(param);
     Thread::getCurrent()->setPriority(Thread::Priority_Min);
+    Thread::getCurrent()->setUserData("MulticoreLauncher", (void*)1); // Marks pool threads, see pop().
     s_monitor->enter();
 
     while (s_numThreads <= s_desiredThreads)
@@ -239,22 +294,11 @@ void MulticoreLauncher::threadFunc(void* param)
             continue;
         }
 
-        // Pick a task.
+        // Pick a task and execute.
 
         Task task = s_pending.removeFirst();
-        MulticoreLauncher* launcher = task.launcher;
-
-        // Execute.
-
-        s_monitor->leave();
-        task.func(task);
-        failIfError();
-        s_monitor->enter();
-
-        // Mark as finished.
-
-        launcher->m_finished.addLast(task);
-        s_monitor->notifyAll();
+        task.launcher->m_numPending--;
+        runTask(task);
     }
 
     s_numThreads--;
@@ -264,3 +308,27 @@ void MulticoreLauncher::threadFunc(void* param)
 }
 
 //------------------------------------------------------------------------
+
+void FW::splitChunks(ChunkState& s, int numItems, int chunkSize)
+{
+    FW_ASSERT(numItems >= 0 && chunkSize > 0);
+    s.numItems = numItems;
+    s.numChunks = clamp(numItems / chunkSize, 1, maxChunks());
+}
+
+//------------------------------------------------------------------------
+
+void FW::launchChunks(MulticoreLauncher::TaskFunc func, ChunkState& s)
+{
+    if (s.numChunks > 1)
+        MulticoreLauncher().push(func, &s, 0, s.numChunks).popAll();
+    else
+    {
+        MulticoreLauncher::Task task;
+        task.data = &s;
+        task.idx = 0;
+        func(task);
+    }
+}
+
+//------------------------------------------------------------------------
@@ -28,6 +28,7 @@
 #pragma once
 #include "base/Thread.hpp"
 #include "base/Deque.hpp"
+#include "base/Math.hpp"
 
 namespace FW
 {
@@ -58,7 +59,9 @@ namespace FW
 //     }
 // }
 //
-// Create dependent tasks dynamically:
+// Create dependent tasks dynamically (a task may also wait for them; the
+// waiting pool thread executes pending tasks of the same launcher in the
+// meantime):
 //
 // void myTaskFunc(MulticoreLauncher::Task& task)
 // {
@@ -106,7 +109,7 @@ public:
                             ~MulticoreLauncher  (void);
 
     MulticoreLauncher&      push                (TaskFunc func, void* data, int firstIdx = 0, int numTasks = 1);
-    Task                    pop                 (void);         // Blocks until at least one task has finished.
+    Task                    pop                 (void);         // Blocks until at least one task has finished. Pool threads run pending tasks of this launcher meanwhile.
 
     int                     getNumTasks         (void) const;   // Tasks that have been pushed but not popped.
     int                     getNumFinished      (void) const;   // Tasks that can be popped without blocking.
@@ -119,6 +122,8 @@ public:
 
 private:
     static void             applyNumThreads     (void);
+    Task                    takePending         (void);
+    static void             runTask             (Task task);
     static void             threadFunc          (void* param);
 
 private:
@@ -135,8 +140,49 @@ private:
     static S32              s_numThreads;
 
     S32                     m_numTasks;
+    S32                     m_numPending;       // Tasks still in s_pending.
     Deque<Task>             m_finished;
 };
 
+//------------------------------------------------------------------------
+// Split a range of items into chunks, one task per chunk:
+//
+// struct MyState : ChunkState
+// {
+//     ...
+// };
+//
+// void myChunkFunc(MulticoreLauncher::Task& task)
+// {
+//     MyState& s = *(MyState*)task.data;
+//     Vec2i range = chunkRange(s, task.idx);
+//     for (int i = range.x; i < range.y; i++)
+//         ...
+// }
+//
+// launchChunks(myChunkFunc, s, numItems, chunkSize);
+//
+// Every chunk but a lone one has at least chunkSize items, and there are
+// at most maxChunks(), so that per-chunk results fit in an array of that
+// size. A single chunk runs on the calling thread. splitChunks() fixes the
+// chunks ahead of time for several launches over the same items.
+//------------------------------------------------------------------------
+
+struct ChunkState
+{
+    S32                     numItems;           // Of the current launch.
+    S32                     numChunks;
+};
+
+void                        splitChunks         (ChunkState& s, int numItems, int chunkSize);
+void                        launchChunks        (MulticoreLauncher::TaskFunc func, ChunkState& s); // Chunks of the last splitChunks().
+inline void                 launchChunks        (MulticoreLauncher::TaskFunc func, ChunkState& s, int numItems, int chunkSize) { splitChunks(s, numItems, chunkSize); launchChunks(func, s); }
+inline Vec2i                chunkRange          (const ChunkState& s, int idx) { return Vec2i((int)((S64)s.numItems * idx / s.numChunks), (int)((S64)s.numItems * (idx + 1) / s.numChunks)); }
+inline int                  maxChunks           (void)                          { return MulticoreLauncher::getNumCores() * 4; }
+
+// Moves a chunk boundary in sorted keys forward to the start of a run of
+// equal keys, so that no run is split between chunks.
+template <class K> int      alignToRun          (const Array<K>& keys, int idx) { while (idx > 0 && idx < keys.getSize() && keys[idx] == keys[idx - 1]) idx++; return idx; }
+
 //------------------------------------------------------------------------
 }
@@ -35,6 +35,9 @@ using namespace FW;
 #define QSORT_STACK_SIZE    32
 #define QSORT_MIN_SIZE      16
 #define MULTICORE_MIN_SIZE  (1 << 13)
+#define RADIX_BITS          8
+#define RADIX_SIZE          (1 << RADIX_BITS)
+#define RADIX_CHUNK_SIZE    (1 << 16)
 
 //------------------------------------------------------------------------
 
@@ -56,6 +59,21 @@ static int          partition       (int low, int high, void* data, SortCompareF
 static void         qsort           (int low, int high, void* data, SortCompareFunc compareFunc, SortSwapFunc swapFunc);
 static void         qsortMulticore  (MulticoreLauncher::Task& task);
 
+template <class K> struct RadixPass : ChunkState
+{
+    K*              srcKeys;
+    S32*            srcValues;
+    K*              dstKeys;
+    S32*            dstValues;
+    S32             shift;
+    K               mask;
+    S32*            offsets;    // [numChunks][RADIX_SIZE]: counts, then output positions.
+};
+
+template <class K> static void  radixCount      (MulticoreLauncher::Task& task);
+template <class K> static void  radixScatter    (MulticoreLauncher::Task& task);
+template <class K> static void  radixSortImpl   (K* keys, S32* values, int num, int keyBits, bool multicore);
+
 }
 
 //------------------------------------------------------------------------
@@ -237,3 +255,111 @@ void FW::sort(void* data, int start, int end, SortCompareFunc compareFunc, SortS
 }
 
 //------------------------------------------------------------------------
+
+template <class K> void FW::radixCount(MulticoreLauncher::Task& task)
+{
+    const RadixPass<K>& pass = *(const RadixPass<K>*)task.data;
+    S32* counts = pass.offsets + task.idx * RADIX_SIZE;
+    Vec2i range = chunkRange(pass, task.idx);
+
+    memset(counts, 0, RADIX_SIZE * sizeof(S32));
+    for (int i = range.x; i < range.y; i++)
+        counts[(pass.srcKeys[i] >> pass.shift) & pass.mask]++;
+}
+
+//------------------------------------------------------------------------
+
+template <class K> void FW::radixScatter(MulticoreLauncher::Task& task)
+{
+    const RadixPass<K>& pass = *(const RadixPass<K>*)task.data;
+    S32* offsets = pass.offsets + task.idx * RADIX_SIZE;
+    Vec2i range = chunkRange(pass, task.idx);
+
+    for (int i = range.x; i < range.y; i++)
+    {
+        int j = offsets[(pass.srcKeys[i] >> pass.shift) & pass.mask]++;
+        pass.dstKeys[j] = pass.srcKeys[i];
+        pass.dstValues[j] = pass.srcValues[i];
+    }
+}
+
+//------------------------------------------------------------------------
+
+template <class K> void FW::radixSortImpl(K* keys, S32* values, int num, int keyBits, bool multicore)
+{
+    FW_ASSERT(num >= 0 && ((keys && values) || !num));
+    FW_ASSERT(keyBits >= 0 && keyBits <= (int)sizeof(K) * 8);
+
+    if (num < 2)
+        return;
+
+    Array<K> tmpKeys;
+    Array<S32> tmpValues;
+    Array<S32> offsets;
+    tmpKeys.reset(num);
+    tmpValues.reset(num);
+
+    RadixPass<K> pass;
+    pass.srcKeys = keys;
+    pass.srcValues = values;
+    pass.dstKeys = tmpKeys.getPtr();
+    pass.dstValues = tmpValues.getPtr();
+    splitChunks(pass, num, (multicore) ? RADIX_CHUNK_SIZE : num);
+    offsets.reset(pass.numChunks * RADIX_SIZE);
+    pass.offsets = offsets.getPtr();
+
+    for (pass.shift = 0; pass.shift < keyBits; pass.shift += RADIX_BITS)
+    {
+        pass.mask = (K)((keyBits - pass.shift >= RADIX_BITS) ? RADIX_SIZE - 1 : (1 << (keyBits - pass.shift)) - 1);
+        launchChunks(radixCount<K>, pass);
+
+        // Turn the counts into output positions, bucket by bucket and chunk
+        // by chunk so that the sort is stable. A pass that puts everything
+        // into one bucket would only copy the data; skip it.
+
+        bool trivial = false;
+        S32 sum = 0;
+        for (int bucket = 0; bucket < RADIX_SIZE; bucket++)
+        {
+            S32 bucketStart = sum;
+            for (int chunk = 0; chunk < pass.numChunks; chunk++)
+            {
+                S32& slot = offsets[chunk * RADIX_SIZE + bucket];
+                S32 count = slot;
+                slot = sum;
+                sum += count;
+            }
+            trivial = (trivial || sum - bucketStart == num);
+        }
+        if (trivial)
+            continue;
+
+        launchChunks(radixScatter<K>, pass);
+        nvswap(pass.srcKeys, pass.dstKeys);
+        nvswap(pass.srcValues, pass.dstValues);
+    }
+
+    // Odd number of passes => copy back.
+
+    if (pass.srcKeys != keys)
+    {
+        memcpy(keys, pass.srcKeys, num * sizeof(K));
+        memcpy(values, pass.srcValues, num * sizeof(S32));
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::radixSort(U32* keys, S32* values, int num, int keyBits, bool multicore)
+{
+    radixSortImpl(keys, values, num, keyBits, multicore);
+}
+
+//------------------------------------------------------------------------
+
+void FW::radixSort(U64* keys, S32* values, int num, int keyBits, bool multicore)
+{
+    radixSortImpl(keys, values, num, keyBits, multicore);
+}
+
+//------------------------------------------------------------------------
@@ -48,6 +48,22 @@ typedef void    (*SortSwapFunc)    (void* data, int idxA, int idxB);    // Swaps
 
 void sort(void* data, int start, int end, SortCompareFunc compareFunc, SortSwapFunc swapFunc, bool multicore = false);
 
+//------------------------------------------------------------------------
+// Stable LSD radix sort of (key, value) pairs by the lowest 'keyBits' bits
+// of the keys. Pairs with equal keys keep their input order. Takes linear
+// time and a temporary copy of both arrays; the multicore version splits
+// every pass into chunks.
+//
+// Group vertex indices by cell, keeping them ascending within a cell:
+//
+//   Array<U32> cells = ...;                    // < (1 << 20)
+//   Array<S32> verts = ...;                    // 0, 1, 2, ...
+//   radixSort(cells.getPtr(), verts.getPtr(), cells.getSize(), 20, true);
+//------------------------------------------------------------------------
+
+void radixSort(U32* keys, S32* values, int num, int keyBits = 32, bool multicore = false);
+void radixSort(U64* keys, S32* values, int num, int keyBits = 64, bool multicore = false);
+
 //------------------------------------------------------------------------
 // Template-based wrappers.
 // Use these if your type defines operator< and you want to sort in
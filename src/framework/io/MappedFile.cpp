@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io/MappedFile.hpp"
+
+using namespace FW;
+
+//------------------------------------------------------------------------
+
+MappedFile::MappedFile(const String& name)
+:   m_name      (name),
+    m_file      (NULL),
+    m_mapping   (NULL),
+    m_ptr       (NULL),
+    m_size      (0),
+    m_modifiedTime(0)
+{
+    // Open.
+
+    m_file = CreateFile(
+        name.getPtr(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL);
+
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        m_file = NULL;
+        setError("Cannot open file '%s' for read!", m_name.getPtr());
+        return;
+    }
+
+    // Get size. Empty files cannot be mapped => leave the view NULL.
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+    {
+        setError("GetFileSizeEx() failed on '%s'!", m_name.getPtr());
+        return;
+    }
+    m_size = size.QuadPart;
+
+    FILETIME modified;
+    if (GetFileTime(m_file, NULL, NULL, &modified))
+        m_modifiedTime = ((U64)modified.dwHighDateTime << 32) | modified.dwLowDateTime;
+
+    if (!m_size)
+        return;
+
+    // Map.
+
+    m_mapping = CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!m_mapping)
+    {
+        m_size = 0;
+        setError("CreateFileMapping() failed on '%s'!", m_name.getPtr());
+        return;
+    }
+
+    m_ptr = (const U8*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_ptr)
+    {
+        m_size = 0;
+        setError("MapViewOfFile() failed on '%s'!", m_name.getPtr());
+    }
+}
+
+//------------------------------------------------------------------------
+
+MappedFile::~MappedFile(void)
+{
+    if (m_ptr)
+        UnmapViewOfFile(m_ptr);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+}
+
+//------------------------------------------------------------------------
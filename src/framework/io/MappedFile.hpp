@@ -0,0 +1,67 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include "base/String.hpp"
+#include "base/DLLImports.hpp"
+
+namespace FW
+{
+//------------------------------------------------------------------------
+// Read-only memory mapping of an entire file.
+// The view stays valid for the lifetime of the object.
+//------------------------------------------------------------------------
+
+class MappedFile
+{
+public:
+    explicit                MappedFile              (const String& name);
+                            ~MappedFile             (void);
+
+    const String&           getName                 (void) const    { return m_name; }
+    bool                    isMapped                (void) const    { return (m_ptr != NULL); }
+    S64                     getSize                 (void) const    { return m_size; }
+    U64                     getModifiedTime         (void) const    { return m_modifiedTime; } // FILETIME ticks; 0 if unknown.
+    const U8*               getPtr                  (S64 ofs = 0) const { FW_ASSERT(ofs >= 0 && ofs <= m_size); return m_ptr + ofs; }
+    const char*             getChars                (void) const    { return (const char*)m_ptr; }
+    const char*             getCharsEnd             (void) const    { return (const char*)m_ptr + m_size; }
+
+private:
+                            MappedFile              (const MappedFile&); // forbidden
+    MappedFile&             operator=               (const MappedFile&); // forbidden
+
+private:
+    String                  m_name;
+    HANDLE                  m_file;
+    HANDLE                  m_mapping;
+    const U8*               m_ptr;
+    S64                     m_size;
+    U64                     m_modifiedTime;
+};
+
+//------------------------------------------------------------------------
+}
@@ -29,11 +29,41 @@
 #include "3d/Mesh.hpp"
 #include "io/Stream.hpp"
 #include "io/ImageBinaryIO.hpp"
+#include "io/MeshCodec.hpp"
 
 using namespace FW;
 
 //------------------------------------------------------------------------
 
+namespace FW
+{
+
+struct AttribQuant
+{
+    S32             bits;           // 0 = as is.
+    Vec4f           offset;
+    Vec4f           step;
+};
+
+static int      getQuantBits        (const MeshBase::AttribSpec& spec, const BinaryMeshParams& params);
+static void     setupQuant          (AttribQuant& quant, const MeshBase* mesh, int attrib);
+static int      getCodedStride      (const MeshBase* mesh, const Array<AttribQuant>& quant);
+static void     quantizeVertices    (U8* coded, const MeshBase* mesh, const Array<AttribQuant>& quant);
+static void     dequantizeVertices  (MeshBase* mesh, const U8* coded, const Array<AttribQuant>& quant);
+static bool     readCoded           (InputStream& stream, Array<U8>& data);
+static void     writeCoded          (OutputStream& stream, const Array<U8>& data);
+static void     readVertexData      (InputStream& stream, MeshBase* mesh);
+static void     writeVertexData     (OutputStream& stream, const MeshBase* mesh, const BinaryMeshParams& params);
+static void     readClusters        (InputStream& stream, MeshBase* mesh);
+static void     writeClusters       (OutputStream& stream, const MeshBase* mesh);
+static void     readLods            (InputStream& stream, MeshBase* mesh);
+static void     writeLods           (OutputStream& stream, const MeshBase* mesh);
+static void     writeSection        (OutputStream& stream, const char* id, const MemoryOutputStream& section);
+
+}
+
+//------------------------------------------------------------------------
+
 MeshBase* FW::importBinaryMesh(InputStream& stream)
 {
     MeshBase* mesh = new MeshBase;
@@ -55,7 +85,9 @@ MeshBase* FW::importBinaryMesh(InputStream& stream)
     case 1:     numTex = 0; break;
     case 2:     numTex = MeshBase::TextureType_Alpha + 1; break;
     case 3:     numTex = MeshBase::TextureType_Displacement + 1; break;
-    case 4:     numTex = MeshBase::TextureType_Environment + 1; break;
+    case 4:
+    case 5:
+    case 6:     numTex = MeshBase::TextureType_Environment + 1; break;
     default:    numTex = 0; setError("Unsupported binary mesh version!"); break;
     }
 
@@ -83,7 +115,10 @@ MeshBase* FW::importBinaryMesh(InputStream& stream)
     if (!hasError())
     {
         mesh->resetVertices(numVertices);
-        stream.readFully(mesh->getMutableVertexPtr(), numVertices * mesh->vertexStride());
+        if (version >= 6)
+            readVertexData(stream, mesh);
+        else
+            stream.readFully(mesh->getMutableVertexPtr(), numVertices * mesh->vertexStride());
     }
 
     // Array of Texture.
@@ -130,8 +165,46 @@ MeshBase* FW::importBinaryMesh(InputStream& stream)
         {
             Array<Vec3i>& inds = mesh->mutableIndices(i);
             inds.reset(numTriangles);
-            stream.readFully(inds.getPtr(), inds.getNumBytes());
+            if (version < 6)
+                stream.readFully(inds.getPtr(), inds.getNumBytes());
+            else
+            {
+                Array<U8> data;
+                if (readCoded(stream, data) && !decodeIndices(inds.getPtr(), numTriangles, data.getPtr(), data.getSize()))
+                    setError("Corrupt binary mesh data!");
+            }
+        }
+    }
+
+    // Array of Section.
+
+    S32 numSections = 0;
+    if (version >= 5 && !hasError())
+        stream >> numSections;
+
+    for (int i = 0; i < numSections && !hasError(); i++)
+    {
+        char id[5];
+        S32 numBytes;
+        stream.readFully(id, 4);
+        id[4] = '\0';
+        stream >> numBytes;
+        if (numBytes < 0)
+        {
+            setError("Corrupt binary mesh data!");
+            break;
         }
+
+        Array<U8> data(NULL, numBytes);
+        stream.readFully(data.getPtr(), numBytes);
+        if (hasError())
+            break;
+
+        MemoryInputStream section(data);
+        if (String(id) == "CLUS")
+            readClusters(section, mesh);
+        else if (String(id) == "LODS")
+            readLods(section, mesh);
     }
 
     // Handle errors.
@@ -146,7 +219,7 @@ MeshBase* FW::importBinaryMesh(InputStream& stream)
 
 //------------------------------------------------------------------------
 
-void FW::exportBinaryMesh(OutputStream& stream, const MeshBase* mesh)
+void FW::exportBinaryMesh(OutputStream& stream, const MeshBase* mesh, const BinaryMeshParams& params)
 {
     FW_ASSERT(mesh);
 
@@ -174,7 +247,7 @@ void FW::exportBinaryMesh(OutputStream& stream, const MeshBase* mesh)
     // MeshHeader.
 
     stream.write("BinMesh ", 8);
-    stream << (S32)4 << (S32)mesh->numAttribs() << (S32)mesh->numVertices() << (S32)mesh->numSubmeshes() << (S32)textures.getSize();
+    stream << (S32)((params.compress) ? 6 : 5) << (S32)mesh->numAttribs() << (S32)mesh->numVertices() << (S32)mesh->numSubmeshes() << (S32)textures.getSize();
 
     // Array of AttribSpec.
 
@@ -184,9 +257,12 @@ void FW::exportBinaryMesh(OutputStream& stream, const MeshBase* mesh)
         stream << (S32)spec.type << (S32)spec.format << spec.length;
     }
 
-    // Array of Vertex.
+    // Array of Vertex or VertexData.
 
-    stream.write(mesh->getVertexPtr(), mesh->numVertices() * mesh->vertexStride());
+    if (params.compress)
+        writeVertexData(stream, mesh, params);
+    else
+        stream.write(mesh->getVertexPtr(), mesh->numVertices() * mesh->vertexStride());
 
     // Array of Texture.
 
@@ -208,8 +284,428 @@ void FW::exportBinaryMesh(OutputStream& stream, const MeshBase* mesh)
         for (int j = 0; j < numTex; j++)
             stream << texHash[mat.textures[j].getImage()];
         stream << (S32)inds.getSize();
-        stream.write(inds.getPtr(), inds.getNumBytes());
+
+        if (!params.compress)
+            stream.write(inds.getPtr(), inds.getNumBytes());
+        else
+        {
+            Array<U8> data;
+            encodeIndices(data, inds.getPtr(), inds.getSize());
+            writeCoded(stream, data);
+        }
+    }
+
+    // Array of Section.
+
+    bool hasClusters = (mesh->clusters().numClusters() != 0);
+    bool hasLods = (mesh->lods().numLevels() > 1);
+    stream << (S32)(((hasClusters) ? 1 : 0) + ((hasLods) ? 1 : 0));
+
+    if (hasClusters)
+    {
+        MemoryOutputStream section;
+        writeClusters(section, mesh);
+        writeSection(stream, "CLUS", section);
+    }
+
+    if (hasLods)
+    {
+        MemoryOutputStream section;
+        writeLods(section, mesh);
+        writeSection(stream, "LODS", section);
+    }
+}
+
+//------------------------------------------------------------------------
+
+int FW::getQuantBits(const MeshBase::AttribSpec& spec, const BinaryMeshParams& params)
+{
+    if (spec.format != MeshBase::AttribFormat_F32)
+        return 0;
+
+    int bits;
+    switch (spec.type)
+    {
+    case MeshBase::AttribType_Position: bits = params.positionBits; break;
+    case MeshBase::AttribType_Normal:   bits = params.normalBits; break;
+    case MeshBase::AttribType_TexCoord: bits = params.texCoordBits; break;
+    default:                            bits = 0; break;
+    }
+
+    FW_ASSERT(bits >= 0 && bits <= 16);
+    return bits;
+}
+
+//------------------------------------------------------------------------
+
+void FW::setupQuant(AttribQuant& quant, const MeshBase* mesh, int attrib)
+{
+    const MeshBase::AttribSpec& spec = mesh->attribSpec(attrib);
+    F32 maxQ = (F32)((1 << quant.bits) - 1);
+
+    if (spec.type == MeshBase::AttribType_Normal)
+    {
+        quant.offset = Vec4f(-1.0f);
+        quant.step = Vec4f(2.0f / maxQ);
+        return;
+    }
+
+    Vec4f lo(+FW_F32_MAX);
+    Vec4f hi(-FW_F32_MAX);
+    for (int i = 0; i < mesh->numVertices(); i++)
+    {
+        const F32* v = (const F32*)(mesh->vertex(i) + spec.offset);
+        for (int j = 0; j < spec.length; j++)
+        {
+            lo[j] = min(lo[j], v[j]);
+            hi[j] = max(hi[j], v[j]);
+        }
+    }
+
+    // One step size for all axes of a position keeps the error isotropic.
+
+    quant.offset = Vec4f(0.0f);
+    quant.step = Vec4f(0.0f);
+    F32 extent = 0.0f;
+    for (int j = 0; j < spec.length; j++)
+        extent = max(extent, hi[j] - lo[j]);
+
+    for (int j = 0; j < spec.length && mesh->numVertices(); j++)
+    {
+        quant.offset[j] = lo[j];
+        quant.step[j] = ((spec.type == MeshBase::AttribType_Position) ? extent : hi[j] - lo[j]) / maxQ;
     }
 }
 
 //------------------------------------------------------------------------
+
+int FW::getCodedStride(const MeshBase* mesh, const Array<AttribQuant>& quant)
+{
+    int stride = 0;
+    for (int i = 0; i < mesh->numAttribs(); i++)
+        stride += (quant[i].bits) ? mesh->attribSpec(i).length * (int)sizeof(U16) : mesh->attribSpec(i).bytes;
+    return stride;
+}
+
+//------------------------------------------------------------------------
+
+void FW::quantizeVertices(U8* coded, const MeshBase* mesh, const Array<AttribQuant>& quant)
+{
+    for (int i = 0; i < mesh->numVertices(); i++)
+    {
+        const U8* vertex = mesh->vertex(i);
+        for (int j = 0; j < mesh->numAttribs(); j++)
+        {
+            const MeshBase::AttribSpec& spec = mesh->attribSpec(j);
+            const AttribQuant& q = quant[j];
+            if (!q.bits)
+            {
+                memcpy(coded, vertex + spec.offset, spec.bytes);
+                coded += spec.bytes;
+                continue;
+            }
+
+            const F32* v = (const F32*)(vertex + spec.offset);
+            F32 maxQ = (F32)((1 << q.bits) - 1);
+            for (int k = 0; k < spec.length; k++)
+            {
+                F32 t = (q.step[k] > 0.0f) ? clamp((v[k] - q.offset[k]) / q.step[k], 0.0f, maxQ) : 0.0f;
+                U16 value = (U16)(t + 0.5f);
+                memcpy(coded, &value, sizeof(U16));
+                coded += sizeof(U16);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::dequantizeVertices(MeshBase* mesh, const U8* coded, const Array<AttribQuant>& quant)
+{
+    U8* vertex = mesh->getMutableVertexPtr();
+    for (int i = 0; i < mesh->numVertices(); i++)
+    {
+        for (int j = 0; j < mesh->numAttribs(); j++)
+        {
+            const MeshBase::AttribSpec& spec = mesh->attribSpec(j);
+            const AttribQuant& q = quant[j];
+            if (!q.bits)
+            {
+                memcpy(vertex + spec.offset, coded, spec.bytes);
+                coded += spec.bytes;
+                continue;
+            }
+
+            F32* v = (F32*)(vertex + spec.offset);
+            for (int k = 0; k < spec.length; k++)
+            {
+                U16 value;
+                memcpy(&value, coded, sizeof(U16));
+                coded += sizeof(U16);
+                v[k] = q.offset[k] + (F32)value * q.step[k];
+            }
+        }
+        vertex += mesh->vertexStride();
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool FW::readCoded(InputStream& stream, Array<U8>& data)
+{
+    S32 numBytes;
+    stream >> numBytes;
+    if (hasError() || numBytes < 0)
+    {
+        setError("Corrupt binary mesh data!");
+        return false;
+    }
+
+    U8 padding[3];
+    data.reset(numBytes);
+    stream.readFully(data.getPtr(), numBytes);
+    stream.readFully(padding, (4 - numBytes % 4) % 4);
+    return !hasError();
+}
+
+//------------------------------------------------------------------------
+
+void FW::writeCoded(OutputStream& stream, const Array<U8>& data)
+{
+    static const U8 padding[3] = { 0, 0, 0 };
+    stream << (S32)data.getSize();
+    stream.write(data.getPtr(), data.getSize());
+    stream.write(padding, (4 - data.getSize() % 4) % 4);
+}
+
+//------------------------------------------------------------------------
+
+void FW::readVertexData(InputStream& stream, MeshBase* mesh)
+{
+    // Array of AttribQuant.
+
+    Array<AttribQuant> quant(NULL, mesh->numAttribs());
+    bool quantized = false;
+    for (int i = 0; i < mesh->numAttribs() && !hasError(); i++)
+    {
+        const MeshBase::AttribSpec& spec = mesh->attribSpec(i);
+        AttribQuant& q = quant[i];
+        q.offset = Vec4f(0.0f);
+        q.step = Vec4f(0.0f);
+        stream >> q.bits;
+        if (q.bits < 0 || q.bits > 16 || (q.bits && spec.format != MeshBase::AttribFormat_F32))
+        {
+            setError("Corrupt binary mesh data!");
+            return;
+        }
+
+        if (q.bits)
+        {
+            stream.readFully(q.offset.getPtr(), spec.length * sizeof(F32));
+            stream.readFully(q.step.getPtr(), spec.length * sizeof(F32));
+            quantized = true;
+        }
+    }
+
+    // Data.
+
+    Array<U8> data;
+    if (!readCoded(stream, data))
+        return;
+
+    int stride = getCodedStride(mesh, quant);
+    bool ok;
+    if (!stride)
+        ok = (data.getSize() == 0);
+    else if (!quantized)
+        ok = decodeVertices(mesh->getMutableVertexPtr(), mesh->numVertices(), stride, data.getPtr(), data.getSize());
+    else
+    {
+        Array<U8> coded(NULL, mesh->numVertices() * stride);
+        ok = decodeVertices(coded.getPtr(), mesh->numVertices(), stride, data.getPtr(), data.getSize());
+        if (ok)
+            dequantizeVertices(mesh, coded.getPtr(), quant);
+    }
+
+    if (!ok)
+        setError("Corrupt binary mesh data!");
+}
+
+//------------------------------------------------------------------------
+
+void FW::writeVertexData(OutputStream& stream, const MeshBase* mesh, const BinaryMeshParams& params)
+{
+    // Array of AttribQuant.
+
+    Array<AttribQuant> quant(NULL, mesh->numAttribs());
+    bool quantized = false;
+    for (int i = 0; i < mesh->numAttribs(); i++)
+    {
+        const MeshBase::AttribSpec& spec = mesh->attribSpec(i);
+        AttribQuant& q = quant[i];
+        q.bits = getQuantBits(spec, params);
+        stream << q.bits;
+        if (!q.bits)
+            continue;
+
+        setupQuant(q, mesh, i);
+        stream.write(q.offset.getPtr(), spec.length * sizeof(F32));
+        stream.write(q.step.getPtr(), spec.length * sizeof(F32));
+        quantized = true;
+    }
+
+    // Data.
+
+    int stride = getCodedStride(mesh, quant);
+    Array<U8> data;
+    if (stride && !quantized)
+        encodeVertices(data, mesh->getVertexPtr(), mesh->numVertices(), stride);
+    else if (stride)
+    {
+        Array<U8> coded(NULL, mesh->numVertices() * stride);
+        quantizeVertices(coded.getPtr(), mesh, quant);
+        encodeVertices(data, coded.getPtr(), mesh->numVertices(), stride);
+    }
+    writeCoded(stream, data);
+}
+
+//------------------------------------------------------------------------
+
+void FW::readClusters(InputStream& stream, MeshBase* mesh)
+{
+    S32 numClusters, numVertices, numTriangles;
+    stream >> numClusters >> numVertices >> numTriangles;
+    if (hasError() || numClusters < 0 || numVertices < 0 || numTriangles < 0)
+    {
+        setError("Corrupt binary mesh data!");
+        return;
+    }
+
+    MeshBase::Clusters c;
+    c.submeshStart.reset(mesh->numSubmeshes() + 1);
+    c.vertexRange.reset(numClusters);
+    c.triangleRange.reset(numClusters);
+    c.spheres.reset(numClusters);
+    c.cones.reset(numClusters);
+    c.vertices.reset(numVertices);
+    c.triangles.reset(numTriangles * 3);
+
+    stream.readFully(c.submeshStart.getPtr(), c.submeshStart.getNumBytes());
+    stream.readFully(c.vertexRange.getPtr(), c.vertexRange.getNumBytes());
+    stream.readFully(c.triangleRange.getPtr(), c.triangleRange.getNumBytes());
+    stream.readFully(c.spheres.getPtr(), c.spheres.getNumBytes());
+    stream.readFully(c.cones.getPtr(), c.cones.getNumBytes());
+    stream.readFully(c.vertices.getPtr(), c.vertices.getNumBytes());
+    stream.readFully(c.triangles.getPtr(), c.triangles.getNumBytes());
+    if (hasError())
+        return;
+
+    // Validate everything that is used for indexing.
+
+    bool ok = (c.submeshStart[0] == 0 && c.submeshStart.getLast() == numClusters);
+    for (int i = 1; i < c.submeshStart.getSize() && ok; i++)
+        ok = (c.submeshStart[i] >= c.submeshStart[i - 1]);
+
+    for (int i = 0; i < numVertices && ok; i++)
+        ok = (c.vertices[i] >= 0 && c.vertices[i] < mesh->numVertices());
+
+    for (int i = 0; i < numClusters && ok; i++)
+    {
+        const Vec2i& v = c.vertexRange[i];
+        const Vec2i& t = c.triangleRange[i];
+        ok = (v.x >= 0 && v.y >= 0 && v.y <= 256 && v.x <= numVertices - v.y && t.x >= 0 && t.y >= 0 && t.x <= numTriangles - t.y);
+        for (int j = t.x * 3; j < (t.x + t.y) * 3 && ok; j++)
+            ok = (c.triangles[j] < v.y);
+    }
+
+    if (!ok)
+        setError("Corrupt binary mesh data!");
+    else
+        mesh->setClusters(c);
+}
+
+//------------------------------------------------------------------------
+
+void FW::writeClusters(OutputStream& stream, const MeshBase* mesh)
+{
+    const MeshBase::Clusters& c = mesh->clusters();
+    FW_ASSERT(c.submeshStart.getSize() == mesh->numSubmeshes() + 1);
+
+    stream << (S32)c.numClusters() << (S32)c.vertices.getSize() << (S32)(c.triangles.getSize() / 3);
+    stream.write(c.submeshStart.getPtr(), c.submeshStart.getNumBytes());
+    stream.write(c.vertexRange.getPtr(), c.vertexRange.getNumBytes());
+    stream.write(c.triangleRange.getPtr(), c.triangleRange.getNumBytes());
+    stream.write(c.spheres.getPtr(), c.spheres.getNumBytes());
+    stream.write(c.cones.getPtr(), c.cones.getNumBytes());
+    stream.write(c.vertices.getPtr(), c.vertices.getNumBytes());
+    stream.write(c.triangles.getPtr(), c.triangles.getNumBytes());
+
+    static const U8 padding[3] = { 0, 0, 0 };
+    stream.write(padding, (4 - c.triangles.getSize() % 4) % 4);
+}
+
+//------------------------------------------------------------------------
+
+void FW::readLods(InputStream& stream, MeshBase* mesh)
+{
+    S32 numLevels, numTriangles;
+    stream >> numLevels >> numTriangles;
+    if (hasError() || numLevels < 0 || numTriangles < 0)
+    {
+        setError("Corrupt binary mesh data!");
+        return;
+    }
+
+    MeshBase::Lods l;
+    l.errors.reset(numLevels);
+    l.ranges.reset(numLevels * mesh->numSubmeshes());
+    l.triangles.reset(numTriangles);
+
+    stream.readFully(l.errors.getPtr(), l.errors.getNumBytes());
+    stream.readFully(l.ranges.getPtr(), l.ranges.getNumBytes());
+    stream.readFully(l.triangles.getPtr(), l.triangles.getNumBytes());
+    if (hasError())
+        return;
+
+    // Validate everything that is used for indexing.
+
+    bool ok = true;
+    for (int i = 0; i < l.ranges.getSize() && ok; i++)
+    {
+        const Vec2i& r = l.ranges[i];
+        ok = (r.x >= 0 && r.y >= 0 && r.x <= numTriangles - r.y);
+    }
+
+    for (int i = 0; i < numTriangles && ok; i++)
+        for (int j = 0; j < 3 && ok; j++)
+            ok = (l.triangles[i][j] >= 0 && l.triangles[i][j] < mesh->numVertices());
+
+    if (!ok)
+        setError("Corrupt binary mesh data!");
+    else
+        mesh->setLods(l);
+}
+
+//------------------------------------------------------------------------
+
+void FW::writeLods(OutputStream& stream, const MeshBase* mesh)
+{
+    const MeshBase::Lods& l = mesh->lods();
+    FW_ASSERT(l.ranges.getSize() == l.errors.getSize() * mesh->numSubmeshes());
+
+    stream << (S32)l.errors.getSize() << (S32)l.triangles.getSize();
+    stream.write(l.errors.getPtr(), l.errors.getNumBytes());
+    stream.write(l.ranges.getPtr(), l.ranges.getNumBytes());
+    stream.write(l.triangles.getPtr(), l.triangles.getNumBytes());
+}
+
+//------------------------------------------------------------------------
+
+void FW::writeSection(OutputStream& stream, const char* id, const MemoryOutputStream& section)
+{
+    stream.write(id, 4);
+    stream << (S32)section.getData().getSize();
+    stream.write(section.getData().getPtr(), section.getData().getSize());
+}
+
+//------------------------------------------------------------------------
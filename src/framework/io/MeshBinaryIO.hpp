@@ -38,28 +38,53 @@ class OutputStream;
 
 //------------------------------------------------------------------------
 
+// Compression of the vertices and indices with MeshCodec, and optional
+// quantization of F32 attributes to 1-16 bits per component. Quantized
+// positions share one step size for all axes; normals map [-1, 1] and
+// texture coordinates their range onto the integers. Decoded values are
+// within half a step of the original ones. Without compression, the
+// mesh is written in the v5 format and quantization is ignored.
+
+struct BinaryMeshParams
+{
+    bool        compress;
+    S32         positionBits;       // 0 = lossless.
+    S32         normalBits;         // 0 = lossless.
+    S32         texCoordBits;       // 0 = lossless.
+
+                BinaryMeshParams    (void) : compress(true), positionBits(0), normalBits(0), texCoordBits(0) {}
+};
+
+//------------------------------------------------------------------------
+
 MeshBase*   importBinaryMesh    (InputStream& stream);
-void        exportBinaryMesh    (OutputStream& stream, const MeshBase* mesh);
+void        exportBinaryMesh    (OutputStream& stream, const MeshBase* mesh, const BinaryMeshParams& params = BinaryMeshParams());
 
 //------------------------------------------------------------------------
 /*
 
-Binary mesh file format v4
+Binary mesh file format v6
 --------------------------
 
 - the basic units of data are 32-bit little-endian ints and floats
+- v6 replaces the raw vertices and indices with VertexData and
+  IndexData, coded as described in MeshCodec.hpp; exportBinaryMesh()
+  still writes v5 when asked not to compress
 
 BinaryMesh
     0       6       struct  v1  MeshHeader
     6       n*3     struct  v1  array of AttribSpec (MeshHeader.numAttribs)
-    ?       n*?     struct  v1  array of Vertex (MeshHeader.numVertices)
+    ?       n*?     struct  v1  array of Vertex (MeshHeader.numVertices, v1-v5)
+    ?       ?       struct  v6  VertexData
     ?       n*?     struct  v2  array of Texture (MeshHeader.numTextures)
     ?       n*?     struct  v1  array of Submesh (MeshHeader.numSubmeshes)
+    ?       1       int     v5  numSections
+    ?       n*?     struct  v5  array of Section
     ?
 
 MeshHeader
     0       2       bytes   v1  formatID (must be "BinMesh ")
-    2       1       int     v1  formatVersion (must be 4)
+    2       1       int     v1  formatVersion (must be 6)
     3       1       int     v1  numAttribs
     4       1       int     v1  numVertices
     5       1       int     v2  numTextures
@@ -76,6 +101,21 @@ Vertex
     0       ?       bytes   v1  array of values (dictated by the set of AttribSpecs)
     ?
 
+VertexData
+    0       n*?     struct  v6  array of AttribQuant (MeshHeader.numAttribs)
+    ?       1       int     v6  numBytes
+    ?       ?       bytes   v6  data (see encodeVertices(), zero-padded to a multiple of 4)
+    ?
+
+AttribQuant
+    0       1       int     v6  bits (0 = as is, otherwise 1-16; the attribute must be F32)
+    1       n       float   v6  offset (AttribSpec.length, only if bits != 0)
+    ?       n       float   v6  step (AttribSpec.length, only if bits != 0)
+    ?
+
+- data codes vertices in which every quantized attribute is replaced by
+  one 16-bit unsigned int per component, q; the value is offset + q * step
+
 Texture
     0       1       int     v2  idLength
     1       ?       bytes   v2  idString
@@ -95,7 +135,40 @@ Submesh
     16      1       int     v4  normalTexture (-1 if none)
     17      1       int     v4  environmentTexture (-1 if none)
     18      1       int     v1  numTriangles
-    19      n*3     int     v1  indices
+    19      n*3     int     v1  indices (v1-v5)
+    19      ?       struct  v6  IndexData
+    ?
+
+IndexData
+    0       1       int     v6  numBytes
+    1       ?       bytes   v6  data (see encodeIndices(), zero-padded to a multiple of 4)
+    ?
+
+Section
+    0       1       bytes   v5  id (4 characters, e.g. "CLUS")
+    1       1       int     v5  numBytes
+    2       ?       bytes   v5  data (readers skip sections they do not know)
+    ?
+
+Clusters section "CLUS" (see MeshBase::Clusters)
+    0       1       int     v5  numClusters
+    1       1       int     v5  numVertices (total over the clusters)
+    2       1       int     v5  numTriangles (total over the clusters)
+    3       n       int     v5  submeshStart (MeshHeader.numSubmeshes + 1)
+    ?       n*2     int     v5  vertexRange (numClusters)
+    ?       n*2     int     v5  triangleRange (numClusters)
+    ?       n*4     float   v5  spheres (numClusters)
+    ?       n*4     float   v5  cones (numClusters)
+    ?       n       int     v5  vertices (numVertices)
+    ?       ?       bytes   v5  triangles (numTriangles * 3, zero-padded to a multiple of 4)
+    ?
+
+LODs section "LODS" (see MeshBase::Lods)
+    0       1       int     v5  numLevels (excluding level 0)
+    1       1       int     v5  numTriangles (total over the levels)
+    2       n       float   v5  errors (numLevels)
+    ?       n*2     int     v5  ranges (numLevels * MeshHeader.numSubmeshes)
+    ?       n*3     int     v5  triangles (numTriangles)
     ?
 
 */
@@ -0,0 +1,609 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io/MeshCodec.hpp"
+
+#include <string.h>
+
+// The vertex decoder unpacks, undoes the deltas of and transposes 16 bytes
+// at a time with SSE2, and one byte at a time in plain C++ otherwise.
+// Define FW_CODEC_SIMD as 0 to force the latter; both read the same data.
+
+#ifndef FW_CODEC_SIMD
+#   if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#       define FW_CODEC_SIMD    1
+#   else
+#       define FW_CODEC_SIMD    0
+#   endif
+#endif
+
+#if FW_CODEC_SIMD
+#   include <emmintrin.h>
+#endif
+
+using namespace FW;
+
+//------------------------------------------------------------------------
+
+#define VERTEX_BLOCK_BYTES  8192    // Target size of a decoded block; keeps the lanes in L1.
+#define VERTEX_BLOCK_MAX    256     // Vertices per block at most.
+#define INDEX_FIFO_SIZE     16      // Entries in the edge and vertex FIFOs.
+#define INDEX_FIFO_CODED    14      // Of those, the ones a code can refer to.
+#define INDEX_PADDING       16      // Zero bytes after the index data; covers the most one triangle reads.
+
+//------------------------------------------------------------------------
+
+namespace FW
+{
+
+struct IndexCoder
+{
+    Vec2i               edges[INDEX_FIFO_SIZE];
+    S32                 vertices[INDEX_FIFO_SIZE];
+    S32                 edgeOfs;
+    S32                 vertexOfs;
+    S32                 next;
+    U32                 last;
+
+    void                init                (S32 first);
+    void                pushEdge            (S32 a, S32 b)  { edges[edgeOfs] = Vec2i(a, b); edgeOfs = (edgeOfs + 1) & (INDEX_FIFO_SIZE - 1); }
+    void                pushVertex          (S32 v)         { vertices[vertexOfs] = v; vertexOfs = (vertexOfs + 1) & (INDEX_FIFO_SIZE - 1); }
+    const Vec2i&        getEdge             (int fe) const  { return edges[(edgeOfs - 1 - fe) & (INDEX_FIFO_SIZE - 1)]; }
+    S32                 getVertex           (int fv) const  { return vertices[(vertexOfs - 1 - fv) & (INDEX_FIFO_SIZE - 1)]; }
+};
+
+static inline U8    zigzag8             (U8 d)                      { return (U8)((d << 1) ^ (U8)((S8)d >> 7)); }
+static inline U8    unzigzag8           (U8 z)                      { return (U8)((z >> 1) ^ (U8)-(z & 1)); }
+static inline int   groupBytes          (int mode)                  { return (mode) ? 2 << mode : 0; }
+
+static void         encodeGroup         (Array<U8>& out, const U8* z, int mode);
+static const U8*    decodeLane          (U8* lane, int n, U8 last, const U8* data, const U8* end);
+static void         transposeBlock      (U8* vertices, const U8* lanes, int n, int stride, int blockSize);
+
+static void         writeVarint         (Array<U8>& out, U32 v);
+static inline U32   readVarint          (const U8*& data);
+static int          encodeVertex        (IndexCoder& coder, Array<U8>& data, S32 v);
+static inline S32   decodeVertex        (IndexCoder& coder, const U8*& data, int f);
+
+}
+
+//------------------------------------------------------------------------
+
+void FW::IndexCoder::init(S32 first)
+{
+    for (int i = 0; i < INDEX_FIFO_SIZE; i++)
+    {
+        edges[i] = Vec2i(-1);
+        vertices[i] = -1;
+    }
+    edgeOfs = 0;
+    vertexOfs = 0;
+    next = first;
+    last = (U32)first;
+}
+
+//------------------------------------------------------------------------
+
+int FW::getVertexBlockSize(int stride)
+{
+    FW_ASSERT(stride > 0);
+    return clamp((VERTEX_BLOCK_BYTES / stride) & ~15, 16, VERTEX_BLOCK_MAX);
+}
+
+//------------------------------------------------------------------------
+
+void FW::encodeVertices(Array<U8>& out, const void* vertices, int numVertices, int stride)
+{
+    FW_ASSERT(numVertices >= 0 && stride > 0);
+    FW_ASSERT(vertices || !numVertices);
+
+    const U8* src = (const U8*)vertices;
+    int blockSize = getVertexBlockSize(stride);
+    Array<U8> last(NULL, stride);
+    memset(last.getPtr(), 0, stride);
+
+    for (int first = 0; first < numVertices; first += blockSize)
+    {
+        int n = min(blockSize, numVertices - first);
+        int numGroups = (n + 15) >> 4;
+        for (int k = 0; k < stride; k++)
+        {
+            // Header of 2-bit group modes, filled in as the groups are coded.
+
+            int header = out.getSize();
+            memset(out.add(NULL, (numGroups + 3) >> 2), 0, (numGroups + 3) >> 2);
+
+            const U8* lane = src + (size_t)first * stride + k;
+            U8 prev = last[k];
+            for (int g = 0; g < numGroups; g++)
+            {
+                U8 z[16] = {};
+                U8 bits = 0;
+                for (int j = 0; j < 16 && g * 16 + j < n; j++)
+                {
+                    U8 v = lane[(size_t)(g * 16 + j) * stride];
+                    z[j] = zigzag8((U8)(v - prev));
+                    bits |= z[j];
+                    prev = v;
+                }
+
+                int mode = (!bits) ? 0 : (bits < 4) ? 1 : (bits < 16) ? 2 : 3;
+                out[header + (g >> 2)] |= (U8)(mode << ((g & 3) * 2));
+                encodeGroup(out, z, mode);
+            }
+            last[k] = prev;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool FW::decodeVertices(void* vertices, int numVertices, int stride, const U8* data, int numBytes)
+{
+    FW_ASSERT(numVertices >= 0 && stride > 0 && numBytes >= 0);
+    FW_ASSERT(vertices || !numVertices);
+    FW_ASSERT(data || !numBytes);
+
+    // Lanes are decoded into a lane-major block, padded to a multiple of
+    // 16 lanes, and then transposed into the vertices.
+
+    U8* dst = (U8*)vertices;
+    const U8* end = data + numBytes;
+    int blockSize = getVertexBlockSize(stride);
+    int numLanes = (stride + 15) & ~15;
+    Array<U8> lanes(NULL, numLanes * blockSize);
+    Array<U8> last(NULL, stride);
+    memset(lanes.getPtr(), 0, lanes.getNumBytes());
+    memset(last.getPtr(), 0, stride);
+
+    for (int first = 0; first < numVertices; first += blockSize)
+    {
+        int n = min(blockSize, numVertices - first);
+        for (int k = 0; k < stride; k++)
+        {
+            U8* lane = lanes.getPtr(k * blockSize);
+            data = decodeLane(lane, n, last[k], data, end);
+            if (!data)
+                return false;
+            last[k] = lane[n - 1];
+        }
+        transposeBlock(dst + (size_t)first * stride, lanes.getPtr(), n, stride, blockSize);
+    }
+    return (data == end);
+}
+
+//------------------------------------------------------------------------
+
+void FW::encodeIndices(Array<U8>& out, const Vec3i* tris, int numTris)
+{
+    FW_ASSERT(numTris >= 0);
+    FW_ASSERT(tris || !numTris);
+
+    IndexCoder coder;
+    coder.init((numTris) ? tris[0].x : 0);
+    writeVarint(out, (U32)coder.next);
+
+    Array<U8> codes(NULL, numTris);
+    Array<U8> rotations(NULL, (numTris + 3) >> 2);
+    Array<U8> data;
+    memset(rotations.getPtr(), 0, rotations.getNumBytes());
+
+    for (int i = 0; i < numTris; i++)
+    {
+        const Vec3i& t = tris[i];
+
+        // Look for an edge of the triangle, in any rotation, among the
+        // recent edges; the most recent match wins.
+
+        int fe = 0;
+        int rot = 0;
+        for (; fe < INDEX_FIFO_CODED; fe++)
+        {
+            const Vec2i& e = coder.getEdge(fe);
+            for (rot = 0; rot < 3; rot++)
+                if (e.x == t[rot] && e.y == t[(rot + 1) % 3])
+                    break;
+            if (rot < 3)
+                break;
+        }
+
+        if (fe < INDEX_FIFO_CODED)
+        {
+            S32 a = t[rot];
+            S32 b = t[(rot + 1) % 3];
+            S32 c = t[(rot + 2) % 3];
+            codes[i] = (U8)((fe << 4) | encodeVertex(coder, data, c));
+            rotations[i >> 2] |= (U8)(rot << ((i & 3) * 2));
+            coder.pushEdge(c, b);
+            coder.pushEdge(a, c);
+        }
+        else
+        {
+            int extra = data.getSize();
+            data.add(0);
+            int fa = encodeVertex(coder, data, t.x);
+            int fb = encodeVertex(coder, data, t.y);
+            int fc = encodeVertex(coder, data, t.z);
+            codes[i] = (U8)(0xE0 | fa);
+            data[extra] = (U8)((fb << 4) | fc);
+            coder.pushEdge(t.y, t.x);
+            coder.pushEdge(t.z, t.y);
+            coder.pushEdge(t.x, t.z);
+        }
+    }
+
+    out.add(codes);
+    out.add(rotations);
+    out.add(data);
+    memset(out.add(NULL, INDEX_PADDING), 0, INDEX_PADDING);
+}
+
+//------------------------------------------------------------------------
+
+bool FW::decodeIndices(Vec3i* tris, int numTris, const U8* data, int numBytes)
+{
+    FW_ASSERT(numTris >= 0 && numBytes >= 0);
+    FW_ASSERT(tris || !numTris);
+    FW_ASSERT(data || !numBytes);
+
+    // Every triangle reads at most INDEX_PADDING bytes of data, so checking
+    // that much is left before each one bounds all the reads.
+
+    const U8* end = data + numBytes;
+    int numRotations = (numTris + 3) >> 2;
+    if (numBytes < INDEX_PADDING + numTris + numRotations)
+        return false;
+
+    IndexCoder coder;
+    coder.init((S32)readVarint(data));
+    if (end - data < INDEX_PADDING + numTris + numRotations)
+        return false;
+
+    const U8* codes = data;
+    const U8* rotations = codes + numTris;
+    data = rotations + numRotations;
+
+    for (int i = 0; i < numRotations; i++)
+        if (rotations[i] & (rotations[i] >> 1) & 0x55)
+            return false;   // Rotation 3.
+
+    for (int i = 0; i < numTris; i++)
+    {
+        if (data > end - INDEX_PADDING)
+            return false;
+
+        S32 a, b, c;
+        int code = codes[i];
+        if (code < 0xE0)
+        {
+            const Vec2i& e = coder.getEdge(code >> 4);
+            a = e.x;
+            b = e.y;
+            c = decodeVertex(coder, data, code & 15);
+            coder.pushEdge(c, b);
+            coder.pushEdge(a, c);
+        }
+        else
+        {
+            int extra = *data++;
+            a = decodeVertex(coder, data, code & 15);
+            b = decodeVertex(coder, data, extra >> 4);
+            c = decodeVertex(coder, data, extra & 15);
+            coder.pushEdge(b, a);
+            coder.pushEdge(c, b);
+            coder.pushEdge(a, c);
+        }
+
+        static const U8 corners[4][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 0, 1, 2 } };
+        const U8* rot = corners[(rotations[i >> 2] >> ((i & 3) * 2)) & 3];
+        S32* t = &tris[i].x;
+        t[rot[0]] = a;
+        t[rot[1]] = b;
+        t[rot[2]] = c;
+    }
+    return (data == end - INDEX_PADDING);
+}
+
+//------------------------------------------------------------------------
+
+void FW::encodeGroup(Array<U8>& out, const U8* z, int mode)
+{
+    // Value j of a 2-bit group is in byte j % 4, of a 4-bit group in byte
+    // j % 8, so that SSE2 can unpack them with whole-register shifts.
+
+    U8* dst = out.add(NULL, groupBytes(mode));
+    switch (mode)
+    {
+    case 1:
+        memset(dst, 0, 4);
+        for (int j = 0; j < 16; j++)
+            dst[j & 3] |= (U8)(z[j] << ((j >> 2) * 2));
+        break;
+
+    case 2:
+        memset(dst, 0, 8);
+        for (int j = 0; j < 16; j++)
+            dst[j & 7] |= (U8)(z[j] << ((j >> 3) * 4));
+        break;
+
+    case 3:
+        memcpy(dst, z, 16);
+        break;
+
+    default:
+        break;
+    }
+}
+
+//------------------------------------------------------------------------
+
+const U8* FW::decodeLane(U8* lane, int n, U8 last, const U8* data, const U8* end)
+{
+    // Validate the sizes of all groups up front so that the loop below
+    // needs no checks. It writes whole groups; the block has room.
+
+    int numGroups = (n + 15) >> 4;
+    int headerSize = (numGroups + 3) >> 2;
+    if (end - data < headerSize)
+        return NULL;
+
+    const U8* header = data;
+    data += headerSize;
+    int dataSize = 0;
+    for (int i = 0; i < headerSize; i++)
+        for (int j = 0; j < 8; j += 2)
+            dataSize += groupBytes((header[i] >> j) & 3);
+    if (end - data < dataSize)
+        return NULL;
+
+#if FW_CODEC_SIMD
+    const __m128i ones = _mm_set1_epi8(1);
+    const __m128i low2 = _mm_set1_epi8(3);
+    const __m128i low4 = _mm_set1_epi8(15);
+    const __m128i low7 = _mm_set1_epi8(127);
+    __m128i prev = _mm_set1_epi8((char)last);
+
+    for (int g = 0; g < numGroups; g++)
+    {
+        __m128i z;
+        switch ((header[g >> 2] >> ((g & 3) * 2)) & 3)
+        {
+        case 0:
+            z = _mm_setzero_si128();
+            break;
+
+        case 1:
+            {
+                U32 v;
+                memcpy(&v, data, 4);
+                z = _mm_and_si128(_mm_set_epi32((int)(v >> 6), (int)(v >> 4), (int)(v >> 2), (int)v), low2);
+                data += 4;
+            }
+            break;
+
+        case 2:
+            {
+                __m128i v = _mm_loadl_epi64((const __m128i*)data);
+                z = _mm_and_si128(_mm_unpacklo_epi64(v, _mm_srli_epi16(v, 4)), low4);
+                data += 8;
+            }
+            break;
+
+        default:
+            z = _mm_loadu_si128((const __m128i*)data);
+            data += 16;
+            break;
+        }
+
+        // Undo the zigzag, then take the prefix sum in log2(16) steps.
+
+        __m128i d = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(z, 1), low7), _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(z, ones)));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 1));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+        d = _mm_add_epi8(d, prev);
+        _mm_storeu_si128((__m128i*)(lane + g * 16), d);
+
+        // Broadcast byte 15 for the next group.
+
+        prev = _mm_unpackhi_epi8(d, d);
+        prev = _mm_shufflehi_epi16(prev, 0xFF);
+        prev = _mm_shuffle_epi32(prev, 0xFF);
+    }
+
+#else
+    for (int g = 0; g < numGroups; g++)
+    {
+        U8 z[16];
+        switch ((header[g >> 2] >> ((g & 3) * 2)) & 3)
+        {
+        case 0:
+            memset(z, 0, 16);
+            break;
+
+        case 1:
+            for (int j = 0; j < 16; j++)
+                z[j] = (U8)((data[j & 3] >> ((j >> 2) * 2)) & 3);
+            data += 4;
+            break;
+
+        case 2:
+            for (int j = 0; j < 16; j++)
+                z[j] = (U8)((data[j & 7] >> ((j >> 3) * 4)) & 15);
+            data += 8;
+            break;
+
+        default:
+            memcpy(z, data, 16);
+            data += 16;
+            break;
+        }
+
+        for (int j = 0; j < 16; j++)
+        {
+            last = (U8)(last + unzigzag8(z[j]));
+            lane[g * 16 + j] = last;
+        }
+    }
+#endif
+
+    return data;
+}
+
+//------------------------------------------------------------------------
+
+void FW::transposeBlock(U8* vertices, const U8* lanes, int n, int stride, int blockSize)
+{
+    int i = 0;
+
+#if FW_CODEC_SIMD
+    // 16x16 tiles: four rounds of interleaving row r with row r + 8 move
+    // one bit of the column index into the row index each, which amounts
+    // to a transpose. Lanes past the stride are padding and not stored.
+
+    for (; i + 16 <= n; i += 16)
+    {
+        for (int k = 0; k < stride; k += 16)
+        {
+            __m128i r[16];
+            for (int j = 0; j < 16; j++)
+                r[j] = _mm_loadu_si128((const __m128i*)(lanes + (k + j) * blockSize + i));
+
+            for (int round = 0; round < 4; round++)
+            {
+                __m128i t[16];
+                for (int j = 0; j < 8; j++)
+                {
+                    t[j * 2 + 0] = _mm_unpacklo_epi8(r[j], r[j + 8]);
+                    t[j * 2 + 1] = _mm_unpackhi_epi8(r[j], r[j + 8]);
+                }
+                for (int j = 0; j < 16; j++)
+                    r[j] = t[j];
+            }
+
+            U8* dst = vertices + (size_t)i * stride + k;
+            if (k + 16 <= stride)
+                for (int j = 0; j < 16; j++)
+                    _mm_storeu_si128((__m128i*)(dst + j * stride), r[j]);
+            else
+            {
+                U8 tmp[16];
+                for (int j = 0; j < 16; j++)
+                {
+                    _mm_storeu_si128((__m128i*)tmp, r[j]);
+                    memcpy(dst + j * stride, tmp, stride - k);
+                }
+            }
+        }
+    }
+#endif
+
+    for (; i < n; i++)
+        for (int k = 0; k < stride; k++)
+            vertices[(size_t)i * stride + k] = lanes[k * blockSize + i];
+}
+
+//------------------------------------------------------------------------
+
+void FW::writeVarint(Array<U8>& out, U32 v)
+{
+    while (v >= 0x80)
+    {
+        out.add((U8)(v | 0x80));
+        v >>= 7;
+    }
+    out.add((U8)v);
+}
+
+//------------------------------------------------------------------------
+
+U32 FW::readVarint(const U8*& data)
+{
+    // At most 5 bytes, even if the data says otherwise.
+
+    U32 v = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        U8 b = *data++;
+        v |= (U32)(b & 0x7F) << shift;
+        if (b < 0x80)
+            break;
+    }
+    return v;
+}
+
+//------------------------------------------------------------------------
+
+int FW::encodeVertex(IndexCoder& coder, Array<U8>& data, S32 v)
+{
+    // 0 = next unused index, 1-14 = FIFO position + 1, 15 = explicit.
+
+    if (v == coder.next)
+    {
+        coder.next++;
+        coder.pushVertex(v);
+        return 0;
+    }
+
+    for (int fv = 0; fv < INDEX_FIFO_CODED; fv++)
+        if (coder.getVertex(fv) == v)
+            return fv + 1;
+
+    U32 d = (U32)v - coder.last;
+    writeVarint(data, (d << 1) ^ (U32)((S32)d >> 31));
+    coder.last = (U32)v;
+    coder.pushVertex(v);
+    return 15;
+}
+
+//------------------------------------------------------------------------
+
+S32 FW::decodeVertex(IndexCoder& coder, const U8*& data, int f)
+{
+    // Codes 0-14 are unpredictable, so they are decoded without branches;
+    // the masks keep compilers from turning the select back into one.
+    // The slot at vertexOfs is always written; it holds the oldest entry,
+    // which no code refers to, unless the vertex is pushed.
+
+    if (f == 15)
+    {
+        U32 z = readVarint(data);
+        coder.last += (z >> 1) ^ (U32)-(S32)(z & 1);
+        coder.pushVertex((S32)coder.last);
+        return (S32)coder.last;
+    }
+
+    S32 isNext = (f == 0) ? 1 : 0;
+    S32 v = (coder.next & -isNext) | (coder.vertices[(coder.vertexOfs - f) & (INDEX_FIFO_SIZE - 1)] & (isNext - 1));
+    coder.vertices[coder.vertexOfs] = v;
+    coder.vertexOfs = (coder.vertexOfs + isNext) & (INDEX_FIFO_SIZE - 1);
+    coder.next += isNext;
+    return v;
+}
+
+//------------------------------------------------------------------------
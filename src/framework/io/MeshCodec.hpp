@@ -0,0 +1,123 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include "base/Math.hpp"
+#include "base/Array.hpp"
+
+namespace FW
+{
+//------------------------------------------------------------------------
+// Lossless codecs for vertex and index buffers, used by the binary mesh
+// format. Both favor decoding speed over ratio: they decode with simple
+// table-free loops and write each output byte once.
+//
+// Vertex codec: vertices are coded in blocks (see getVertexBlockSize()).
+// Within a block, byte k of every vertex forms a lane; each byte is
+// replaced by its difference to the same byte of the previous vertex,
+// zigzag-mapped so that small differences of either sign become small
+// values. Each group of 16 values in a lane is then stored with the
+// fewest bits that hold all of them: 0, 2, 4 or 8, chosen by a 2-bit code
+// in a header of the lane. Bytes that rarely change, such as the sign and
+// exponent of floats, cost little; noisy mantissa bytes are stored as is.
+//
+// Index codec: triangles that share an edge with one of the 16 most
+// recently coded edges store that edge's position and the third vertex in
+// one byte. Vertices are coded as the next unused index (in order of
+// first use), a position in a FIFO of 16 recent vertices, or an explicit
+// difference to the last explicit index. A 2-bit rotation per triangle
+// keeps the corners where they were, so the triangles decode exactly.
+//
+// The decoders return false on malformed data. They never read or write
+// out of bounds, but may have written to the output by then.
+//------------------------------------------------------------------------
+
+int     getVertexBlockSize      (int stride);                               // Vertices per block, a multiple of 16.
+
+void    encodeVertices          (Array<U8>& out, const void* vertices, int numVertices, int stride);   // Appends to 'out'.
+bool    decodeVertices          (void* vertices, int numVertices, int stride, const U8* data, int numBytes);
+
+void    encodeIndices           (Array<U8>& out, const Vec3i* tris, int numTris);                       // Appends to 'out'.
+bool    decodeIndices           (Vec3i* tris, int numTris, const U8* data, int numBytes);
+
+//------------------------------------------------------------------------
+/*
+
+Coded data
+----------
+
+- sizes are in bytes; varints are 7 bits per byte, low first, with the
+  high bit set on all but the last byte; signed values are zigzag-mapped
+  (0, -1, 1, -2, ... become 0, 1, 2, 3, ...)
+
+Vertices
+    0       ?       struct  array of Block (ceil(numVertices / blockSize))
+    ?
+
+Block (n = min(blockSize, vertices left))
+    0       ?       struct  array of Lane (stride)
+    ?
+
+Lane (byte k of the n vertices, groups of 16)
+    0       ?       bytes   modes (2 bits per group, 4 groups per byte, low first)
+    ?       ?       bytes   array of Group (ceil(n / 16))
+    ?
+
+Group (16 values; those past n are 0)
+    mode 0: 0 bytes, every value is 0
+    mode 1: 4 bytes, value j in bits 2 * (j / 4) of byte j % 4
+    mode 2: 8 bytes, value j in bits 4 * (j / 8) of byte j % 8
+    mode 3: 16 bytes, value j in byte j
+    - a value is the zigzag-mapped difference, modulo 256, between the
+      byte and the same byte of the previous vertex (0 for the first one)
+
+Indices
+    0       ?       varint  first (starts 'next' and 'last')
+    ?       n       bytes   codes (numTris)
+    ?       ?       bytes   rotations (2 bits per triangle, 4 per byte, low first)
+    ?       ?       bytes   data (read in order by the codes)
+    ?       16      bytes   padding (zero)
+    ?
+
+Triangle code (the triangle decodes as (a, b, c), rotated to the right
+rotation times)
+    0x00-0xDF: (a, b) = edge FIFO entry code >> 4 (0 = newest),
+               c = vertex code & 15
+    0xE0-0xEF: a data byte comes first; a = vertex code & 15, b = vertex
+               of the high 4 bits of the byte, c = vertex of the low 4 bits
+    - afterwards, the edges (b, a) unless it came from the FIFO, (c, b)
+      and (a, c) enter the edge FIFO, in this order
+
+Vertex code
+    0:      'next', which then increments
+    1-14:   vertex FIFO entry code - 1 (0 = newest)
+    15:     'last' plus a signed varint from data; becomes 'last'
+    - the vertices of codes 0 and 15 enter the vertex FIFO
+
+*/
+//------------------------------------------------------------------------
+}
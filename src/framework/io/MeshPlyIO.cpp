@@ -0,0 +1,626 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io/MeshPlyIO.hpp"
+#include "3d/Mesh.hpp"
+#include "3d/Triangulator.hpp"
+#include "io/Stream.hpp"
+
+using namespace FW;
+
+//------------------------------------------------------------------------
+
+#define PLY_BLOCK_SIZE  (64 << 10)  // Bytes decoded at a time for fixed-size elements.
+
+//------------------------------------------------------------------------
+
+namespace FW
+{
+
+enum PlyType
+{
+    PlyType_Int8 = 0,
+    PlyType_UInt8,
+    PlyType_Int16,
+    PlyType_UInt16,
+    PlyType_Int32,
+    PlyType_UInt32,
+    PlyType_Float32,
+    PlyType_Float64,
+
+    PlyType_Max
+};
+
+struct PlyProperty
+{
+    String                  name;
+    PlyType                 type;
+    PlyType                 countType;      // PlyType_Max if not a list.
+    S32                     attrib;         // -1 if skipped.
+    S32                     component;
+    S32                     offset;         // Byte offset within a fixed-size record.
+};
+
+struct PlyElement
+{
+    String                  name;
+    S32                     count;
+    Array<PlyProperty>      props;
+    S32                     recordSize;     // 0 if the element contains lists.
+};
+
+struct PlyVertexProp
+{
+    const char*             name;
+    MeshBase::AttribType    type;
+    S32                     component;
+};
+
+static const char* const    c_plyTypeNames[]    = { "char", "uchar", "short", "ushort", "int", "uint", "float", "double" };
+static const char* const    c_plyTypeNames2[]   = { "int8", "uint8", "int16", "uint16", "int32", "uint32", "float32", "float64" };
+static const S32            c_plyTypeSizes[]    = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+static const PlyVertexProp  c_plyVertexProps[] =
+{
+    { "x",          MeshBase::AttribType_Position,  0 },
+    { "y",          MeshBase::AttribType_Position,  1 },
+    { "z",          MeshBase::AttribType_Position,  2 },
+    { "w",          MeshBase::AttribType_Position,  3 },
+    { "nx",         MeshBase::AttribType_Normal,    0 },
+    { "ny",         MeshBase::AttribType_Normal,    1 },
+    { "nz",         MeshBase::AttribType_Normal,    2 },
+    { "red",        MeshBase::AttribType_Color,     0 },
+    { "green",      MeshBase::AttribType_Color,     1 },
+    { "blue",       MeshBase::AttribType_Color,     2 },
+    { "alpha",      MeshBase::AttribType_Color,     3 },
+    { "u",          MeshBase::AttribType_TexCoord,  0 },
+    { "v",          MeshBase::AttribType_TexCoord,  1 },
+    { "s",          MeshBase::AttribType_TexCoord,  0 },
+    { "t",          MeshBase::AttribType_TexCoord,  1 },
+    { "texture_u",  MeshBase::AttribType_TexCoord,  0 },
+    { "texture_v",  MeshBase::AttribType_TexCoord,  1 },
+    { "ao_min",     MeshBase::AttribType_AORadius,  0 },
+    { "ao_max",     MeshBase::AttribType_AORadius,  1 },
+};
+
+static bool     isLittleEndianHost  (void);
+static bool     parsePlyType        (const char*& ptr, PlyType& type);
+static F64      decodePlyValue      (const U8* ptr, PlyType type, bool swap);
+static bool     readPlyValue        (InputStream& stream, PlyType type, bool swap, F64& value);
+static bool     readPlyValue        (BufferedInputStream& stream, const char*& ptr, PlyType type, F64& value);
+static void     storeAttrib         (U8* ptr, MeshBase::AttribFormat format, F64 value);
+static void     addPolygon          (Array<Vec3i>& tris, const Array<S32>& poly, const MeshBase& mesh, Triangulator& triangulator, Array<Vec3f>& corners);
+static void     setupVertexAttribs  (MeshBase& mesh, PlyElement& elem);
+
+}
+
+//------------------------------------------------------------------------
+
+bool FW::isLittleEndianHost(void)
+{
+    U32 v = 1;
+    return (*(U8*)&v == 1);
+}
+
+//------------------------------------------------------------------------
+
+bool FW::parsePlyType(const char*& ptr, PlyType& type)
+{
+    for (int i = 0; i < PlyType_Max; i++)
+    {
+        const char* tmp = ptr;
+        if ((parseLiteral(tmp, c_plyTypeNames[i]) || parseLiteral(tmp, c_plyTypeNames2[i])) && (*tmp == ' ' || !*tmp))
+        {
+            ptr = tmp;
+            type = (PlyType)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------
+
+F64 FW::decodePlyValue(const U8* ptr, PlyType type, bool swap)
+{
+    U8 tmp[8];
+    if (swap)
+    {
+        int size = c_plyTypeSizes[type];
+        for (int i = 0; i < size; i++)
+            tmp[i] = ptr[size - 1 - i];
+        ptr = tmp;
+    }
+
+    switch (type)
+    {
+    case PlyType_Int8:      return *(const S8*)ptr;
+    case PlyType_UInt8:     return *(const U8*)ptr;
+    case PlyType_Int16:     return *(const S16*)ptr;
+    case PlyType_UInt16:    return *(const U16*)ptr;
+    case PlyType_Int32:     return *(const S32*)ptr;
+    case PlyType_UInt32:    return *(const U32*)ptr;
+    case PlyType_Float32:   return *(const F32*)ptr;
+    case PlyType_Float64:   return *(const F64*)ptr;
+    default:                FW_ASSERT(false); return 0.0;
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool FW::readPlyValue(InputStream& stream, PlyType type, bool swap, F64& value)
+{
+    U8 tmp[8];
+    stream.readFully(tmp, c_plyTypeSizes[type]);
+    value = decodePlyValue(tmp, type, swap);
+    return !hasError();
+}
+
+//------------------------------------------------------------------------
+
+bool FW::readPlyValue(BufferedInputStream& stream, const char*& ptr, PlyType type, F64& value)
+{
+    // Values may continue on the next line.
+
+    for (;;)
+    {
+        parseSpace(ptr);
+        if (*ptr)
+            break;
+        ptr = stream.readLine(false, true);
+        if (!ptr)
+        {
+            ptr = "";
+            return false;
+        }
+    }
+
+    if (type == PlyType_Float32 || type == PlyType_Float64)
+    {
+        F32 v;
+        if (!parseFloat(ptr, v))
+            return false;
+        value = v;
+    }
+    else
+    {
+        S64 v;
+        if (!parseInt(ptr, v))
+            return false;
+        value = (F64)v;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+void FW::storeAttrib(U8* ptr, MeshBase::AttribFormat format, F64 value)
+{
+    switch (format)
+    {
+    case MeshBase::AttribFormat_U8:     *ptr = (U8)value; break;
+    case MeshBase::AttribFormat_S32:    *(S32*)ptr = (S32)value; break;
+    case MeshBase::AttribFormat_F32:    *(F32*)ptr = (F32)value; break;
+    default:                            FW_ASSERT(false); break;
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::addPolygon(Array<Vec3i>& tris, const Array<S32>& poly, const MeshBase& mesh, Triangulator& triangulator, Array<Vec3f>& corners)
+{
+    for (int i = 0; i < poly.getSize(); i++)
+    {
+        if (poly[i] < 0 || poly[i] >= mesh.numVertices())
+        {
+            setError("Corrupt PLY face data!");
+            return;
+        }
+    }
+
+    // Polygons may be concave => triangulate in their best-fit plane.
+
+    int posAttrib = mesh.findAttrib(MeshBase::AttribType_Position);
+    if (poly.getSize() <= 3 || posAttrib == -1)
+    {
+        for (int i = 2; i < poly.getSize(); i++)
+            tris.add(Vec3i(poly[0], poly[i - 1], poly[i]));
+        return;
+    }
+
+    corners.resize(poly.getSize());
+    for (int i = 0; i < poly.getSize(); i++)
+        corners[i] = mesh.getVertexAttrib(poly[i], posAttrib).getXYZ();
+    triangulator.triangulate(tris, corners.getPtr(), poly.getPtr(), poly.getSize());
+}
+
+//------------------------------------------------------------------------
+
+void FW::setupVertexAttribs(MeshBase& mesh, PlyElement& elem)
+{
+    // Map property names to attribute components.
+
+    Array<MeshBase::AttribType> types;
+    Array<S32> lengths;
+    Array<U32> formatMasks;
+
+    for (int i = 0; i < elem.props.getSize(); i++)
+    {
+        PlyProperty& prop = elem.props[i];
+        prop.attrib = -1;
+        if (prop.countType != PlyType_Max)
+            continue;
+
+        for (int j = 0; j < (int)FW_ARRAY_SIZE(c_plyVertexProps); j++)
+        {
+            const PlyVertexProp& vp = c_plyVertexProps[j];
+            if (prop.name != vp.name)
+                continue;
+
+            int idx = types.indexOf(vp.type);
+            if (idx == -1)
+            {
+                idx = types.getSize();
+                types.add(vp.type);
+                lengths.add(0);
+                formatMasks.add(0);
+            }
+
+            prop.attrib = idx;
+            prop.component = vp.component;
+            lengths[idx] = max(lengths[idx], vp.component + 1);
+            formatMasks[idx] |= 1 << prop.type;
+            break;
+        }
+    }
+
+    // Choose formats.
+
+    U32 intMask = (1 << PlyType_Int8) | (1 << PlyType_UInt8) | (1 << PlyType_Int16) | (1 << PlyType_UInt16) | (1 << PlyType_Int32) | (1 << PlyType_UInt32);
+    for (int i = 0; i < types.getSize(); i++)
+    {
+        MeshBase::AttribFormat format = MeshBase::AttribFormat_F32;
+        if (formatMasks[i] == (1 << PlyType_UInt8))
+            format = MeshBase::AttribFormat_U8;
+        else if ((formatMasks[i] & ~intMask) == 0)
+            format = MeshBase::AttribFormat_S32;
+        mesh.addAttrib(types[i], format, lengths[i]);
+    }
+}
+
+//------------------------------------------------------------------------
+
+MeshBase* FW::importPlyMesh(BufferedInputStream& stream)
+{
+    MeshBase* mesh = new MeshBase;
+
+    // Header.
+
+    const char* line = stream.readLine(false, true);
+    if (!line || String(line) != "ply")
+        setError("Not a PLY file!");
+
+    int format = -1; // 0 = ascii, 1 = binary_little_endian, 2 = binary_big_endian
+    Array<PlyElement> elems;
+
+    while (!hasError())
+    {
+        line = stream.readLine(false, true);
+        if (!line)
+        {
+            setError("Unexpected end of PLY header!");
+            break;
+        }
+
+        const char* ptr = line;
+        parseSpace(ptr);
+
+        if (parseLiteral(ptr, "end_header"))
+            break;
+        else if (!*ptr || parseLiteral(ptr, "comment") || parseLiteral(ptr, "obj_info"))
+        {
+        }
+        else if (parseLiteral(ptr, "format ") && parseSpace(ptr))
+        {
+            if (parseLiteral(ptr, "ascii "))
+                format = 0;
+            else if (parseLiteral(ptr, "binary_little_endian "))
+                format = 1;
+            else if (parseLiteral(ptr, "binary_big_endian "))
+                format = 2;
+            else
+                setError("Unsupported PLY format: '%s'!", line);
+        }
+        else if (parseLiteral(ptr, "element ") && parseSpace(ptr))
+        {
+            PlyElement& elem = elems.add();
+            while (*ptr && *ptr != ' ')
+                elem.name.append(*ptr++);
+            parseSpace(ptr);
+            if (!elem.name.getLength() || !parseInt(ptr, elem.count) || elem.count < 0)
+                setError("Invalid PLY element: '%s'!", line);
+        }
+        else if (parseLiteral(ptr, "property ") && parseSpace(ptr))
+        {
+            if (!elems.getSize())
+            {
+                setError("PLY property without element: '%s'!", line);
+                break;
+            }
+
+            PlyProperty& prop = elems.getLast().props.add();
+            prop.countType = PlyType_Max;
+            prop.attrib = -1;
+            prop.component = 0;
+            prop.offset = 0;
+
+            bool valid = true;
+            if (parseLiteral(ptr, "list ") && parseSpace(ptr))
+                valid = (parsePlyType(ptr, prop.countType) && parseSpace(ptr));
+            valid = (valid && parsePlyType(ptr, prop.type) && parseSpace(ptr) && *ptr);
+            if (!valid)
+                setError("Invalid PLY property: '%s'!", line);
+            prop.name = ptr;
+        }
+        else
+            setError("Invalid line in PLY header: '%s'!", line);
+    }
+
+    if (!hasError() && format == -1)
+        setError("PLY format not specified!");
+
+    // Compute record layouts and set up vertex attributes.
+
+    int vertexElem = -1;
+    int faceElem = -1;
+
+    for (int i = 0; i < elems.getSize() && !hasError(); i++)
+    {
+        PlyElement& elem = elems[i];
+        elem.recordSize = 0;
+        for (int j = 0; j < elem.props.getSize(); j++)
+        {
+            PlyProperty& prop = elem.props[j];
+            prop.offset = elem.recordSize;
+            if (prop.countType != PlyType_Max)
+            {
+                elem.recordSize = -1;
+                break;
+            }
+            elem.recordSize += c_plyTypeSizes[prop.type];
+        }
+        elem.recordSize = max(elem.recordSize, 0);
+
+        if (elem.name == "vertex" && vertexElem == -1)
+        {
+            vertexElem = i;
+            setupVertexAttribs(*mesh, elem);
+            mesh->resetVertices(elem.count);
+            memset(mesh->getMutableVertexPtr(), 0, elem.count * mesh->vertexStride());
+        }
+        else if (elem.name == "face" && faceElem == -1)
+            faceElem = i;
+    }
+
+    if (faceElem != -1)
+        mesh->addSubmesh();
+
+    // Element data.
+
+    bool binary = (format != 0);
+    bool swap = (binary && (format == 1) != isLittleEndianHost());
+    U8* vertexPtr = mesh->getMutableVertexPtr();
+    int stride = mesh->vertexStride();
+    Array<U8> block;
+    Array<S32> poly;
+    Array<Vec3f> corners;
+    Triangulator triangulator;
+
+    for (int i = 0; i < elems.getSize() && !hasError(); i++)
+    {
+        PlyElement& elem = elems[i];
+        Array<Vec3i>* tris = (i == faceElem) ? &mesh->mutableIndices(0) : NULL;
+
+        // Vertex layout identical to the file => read directly into the mesh.
+
+        if (i == vertexElem && binary && !swap && elem.recordSize == stride)
+        {
+            bool direct = true;
+            for (int j = 0; j < elem.props.getSize() && direct; j++)
+            {
+                const PlyProperty& prop = elem.props[j];
+                if (prop.attrib == -1)
+                {
+                    direct = false;
+                    break;
+                }
+                const MeshBase::AttribSpec& spec = mesh->attribSpec(prop.attrib);
+                int compSize = spec.bytes / spec.length;
+                PlyType exact = (spec.format == MeshBase::AttribFormat_U8) ? PlyType_UInt8 : (spec.format == MeshBase::AttribFormat_S32) ? PlyType_Int32 : PlyType_Float32;
+                direct = (prop.type == exact && prop.offset == spec.offset + prop.component * compSize);
+            }
+
+            if (direct)
+            {
+                stream.readFully(vertexPtr, elem.count * elem.recordSize);
+                continue;
+            }
+        }
+
+        // Binary fixed-size records => decode a block at a time.
+
+        if (binary && elem.recordSize)
+        {
+            int recordsPerBlock = max(PLY_BLOCK_SIZE / elem.recordSize, 1);
+            for (int first = 0; first < elem.count && !hasError(); first += recordsPerBlock)
+            {
+                int num = min(recordsPerBlock, elem.count - first);
+                block.reset(num * elem.recordSize);
+                stream.readFully(block.getPtr(), block.getSize());
+                if (i != vertexElem)
+                    continue;
+
+                for (int j = 0; j < num; j++)
+                {
+                    const U8* src = block.getPtr(j * elem.recordSize);
+                    U8* dst = vertexPtr + (first + j) * stride;
+                    for (int k = 0; k < elem.props.getSize(); k++)
+                    {
+                        const PlyProperty& prop = elem.props[k];
+                        if (prop.attrib == -1)
+                            continue;
+                        const MeshBase::AttribSpec& spec = mesh->attribSpec(prop.attrib);
+                        storeAttrib(dst + spec.offset + prop.component * (spec.bytes / spec.length), spec.format, decodePlyValue(src + prop.offset, prop.type, swap));
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Generic path: one value at a time.
+
+        for (int j = 0; j < elem.count && !hasError(); j++)
+        {
+            const char* ptr = "";
+            poly.clear();
+
+            for (int k = 0; k < elem.props.getSize() && !hasError(); k++)
+            {
+                const PlyProperty& prop = elem.props[k];
+                F64 value;
+                int num = 1;
+
+                if (prop.countType != PlyType_Max)
+                {
+                    bool ok = (binary) ? readPlyValue(stream, prop.countType, swap, value) : readPlyValue(stream, ptr, prop.countType, value);
+                    if (!ok || value < 0.0)
+                    {
+                        setError("Corrupt PLY data!");
+                        break;
+                    }
+                    num = (int)value;
+                }
+
+                bool isPoly = (tris && prop.countType != PlyType_Max && (prop.name == "vertex_indices" || prop.name == "vertex_index"));
+                for (int l = 0; l < num; l++)
+                {
+                    bool ok = (binary) ? readPlyValue(stream, prop.type, swap, value) : readPlyValue(stream, ptr, prop.type, value);
+                    if (!ok)
+                    {
+                        setError("Corrupt PLY data!");
+                        break;
+                    }
+
+                    if (isPoly)
+                        poly.add((S32)value);
+                    else if (i == vertexElem && prop.attrib != -1)
+                    {
+                        const MeshBase::AttribSpec& spec = mesh->attribSpec(prop.attrib);
+                        storeAttrib(vertexPtr + j * stride + spec.offset + prop.component * (spec.bytes / spec.length), spec.format, value);
+                    }
+                }
+            }
+
+            if (tris && !hasError())
+                addPolygon(*tris, poly, *mesh, triangulator, corners);
+        }
+    }
+
+    // Handle errors.
+
+    if (hasError())
+    {
+        delete mesh;
+        return NULL;
+    }
+    return mesh;
+}
+
+//------------------------------------------------------------------------
+
+void FW::exportPlyMesh(BufferedOutputStream& stream, const MeshBase* mesh)
+{
+    FW_ASSERT(mesh);
+    FW_ASSERT(isLittleEndianHost());
+
+    // Header. Every attribute component becomes one property, so the
+    // vertex records are laid out exactly like the mesh vertices.
+
+    stream.writef("ply\n");
+    stream.writef("format binary_little_endian 1.0\n");
+    stream.writef("element vertex %d\n", mesh->numVertices());
+
+    for (int i = 0; i < mesh->numAttribs(); i++)
+    {
+        const MeshBase::AttribSpec& spec = mesh->attribSpec(i);
+        const char* typeName =
+            (spec.format == MeshBase::AttribFormat_U8) ? "uchar" :
+            (spec.format == MeshBase::AttribFormat_S32) ? "int" : "float";
+
+        for (int j = 0; j < spec.length; j++)
+        {
+            const char* name = NULL;
+            for (int k = 0; k < (int)FW_ARRAY_SIZE(c_plyVertexProps) && !name; k++)
+                if (c_plyVertexProps[k].type == spec.type && c_plyVertexProps[k].component == j)
+                    name = c_plyVertexProps[k].name;
+
+            if (name)
+                stream.writef("property %s %s\n", typeName, name);
+            else
+                stream.writef("property %s attrib%d_%d\n", typeName, i, j);
+        }
+    }
+
+    stream.writef("element face %d\n", mesh->numTriangles());
+    stream.writef("property list uchar int vertex_indices\n");
+    stream.writef("end_header\n");
+
+    // Vertices.
+
+    stream.write(mesh->getVertexPtr(), mesh->numVertices() * mesh->vertexStride());
+
+    // Faces.
+
+    const int faceBytes = 1 + 3 * sizeof(S32);
+    Array<U8> block;
+
+    for (int i = 0; i < mesh->numSubmeshes(); i++)
+    {
+        const Array<Vec3i>& inds = mesh->indices(i);
+        block.reset(inds.getSize() * faceBytes);
+        U8* ptr = block.getPtr();
+        for (int j = 0; j < inds.getSize(); j++)
+        {
+            *ptr = 3;
+            memcpy(ptr + 1, &inds[j], 3 * sizeof(S32));
+            ptr += faceBytes;
+        }
+        stream.write(block.getPtr(), block.getSize());
+    }
+}
+
+//------------------------------------------------------------------------
@@ -0,0 +1,71 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include "base/Defs.hpp"
+
+namespace FW
+{
+//------------------------------------------------------------------------
+
+class MeshBase;
+class BufferedInputStream;
+class BufferedOutputStream;
+
+//------------------------------------------------------------------------
+
+MeshBase*   importPlyMesh       (BufferedInputStream& stream);
+void        exportPlyMesh       (BufferedOutputStream& stream, const MeshBase* mesh);
+
+//------------------------------------------------------------------------
+/*
+
+Stanford PLY
+------------
+
+- ascii, binary_little_endian and binary_big_endian are supported on import
+- export always writes binary_little_endian
+- all scalar types (char/int8 ... double/float64) and list properties are accepted
+- polygons are triangulated, all faces go to a single submesh
+
+Vertex properties are mapped to mesh attributes by name:
+
+    x y z w                 AttribType_Position
+    nx ny nz                AttribType_Normal
+    red green blue alpha    AttribType_Color
+    u v / s t               AttribType_TexCoord
+    ao_min ao_max           AttribType_AORadius
+
+Unknown vertex properties are skipped. An attribute is U8 if all of its
+properties are uchar, S32 if they are all integers, and F32 otherwise.
+If the resulting vertex layout matches the file byte-for-byte (e.g. float
+x y z nx ny nz in a little-endian file), the whole vertex block is read
+straight into mesh vertex storage.
+
+*/
+//------------------------------------------------------------------------
+}
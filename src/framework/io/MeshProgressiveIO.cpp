@@ -0,0 +1,401 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "io/MeshProgressiveIO.hpp"
+#include "io/MeshBinaryIO.hpp"
+#include "3d/Mesh.hpp"
+#include "3d/QuadricSimplifier.hpp"
+
+using namespace FW;
+
+//------------------------------------------------------------------------
+
+#define PM_BASE_DIVISOR     256             // Of the triangles in the base mesh, by default...
+#define PM_MIN_BASE         1024            // ...within these limits.
+#define PM_MAX_BASE         65536
+#define PM_SPLITS_PER_READ  64              // By refine() before applying them.
+
+//------------------------------------------------------------------------
+
+namespace FW
+{
+
+static int      introduceVertex     (int v, Array<S32>& vertexId, Array<S32>& order);
+
+}
+
+//------------------------------------------------------------------------
+
+ProgressiveMeshReader::ProgressiveMeshReader(InputStream& stream)
+:   m_stream        (stream),
+    m_mesh          (NULL),
+    m_numSplits     (0),
+    m_numApplied    (0),
+    m_finalNumVertices  (0),
+    m_finalNumTriangles (0),
+    m_numSubmeshes  (0),
+    m_stride        (0),
+    m_numRead       (0),
+    m_numReadVertices   (0),
+    m_numReadTriangles  (0)
+{
+    char formatID[9];
+    stream.readFully(formatID, 8);
+    formatID[8] = '\0';
+    if (String(formatID) != "PrgMesh ")
+        setError("Not a progressive mesh file!");
+
+    S32 version;
+    stream >> version >> m_finalNumVertices >> m_finalNumTriangles >> m_numSplits;
+    if (!hasError() && version != 1)
+        setError("Unsupported progressive mesh version!");
+    if (!hasError() && (m_finalNumVertices < 0 || m_finalNumTriangles < 0 || m_numSplits < 0))
+        setError("Corrupt progressive mesh data!");
+    if (hasError())
+        return;
+
+    m_mesh = importBinaryMesh(stream);
+    if (!m_mesh)
+        return;
+
+    m_faces.setCapacity(m_finalNumTriangles);
+    for (int i = 0; i < m_mesh->numSubmeshes(); i++)
+        for (int j = 0; j < m_mesh->indices(i).getSize(); j++)
+            m_faces.add(Vec2i(i, j));
+
+    m_numSubmeshes = m_mesh->numSubmeshes();
+    m_stride = m_mesh->vertexStride();
+    m_numReadVertices = m_mesh->numVertices();
+    m_numReadTriangles = m_faces.getSize();
+}
+
+//------------------------------------------------------------------------
+
+ProgressiveMeshReader::~ProgressiveMeshReader(void)
+{
+    delete m_mesh;
+}
+
+//------------------------------------------------------------------------
+
+const Vec3i& ProgressiveMeshReader::getTriangle(int idx) const
+{
+    const Vec2i& face = m_faces[idx];
+    return m_mesh->indices(face.x)[face.y];
+}
+
+//------------------------------------------------------------------------
+
+int ProgressiveMeshReader::refine(int maxSplits, Array<S32>* movedCorners)
+{
+    int num = 0;
+    while (num < maxSplits)
+    {
+        m_buffer.clear();
+        int numRead = readSplits(m_buffer, min(maxSplits - num, PM_SPLITS_PER_READ));
+        if (!numRead)
+            break;
+        applySplits(m_buffer.getPtr(), m_buffer.getPtr() + m_buffer.getSize(), numRead, movedCorners);
+        num += numRead;
+    }
+    return num;
+}
+
+//------------------------------------------------------------------------
+
+int ProgressiveMeshReader::readSplits(Array<U8>& splits, int maxSplits)
+{
+    if (!m_mesh || hasError())
+        return 0;
+
+    int num = 0;
+    for (; num < maxSplits && m_numRead < m_numSplits; num++)
+    {
+        // Read the whole split, then check every index against what the
+        // splits read so far add up to.
+
+        S32 header[3];
+        m_stream.readFully(header, sizeof(header));
+        if (hasError())
+            break;
+        if (header[0] < 0 || header[1] < 0 || header[2] < 0 ||
+            (S64)splits.getSize() + (S64)sizeof(header) + (S64)header[0] * m_stride + (S64)header[1] * 8 + (S64)header[2] * 16 > FW_S32_MAX)
+        {
+            setError("Corrupt progressive mesh data!");
+            break;
+        }
+
+        int vertexBytes = header[0] * m_stride;
+        int start = splits.getSize();
+        U8* split = splits.add(NULL, (int)sizeof(header) + vertexBytes + header[1] * 8 + header[2] * 16);
+        memcpy(split, header, sizeof(header));
+        m_stream.readFully(split + sizeof(header), splits.getSize() - start - (int)sizeof(header));
+        if (hasError())
+        {
+            splits.resize(start);
+            break;
+        }
+
+        int numVertices = m_numReadVertices + header[0];
+        const S32* corners = (const S32*)(split + sizeof(header) + vertexBytes);
+        const S32* tris = corners + header[1] * 2;
+        bool ok = true;
+        for (int i = 0; i < header[1] && ok; i++)
+            ok = (corners[i * 2] >= 0 && corners[i * 2] < m_numReadTriangles * 3 && corners[i * 2 + 1] >= 0 && corners[i * 2 + 1] < numVertices);
+        for (int i = 0; i < header[2] && ok; i++)
+            ok = (tris[i * 4] >= 0 && tris[i * 4] < m_numSubmeshes &&
+                tris[i * 4 + 1] >= 0 && tris[i * 4 + 1] < numVertices &&
+                tris[i * 4 + 2] >= 0 && tris[i * 4 + 2] < numVertices &&
+                tris[i * 4 + 3] >= 0 && tris[i * 4 + 3] < numVertices);
+        if (!ok)
+        {
+            splits.resize(start);
+            setError("Corrupt progressive mesh data!");
+            break;
+        }
+
+        m_numReadVertices = numVertices;
+        m_numReadTriangles += header[2];
+        m_numRead++;
+    }
+    return num;
+}
+
+//------------------------------------------------------------------------
+
+const U8* ProgressiveMeshReader::applySplits(const U8* splits, const U8* end, int maxSplits, Array<S32>* movedCorners)
+{
+    FW_ASSERT(m_mesh && splits <= end);
+    int numSubmeshes = m_mesh->numSubmeshes();
+    Array<Array<Vec3i>*> indices(NULL, numSubmeshes);
+    for (int i = 0; i < numSubmeshes; i++)
+        indices[i] = &m_mesh->mutableIndices(i);
+
+    for (int num = 0; num < maxSplits && splits < end; num++)
+    {
+        FW_ASSERT(m_numApplied < m_numSplits);
+        const S32* header = (const S32*)splits;
+        int vertexBytes = header[0] * m_stride;
+        const S32* corners = (const S32*)(splits + sizeof(S32) * 3 + vertexBytes);
+        const S32* tris = corners + header[1] * 2;
+
+        m_mesh->addVertices(splits + sizeof(S32) * 3, header[0]);
+        for (int i = 0; i < header[1]; i++)
+        {
+            const Vec2i& face = m_faces[corners[i * 2] / 3];
+            (*indices[face.x])[face.y][corners[i * 2] % 3] = corners[i * 2 + 1];
+            if (movedCorners)
+                movedCorners->add(corners[i * 2]);
+        }
+        for (int i = 0; i < header[2]; i++)
+        {
+            const S32* t = tris + i * 4;
+            m_faces.add(Vec2i(t[0], indices[t[0]]->getSize()));
+            indices[t[0]]->add(Vec3i(t[1], t[2], t[3]));
+        }
+        m_numApplied++;
+        splits = (const U8*)(tris + header[2] * 4);
+    }
+    return splits;
+}
+
+//------------------------------------------------------------------------
+
+MeshBase* FW::importProgressiveMesh(InputStream& stream)
+{
+    ProgressiveMeshReader reader(stream);
+    reader.refine(reader.getNumSplits());
+    if (hasError())
+        return NULL;
+    return reader.takeMesh();
+}
+
+//------------------------------------------------------------------------
+
+void FW::exportProgressiveMesh(OutputStream& stream, const MeshBase* mesh, int baseTriangles)
+{
+    FW_ASSERT(mesh);
+    int numSubmeshes = mesh->numSubmeshes();
+    int stride = mesh->vertexStride();
+    if (baseTriangles <= 0)
+        baseTriangles = clamp(mesh->numTriangles() / PM_BASE_DIVISOR, PM_MIN_BASE, PM_MAX_BASE);
+
+    // Simplify a copy of the vertices and triangles down to the base mesh,
+    // logging the collapses. Without positions, there are none.
+
+    SimplifyLog log;
+    {
+        MeshBase work;
+        work.addAttribs(*mesh);
+        work.resetVertices(mesh->numVertices());
+        if (mesh->numVertices())
+            work.setVertices(0, mesh->getVertexPtr(), mesh->numVertices());
+        work.resizeSubmeshes(numSubmeshes);
+        for (int i = 0; i < numSubmeshes; i++)
+            work.setIndices(i, mesh->indices(i));
+
+        SimplifyParams params;
+        params.targetTriangles = baseTriangles;
+        params.keepVertices = true;
+        params.log = &log;
+        simplifyQuadric(work, params);
+    }
+
+    if (!log.faces.getSize())
+        for (int i = 0; i < numSubmeshes; i++)
+            for (int j = 0; j < mesh->indices(i).getSize(); j++)
+            {
+                log.faces.add(mesh->indices(i)[j]);
+                log.faceSubmesh.add(i);
+            }
+
+    // Replay the collapses, keeping the faces they remove.
+
+    Array<Vec3i> faces = log.faces;
+    Array<Vec3i> removed(NULL, log.removedFaces.getSize());
+    for (int i = 0; i < log.collapses.getSize(); i++)
+    {
+        const SimplifyLog::Collapse& c = log.collapses[i];
+        for (int j = c.firstRemoved; j < c.firstRemoved + c.numRemoved; j++)
+        {
+            removed[j] = faces[log.removedFaces[j]];
+            faces[log.removedFaces[j]] = Vec3i(-1);
+        }
+        for (int j = c.firstMoved; j < c.firstMoved + c.numMoved; j++)
+        {
+            const Vec4i& m = log.movedCorners[j];
+            FW_ASSERT(faces[m.x][m.y] == m.z);
+            faces[m.x][m.y] = m.w;
+        }
+    }
+
+    // Base mesh: what is left, submesh by submesh, with the vertices in
+    // order of first use.
+
+    Array<S32> vertexId(NULL, mesh->numVertices());
+    Array<S32> faceId(NULL, faces.getSize());
+    Array<S32> order;
+    memset(vertexId.getPtr(), -1, vertexId.getNumBytes());
+    memset(faceId.getPtr(), -1, faceId.getNumBytes());
+
+    MeshBase base;
+    base.addAttribs(*mesh);
+    base.resizeSubmeshes(numSubmeshes);
+    for (int i = 0; i < numSubmeshes; i++)
+        base.material(i) = mesh->material(i);
+
+    Array<Array<S32> > bySubmesh(NULL, numSubmeshes);
+    for (int i = 0; i < faces.getSize(); i++)
+        if (faces[i].x >= 0)
+            bySubmesh[log.faceSubmesh[i]].add(i);
+
+    int numFaces = 0;
+    for (int i = 0; i < numSubmeshes; i++)
+    {
+        Array<Vec3i>& inds = base.mutableIndices(i);
+        inds.reset(bySubmesh[i].getSize());
+        for (int j = 0; j < inds.getSize(); j++)
+        {
+            int f = bySubmesh[i][j];
+            for (int k = 0; k < 3; k++)
+                inds[j][k] = introduceVertex(faces[f][k], vertexId, order);
+            faceId[f] = numFaces++;
+        }
+    }
+    bySubmesh.reset();
+
+    base.resetVertices(order.getSize());
+    for (int i = 0; i < order.getSize(); i++)
+        base.setVertex(i, mesh->getVertexPtr(order[i]));
+
+    // Header and base mesh.
+
+    int numVertices = 0;
+    {
+        Array<U8> used(NULL, mesh->numVertices());
+        memset(used.getPtr(), 0, used.getNumBytes());
+        for (int i = 0; i < log.faces.getSize(); i++)
+            for (int k = 0; k < 3; k++)
+                used[log.faces[i][k]] = 1;
+        for (int i = 0; i < used.getSize(); i++)
+            numVertices += used[i];
+    }
+
+    stream.write("PrgMesh ", 8);
+    stream << (S32)1 << (S32)numVertices << (S32)log.faces.getSize() << (S32)log.collapses.getSize();
+    exportBinaryMesh(stream, &base);
+
+    // Vertex splits: undo the collapses, last first.
+
+    Array<S32> corners;
+    Array<S32> tris;
+    for (int i = log.collapses.getSize() - 1; i >= 0; i--)
+    {
+        const SimplifyLog::Collapse& c = log.collapses[i];
+        int firstVertex = order.getSize();
+        corners.clear();
+        tris.clear();
+
+        for (int j = c.firstMoved + c.numMoved - 1; j >= c.firstMoved; j--)
+        {
+            const Vec4i& m = log.movedCorners[j];
+            faces[m.x][m.y] = m.z;
+            corners.add(faceId[m.x] * 3 + m.y);
+            corners.add(introduceVertex(m.z, vertexId, order));
+        }
+
+        for (int j = c.firstRemoved; j < c.firstRemoved + c.numRemoved; j++)
+        {
+            int f = log.removedFaces[j];
+            faces[f] = removed[j];
+            faceId[f] = numFaces++;
+            tris.add(log.faceSubmesh[f]);
+            for (int k = 0; k < 3; k++)
+                tris.add(introduceVertex(faces[f][k], vertexId, order));
+        }
+
+        stream << (S32)(order.getSize() - firstVertex) << (S32)(corners.getSize() / 2) << (S32)(tris.getSize() / 4);
+        for (int j = firstVertex; j < order.getSize(); j++)
+            stream.write(mesh->getVertexPtr(order[j]), stride);
+        stream.write(corners.getPtr(), corners.getNumBytes());
+        stream.write(tris.getPtr(), tris.getNumBytes());
+    }
+}
+
+//------------------------------------------------------------------------
+
+int FW::introduceVertex(int v, Array<S32>& vertexId, Array<S32>& order)
+{
+    if (vertexId[v] == -1)
+    {
+        vertexId[v] = order.getSize();
+        order.add(v);
+    }
+    return vertexId[v];
+}
+
+//------------------------------------------------------------------------
@@ -0,0 +1,141 @@
+/*
+ *  Copyright (c) 2009-2011, NVIDIA Corporation
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *      * Neither the name of NVIDIA Corporation nor the
+ *        names of its contributors may be used to endorse or promote products
+ *        derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *  DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ *  DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+#include "io/Stream.hpp"
+
+namespace FW
+{
+//------------------------------------------------------------------------
+
+class MeshBase;
+
+//------------------------------------------------------------------------
+
+MeshBase*   importProgressiveMesh   (InputStream& stream);                  // Reads all of the refinements.
+void        exportProgressiveMesh   (OutputStream& stream, const MeshBase* mesh, int baseTriangles = 0); // 0 = a fraction of the mesh, see below.
+
+//------------------------------------------------------------------------
+// Refines a progressive mesh as its vertex splits come in, so that a
+// viewer can show the base mesh right away and more detail every frame.
+//
+// The constructor reads the header and the base mesh; refine() reads and
+// applies vertex splits, blocking on the stream. A viewer that must not
+// block can instead read splits ahead on another thread with readSplits()
+// and apply those that have arrived with applySplits(); the former only
+// uses the stream and the counts of what it has read, the latter only
+// the mesh, so each can have a thread of its own. Each split only appends
+// vertices and triangles and moves corners of existing triangles, so the
+// vertex and triangle indices of the mesh stay valid as it is refined.
+// Triangles are numbered as in the file, see getTriangle(); a viewer that
+// draws them in that order only has to append the new vertices and
+// triangles and rewrite the moved corners.
+//------------------------------------------------------------------------
+
+class ProgressiveMeshReader
+{
+public:
+                        ProgressiveMeshReader   (InputStream& stream);     // On failure, sets the error and leaves no mesh.
+                        ~ProgressiveMeshReader  (void);
+
+    MeshBase*           getMesh                 (void) const                { return m_mesh; }
+    MeshBase*           takeMesh                (void)                      { MeshBase* mesh = m_mesh; m_mesh = NULL; return mesh; } // Refining stops.
+
+    int                 getNumSplits            (void) const                { return m_numSplits; }
+    int                 getNumApplied           (void) const                { return m_numApplied; }
+    bool                isComplete              (void) const                { return (m_numApplied == m_numSplits); }
+    int                 getFinalNumVertices     (void) const                { return m_finalNumVertices; } // From the header.
+    int                 getFinalNumTriangles    (void) const                { return m_finalNumTriangles; }
+
+    int                 getNumTriangles         (void) const                { return m_faces.getSize(); }
+    const Vec3i&        getTriangle             (int idx) const;            // In file order.
+
+    int                 refine                  (int maxSplits, Array<S32>* movedCorners = NULL); // Returns the number applied; stops early at the end or on an error. Optionally lists the moved corners as triangle * 3 + corner.
+
+    int                 getNumRead              (void) const                { return m_numRead; }
+    int                 readSplits              (Array<U8>& splits, int maxSplits); // Appends checked splits, each as its three counts and data; returns the number read.
+    const U8*           applySplits             (const U8* splits, const U8* end, int maxSplits, Array<S32>* movedCorners = NULL); // Next ones from readSplits(); returns where it stopped.
+
+private:
+                        ProgressiveMeshReader   (const ProgressiveMeshReader&); // forbidden
+    ProgressiveMeshReader& operator=            (const ProgressiveMeshReader&); // forbidden
+
+private:
+    InputStream&        m_stream;
+    MeshBase*           m_mesh;
+    S32                 m_numSplits;
+    S32                 m_numApplied;
+    S32                 m_finalNumVertices;
+    S32                 m_finalNumTriangles;
+    Array<Vec2i>        m_faces;                // [triangle] (submesh, index in submesh)
+    Array<U8>           m_buffer;               // Splits read by refine().
+
+    S32                 m_numSubmeshes;         // Used by readSplits().
+    S32                 m_stride;
+    S32                 m_numRead;
+    S32                 m_numReadVertices;      // Once the splits read so far are applied.
+    S32                 m_numReadTriangles;
+};
+
+//------------------------------------------------------------------------
+/*
+
+Progressive mesh file format v1
+-------------------------------
+
+- the basic units of data are 32-bit little-endian ints
+- the vertex splits undo, last first, the edge collapses that
+  simplifyQuadric() did with keepVertices to get from the mesh to the
+  base mesh; applying all of them restores every triangle of the mesh,
+  except those with two corners at one position
+- vertices are numbered in the order they appear, starting with those of
+  the base mesh, and so are triangles, submesh by submesh in the base mesh
+- exportProgressiveMesh() makes the base mesh 1/256 of the triangles,
+  within [1024, 65536], unless told otherwise
+
+ProgressiveMesh
+    0       2       bytes   v1  formatID (must be "PrgMesh ")
+    2       1       int     v1  formatVersion (must be 1)
+    3       1       int     v1  numVertices (once refined)
+    4       1       int     v1  numTriangles (once refined)
+    5       1       int     v1  numSplits
+    6       ?       struct  v1  BinaryMesh (the base mesh, see MeshBinaryIO.hpp)
+    ?       n*?     struct  v1  array of VertexSplit (numSplits)
+    ?
+
+VertexSplit
+    0       1       int     v1  numVertices
+    1       1       int     v1  numCorners
+    2       1       int     v1  numTriangles
+    3       ?       bytes   v1  array of Vertex (numVertices, as in the base mesh)
+    ?       n*2     int     v1  corners (numCorners): triangle * 3 + corner, new vertex
+    ?       n*4     int     v1  triangles (numTriangles): submesh, 3 vertices
+    ?
+
+*/
+//------------------------------------------------------------------------
+}
@@ -27,7 +27,9 @@
 
 #include "io/MeshWavefrontIO.hpp"
 #include "io/File.hpp"
+#include "io/MappedFile.hpp"
 #include "base/Hash.hpp"
+#include "base/MulticoreLauncher.hpp"
 
 using namespace FW;
 
@@ -35,6 +37,9 @@ using namespace FW;
 
 #define WAVEFRONT_DEBUG 0   // 1 = fail on error, 0 = ignore errors
 
+#define CHUNK_MIN_SIZE  (256 << 10) // Smallest piece of the file parsed by one task.
+#define CHUNKS_PER_CORE 4
+
 //------------------------------------------------------------------------
 
 namespace FW
@@ -65,6 +70,41 @@ struct ImportState
 
     Array<S32>              vertexTmp;
     Array<Vec3i>            indexTmp;
+
+    S32                     submesh;
+    S32                     defaultSubmesh;
+};
+
+struct ObjFace
+{
+    S32                     firstCorner;
+    S32                     numCorners;
+    Vec3i                   numVertices;    // Chunk-local v/vt/vn counts at the face.
+    bool                    valid;
+};
+
+struct ObjCommand
+{
+    S32                     firstFace;      // Number of chunk faces preceding the command.
+    bool                    isMtllib;       // false => usemtl
+    String                  name;
+};
+
+struct ObjChunk
+{
+    const char*             begin;
+    const char*             end;
+
+    Array<Vec3f>            positions;
+    Array<Vec2f>            texCoords;
+    Array<Vec3f>            normals;
+    Array<Vec3i>            corners;        // Indices as written in the file.
+    Array<ObjFace>          faces;
+    Array<ObjCommand>       commands;
+
+    Vec3i                   base;           // Global v/vt/vn counts preceding the chunk.
+    Array<S32>              cornerVertex;   // Corner => index in 'vertices'.
+    Array<Vec3i>            vertices;       // Unique resolved corners in order of first use.
 };
 
 template <class T> bool equals  (const VertexPNT& a, const VertexPNT& b);
@@ -72,10 +112,22 @@ template <class T> U32 hash     (const VertexPNT& value);
 
 static bool     parseFloats     (const char*& ptr, F32* values, int num);
 static bool     parseTexture    (const char*& ptr, TextureSpec& value, const String& dirName);
+static bool     parseCorner     (const char*& ptr, Vec3i& ptn);
+static void     resolveCorner   (Vec3i& ptn, const Vec3i& size);
+
+static S32      addVertex       (ImportState& s, const Vec3i& ptn);
+static void     addFace         (ImportState& s);
+static void     useMaterial     (ImportState& s, const char* name);
+static bool     loadMtllib      (ImportState& s, const char* name, const String& dirName);
 
 static void     loadMtl         (ImportState& s, BufferedInputStream& mtlIn, const String& dirName);
 static void     loadObj         (ImportState& s, BufferedInputStream& objIn, const String& dirName);
 
+static const char* readObjLine  (const char*& ptr, const char* end, Array<char>& line);
+static void     parseObjChunk   (MulticoreLauncher::Task& task);
+static void     resolveObjChunk (MulticoreLauncher::Task& task);
+static void     loadObj         (ImportState& s, const char* begin, const char* end, const String& dirName, bool multicore);
+
 }
 
 //------------------------------------------------------------------------
@@ -195,6 +247,113 @@ bool FW::parseTexture(const char*& ptr, TextureSpec& value, const String& dirNam
 
 //------------------------------------------------------------------------
 
+bool FW::parseCorner(const char*& ptr, Vec3i& ptn)
+{
+    ptn = Vec3i(0);
+    if (!parseInt(ptr, ptn.x))
+        return false;
+    for (int i = 1; i < 4 && parseLiteral(ptr, "/"); i++)
+    {
+        S32 tmp = 0;
+        parseInt(ptr, tmp);
+        if (i < 3)
+            ptn[i] = tmp;
+    }
+    parseSpace(ptr);
+    return true;
+}
+
+//------------------------------------------------------------------------
+
+void FW::resolveCorner(Vec3i& ptn, const Vec3i& size)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (ptn[i] < 0)
+            ptn[i] += size[i];
+        else
+            ptn[i]--;
+
+        if (ptn[i] < 0 || ptn[i] >= size[i])
+            ptn[i] = -1;
+    }
+}
+
+//------------------------------------------------------------------------
+
+S32 FW::addVertex(ImportState& s, const Vec3i& ptn)
+{
+    S32* idx = s.vertexHash.search(ptn);
+    if (idx)
+        return *idx;
+
+    S32 res = s.vertexHash.add(ptn, s.mesh->numVertices());
+    VertexPNT& v = s.mesh->addVertex();
+    v.p = (ptn.x == -1) ? Vec3f(0.0f) : s.positions[ptn.x];
+    v.t = (ptn.y == -1) ? Vec2f(0.0f) : s.texCoords[ptn.y];
+    v.n = (ptn.z == -1) ? Vec3f(0.0f) : s.normals[ptn.z];
+    return res;
+}
+
+//------------------------------------------------------------------------
+
+void FW::addFace(ImportState& s)
+{
+    if (s.submesh == -1)
+    {
+        if (s.defaultSubmesh == -1)
+            s.defaultSubmesh = s.mesh->addSubmesh();
+        s.submesh = s.defaultSubmesh;
+    }
+    for (int i = 2; i < s.vertexTmp.getSize(); i++)
+        s.indexTmp.add(Vec3i(s.vertexTmp[0], s.vertexTmp[i - 1], s.vertexTmp[i]));
+}
+
+//------------------------------------------------------------------------
+
+void FW::useMaterial(ImportState& s, const char* name)
+{
+    Material* mat = s.materialHash.search(name);
+    if (s.submesh != -1)
+    {
+        s.mesh->mutableIndices(s.submesh).add(s.indexTmp);
+        s.indexTmp.clear();
+        s.submesh = -1;
+    }
+    if (mat)
+    {
+        if (mat->submesh == -1)
+        {
+            mat->submesh = s.mesh->addSubmesh();
+            s.mesh->material(mat->submesh) = *mat;
+        }
+        s.submesh = mat->submesh;
+        s.indexTmp.clear();
+    }
+}
+
+//------------------------------------------------------------------------
+
+bool FW::loadMtllib(ImportState& s, const char* name, const String& dirName)
+{
+    if (!dirName.getLength())
+        return true;
+    if (hasError())
+        return false;
+
+    String fileName = dirName + "/" + name;
+    File file(fileName, File::Read);
+    BufferedInputStream mtlIn(file);
+    loadMtl(s, mtlIn, fileName.getDirName());
+
+#if (!WAVEFRONT_DEBUG)
+    clearError();
+#endif
+    return true;
+}
+
+//------------------------------------------------------------------------
+
 void FW::loadMtl(ImportState& s, BufferedInputStream& mtlIn, const String& dirName)
 {
     Material* mat = NULL;
@@ -332,9 +491,6 @@ void FW::loadMtl(ImportState& s, BufferedInputStream& mtlIn, const String& dirNa
 
 void FW::loadObj(ImportState& s, BufferedInputStream& objIn, const String& dirName)
 {
-    int submesh = -1;
-    int defaultSubmesh = -1;
-
     for (int lineNum = 1;; lineNum++)
     {
         const char* line = objIn.readLine(true, true);
@@ -385,94 +541,27 @@ void FW::loadObj(ImportState& s, BufferedInputStream& objIn, const String& dirNa
         else if (parseLiteral(ptr, "f ") && parseSpace(ptr)) // face
         {
             s.vertexTmp.clear();
-            while (*ptr)
+            Vec3i ptn;
+            while (*ptr && parseCorner(ptr, ptn))
             {
-                Vec3i ptn;
-                if (!parseInt(ptr, ptn.x))
-                    break;
-                for (int i = 1; i < 4 && parseLiteral(ptr, "/"); i++)
-                {
-                    S32 tmp = 0;
-                    parseInt(ptr, tmp);
-                    if (i < 3)
-                        ptn[i] = tmp;
-                }
-                parseSpace(ptr);
-
-                Vec3i size(s.positions.getSize(), s.texCoords.getSize(), s.normals.getSize());
-                for (int i = 0; i < 3; i++)
-                {
-                    if (ptn[i] < 0)
-                        ptn[i] += size[i];
-                    else
-                        ptn[i]--;
-
-                    if (ptn[i] < 0 || ptn[i] >= size[i])
-                        ptn[i] = -1;
-                }
-
-                S32* idx = s.vertexHash.search(ptn);
-                if (idx)
-                    s.vertexTmp.add(*idx);
-                else
-                {
-                    s.vertexTmp.add(s.vertexHash.add(ptn, s.mesh->numVertices()));
-                    VertexPNT& v = s.mesh->addVertex();
-                v.p = (ptn.x == -1) ? Vec3f(0.0f) : s.positions[ptn.x];
-                v.t = (ptn.y == -1) ? Vec2f(0.0f) : s.texCoords[ptn.y];
-                v.n = (ptn.z == -1) ? Vec3f(0.0f) : s.normals[ptn.z];
-                }
+                resolveCorner(ptn, Vec3i(s.positions.getSize(), s.texCoords.getSize(), s.normals.getSize()));
+                s.vertexTmp.add(addVertex(s, ptn));
             }
             if (!*ptr)
             {
-                if (submesh == -1)
-                {
-                    if (defaultSubmesh == -1)
-                        defaultSubmesh = s.mesh->addSubmesh();
-                    submesh = defaultSubmesh;
-                }
-                for (int i = 2; i < s.vertexTmp.getSize(); i++)
-                    s.indexTmp.add(Vec3i(s.vertexTmp[0], s.vertexTmp[i - 1], s.vertexTmp[i]));
+                addFace(s);
                 valid = true;
             }
         }
         else if (parseLiteral(ptr, "usemtl ") && parseSpace(ptr)) // material name
         {
-            Material* mat = s.materialHash.search(ptr);
-            if (submesh != -1)
-            {
-                s.mesh->mutableIndices(submesh).add(s.indexTmp);
-                s.indexTmp.clear();
-            submesh = -1;
-            }
-            if (mat)
-            {
-                if (mat->submesh == -1)
-                {
-                    mat->submesh = s.mesh->addSubmesh();
-                    s.mesh->material(mat->submesh) = *mat;
-                }
-                submesh = mat->submesh;
-                s.indexTmp.clear();
-            }
+            useMaterial(s, ptr);
             valid = true;
         }
         else if (parseLiteral(ptr, "mtllib ") && parseSpace(ptr) && *ptr) // material library
         {
-            if (dirName.getLength())
-            {
-                if (hasError())
-                    break;
-
-                String fileName = dirName + "/" + ptr;
-                File file(fileName, File::Read);
-                BufferedInputStream mtlIn(file);
-                loadMtl(s, mtlIn, fileName.getDirName());
-
-#if (!WAVEFRONT_DEBUG)
-                clearError();
-#endif
-            }
+            if (!loadMtllib(s, ptr, dirName))
+                break;
             valid = true;
         }
         else if (
@@ -518,8 +607,301 @@ void FW::loadObj(ImportState& s, BufferedInputStream& objIn, const String& dirNa
 
     // Flush remaining indices.
 
-    if (submesh != -1)
-        s.mesh->mutableIndices(submesh).add(s.indexTmp);
+    if (s.submesh != -1)
+        s.mesh->mutableIndices(s.submesh).add(s.indexTmp);
+}
+
+//------------------------------------------------------------------------
+
+const char* FW::readObjLine(const char*& ptr, const char* end, Array<char>& line)
+{
+    // Same transformation as BufferedInputStream::readLine(true, true).
+
+    if (ptr >= end)
+        return NULL;
+
+    line.clear();
+    bool pendingBackslash = false;
+
+    while (ptr < end)
+    {
+        char chr = *ptr++;
+        if ((U8)chr >= 32 && chr != '\\' && !pendingBackslash)
+            line.add(chr);
+        else if (chr == '\n')
+        {
+            if (!pendingBackslash)
+            {
+                line.add('\0');
+                return line.getPtr();
+            }
+            line.add(' ');
+            pendingBackslash = false;
+        }
+        else if (chr != '\r')
+        {
+            if (pendingBackslash)
+            {
+                line.add('\\');
+                pendingBackslash = false;
+            }
+            if (chr == '\t')
+                line.add(' ');
+            else if (chr == '\\')
+                pendingBackslash = true;
+            else
+                line.add(chr);
+        }
+    }
+
+    if (pendingBackslash)
+        line.add('\\');
+    line.add('\0');
+    return line.getPtr();
+}
+
+//------------------------------------------------------------------------
+
+void FW::parseObjChunk(MulticoreLauncher::Task& task)
+{
+    ObjChunk& chunk = (*(Array<ObjChunk>*)task.data)[task.idx];
+    const char* src = chunk.begin;
+    Array<char> line;
+
+    // Parse everything that does not depend on preceding chunks.
+    // Faces keep their raw indices, material statements are deferred.
+
+    for (;;)
+    {
+        const char* ptr = readObjLine(src, chunk.end, line);
+        if (!ptr)
+            break;
+
+        parseSpace(ptr);
+        if (!*ptr || parseLiteral(ptr, "#"))
+        {
+        }
+        else if (parseLiteral(ptr, "v ") && parseSpace(ptr)) // position vertex
+        {
+            Vec3f v;
+            if (parseFloats(ptr, v.getPtr(), 3) && parseSpace(ptr) && !*ptr)
+                chunk.positions.add(v);
+        }
+        else if (parseLiteral(ptr, "vt ") && parseSpace(ptr)) // texture vertex
+        {
+            Vec2f v;
+            if (parseFloats(ptr, v.getPtr(), 2) && parseSpace(ptr))
+            {
+                F32 dummy;
+                while (parseFloat(ptr, dummy) && parseSpace(ptr));
+
+                if (!*ptr)
+                    chunk.texCoords.add(Vec2f(v.x, 1.0f - v.y));
+            }
+        }
+        else if (parseLiteral(ptr, "vn ") && parseSpace(ptr)) // normal vertex
+        {
+            Vec3f v;
+            if (parseFloats(ptr, v.getPtr(), 3) && parseSpace(ptr) && !*ptr)
+                chunk.normals.add(v);
+        }
+        else if (parseLiteral(ptr, "f ") && parseSpace(ptr)) // face
+        {
+            ObjFace& face = chunk.faces.add();
+            face.firstCorner = chunk.corners.getSize();
+            face.numVertices = Vec3i(chunk.positions.getSize(), chunk.texCoords.getSize(), chunk.normals.getSize());
+
+            Vec3i ptn;
+            while (*ptr && parseCorner(ptr, ptn))
+                chunk.corners.add(ptn);
+
+            face.numCorners = chunk.corners.getSize() - face.firstCorner;
+            face.valid = (!*ptr);
+        }
+        else if (parseLiteral(ptr, "usemtl ") && parseSpace(ptr)) // material name
+        {
+            ObjCommand& cmd = chunk.commands.add();
+            cmd.firstFace = chunk.faces.getSize();
+            cmd.isMtllib = false;
+            cmd.name = ptr;
+        }
+        else if (parseLiteral(ptr, "mtllib ") && parseSpace(ptr) && *ptr) // material library
+        {
+            ObjCommand& cmd = chunk.commands.add();
+            cmd.firstFace = chunk.faces.getSize();
+            cmd.isMtllib = true;
+            cmd.name = ptr;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void FW::resolveObjChunk(MulticoreLauncher::Task& task)
+{
+    ObjChunk& chunk = (*(Array<ObjChunk>*)task.data)[task.idx];
+    Hash<Vec3i, S32> vertexHash;
+    chunk.cornerVertex.reset(chunk.corners.getSize());
+
+    // Turn raw indices into absolute ones and find the unique corners.
+
+    for (int i = 0; i < chunk.faces.getSize(); i++)
+    {
+        const ObjFace& face = chunk.faces[i];
+        Vec3i size = chunk.base + face.numVertices;
+
+        for (int j = face.firstCorner; j < face.firstCorner + face.numCorners; j++)
+        {
+            Vec3i ptn = chunk.corners[j];
+            resolveCorner(ptn, size);
+
+            S32* idx = vertexHash.search(ptn);
+            if (idx)
+                chunk.cornerVertex[j] = *idx;
+            else
+            {
+                chunk.cornerVertex[j] = vertexHash.add(ptn, chunk.vertices.getSize());
+                chunk.vertices.add(ptn);
+            }
+        }
+    }
+    chunk.corners.reset();
+}
+
+//------------------------------------------------------------------------
+
+void FW::loadObj(ImportState& s, const char* begin, const char* end, const String& dirName, bool multicore)
+{
+    // Split at line breaks that are not escaped with a backslash.
+
+    S64 size = end - begin;
+    int numChunks = (multicore) ? (int)clamp(size / CHUNK_MIN_SIZE, (S64)1, (S64)MulticoreLauncher::getNumCores() * CHUNKS_PER_CORE) : 1;
+
+    Array<ObjChunk> chunks;
+    chunks.reset(numChunks);
+
+    const char* ptr = begin;
+    for (int i = 0; i < numChunks; i++)
+    {
+        ObjChunk& chunk = chunks[i];
+        chunk.begin = ptr;
+        ptr = max(ptr, begin + size * (i + 1) / numChunks);
+
+        while (ptr < end && i != numChunks - 1)
+        {
+            const char* nl = (const char*)memchr(ptr, '\n', end - ptr);
+            if (!nl)
+            {
+                ptr = end;
+                break;
+            }
+
+            const char* last = nl;
+            while (last > begin && last[-1] == '\r')
+                last--;
+
+            ptr = nl + 1;
+            if (last == begin || last[-1] != '\\')
+                break;
+        }
+
+        chunk.end = (i == numChunks - 1) ? end : ptr;
+    }
+
+    // Parse chunks.
+
+    if (numChunks > 1)
+        MulticoreLauncher().push(parseObjChunk, &chunks, 0, numChunks).popAll();
+    else if (numChunks == 1)
+    {
+        MulticoreLauncher::Task task;
+        task.data = &chunks;
+        task.idx = 0;
+        parseObjChunk(task);
+    }
+
+    // Prefix sum of vertex counts, so that relative indices can be resolved.
+
+    Vec3i base(0);
+    for (int i = 0; i < numChunks; i++)
+    {
+        ObjChunk& chunk = chunks[i];
+        chunk.base = base;
+        base += Vec3i(chunk.positions.getSize(), chunk.texCoords.getSize(), chunk.normals.getSize());
+    }
+
+    s.positions.setCapacity(base.x);
+    s.texCoords.setCapacity(base.y);
+    s.normals.setCapacity(base.z);
+    for (int i = 0; i < numChunks; i++)
+    {
+        ObjChunk& chunk = chunks[i];
+        s.positions.add(chunk.positions);
+        s.texCoords.add(chunk.texCoords);
+        s.normals.add(chunk.normals);
+        chunk.positions.reset();
+        chunk.texCoords.reset();
+        chunk.normals.reset();
+    }
+
+    // Resolve indices and deduplicate corners within each chunk.
+
+    if (numChunks > 1)
+        MulticoreLauncher().push(resolveObjChunk, &chunks, 0, numChunks).popAll();
+    else if (numChunks == 1)
+    {
+        MulticoreLauncher::Task task;
+        task.data = &chunks;
+        task.idx = 0;
+        resolveObjChunk(task);
+    }
+
+    // Replay faces and material statements in file order.
+
+    bool done = false;
+    for (int i = 0; i < numChunks && !done; i++)
+    {
+        ObjChunk& chunk = chunks[i];
+        Array<S32> remap;
+        remap.reset(chunk.vertices.getSize());
+        for (int j = 0; j < remap.getSize(); j++)
+            remap[j] = -1;
+
+        int cmdIdx = 0;
+        for (int j = 0; j <= chunk.faces.getSize() && !done; j++)
+        {
+            for (; cmdIdx < chunk.commands.getSize() && chunk.commands[cmdIdx].firstFace == j; cmdIdx++)
+            {
+                const ObjCommand& cmd = chunk.commands[cmdIdx];
+                if (!cmd.isMtllib)
+                    useMaterial(s, cmd.name.getPtr());
+                else if (!loadMtllib(s, cmd.name.getPtr(), dirName))
+                {
+                    done = true;
+                    break;
+                }
+            }
+            if (done || j == chunk.faces.getSize())
+                break;
+
+            const ObjFace& face = chunk.faces[j];
+            s.vertexTmp.clear();
+            for (int k = face.firstCorner; k < face.firstCorner + face.numCorners; k++)
+            {
+                S32& idx = remap[chunk.cornerVertex[k]];
+                if (idx == -1)
+                    idx = addVertex(s, chunk.vertices[chunk.cornerVertex[k]]);
+                s.vertexTmp.add(idx);
+            }
+            if (face.valid)
+                addFace(s);
+        }
+    }
+
+    // Flush remaining indices.
+
+    if (s.submesh != -1)
+        s.mesh->mutableIndices(s.submesh).add(s.indexTmp);
 }
 
 //------------------------------------------------------------------------
@@ -538,6 +920,8 @@ Mesh<VertexPNT>* FW::importWavefrontMesh(BufferedInputStream& stream, const Stri
     s.normals.setCapacity(vertexCapacity);
     s.vertexHash.setCapacity(vertexCapacity);
     s.indexTmp.setCapacity(indexCapacity);
+    s.submesh = -1;
+    s.defaultSubmesh = -1;
 
     loadObj(s, stream, fileName.getDirName());
     s.mesh->compact();
@@ -546,6 +930,28 @@ Mesh<VertexPNT>* FW::importWavefrontMesh(BufferedInputStream& stream, const Stri
 
 //------------------------------------------------------------------------
 
+Mesh<VertexPNT>* FW::importWavefrontMesh(const MappedFile& file, bool multicore)
+{
+    int vertexCapacity = 4 << 10;
+    int indexCapacity = 4 << 10;
+
+    ImportState s;
+    s.mesh = new Mesh<VertexPNT>;
+    s.mesh->resizeVertices(vertexCapacity);
+    s.mesh->clearVertices();
+    s.vertexHash.setCapacity(vertexCapacity);
+    s.indexTmp.setCapacity(indexCapacity);
+    s.submesh = -1;
+    s.defaultSubmesh = -1;
+
+    if (file.isMapped())
+        loadObj(s, file.getChars(), file.getCharsEnd(), file.getName().getDirName(), multicore);
+    s.mesh->compact();
+    return s.mesh;
+}
+
+//------------------------------------------------------------------------
+
 void FW::exportWavefrontMesh(BufferedOutputStream& stream, const MeshBase* mesh, const String& fileName)
 {
     FW_ASSERT(mesh);
@@ -34,10 +34,12 @@ namespace FW
 
 class BufferedInputStream;
 class BufferedOutputStream;
+class MappedFile;
 
 //------------------------------------------------------------------------
 
 Mesh<VertexPNT>*    importWavefrontMesh (BufferedInputStream& stream, const String& fileName);
+Mesh<VertexPNT>*    importWavefrontMesh (const MappedFile& file, bool multicore = true); // Parses newline-aligned chunks in parallel, same result as above.
 void                exportWavefrontMesh (BufferedOutputStream& stream, const MeshBase* mesh, const String& fileName);
 
 //------------------------------------------------------------------------